@@ -0,0 +1,126 @@
+// Copyright (c) 2024 Broadcom. All Rights Reserved.
+// The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
+// SPDX-License-Identifier: GPL-2.0
+
+/*
+ * Compare the speed of reading a file through a plain FileImage with the
+ * speed of reading a block compressed copy of that file, as written by
+ * "chap -z", both sequentially and at random offsets.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include "../src/FileImage.h"
+
+using namespace chap;
+
+namespace {
+constexpr uint64_t NUM_RANDOM_READS = 100000;
+constexpr uint64_t RANDOM_READ_SIZE = 64;
+
+double SecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+/*
+ * Read the whole image in order, returning a checksum so that the reads
+ * can't be optimized away and the two images can be checked to match.
+ */
+uint64_t ReadSequentially(const FileImage &fileImage, double &seconds) {
+  const char *image = fileImage.GetImage();
+  uint64_t size = fileImage.GetFileSize();
+  uint64_t sum = 0;
+  auto start = std::chrono::steady_clock::now();
+  uint64_t offset = 0;
+  for (; offset + sizeof(uint64_t) <= size; offset += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, image + offset, sizeof(word));
+    sum += word;
+  }
+  for (; offset < size; offset++) {
+    sum += (unsigned char)(image[offset]);
+  }
+  seconds = SecondsSince(start);
+  return sum;
+}
+
+uint64_t ReadRandomly(const FileImage &fileImage, double &seconds) {
+  const char *image = fileImage.GetImage();
+  uint64_t size = fileImage.GetFileSize();
+  if (size < RANDOM_READ_SIZE) {
+    seconds = 0;
+    return 0;
+  }
+  std::mt19937_64 generator(0);
+  std::uniform_int_distribution<uint64_t> offsets(0, size - RANDOM_READ_SIZE);
+  uint64_t sum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < NUM_RANDOM_READS; i++) {
+    char buffer[RANDOM_READ_SIZE];
+    memcpy(buffer, image + offsets(generator), RANDOM_READ_SIZE);
+    for (uint64_t j = 0; j < RANDOM_READ_SIZE; j++) {
+      sum += (unsigned char)(buffer[j]);
+    }
+  }
+  seconds = SecondsSince(start);
+  return sum;
+}
+
+void Report(const char *label, const FileImage &fileImage,
+            uint64_t &sequentialSum, uint64_t &randomSum) {
+  double sequentialSeconds;
+  double randomSeconds;
+  sequentialSum = ReadSequentially(fileImage, sequentialSeconds);
+  randomSum = ReadRandomly(fileImage, randomSeconds);
+  double megabytes = (double)(fileImage.GetFileSize()) / (1 << 20);
+  std::cout << std::fixed << std::setprecision(1) << label << ": "
+            << megabytes / sequentialSeconds << " MB/s sequential, "
+            << (double)(NUM_RANDOM_READS) / randomSeconds / 1000.0
+            << " thousand " << RANDOM_READ_SIZE
+            << "-byte reads/s at random offsets\n";
+}
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (argc != 3 && argc != 4) {
+    std::cerr << "Usage: fileImageBenchmark <file> <compressed-file> "
+                 "[<megabytes>]\n\n"
+                 "<compressed-file> should have been written by\n"
+                 "chap -z <compressed-file> <file>\n"
+                 "<megabytes> is how much of <compressed-file> to keep\n"
+                 "decompressed at once, which is 1024 by default.\n";
+    return 1;
+  }
+  uint64_t cacheSize = BlockCompressedImage::DEFAULT_CACHE_SIZE;
+  if (argc == 4) {
+    cacheSize = strtoull(argv[3], nullptr, 10) << 20;
+  }
+  try {
+    FileImage plainImage(argv[1]);
+    FileImage compressedImage(argv[2], true, cacheSize);
+    if (plainImage.GetFileSize() != compressedImage.GetFileSize()) {
+      std::cerr << "The files do not have the same contents.\n";
+      return 1;
+    }
+    uint64_t plainSequentialSum, plainRandomSum;
+    uint64_t compressedSequentialSum, compressedRandomSum;
+    Report("plain", plainImage, plainSequentialSum, plainRandomSum);
+    Report("compressed", compressedImage, compressedSequentialSum,
+           compressedRandomSum);
+    if (plainSequentialSum != compressedSequentialSum ||
+        plainRandomSum != compressedRandomSum) {
+      std::cerr << "The files do not have the same contents.\n";
+      return 1;
+    }
+  } catch (...) {
+    return 1;
+  }
+  return 0;
+}
@@ -1,4 +1,4 @@
-// Copyright (c) 2017-2019 Broadcom. All Rights Reserved.
+// Copyright (c) 2017-2019,2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
@@ -13,6 +13,7 @@ namespace Allocations {
 template <typename Offset>
 class AnchorChainLister : public Graph<Offset>::AnchorChainVisitor {
  public:
+  typedef typename Graph<Offset>::Anchors Anchors;
   AnchorChainLister(const InModuleDescriber<Offset>& inModuleDescriber,
                     const StackDescriber<Offset>& stackDescriber,
                     const Graph<Offset>& graph,
@@ -35,7 +36,7 @@ class AnchorChainLister : public Graph<Offset>::AnchorChainVisitor {
     // head vs whole chain
   }
 
-  bool VisitStaticAnchorChainHeader(const std::vector<Offset>& staticAddrs,
+  bool VisitStaticAnchorChainHeader(const Anchors& staticAddrs,
                                     Offset address, Offset size,
                                     const char* image) {
     Commands::Output& output = _context.GetOutput();
@@ -55,9 +56,7 @@ class AnchorChainLister : public Graph<Offset>::AnchorChainVisitor {
       ShowSignatureIfPresent(output, size, image);
       output << ".\n";
     }
-    for (typename std::vector<Offset>::const_iterator it = staticAddrs.begin();
-         it != staticAddrs.end(); ++it) {
-      Offset staticAddr = *it;
+    for (Offset staticAddr : staticAddrs) {
       _inModuleDescriber.Describe(_context, staticAddr, false, true);
       output << "Static address 0x" << staticAddr;
       const std::string& name = _anchorDirectory.Name(staticAddr);
@@ -74,7 +73,7 @@ class AnchorChainLister : public Graph<Offset>::AnchorChainVisitor {
     return false;
   }
 
-  bool VisitStackAnchorChainHeader(const std::vector<Offset>& stackAddrs,
+  bool VisitStackAnchorChainHeader(const Anchors& stackAddrs,
                                    Offset address, Offset size,
                                    const char* image) {
     Commands::Output& output = _context.GetOutput();
@@ -95,9 +94,7 @@ class AnchorChainLister : public Graph<Offset>::AnchorChainVisitor {
       ShowSignatureIfPresent(output, size, image);
       output << ".\n";
     }
-    for (typename std::vector<Offset>::const_iterator it = stackAddrs.begin();
-         it != stackAddrs.end(); ++it) {
-      Offset stackAddr = *it;
+    for (Offset stackAddr : stackAddrs) {
       _stackDescriber.Describe(_context, stackAddr, false, true);
       output << "Stack address 0x" << std::hex << stackAddr << " references"
              << (isDirect ? " 0x" : " anchor point 0x") << address
@@ -0,0 +1,152 @@
+// Copyright (c) 2024 Broadcom. All Rights Reserved.
+// The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
+// SPDX-License-Identifier: GPL-2.0
+
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "../AnalysisCache.h"
+
+namespace chap {
+namespace Allocations {
+/*
+ * An AnchorList is a view of the anchors, such as the addresses of the
+ * static or stack words, that refer to a single anchor point.  It stays
+ * valid as long as the AnchorPoints it came from.
+ */
+template <typename Offset>
+class AnchorList {
+ public:
+  AnchorList() : _first(nullptr), _limit(nullptr) {}
+  AnchorList(const Offset* first, const Offset* limit)
+      : _first(first), _limit(limit) {}
+  const Offset* begin() const { return _first; }
+  const Offset* end() const { return _limit; }
+  size_t size() const { return _limit - _first; }
+  bool empty() const { return _first == _limit; }
+
+ private:
+  const Offset* _first;
+  const Offset* _limit;
+};
+
+/*
+ * An AnchorPoints holds the anchors for each anchor point of one kind in
+ * flat arrays sorted by allocation index, rather than in a map with a
+ * separate vector per anchor point, because there may be a huge number of
+ * anchor points with just one or two anchors each.
+ *
+ * The anchors are first added in any order with Add, then Finish must be
+ * called before any lookups.  The anchors for any one anchor point keep the
+ * order in which they were added.
+ */
+template <typename Index, typename Offset>
+class AnchorPoints {
+ public:
+  void Add(Index index, Offset anchor) { _pending.emplace_back(index, anchor); }
+
+  /*
+   * Add all the anchors that have been added to the given anchor points,
+   * which must not have been finished, leaving it empty.
+   */
+  void Append(AnchorPoints& other) {
+    if (_pending.empty()) {
+      _pending.swap(other._pending);
+    } else {
+      _pending.insert(_pending.end(), other._pending.begin(),
+                      other._pending.end());
+    }
+    std::vector<std::pair<Index, Offset> > pending;
+    pending.swap(other._pending);
+  }
+
+  void Finish() {
+    std::stable_sort(
+        _pending.begin(), _pending.end(),
+        [](const std::pair<Index, Offset>& left,
+           const std::pair<Index, Offset>& right) {
+          return left.first < right.first;
+        });
+    _indices.clear();
+    _firstAnchor.clear();
+    _anchors.clear();
+    _anchors.reserve(_pending.size());
+    for (const auto& indexAndAnchor : _pending) {
+      if (_indices.empty() || _indices.back() != indexAndAnchor.first) {
+        _indices.push_back(indexAndAnchor.first);
+        _firstAnchor.push_back(_anchors.size());
+      }
+      _anchors.push_back(indexAndAnchor.second);
+    }
+    _firstAnchor.push_back(_anchors.size());
+    std::vector<std::pair<Index, Offset> > pending;
+    pending.swap(_pending);
+    _indices.shrink_to_fit();
+    _firstAnchor.shrink_to_fit();
+  }
+
+  /*
+   * Return the number of anchor points.
+   */
+  size_t Size() const { return _indices.size(); }
+
+  /*
+   * Return the allocation index of the given anchor point, where anchor
+   * points are numbered in increasing order of allocation index.
+   */
+  Index IndexAt(size_t i) const { return _indices[i]; }
+
+  /*
+   * Return the anchors for the given allocation, which are empty if the
+   * allocation is not an anchor point of this kind.
+   */
+  AnchorList<Offset> Find(Index index) const {
+    typename std::vector<Index>::const_iterator it =
+        std::lower_bound(_indices.begin(), _indices.end(), index);
+    if (it == _indices.end() || *it != index) {
+      return AnchorList<Offset>();
+    }
+    size_t i = it - _indices.begin();
+    return AnchorList<Offset>(_anchors.data() + _firstAnchor[i],
+                              _anchors.data() + _firstAnchor[i + 1]);
+  }
+
+  size_t MemoryFootprint() const {
+    return _indices.capacity() * sizeof(Index) +
+           _firstAnchor.capacity() * sizeof(uint64_t) +
+           _anchors.capacity() * sizeof(Offset);
+  }
+
+  void Write(AnalysisCacheWriter& writer) const {
+    writer.WriteVector(_indices);
+    writer.WriteVector(_firstAnchor);
+    writer.WriteVector(_anchors);
+  }
+
+  bool Read(AnalysisCacheReader& reader, Index numAllocations) {
+    if (!reader.ReadVector(_indices) || !reader.ReadVector(_firstAnchor) ||
+        !reader.ReadVector(_anchors) ||
+        _firstAnchor.size() != _indices.size() + 1 || _firstAnchor[0] != 0 ||
+        _firstAnchor.back() != _anchors.size()) {
+      return reader.Fail();
+    }
+    for (size_t i = 0; i < _indices.size(); i++) {
+      if (_indices[i] >= numAllocations ||
+          (i > 0 && _indices[i] <= _indices[i - 1]) ||
+          _firstAnchor[i + 1] <= _firstAnchor[i]) {
+        return reader.Fail();
+      }
+    }
+    return true;
+  }
+
+ private:
+  std::vector<std::pair<Index, Offset> > _pending;
+  std::vector<Index> _indices;
+  std::vector<uint64_t> _firstAnchor;
+  std::vector<Offset> _anchors;
+};
+}  // namespace Allocations
+}  // namespace chap
@@ -0,0 +1,317 @@
+// Copyright (c) 2024 Broadcom. All Rights Reserved.
+// The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
+// SPDX-License-Identifier: GPL-2.0
+
+#pragma once
+#include <algorithm>
+#include <vector>
+#include "../Commands/Runner.h"
+#include "../VirtualAddressMap.h"
+#include "Directory.h"
+#include "Graph.h"
+
+namespace chap {
+namespace Allocations {
+/*
+ * A LinkFollower finds the allocation that follows a given one in a chain
+ * by reading the link at a fixed offset in the given allocation and finding
+ * the allocation that contains the link target.
+ */
+template <typename Offset>
+class LinkFollower {
+ public:
+  typedef typename Directory<Offset>::AllocationIndex AllocationIndex;
+  typedef typename Directory<Offset>::Allocation Allocation;
+  LinkFollower(const Directory<Offset>& directory,
+               const VirtualAddressMap<Offset>& addressMap, Offset linkOffset)
+      : _directory(directory),
+        _locator(directory),
+        _reader(addressMap),
+        _numAllocations(directory.NumAllocations()),
+        _linkOffset(linkOffset) {}
+
+  AllocationIndex Follow(AllocationIndex index) {
+    const Allocation* allocation = _directory.AllocationAt(index);
+    if (allocation == 0) {
+      abort();
+    }
+    if (allocation->Size() < _linkOffset + sizeof(Offset)) {
+      return _numAllocations;
+    }
+    Offset target = _reader.ReadOffset(allocation->Address() + _linkOffset, 0);
+    if (target == 0) {
+      return _numAllocations;
+    }
+    /*
+     * The next link is normally either at the target, for a link to the
+     * link field, or at the link offset from the target, for a link to the
+     * start of the allocation.  Start fetching both while the directory
+     * is searched for the allocation containing the target.
+     */
+    _reader.Prefetch(target);
+    _reader.Prefetch(target + _linkOffset);
+    return _locator.AllocationIndexOf(target);
+  }
+
+ private:
+  const Directory<Offset>& _directory;
+  typename Directory<Offset>::Locator _locator;
+  typename VirtualAddressMap<Offset>::Reader _reader;
+  const AllocationIndex _numAllocations;
+  const Offset _linkOffset;
+};
+
+/*
+ * An IncomingLinkFollower walks a chain backwards, finding the allocation
+ * that precedes a given one as the only allocation that references it with
+ * a link at the given source offset that points to the given offset in the
+ * target.
+ */
+template <typename Offset>
+class IncomingLinkFollower {
+ public:
+  typedef typename Directory<Offset>::AllocationIndex AllocationIndex;
+  typedef typename Directory<Offset>::Allocation Allocation;
+  IncomingLinkFollower(const Directory<Offset>& directory,
+                       const Graph<Offset>& graph,
+                       const VirtualAddressMap<Offset>& addressMap,
+                       Offset linkOffset, Offset targetOffset)
+      : _directory(directory),
+        _graph(graph),
+        _reader(addressMap),
+        _numAllocations(directory.NumAllocations()),
+        _linkOffset(linkOffset),
+        _targetOffset(targetOffset) {}
+
+  AllocationIndex Follow(AllocationIndex index) {
+    const Allocation* target = _directory.AllocationAt(index);
+    if (target == 0) {
+      abort();
+    }
+    if (target->Size() < _targetOffset) {
+      return _numAllocations;
+    }
+    Offset linkTarget = target->Address() + _targetOffset;
+    const AllocationIndex* pFirstIncoming;
+    const AllocationIndex* pPastIncoming;
+    _graph.GetIncoming(index, &pFirstIncoming, &pPastIncoming);
+
+    /*
+     * Start fetching the links of all the candidates before checking any
+     * of them, because each check is otherwise likely to wait for memory.
+     */
+    for (const AllocationIndex* pIncoming = pFirstIncoming;
+         pIncoming != pPastIncoming; ++pIncoming) {
+      const Allocation* source = _directory.AllocationAt(*pIncoming);
+      if (source == 0) {
+        abort();
+      }
+      _reader.Prefetch(source->Address() + _linkOffset);
+    }
+
+    AllocationIndex previous = _numAllocations;
+    for (const AllocationIndex* pIncoming = pFirstIncoming;
+         pIncoming != pPastIncoming; ++pIncoming) {
+      const Allocation* source = _directory.AllocationAt(*pIncoming);
+      if ((source->Size() >= _linkOffset + sizeof(Offset)) &&
+          (_reader.ReadOffset(source->Address() + _linkOffset, 0) ==
+           linkTarget)) {
+        if (previous != _numAllocations) {
+          // The chain ends where more than one suitable edge exists.
+          return _numAllocations;
+        }
+        previous = *pIncoming;
+      }
+    }
+    return previous;
+  }
+
+ private:
+  const Directory<Offset>& _directory;
+  const Graph<Offset>& _graph;
+  typename VirtualAddressMap<Offset>::Reader _reader;
+  const AllocationIndex _numAllocations;
+  const Offset _linkOffset;
+  const Offset _targetOffset;
+};
+
+/*
+ * A ChainWalker visits, in order and each only once, the allocations of a
+ * chain in which each allocation leads to at most one next one, as decided
+ * by the Follower.
+ *
+ * The chain is followed just once.  Normally the allocations are visited a
+ * batch at a time as the chain is followed, so that the walk itself is not
+ * interleaved with whatever is done for each allocation.  One bit for each
+ * allocation in the directory records which allocations have been reached,
+ * so that a chain that loops back on itself ends just before the first
+ * allocation that would be visited twice.  If the statistics for the chain
+ * are wanted before it is visited, the whole chain is followed first and
+ * the allocations are kept to be visited from there.
+ */
+template <typename Offset, class Follower>
+class ChainWalker {
+ public:
+  typedef typename Directory<Offset>::AllocationIndex AllocationIndex;
+  typedef typename Directory<Offset>::Allocation Allocation;
+  ChainWalker(const Directory<Offset>& directory, Follower& follower,
+              AllocationIndex head, Commands::Error& error)
+      : _directory(directory),
+        _follower(follower),
+        _numAllocations(directory.NumAllocations()),
+        _head(head),
+        _error(error),
+        _reached(_numAllocations, false),
+        _next(head),
+        _loopTarget(_numAllocations),
+        _loopIsReported(false),
+        _length(0),
+        _totalBytes(0),
+        _isMeasured(false),
+        _numVisitedFromChain(0),
+        _nextInBatch(0),
+        _batchLimit(0) {}
+
+  /*
+   * Follow the whole chain before it is visited, so that the statistics
+   * are known.
+   */
+  void Measure() {
+    for (AllocationIndex index = Advance(); index != _numAllocations;
+         index = Advance()) {
+      _chain.push_back(index);
+    }
+    _isMeasured = true;
+  }
+
+  AllocationIndex Next() {
+    if (_isMeasured) {
+      return (_numVisitedFromChain < _chain.size())
+                 ? _chain[_numVisitedFromChain++]
+                 : _numAllocations;
+    }
+    if (_nextInBatch == _batchLimit && !FillBatch()) {
+      return _numAllocations;
+    }
+    return _batch[_nextInBatch++];
+  }
+
+  /*
+   * Show the length of the chain and the bytes it uses, along with any loop
+   * back, which requires that the chain has been measured.
+   */
+  void ShowStatistics(Commands::Context& context) {
+    Commands::Output& output = context.GetOutput();
+    output << std::dec << "The chain has " << _length
+           << ((_length == 1) ? " allocation that uses 0x"
+                              : " allocations that use 0x")
+           << std::hex << _totalBytes << " bytes.\n";
+    ShowLoop(output);
+  }
+
+ private:
+  static constexpr size_t BATCH_SIZE = 64;
+  const Directory<Offset>& _directory;
+  Follower& _follower;
+  const AllocationIndex _numAllocations;
+  const AllocationIndex _head;
+  Commands::Error& _error;
+  std::vector<bool> _reached;
+  AllocationIndex _next;
+  // The allocation reached a second time, if the chain loops back.
+  AllocationIndex _loopTarget;
+  bool _loopIsReported;
+  size_t _length;
+  Offset _totalBytes;
+  bool _isMeasured;
+  std::vector<AllocationIndex> _chain;
+  size_t _numVisitedFromChain;
+  AllocationIndex _batch[BATCH_SIZE];
+  size_t _nextInBatch;
+  size_t _batchLimit;
+
+  Offset SizeAt(AllocationIndex index) const {
+    const Allocation* allocation = _directory.AllocationAt(index);
+    if (allocation == 0) {
+      abort();
+    }
+    return allocation->Size();
+  }
+
+  /*
+   * Return the next allocation of the chain, or _numAllocations if the
+   * chain has ended, either because there is no next allocation or because
+   * the next one has already been reached.
+   */
+  AllocationIndex Advance() {
+    AllocationIndex index = _next;
+    if (index == _numAllocations) {
+      return _numAllocations;
+    }
+    if (_reached[index]) {
+      _loopTarget = index;
+      _next = _numAllocations;
+      return _numAllocations;
+    }
+    _reached[index] = true;
+    ++_length;
+    _totalBytes += SizeAt(index);
+    _next = _follower.Follow(index);
+    return index;
+  }
+
+  bool FillBatch() {
+    _nextInBatch = 0;
+    _batchLimit = 0;
+    while (_batchLimit < BATCH_SIZE) {
+      AllocationIndex index = Advance();
+      if (index == _numAllocations) {
+        /*
+         * The loop back is reported when it is found, which is only after
+         * the rest of the chain has been visited.
+         */
+        if (!_loopIsReported) {
+          ShowLoop(_error);
+          _loopIsReported = true;
+        }
+        break;
+      }
+      _batch[_batchLimit++] = index;
+    }
+    return _batchLimit > 0;
+  }
+
+  /*
+   * Return the position in the chain of the allocation to which the chain
+   * loops back.  Unless the chain was kept, this requires following the
+   * chain again, but only up to that allocation.
+   */
+  size_t LoopTargetPosition() const {
+    if (_isMeasured) {
+      return std::find(_chain.begin(), _chain.end(), _loopTarget) -
+             _chain.begin();
+    }
+    size_t position = 0;
+    for (AllocationIndex index = _head; index != _loopTarget;
+         index = _follower.Follow(index)) {
+      ++position;
+    }
+    return position;
+  }
+
+  template <class Stream>
+  void ShowLoop(Stream& stream) const {
+    if (_loopTarget == _numAllocations) {
+      return;
+    }
+    size_t loopStart = LoopTargetPosition();
+    size_t loopLength = _length - loopStart;
+    stream << std::dec << "The chain loops back after " << _length
+           << ((_length == 1) ? " allocation" : " allocations")
+           << " to the one at position " << loopStart
+           << ",\nforming a cycle of " << loopLength
+           << ((loopLength == 1) ? " allocation.\n" : " allocations.\n");
+  }
+};
+}  // namespace Allocations
+}  // namespace chap
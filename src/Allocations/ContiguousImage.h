@@ -1,4 +1,4 @@
-// Copyright (c) 2019-2020 Broadcom. All Rights Reserved.
+// Copyright (c) 2019-2020,2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
@@ -20,7 +20,7 @@ class ContiguousImage {
         _numAllocations(directory.NumAllocations()),
         _index(_numAllocations),
         _maxAllocationSize(directory.MaxAllocationSize()),
-        _buffer((_maxAllocationSize / sizeof(Offset)) + 2, 0),
+        _buffer(2, 0),
         _bufferAsChars((char *)(&(_buffer[0]))),
         _bufferAsOffsets((Offset *)(&(_buffer[0]))),
         _pFirstChar(_bufferAsChars),
@@ -32,7 +32,9 @@ class ContiguousImage {
         _endIterator(_addressMap.end()),
         _regionImage(nullptr),
         _regionBase(0),
-        _regionLimit(0) {}
+        _regionLimit(0),
+        _regionKnownZeroBase(0),
+        _isKnownZero(false) {}
 
   void SetIndex(Index index) {
     if (index > _numAllocations) {
@@ -43,6 +45,7 @@ class ContiguousImage {
       _pFirstChar = _bufferAsChars;
       _pFirstOffset = _bufferAsOffsets;
       _pPastOffsets = _bufferAsOffsets;
+      _isKnownZero = false;
       const Allocation *allocation = _directory.AllocationAt(index);
       if (allocation != nullptr) {
         Offset address = allocation->Address();
@@ -59,21 +62,28 @@ class ContiguousImage {
           if (_regionImage != nullptr) {
             _regionBase = _iterator.Base();
             _regionLimit = _iterator.Limit();
+            _regionKnownZeroBase = _iterator.KnownZeroBase();
           } else {
+            /*
+             * The size is left unchanged in this case, so the buffer must
+             * be large enough for any caller that checks only the size.
+             */
+            ReserveBuffer(_size);
             return;
           }
         }
         if (limit <= _regionLimit) {
           _pFirstChar = _regionImage + (address - _regionBase);
           _size = size;
+          _isKnownZero = (address >= _regionKnownZeroBase);
         } else {
           /*
            * This is very rare on Linux but could happen in the case of
            * truncation.  It does happen even without truncation on Windows,
            * which may be supported at some point.
            */
-          memcpy(_bufferAsChars, _regionImage + (address - _regionBase),
-                 _regionLimit - address);
+          ReserveBuffer(size);
+          CopyFromRegion(_bufferAsChars, address, _regionLimit - address);
           Offset copiedTo = _regionLimit;
           while (copiedTo < limit) {
             _regionBase = 0;
@@ -88,6 +98,7 @@ class ContiguousImage {
             }
             _regionBase = _iterator.Base();
             _regionLimit = _iterator.Limit();
+            _regionKnownZeroBase = _iterator.KnownZeroBase();
             if (_regionBase > limit) {
               break;
             }
@@ -97,13 +108,12 @@ class ContiguousImage {
               copiedTo = _regionBase;
             }
             if (_regionLimit >= limit) {
-              memcpy(_bufferAsChars + (copiedTo - address),
-                     _regionImage + (copiedTo - _regionBase), limit - copiedTo);
+              CopyFromRegion(_bufferAsChars + (copiedTo - address), copiedTo,
+                             limit - copiedTo);
               copiedTo = limit;
             } else {
-              memcpy(_bufferAsChars + (copiedTo - address),
-                     _regionImage + (copiedTo - _regionBase),
-                     _regionLimit - copiedTo);
+              CopyFromRegion(_bufferAsChars + (copiedTo - address), copiedTo,
+                             _regionLimit - copiedTo);
               copiedTo = _regionLimit;
             }
           }
@@ -126,7 +136,49 @@ class ContiguousImage {
   const char *FirstChar() const { return _pFirstChar; }
   Offset Size() const { return _size; }
 
+  /*
+   * Return true if the current allocation is entirely within the part of a
+   * range known to contain only zeros, in which case there is no need to
+   * scan it for references.
+   */
+  bool IsKnownZero() const { return _isKnownZero; }
+
  private:
+  /*
+   * Copy the given number of bytes, starting at the given address in the
+   * current region, without reading any part of the image that is known to
+   * contain only zeros.
+   */
+  void CopyFromRegion(char *to, Offset address, Offset numBytes) {
+    Offset numToCopy = 0;
+    if (address < _regionKnownZeroBase) {
+      numToCopy = _regionKnownZeroBase - address;
+      if (numToCopy > numBytes) {
+        numToCopy = numBytes;
+      }
+      memcpy(to, _regionImage + (address - _regionBase), numToCopy);
+    }
+    memset(to + numToCopy, 0, numBytes - numToCopy);
+  }
+
+  /*
+   * The buffer is grown only as needed, rather than being sized for the
+   * largest allocation, because it is used only for the rare allocations
+   * that span regions and because there may be one ContiguousImage per
+   * thread.
+   */
+  void ReserveBuffer(Offset size) {
+    size_t numOffsets = (size / sizeof(Offset)) + 2;
+    if (_buffer.size() < numOffsets) {
+      _buffer.resize(numOffsets, 0);
+      _bufferAsChars = (char *)(&(_buffer[0]));
+      _bufferAsOffsets = (Offset *)(&(_buffer[0]));
+      _pFirstChar = _bufferAsChars;
+      _pFirstOffset = _bufferAsOffsets;
+      _pPastOffsets = _bufferAsOffsets;
+    }
+  }
+
   const Directory<Offset> &_directory;
   const Index _numAllocations;
   Index _index;
@@ -144,6 +196,8 @@ class ContiguousImage {
   const char *_regionImage;
   Offset _regionBase;
   Offset _regionLimit;
+  Offset _regionKnownZeroBase;
+  bool _isKnownZero;
 };
 }  // namespace Allocations
 }  // namespace chap
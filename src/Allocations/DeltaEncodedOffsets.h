@@ -0,0 +1,133 @@
+// Copyright (c) 2024 Broadcom. All Rights Reserved.
+// The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
+// SPDX-License-Identifier: GPL-2.0
+
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "../AnalysisCache.h"
+
+namespace chap {
+namespace Allocations {
+/*
+ * A DeltaEncodedOffsets holds a non-decreasing sequence of offsets, such as
+ * the index of the first edge for each node of a graph, in much less space
+ * than a plain array while still allowing constant time access by position.
+ *
+ * The values are split into blocks of BLOCK_SIZE values.  Each block has a
+ * full-width base, and each value in the block is normally stored as a 16-bit
+ * delta from that base.  The rare block where the values span too much for
+ * 16-bit deltas, for example because one node has a huge number of edges, has
+ * its values stored at full width instead.
+ */
+template <typename Value>
+class DeltaEncodedOffsets {
+ public:
+  DeltaEncodedOffsets() : _numValues(0) {}
+
+  /*
+   * Replace any existing contents with the given non-decreasing values.
+   */
+  void Assign(const Value* values, size_t numValues) {
+    _numValues = numValues;
+    _blocks.clear();
+    _deltas.clear();
+    _wide.clear();
+    size_t numBlocks = (numValues + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    _blocks.reserve(numBlocks);
+    _deltas.reserve(numValues);
+    for (size_t first = 0; first < numValues; first += BLOCK_SIZE) {
+      size_t limit = first + BLOCK_SIZE;
+      if (limit > numValues) {
+        limit = numValues;
+      }
+      Value base = values[first];
+      if (values[limit - 1] - base <= MAX_DELTA) {
+        _blocks.push_back({base, NARROW_BLOCK});
+        for (size_t i = first; i < limit; i++) {
+          _deltas.push_back((uint16_t)(values[i] - base));
+        }
+      } else {
+        _blocks.push_back({base, (uint32_t)(_wide.size())});
+        _wide.insert(_wide.end(), values + first, values + limit);
+        _wide.resize(_wide.size() + (first + BLOCK_SIZE - limit), 0);
+        _deltas.resize(_deltas.size() + (limit - first), 0);
+      }
+    }
+    _blocks.shrink_to_fit();
+    _wide.shrink_to_fit();
+  }
+
+  Value operator[](size_t i) const {
+    const Block& block = _blocks[i / BLOCK_SIZE];
+    if (block._wideStart == NARROW_BLOCK) {
+      return block._base + _deltas[i];
+    }
+    return _wide[block._wideStart + (i % BLOCK_SIZE)];
+  }
+
+  size_t Size() const { return _numValues; }
+
+  size_t MemoryFootprint() const {
+    return _blocks.capacity() * sizeof(Block) +
+           _deltas.capacity() * sizeof(uint16_t) +
+           _wide.capacity() * sizeof(Value);
+  }
+
+  void Write(AnalysisCacheWriter& writer) const {
+    writer.WriteValue<uint64_t>(_numValues);
+    writer.WriteValue<uint64_t>(_blocks.size());
+    for (const Block& block : _blocks) {
+      writer.WriteValue<Value>(block._base);
+      writer.WriteValue<uint32_t>(block._wideStart);
+    }
+    writer.WriteVector(_deltas);
+    writer.WriteVector(_wide);
+  }
+
+  bool Read(AnalysisCacheReader& reader) {
+    uint64_t numValues, numBlocks;
+    if (!reader.ReadValue(numValues) || !reader.ReadValue(numBlocks) ||
+        numBlocks != (numValues + BLOCK_SIZE - 1) / BLOCK_SIZE) {
+      return reader.Fail();
+    }
+    _numValues = numValues;
+    _blocks.clear();
+    _blocks.reserve(numBlocks);
+    for (uint64_t i = 0; i < numBlocks; i++) {
+      Value base;
+      uint32_t wideStart;
+      if (!reader.ReadValue(base) || !reader.ReadValue(wideStart)) {
+        return reader.Fail();
+      }
+      _blocks.push_back({base, wideStart});
+    }
+    if (!reader.ReadVector(_deltas) || !reader.ReadVector(_wide) ||
+        _deltas.size() != _numValues) {
+      return reader.Fail();
+    }
+    for (const Block& block : _blocks) {
+      if (block._wideStart != NARROW_BLOCK &&
+          ((block._wideStart % BLOCK_SIZE) != 0 ||
+           block._wideStart >= _wide.size())) {
+        return reader.Fail();
+      }
+    }
+    return true;
+  }
+
+ private:
+  static constexpr size_t BLOCK_SIZE = 32;
+  static constexpr Value MAX_DELTA = 0xFFFF;
+  static constexpr uint32_t NARROW_BLOCK = ~((uint32_t)0);
+  struct Block {
+    Value _base;
+    uint32_t _wideStart;
+  };
+  size_t _numValues;
+  std::vector<Block> _blocks;
+  std::vector<uint16_t> _deltas;
+  std::vector<Value> _wide;
+};
+}  // namespace Allocations
+}  // namespace chap
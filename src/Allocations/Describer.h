@@ -1,4 +1,4 @@
-// Copyright (c) 2017,2020 Broadcom. All Rights Reserved.
+// Copyright (c) 2017,2020,2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
@@ -27,11 +27,9 @@ class Describer : public chap::Describer<Offset> {
       : _inModuleDescriber(inModuleDescriber),
         _stackDescriber(stackDescriber),
         _patternDescriberRegistry(patternDescriberRegistry),
-        _signatureDirectory(processImage.GetSignatureDirectory()),
-        _anchorDirectory(processImage.GetAnchorDirectory()),
+        _processImage(processImage),
         _addressMap(processImage.GetVirtualAddressMap()),
-        _directory(processImage.GetAllocationDirectory()),
-        _graph(processImage.GetAllocationGraph()) {}
+        _directory(processImage.GetAllocationDirectory()) {}
 
   /*
    * If the address is understood, provide a description for the address,
@@ -41,13 +39,13 @@ class Describer : public chap::Describer<Offset> {
    */
   bool Describe(Commands::Context& context, Offset address, bool explain,
                 bool showAddresses) const {
-    if (_graph == 0) {
-      return false;
-    }
     AllocationIndex index = _directory.AllocationIndexOf(address);
     if (index == _directory.NumAllocations()) {
       return false;
     }
+    if (_processImage.GetAllocationGraph() == nullptr) {
+      return false;
+    }
     const Allocation* allocation = _directory.AllocationAt(index);
     if (allocation == 0) {
       abort();
@@ -71,6 +69,9 @@ class Describer : public chap::Describer<Offset> {
   void Describe(Commands::Context& context, AllocationIndex index,
                 const Allocation& allocation, bool explain,
                 Offset offsetInAllocation, bool showAddresses) const {
+    const Graph<Offset>& graph = *(_processImage.GetAllocationGraph());
+    const SignatureDirectory<Offset>& signatureDirectory =
+        _processImage.GetSignatureDirectory();
     size_t size = allocation.Size();
     Commands::Output& output = context.GetOutput();
     bool isUsed = false;
@@ -79,9 +80,9 @@ class Describer : public chap::Describer<Offset> {
     bool isThreadCached = false;
     if (allocation.IsUsed()) {
       isUsed = true;
-      if (_graph->IsLeaked(index)) {
+      if (graph.IsLeaked(index)) {
         isLeaked = true;
-        if (_graph->IsUnreferenced(index)) {
+        if (graph.IsUnreferenced(index)) {
           isUnreferenced = true;
         }
       }
@@ -109,10 +110,10 @@ class Describer : public chap::Describer<Offset> {
     bool isUnsigned = true;
     if (size >= sizeof(Offset)) {
       Offset signature = *((Offset*)image);
-      if (_signatureDirectory.IsMapped(signature)) {
+      if (signatureDirectory.IsMapped(signature)) {
         isUnsigned = false;
         output << "... with signature " << signature;
-        std::string name = _signatureDirectory.Name(signature);
+        std::string name = signatureDirectory.Name(signature);
         if (!name.empty()) {
           output << "(" << name << ")";
         }
@@ -133,11 +134,11 @@ class Describer : public chap::Describer<Offset> {
       if (isUsed) {
         if (!isLeaked) {
           AnchorChainLister<Offset> anchorChainLister(
-              _inModuleDescriber, _stackDescriber, *_graph, _signatureDirectory,
-              _anchorDirectory, context, address);
-          _graph->VisitStaticAnchorChains(index, anchorChainLister);
-          _graph->VisitRegisterAnchorChains(index, anchorChainLister);
-          _graph->VisitStackAnchorChains(index, anchorChainLister);
+              _inModuleDescriber, _stackDescriber, graph, signatureDirectory,
+              _processImage.GetAnchorDirectory(), context, address);
+          graph.VisitStaticAnchorChains(index, anchorChainLister);
+          graph.VisitRegisterAnchorChains(index, anchorChainLister);
+          graph.VisitStackAnchorChains(index, anchorChainLister);
         }
       }
     }
@@ -148,11 +149,9 @@ class Describer : public chap::Describer<Offset> {
   const InModuleDescriber<Offset>& _inModuleDescriber;
   const StackDescriber<Offset>& _stackDescriber;
   const PatternDescriberRegistry<Offset>& _patternDescriberRegistry;
-  const SignatureDirectory<Offset>& _signatureDirectory;
-  const AnchorDirectory<Offset>& _anchorDirectory;
+  const ProcessImage<Offset>& _processImage;
   const VirtualAddressMap<Offset>& _addressMap;
   const Directory<Offset>& _directory;
-  const Graph<Offset>* _graph;
 };
 }  // namespace Allocations
 }  // namespace chap
@@ -1,4 +1,4 @@
-// Copyright (c) 2020-2021 Broadcom. All Rights Reserved.
+// Copyright (c) 2020-2021,2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
@@ -6,6 +6,7 @@
 #include <algorithm>
 #include <functional>
 #include <vector>
+#include "../AnalysisCache.h"
 namespace chap {
 namespace Allocations {
 template <class Offset>
@@ -15,18 +16,29 @@ class Directory {
   class Allocation {
    public:
     /*
-     * This constructor is generally used only while the directory is being
+     * This constructor is used only by a Finder, while the directory is being
      * resolved.  The address, size information and initial guess about
      * whether the allocation is used or free, are supplied by the Finder.
-     * The remaining arguments are derived as part of resolving the
-     * Directory.
+     * The finder index and whether the allocation is wrapped are set as part
+     * of resolving the Directory.
      */
-    Allocation(Offset address, Offset size, bool isUsed, Offset finderIndex,
-               bool isWrapped)
-        : _address(address),
-          _sizeAndBits(size | (isUsed ? USED_BIT : 0) |
-                       (finderIndex * LOW_FINDER_INDEX_BIT) |
-                       (isWrapped ? WRAPPED_BIT : 0)) {}
+    Allocation(Offset address, Offset size, bool isUsed)
+        : _address(address), _sizeAndBits(size | (isUsed ? USED_BIT : 0)) {}
+
+    /*
+     * Set the index of the finder that reported the allocation.  This is
+     * done only while the directory is being resolved.
+     */
+    void SetFinderIndex(size_t finderIndex) {
+      _sizeAndBits = (_sizeAndBits & ~(FINDER_INDEX_MASK)) |
+                     (finderIndex * LOW_FINDER_INDEX_BIT);
+    }
+
+    /*
+     * Mark the given allocation as wrapped by some other allocation.  This is
+     * done only while the directory is being resolved.
+     */
+    void MarkAsWrapped() { _sizeAndBits |= WRAPPED_BIT; }
 
     /*
      * Mark the given allocation as a wrapper.  This is not allowed after
@@ -95,6 +107,7 @@ class Directory {
     static constexpr Offset LOW_FINDER_INDEX_BIT =
         WRAPPED_BIT >> NUM_FINDER_INDEX_BITS;
     static constexpr Offset SIZE_MASK = LOW_FINDER_INDEX_BIT - 1;
+    static constexpr Offset FINDER_INDEX_MASK = (WRAPPED_BIT - 1) & ~SIZE_MASK;
 
     Offset _address;
     Offset _sizeAndBits;
@@ -103,6 +116,11 @@ class Directory {
     static constexpr Offset MAX_FINDERS = 1 << NUM_FINDER_INDEX_BITS;
   };
 
+  /*
+   * This is the buffer to which a Finder appends the allocations it finds.
+   */
+  typedef std::vector<Allocation> FoundAllocations;
+
   /*
    * This class is used to report a sequence of allocations just once, so
    * that information can be cached in a Directory.
@@ -111,35 +129,18 @@ class Directory {
   class Finder {
    public:
     /*
-     * Return true if there are no more allocations available.
+     * Append all the allocations found by this finder, in increasing order
+     * of address, to the given buffer.  This is called just once, when the
+     * allocation boundaries are resolved.
      */
-    virtual bool Finished() = 0;
+    virtual void FindAllocations(FoundAllocations& found) = 0;
     /*
-     * Return the address of the next allocation (in increasing order of
-     * address) to be reported by this finder, without advancing to the next
-     * allocation.  The return value is undefined if there are no more
-     * allocations available.  Note that at the time this function is called
-     * any allocations already reported by this allocation finder have already
-     * been assigned allocation indices in the Directory.
+     * This is called, in order of finder index, after the allocations
+     * reported by all the finders have been assigned allocation indices in
+     * the Directory, so that a finder can correct the used/free status of
+     * its allocations based on, for example, free lists.
      */
-    virtual Offset NextAddress() = 0;
-    /*
-     * Return the size of the next allocation (in increasing order of
-     * address) to be reported by this finder, without advancing to the next
-     * allocation.  The return value is undefined if there are no more
-     * allocations available.
-     */
-    virtual Offset NextSize() = 0;
-    /*
-     * Return true if the next allocation (in increasing order of address) to
-     * address) to be reported by this finder is considered used, without
-     * advancing to the next allocation.
-     */
-    virtual bool NextIsUsed() = 0;
-    /*
-     * Advance to the next allocation.
-     */
-    virtual void Advance() = 0;
+    virtual void AllocationsResolved() {}
     /*
      * Return the smallest request size that might reasonably have resulted
      * in an allocation of the given size.
@@ -186,30 +187,44 @@ class Directory {
     return finderIndex;
   }
 
-  void ResolveAllocationBoundaries() {
+  /*
+   * Find all the allocations, using the finders that have been registered.
+   * Each finder appends its allocations, which are already sorted by
+   * address, directly to the directory, and the resulting sorted runs are
+   * then put in order in place, so that no second copy of the allocations
+   * is needed.  If favorSpeed is set, the runs are merged, which may take a
+   * temporary buffer as large as the smaller of the two parts being merged,
+   * and an index is also built so that allocations can be found by address
+   * without searching the whole directory, at the cost of some extra memory.
+   * Otherwise the allocations are sorted in place, if needed, and no index
+   * is built.
+   */
+  void ResolveAllocationBoundaries(bool favorSpeed) {
     if (_allocationBoundariesResolved) {
       abort();
     }
-    std::vector<size_t> activeFinders;
+    std::vector<size_t> runStarts;
     size_t numFinders = _indexToFinder.size();
-    activeFinders.reserve(numFinders);
     for (size_t i = 0; i < numFinders; i++) {
-      Finder* finder = _indexToFinder[i];
-      if (!(finder->Finished())) {
-        activeFinders.push_back(i);
+      size_t runStart = _allocations.size();
+      _indexToFinder[i]->FindAllocations(_allocations);
+      size_t runLimit = _allocations.size();
+      if (runLimit != runStart) {
+        for (size_t j = runStart; j < runLimit; j++) {
+          _allocations[j].SetFinderIndex(i);
+        }
+        runStarts.push_back(runStart);
       }
     }
+    OrderFoundRuns(runStarts, favorSpeed);
+    ResolveWrappersAndOverlaps();
 
-    if (!activeFinders.empty()) {
-      Offset numActiveFinders = activeFinders.size();
-      if (numActiveFinders == 1) {
-        AppendRemainingAllocationsFromFinder(activeFinders[0]);
-      } else if (numActiveFinders == 2) {
-        AppendRemainingAllocationsFromFinders(activeFinders[0],
-                                              activeFinders[1]);
-      } else {
-        AppendRemainingAllocationsFromFinders(activeFinders);
-      }
+    if (favorSpeed) {
+      BuildAddressIndex();
+    }
+
+    for (Finder* finder : _indexToFinder) {
+      finder->AllocationsResolved();
     }
 
     _allocationBoundariesResolved = true;
@@ -237,6 +252,9 @@ class Directory {
   AllocationIndex AllocationIndexOf(Offset addr) const {
     size_t limit = _allocations.size();
     size_t base = 0;
+    if (!_addressIndexSegments.empty()) {
+      NarrowSearchUsingAddressIndex(addr, base, limit);
+    }
     while (base < limit) {
       size_t mid = (base + limit) / 2;
       const Allocation& allocation = _allocations[mid];
@@ -284,6 +302,52 @@ class Directory {
     return _allocations.size();
   }
 
+  /*
+   * A Locator finds the allocations containing a series of addresses that
+   * tend to be near each other, as when following the links of a list, by
+   * checking the allocation found last and its immediate neighbors before
+   * searching the whole directory.
+   */
+  class Locator {
+   public:
+    Locator(const Directory& directory)
+        : _directory(directory),
+          _lastIndex(directory.NumAllocations()),
+          _numNearbyHits(0),
+          _numSearches(0) {}
+
+    // index is same as NumAllocations() if offset is not in any range.
+    AllocationIndex AllocationIndexOf(Offset addr) {
+      const std::vector<Allocation>& allocations = _directory._allocations;
+      size_t numAllocations = allocations.size();
+      if (_lastIndex < numAllocations) {
+        size_t base = (_lastIndex == 0) ? 0 : (_lastIndex - 1);
+        size_t limit = (_lastIndex + 2 < numAllocations) ? (_lastIndex + 2)
+                                                         : numAllocations;
+        for (size_t i = base; i < limit; i++) {
+          const Allocation& allocation = allocations[i];
+          if (addr - allocation.Address() < allocation.Size() &&
+              !allocation.IsWrapper()) {
+            _lastIndex = (AllocationIndex)(i);
+            _numNearbyHits++;
+            return _lastIndex;
+          }
+        }
+      }
+      _numSearches++;
+      _lastIndex = _directory.AllocationIndexOf(addr);
+      return _lastIndex;
+    }
+    size_t NumNearbyHits() const { return _numNearbyHits; }
+    size_t NumSearches() const { return _numSearches; }
+
+   private:
+    const Directory& _directory;
+    AllocationIndex _lastIndex;
+    size_t _numNearbyHits;
+    size_t _numSearches;
+  };
+
   // null if index is not valid.
   const Allocation* AllocationAt(AllocationIndex index) const {
     if (index < _allocations.size()) {
@@ -351,6 +415,51 @@ class Directory {
    */
   bool HasThreadCached() const { return _hasThreadCached; }
 
+  /*
+   * Return true if an index was built to speed up finding allocations by
+   * address.
+   */
+  bool HasAddressIndex() const { return !_addressIndexSegments.empty(); }
+
+  /*
+   * Return the number of bytes used by the allocations themselves.
+   */
+  size_t AllocationsMemoryFootprint() const {
+    return _allocations.capacity() * sizeof(Allocation);
+  }
+
+  /*
+   * Return the number of bytes used by the index used to find allocations
+   * by address, or 0 if there is no such index.
+   */
+  size_t AddressIndexMemoryFootprint() const {
+    return _addressIndexSegments.capacity() * sizeof(AddressIndexSegment) +
+           _firstAllocationForPage.capacity() * sizeof(AllocationIndex);
+  }
+
+  /*
+   * Write the resolved allocations to the given analysis cache.
+   */
+  void Write(AnalysisCacheWriter& writer) const {
+    writer.WriteVector(_allocations);
+  }
+
+  /*
+   * Return true if the allocations recorded in the given analysis cache are
+   * the same as the resolved allocations, because nothing else in the cache
+   * can be trusted otherwise.
+   */
+  bool MatchesCachedAllocations(AnalysisCacheReader& reader) const {
+    uint64_t numCached;
+    const Allocation* cached = reader.ReadArray<Allocation>(numCached);
+    if (!reader.Ok() || numCached != _allocations.size() ||
+        (numCached != 0 &&
+         memcmp(cached, _allocations.data(), numCached * sizeof(Allocation)))) {
+      return reader.Fail();
+    }
+    return true;
+  }
+
   /*
    * Add a callback to be invoked after all the allocation boundaries
    * have been resolved.
@@ -360,6 +469,22 @@ class Directory {
   }
 
  private:
+  /*
+   * The address index covers the pages in which allocations start, grouped
+   * into segments of consecutive pages.  Small gaps between such pages are
+   * filled in, to limit the number of segments.  For each page in a segment,
+   * _firstAllocationForPage holds the index of the first allocation at or
+   * after the start of that page, and one extra entry for the page after
+   * the last page of the segment.
+   */
+  static constexpr unsigned int ADDRESS_INDEX_PAGE_SHIFT = 12;
+  static constexpr Offset MAX_ADDRESS_INDEX_GAP_PAGES = 4;
+  struct AddressIndexSegment {
+    Offset _firstPage;
+    Offset _numPages;
+    size_t _firstEntry;
+  };
+
   std::vector<Allocation> _allocations;
   bool _allocationBoundariesResolved;
   bool _freeStatusFinalized;
@@ -367,239 +492,199 @@ class Directory {
   Offset _maxAllocationSize;
   std::map<Finder*, size_t> _finderToIndex;
   std::vector<Finder*> _indexToFinder;
-  std::vector<std::pair<AllocationIndex, Offset> > _limits;
   std::vector<std::vector<AllocationIndex> > _wrappers;
   mutable std::vector<ResolutionDoneCallback> _resolutionDoneCallbacks;
-
-  void ConsumeCurrentAllocation(size_t finderIndex, Finder* finder) {
-    Offset address = finder->NextAddress();
-    Offset size = finder->NextSize();
-    Offset limit = address + size;
-    bool isUsed = finder->NextIsUsed();
-    bool isWrapped = false;
-    while (!_limits.empty() && limit > _limits.back().second) {
-      if (address < _limits.back().second) {
-        std::cerr << "Discarding allocation at [0x" << std::hex << address
-                  << ", 0x" << limit
-                  << ")\n... due to overlap with allocation at [0x" << std::hex
-                  << _allocations[_limits.back().first].Address() << ", 0x"
-                  << _limits.back().second << ")\n";
-        finder->Advance();
-        return;
+  std::vector<AddressIndexSegment> _addressIndexSegments;
+  std::vector<AllocationIndex> _firstAllocationForPage;
+
+  void BuildAddressIndex() {
+    size_t numAllocations = _allocations.size();
+    for (size_t i = 0; i < numAllocations; i++) {
+      Offset page = _allocations[i].Address() >> ADDRESS_INDEX_PAGE_SHIFT;
+      if (_addressIndexSegments.empty()) {
+        _addressIndexSegments.push_back({page, 1, 0});
+        _firstAllocationForPage.push_back(i);
+        continue;
       }
-      _limits.pop_back();
-    }
-    if (!_limits.empty()) {
-      /*
-       * This is a wrapped allocation, because another allocation contains
-       * it.
-       */
-      isWrapped = true;
-      AllocationIndex wrapperIndex = _limits.back().first;
-      if (!(_allocations[wrapperIndex].IsWrapper())) {
-        /*
-         * The wrapping allocation was not previously known to be a wrapper.
-         */
-        _allocations[wrapperIndex].MarkAsWrapper();
+      AddressIndexSegment& segment = _addressIndexSegments.back();
+      Offset pageLimit = segment._firstPage + segment._numPages;
+      if (page < pageLimit) {
+        continue;
+      }
+      if (page - pageLimit <= MAX_ADDRESS_INDEX_GAP_PAGES) {
         /*
-         * Main the invariant that each wrapper is placed according to the
-         * maximum level of nesting in that wrapper.  For example, _wrappers[0]
-         * contains indices of wrappers that don't wrap any wrappers.
+         * Extend the current segment to include this page, noting that
+         * no allocation starts in any of the pages skipped.
          */
-        AllocationIndex toPlace = wrapperIndex;
-        bool needNewLevel = true;
-        for (std::vector<AllocationIndex>& level : _wrappers) {
-          wrapperIndex = level.back();
-          Allocation& allocation = _allocations[wrapperIndex];
-          if (allocation.Size() + allocation.Address() < limit) {
-            level.push_back(toPlace);
-            needNewLevel = false;
-            break;
-          }
-          level.back() = toPlace;
-          toPlace = wrapperIndex;
-        }
-        if (needNewLevel) {
-          _wrappers.emplace_back(std::vector<AllocationIndex>());
-          _wrappers.back().push_back(toPlace);
-        }
+        segment._numPages = page - segment._firstPage + 1;
+        _firstAllocationForPage.resize(
+            segment._firstEntry + segment._numPages, (AllocationIndex)i);
+      } else {
+        _firstAllocationForPage.push_back(i);
+        _addressIndexSegments.push_back(
+            {page, 1, _firstAllocationForPage.size()});
+        _firstAllocationForPage.push_back(i);
       }
     }
-    _limits.emplace_back(_allocations.size(), limit);
-    _allocations.emplace_back(address, size, isUsed, finderIndex, isWrapped);
-    if (_maxAllocationSize < size) {
-      _maxAllocationSize = size;
+    if (!_addressIndexSegments.empty()) {
+      _firstAllocationForPage.push_back(numAllocations);
     }
-    finder->Advance();
+    _addressIndexSegments.shrink_to_fit();
+    _firstAllocationForPage.shrink_to_fit();
   }
-  void AppendRemainingAllocationsFromFinder(size_t finderIndex) {
-    Finder* finder = _indexToFinder[finderIndex];
-    while (!(finder->Finished())) {
-      ConsumeCurrentAllocation(finderIndex, finder);
+
+  /*
+   * Restrict the range of the search for an allocation containing the given
+   * address to the allocations that start in the same page, plus the last
+   * allocation that starts before that page, because any allocation that
+   * could be found by searching the whole directory is in that range.
+   */
+  void NarrowSearchUsingAddressIndex(Offset addr, size_t& base,
+                                     size_t& limit) const {
+    Offset page = addr >> ADDRESS_INDEX_PAGE_SHIFT;
+    auto it = std::upper_bound(
+        _addressIndexSegments.begin(), _addressIndexSegments.end(), page,
+        [](Offset page, const AddressIndexSegment& segment) {
+          return page < segment._firstPage;
+        });
+    if (it == _addressIndexSegments.begin()) {
+      base = limit = 0;
+      return;
     }
-  }
-  void AppendRemainingAllocationsFromFinders(size_t finderIndex0,
-                                             size_t finderIndex1) {
-    Finder* finder0 = _indexToFinder[finderIndex0];
-    Offset address0 = finder0->NextAddress();
-    Offset size0 = finder0->NextSize();
-
-    Finder* finder1 = _indexToFinder[finderIndex1];
-    Offset address1 = finder1->NextAddress();
-    Offset size1 = finder1->NextSize();
-
-    while (true) {
-      if (address0 < address1 || (address0 == address1 && size0 > size1)) {
-        ConsumeCurrentAllocation(finderIndex0, finder0);
-        if (finder0->Finished()) {
-          AppendRemainingAllocationsFromFinder(finderIndex1);
-          return;
-        }
-        address0 = finder0->NextAddress();
-        size0 = finder0->NextSize();
-      } else {
-        ConsumeCurrentAllocation(finderIndex1, finder1);
-        if (finder1->Finished()) {
-          AppendRemainingAllocationsFromFinder(finderIndex0);
-          return;
-        }
-        address1 = finder1->NextAddress();
-        size1 = finder1->NextSize();
-      }
+    --it;
+    const AllocationIndex* firstForPage =
+        _firstAllocationForPage.data() + it->_firstEntry;
+    Offset pageInSegment = page - it->_firstPage;
+    if (pageInSegment < it->_numPages) {
+      base = firstForPage[pageInSegment];
+      limit = firstForPage[pageInSegment + 1];
+    } else {
+      base = limit = firstForPage[it->_numPages];
+    }
+    if (base > 0) {
+      base--;
     }
   }
 
-  void Place(Offset address, Offset size, size_t finderIndex,
-             std::vector<size_t>& activeFinders, size_t heapIndex) {
-    Offset heapSize = activeFinders.size();
-    Offset leftChild = 2 * heapIndex + 1;
-    Offset rightChild = leftChild + 1;
-    while (rightChild < heapSize) {
-      size_t leftFinderIndex = activeFinders[leftChild];
-      Finder* leftFinder = _indexToFinder[leftFinderIndex];
-      Offset leftAddress = leftFinder->NextAddress();
-      Offset leftSize = leftFinder->NextSize();
-      size_t rightFinderIndex = activeFinders[rightChild];
-      Finder* rightFinder = _indexToFinder[rightFinderIndex];
-      Offset rightAddress = rightFinder->NextAddress();
-      Offset rightSize = rightFinder->NextSize();
-      if (leftAddress < rightAddress ||
-          (leftAddress == rightAddress && leftSize > rightSize)) {
-        if (address < leftAddress ||
-            (address == leftAddress && address >= leftSize)) {
-          activeFinders[heapIndex] = finderIndex;
-          return;
-        }
-        activeFinders[heapIndex] = leftFinderIndex;
-        heapIndex = leftChild;
-      } else {
-        if (address < rightAddress ||
-            (address == rightAddress && address >= rightSize)) {
-          activeFinders[heapIndex] = finderIndex;
-          return;
-        }
-        activeFinders[heapIndex] = rightFinderIndex;
-        heapIndex = rightChild;
+  /*
+   * Return true if the first allocation belongs before the second one in the
+   * directory, which is the case if it starts at a lower address or if it
+   * starts at the same address but is larger, and so wraps the second one.
+   * Allocations with the same address and size are kept in order of finder
+   * index.
+   */
+  static bool Precedes(const Allocation& first, const Allocation& second) {
+    return first.Address() < second.Address() ||
+           (first.Address() == second.Address() &&
+            (first.Size() > second.Size() ||
+             (first.Size() == second.Size() &&
+              first.FinderIndex() < second.FinderIndex())));
+  }
+
+  /*
+   * Put in order the allocations, which were appended by the finders as
+   * one sorted run per finder, starting at the given offsets.  Because runs
+   * from different finders are generally interleaved only at a coarse grain,
+   * often each run simply follows the ones before it and nothing needs to be
+   * moved.
+   */
+  void OrderFoundRuns(const std::vector<size_t>& runStarts, bool favorSpeed) {
+    auto begin = _allocations.begin();
+    bool isSorted = true;
+    for (size_t i = 1; i < runStarts.size(); i++) {
+      size_t runStart = runStarts[i];
+      if (Precedes(_allocations[runStart - 1], _allocations[runStart])) {
+        continue;
       }
-    }
-    if (leftChild < heapSize) {
-      size_t leftFinderIndex = activeFinders[leftChild];
-      Finder* leftFinder = _indexToFinder[leftFinderIndex];
-      Offset leftAddress = leftFinder->NextAddress();
-      if ((address < leftAddress ||
-           (address == leftAddress && size > leftFinder->NextSize()))) {
-        activeFinders[heapIndex] = finderIndex;
-      } else {
-        activeFinders[heapIndex] = leftFinderIndex;
-        activeFinders[leftChild] = finderIndex;
+      isSorted = false;
+      if (favorSpeed) {
+        size_t runLimit = (i + 1 < runStarts.size()) ? runStarts[i + 1]
+                                                     : _allocations.size();
+        std::inplace_merge(begin, begin + runStart, begin + runLimit,
+                           Precedes);
       }
-    } else {
-      activeFinders[heapIndex] = finderIndex;
+    }
+    if (!isSorted && !favorSpeed) {
+      std::sort(begin, _allocations.end(), Precedes);
     }
   }
 
-  void AppendRemainingAllocationsFromFinders(
-      std::vector<size_t>& activeFinders) {
-    size_t numActiveFinders = activeFinders.size();
-    std::make_heap(activeFinders.begin(), activeFinders.end(),
-                   [this](const size_t left, const size_t right) {
-                     Finder* leftFinder = this->_indexToFinder[left];
-                     Finder* rightFinder = this->_indexToFinder[right];
-                     Offset leftAddress = leftFinder->NextAddress();
-                     Offset rightAddress = rightFinder->NextAddress();
-                     return (leftAddress > rightAddress) ||
-                            ((leftAddress == rightAddress) &&
-                             leftFinder->NextSize() < rightFinder->NextSize());
-                   });
-    size_t topFinderIndex = activeFinders[0];
-    Finder* topFinder = _indexToFinder[topFinderIndex];
-    Offset topAddress = topFinder->NextAddress();
-    Offset topSize = topFinder->NextSize();
-
-    Finder* leftFinder = _indexToFinder[activeFinders[1]];
-    Offset leftAddress = leftFinder->NextAddress();
-    Offset leftSize = leftFinder->NextSize();
-
-    Finder* rightFinder = _indexToFinder[activeFinders[2]];
-    Offset rightAddress = rightFinder->NextAddress();
-    Offset rightSize = rightFinder->NextSize();
-
-    bool leftIsNext = (leftAddress < rightAddress) ||
-                      (leftAddress == rightAddress && leftSize >= rightSize);
-    Offset nextAddress = leftIsNext ? leftAddress : rightAddress;
-    Offset nextSize = leftIsNext ? leftSize : rightSize;
-
-    while (true) {
-      ConsumeCurrentAllocation(topFinderIndex, topFinder);
-      if (topFinder->Finished()) {
-        size_t lastFinderIndex = activeFinders[numActiveFinders - 1];
-        activeFinders.pop_back();
-        if (--numActiveFinders == 2) {
-          AppendRemainingAllocationsFromFinders(lastFinderIndex,
-                                                activeFinders[1]);
-          return;
+  /*
+   * Make a single pass over the allocations, which are now in order,
+   * discarding any that overlap without one containing the other and noting
+   * which allocations wrap others.  The allocations that are kept are moved
+   * down in place over any that were discarded.
+   */
+  void ResolveWrappersAndOverlaps() {
+    std::vector<std::pair<AllocationIndex, Offset> > limits;
+    size_t numFound = _allocations.size();
+    size_t numKept = 0;
+    for (size_t i = 0; i < numFound; i++) {
+      Allocation found = _allocations[i];
+      Offset address = found.Address();
+      Offset size = found.Size();
+      Offset limit = address + size;
+      bool overlaps = false;
+      while (!limits.empty() && limit > limits.back().second) {
+        if (address < limits.back().second) {
+          std::cerr << "Discarding allocation at [0x" << std::hex << address
+                    << ", 0x" << limit
+                    << ")\n... due to overlap with allocation at [0x"
+                    << std::hex << _allocations[limits.back().first].Address()
+                    << ", 0x" << limits.back().second << ")\n";
+          overlaps = true;
+          break;
         }
-        activeFinders[0] = lastFinderIndex;
-        topFinderIndex = lastFinderIndex;
-        topFinder = _indexToFinder[topFinderIndex];
+        limits.pop_back();
+      }
+      if (overlaps) {
+        continue;
       }
-      topAddress = topFinder->NextAddress();
-      topSize = topFinder->NextSize();
-      if (nextAddress < topAddress ||
-          (nextAddress == topAddress && nextSize > topSize)) {
+      if (!limits.empty()) {
         /*
-         * The top finder is no longer in the correct place.  This is expected
-         * not to happen all that often because many consecutive allocations
-         * will be from the same finder.
+         * This is a wrapped allocation, because another allocation contains
+         * it.
          */
-        Offset address = topAddress;
-        Offset size = topSize;
-        Offset finderIndex = topFinderIndex;
-        topAddress = nextAddress;
-        topSize = nextSize;
-        if (leftIsNext) {
-          topFinderIndex = activeFinders[1];
-          activeFinders[0] = topFinderIndex;
-          topFinder = leftFinder;
-          Place(address, size, finderIndex, activeFinders, 1);
-          leftFinder = _indexToFinder[activeFinders[1]];
-          leftAddress = leftFinder->NextAddress();
-          leftSize = leftFinder->NextSize();
-        } else {
-          topFinderIndex = activeFinders[2];
-          activeFinders[0] = topFinderIndex;
-          topFinder = rightFinder;
-          Place(address, size, finderIndex, activeFinders, 2);
-          rightFinder = _indexToFinder[activeFinders[2]];
-          rightAddress = rightFinder->NextAddress();
-          rightSize = rightFinder->NextSize();
+        found.MarkAsWrapped();
+        AllocationIndex wrapperIndex = limits.back().first;
+        if (!(_allocations[wrapperIndex].IsWrapper())) {
+          /*
+           * The wrapping allocation was not previously known to be a
+           * wrapper.
+           */
+          _allocations[wrapperIndex].MarkAsWrapper();
+          /*
+           * Main the invariant that each wrapper is placed according to the
+           * maximum level of nesting in that wrapper.  For example,
+           * _wrappers[0] contains indices of wrappers that don't wrap any
+           * wrappers.
+           */
+          AllocationIndex toPlace = wrapperIndex;
+          bool needNewLevel = true;
+          for (std::vector<AllocationIndex>& level : _wrappers) {
+            wrapperIndex = level.back();
+            Allocation& allocation = _allocations[wrapperIndex];
+            if (allocation.Size() + allocation.Address() < limit) {
+              level.push_back(toPlace);
+              needNewLevel = false;
+              break;
+            }
+            level.back() = toPlace;
+            toPlace = wrapperIndex;
+          }
+          if (needNewLevel) {
+            _wrappers.emplace_back(std::vector<AllocationIndex>());
+            _wrappers.back().push_back(toPlace);
+          }
         }
-        leftIsNext = (leftAddress < rightAddress) ||
-                     (leftAddress == rightAddress && leftSize >= rightSize);
-        nextAddress = leftIsNext ? leftAddress : rightAddress;
-        nextSize = leftIsNext ? leftSize : rightSize;
+      }
+      limits.emplace_back(numKept, limit);
+      _allocations[numKept++] = found;
+      if (_maxAllocationSize < size) {
+        _maxAllocationSize = size;
       }
     }
+    _allocations.erase(_allocations.begin() + numKept, _allocations.end());
   }
 };
 }  // namespace Allocations
@@ -1,13 +1,20 @@
-// Copyright (c) 2021 Broadcom. All Rights Reserved.
+// Copyright (c) 2021,2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
 #pragma once
+#include <cstdint>
 #include <vector>
 #include "Graph.h"
 
 namespace chap {
 namespace Allocations {
+/*
+ * An EdgePredicate holds one bit for each edge of the allocation graph.  The
+ * bits are packed and indexed by outgoing edge index, so an incoming edge is
+ * first mapped to the corresponding outgoing edge, which keeps a single copy
+ * of each value that is shared by both directions.
+ */
 template <class Offset>
 class EdgePredicate {
  public:
@@ -15,10 +22,8 @@ class EdgePredicate {
   typedef typename Graph<Offset>::EdgeIndex EdgeIndex;
   EdgePredicate(const Graph<Offset>& graph, bool defaultValue)
       : _graph(graph), _totalEdges(graph.TotalEdges()) {
-    _valueByOutgoingEdgeIndex.reserve((size_t)_totalEdges);
-    _valueByOutgoingEdgeIndex.resize((size_t)_totalEdges, defaultValue);
-    _valueByIncomingEdgeIndex.reserve((size_t)_totalEdges);
-    _valueByIncomingEdgeIndex.resize((size_t)_totalEdges, defaultValue);
+    _words.reserve(NumWords());
+    _words.resize(NumWords(), defaultValue ? ~((uint64_t)0) : 0);
   }
 
   void SetAllOutgoing(Index source, bool value) {
@@ -26,10 +31,7 @@ class EdgePredicate {
     _graph.GetOutgoing(source, firstOutgoing, pastOutgoing);
     for (EdgeIndex outgoing = firstOutgoing; outgoing != pastOutgoing;
          outgoing++) {
-      EdgeIndex incoming = _graph.GetIncomingEdgeIndex(
-          source, _graph.GetTargetForOutgoing(outgoing));
-      _valueByOutgoingEdgeIndex[outgoing] = value;
-      _valueByIncomingEdgeIndex[incoming] = value;
+      SetForOutgoing(outgoing, value);
     }
   }
 
@@ -38,42 +40,66 @@ class EdgePredicate {
     _graph.GetIncoming(target, firstIncoming, pastIncoming);
     for (EdgeIndex incoming = firstIncoming; incoming != pastIncoming;
          incoming++) {
-      EdgeIndex outgoing = _graph.GetOutgoingEdgeIndex(
-          _graph.GetSourceForIncoming(incoming), target);
-      _valueByIncomingEdgeIndex[incoming] = value;
-      _valueByOutgoingEdgeIndex[outgoing] = value;
+      SetForOutgoing(_graph.GetOutgoingForIncoming(target, incoming), value);
     }
   }
 
   void Set(Index source, Index target, bool value) {
-    EdgeIndex incoming = _graph.GetIncomingEdgeIndex(source, target);
-    if (incoming == _totalEdges) {
-      return;
+    EdgeIndex outgoing = _graph.GetOutgoingEdgeIndex(source, target);
+    if (outgoing != _totalEdges) {
+      SetForOutgoing(outgoing, value);
     }
-    _valueByIncomingEdgeIndex[incoming] = value;
-    _valueByOutgoingEdgeIndex[_graph.GetOutgoingEdgeIndex(source, target)] =
-        value;
   }
 
   bool For(Index source, Index target) const {
-    EdgeIndex incoming = _graph.GetIncomingEdgeIndex(source, target);
-    return (incoming == _totalEdges) ? false
-                                     : _valueByIncomingEdgeIndex[incoming];
+    return ForOutgoing(_graph.GetOutgoingEdgeIndex(source, target));
   }
 
-  bool ForIncoming(EdgeIndex index) const {
-    return (index < _totalEdges) && (_valueByIncomingEdgeIndex[index] == true);
+  /*
+   * Return the value for the given incoming edge to the given target.
+   */
+  bool ForIncoming(Index target, EdgeIndex index) const {
+    return ForOutgoing(_graph.GetOutgoingForIncoming(target, index));
   }
 
   bool ForOutgoing(EdgeIndex index) const {
-    return (index < _totalEdges) && (_valueByOutgoingEdgeIndex[index] == true);
+    return (index < _totalEdges) &&
+           ((_words[index / 64] & (((uint64_t)1) << (index % 64))) != 0);
+  }
+
+  size_t MemoryFootprint() const {
+    return _words.capacity() * sizeof(uint64_t);
+  }
+
+  void Write(AnalysisCacheWriter& writer) const {
+    writer.WriteValue<uint64_t>(_totalEdges);
+    writer.WriteVector(_words);
+  }
+
+  bool Read(AnalysisCacheReader& reader) {
+    uint64_t totalEdges;
+    if (!reader.ReadValue(totalEdges) || totalEdges != _totalEdges ||
+        !reader.ReadVector(_words) || _words.size() != NumWords()) {
+      return reader.Fail();
+    }
+    return true;
   }
 
  private:
   const Graph<Offset>& _graph;
   const EdgeIndex _totalEdges;
-  std::vector<bool> _valueByOutgoingEdgeIndex;
-  std::vector<bool> _valueByIncomingEdgeIndex;
+  std::vector<uint64_t> _words;
+
+  size_t NumWords() const { return (size_t)((_totalEdges + 63) / 64); }
+
+  void SetForOutgoing(EdgeIndex index, bool value) {
+    uint64_t bit = ((uint64_t)1) << (index % 64);
+    if (value) {
+      _words[index / 64] |= bit;
+    } else {
+      _words[index / 64] &= ~bit;
+    }
+  }
 };
 }  // namespace Allocations
 }  // namespace chap
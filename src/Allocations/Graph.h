@@ -4,15 +4,23 @@
 
 #pragma once
 #include <algorithm>
-#include <deque>
+#include <memory>
+#include <set>
+#include <string>
+#include "../AnalysisCache.h"
+#include "../Parallel.h"
+#include "../SpillAllocator.h"
 #include "../StackRegistry.h"
 #include "../ThreadMap.h"
 #include "../VirtualAddressMap.h"
+#include "AnchorPoints.h"
 #include "ContiguousImage.h"
+#include "DeltaEncodedOffsets.h"
 #include "Directory.h"
 #include "ExternalAnchorPointChecker.h"
 #include "IndexedDistances.h"
 #include "ObscuredReferenceChecker.h"
+#include "PointerCandidateFilter.h"
 
 namespace chap {
 namespace Allocations {
@@ -25,15 +33,16 @@ class Graph {
   typedef Offset EdgeIndex;
   typedef typename VirtualAddressMap<Offset>::Reader Reader;
   typedef typename VirtualAddressMap<Offset>::NotMapped NotMapped;
+  typedef AnchorList<Offset> Anchors;
 
   class AnchorChainVisitor {
    public:
-    virtual bool VisitStaticAnchorChainHeader(
-        const std::vector<Offset> &staticAddrs, Offset address, Offset size,
-        const char *image) = 0;
-    virtual bool VisitStackAnchorChainHeader(
-        const std::vector<Offset> &stackAddrs, Offset address, Offset size,
-        const char *image) = 0;
+    virtual bool VisitStaticAnchorChainHeader(const Anchors &staticAddrs,
+                                              Offset address, Offset size,
+                                              const char *image) = 0;
+    virtual bool VisitStackAnchorChainHeader(const Anchors &stackAddrs,
+                                             Offset address, Offset size,
+                                             const char *image) = 0;
     virtual bool VisitRegisterAnchorChainHeader(
         const std::vector<std::pair<size_t, const char *> > &anchors,
         Offset address, Offset size, const char *image) = 0;
@@ -46,31 +55,99 @@ class Graph {
         const StackRegistry<Offset> &stackRegistry,
         const std::map<Offset, Offset> &staticAnchorLimits,
         const ExternalAnchorPointChecker<Offset> *externalAnchorPointChecker,
-        const ObscuredReferenceChecker<Offset> *obscuredReferenceChecker)
+        const ObscuredReferenceChecker<Offset> *obscuredReferenceChecker,
+        size_t numThreads, bool lowMemory)
       : _directory(directory),
         _addressMap(addressMap),
         _threadMap(threadMap),
         _stackRegistry(stackRegistry),
         _externalAnchorPointChecker(externalAnchorPointChecker),
         _obscuredReferenceChecker(obscuredReferenceChecker),
+        _candidateFilter(directory, obscuredReferenceChecker != nullptr),
         _numAllocations(directory.NumAllocations()),
         _totalEdges(0),
+        _outgoing(SpillAllocator<Index>(lowMemory)),
+        _incoming(SpillAllocator<Index>(lowMemory)),
         _staticAnchorDistances(_numAllocations),
         _stackAnchorDistances(_numAllocations),
         _registerAnchorDistances(_numAllocations),
-        _externalAnchorDistances(_numAllocations) {
+        _externalAnchorDistances(_numAllocations),
+        _numThreads(numThreads),
+        _lowMemory(lowMemory) {
     FindEdges();
-    FindStaticAnchorPoints(staticAnchorLimits);
-    FindStackAnchorPoints();
-    FindRegisterAnchorPoints();
-    FindExternalAnchorPoints();
+    FindAllAnchorPoints(staticAnchorLimits);
     MarkLeakedChunks();
   }
 
+  /*
+   * Restore a graph previously written to an analysis cache.  The caller
+   * is expected to check that the reader is still Ok() afterwards and to
+   * discard the graph otherwise.
+   */
+  Graph(const VirtualAddressMap<Offset> &addressMap,
+        const Directory<Offset> &directory, const ThreadMap<Offset> &threadMap,
+        const StackRegistry<Offset> &stackRegistry,
+        const ExternalAnchorPointChecker<Offset> *externalAnchorPointChecker,
+        const ObscuredReferenceChecker<Offset> *obscuredReferenceChecker,
+        bool lowMemory, AnalysisCacheReader &reader)
+      : _directory(directory),
+        _addressMap(addressMap),
+        _threadMap(threadMap),
+        _stackRegistry(stackRegistry),
+        _externalAnchorPointChecker(externalAnchorPointChecker),
+        _obscuredReferenceChecker(obscuredReferenceChecker),
+        _candidateFilter(directory, obscuredReferenceChecker != nullptr),
+        _numAllocations(directory.NumAllocations()),
+        _totalEdges(0),
+        _outgoing(SpillAllocator<Index>(lowMemory)),
+        _incoming(SpillAllocator<Index>(lowMemory)),
+        _staticAnchorDistances(_numAllocations),
+        _stackAnchorDistances(_numAllocations),
+        _registerAnchorDistances(_numAllocations),
+        _externalAnchorDistances(_numAllocations),
+        _numThreads(1),
+        _lowMemory(lowMemory) {
+    Read(reader);
+  }
+
+  /*
+   * Write everything calculated by the constructor to the given analysis
+   * cache.
+   */
+  void Write(AnalysisCacheWriter &writer) const {
+    writer.WriteValue<uint64_t>(_numAllocations);
+    writer.WriteValue<uint64_t>(_totalEdges);
+    _firstOutgoing.Write(writer);
+    writer.WriteVector(_outgoing);
+    _firstIncoming.Write(writer);
+    writer.WriteVector(_incoming);
+    _staticAnchorDistances.Write(writer);
+    _stackAnchorDistances.Write(writer);
+    _registerAnchorDistances.Write(writer);
+    _externalAnchorDistances.Write(writer);
+    writer.WriteBits(_leaked);
+    _staticAnchorPoints.Write(writer);
+    _stackAnchorPoints.Write(writer);
+    _registerAnchorPoints.Write(writer);
+    writer.WriteValue<uint64_t>(_externalAnchorPoints.size());
+    for (const auto &indexAndReason : _externalAnchorPoints) {
+      writer.WriteValue<uint64_t>(indexAndReason.first);
+      writer.WriteString(indexAndReason.second);
+    }
+  }
+
   const Directory<Offset> &GetAllocationDirectory() const { return _directory; }
 
   const VirtualAddressMap<Offset> &GetAddressMap() const { return _addressMap; }
 
+  /*
+   * Return a filter that accepts at least every value that could be the
+   * target of an edge.
+   */
+  const PointerCandidateFilter<Offset> &GetCandidateFilter() const {
+    return _candidateFilter;
+  }
+
   EdgeIndex TotalEdges() const { return _totalEdges; }
 
   void GetIncoming(Index target, const Index **pFirstIncoming,
@@ -122,6 +199,15 @@ class Graph {
     return (incoming < _totalEdges) ? _incoming[incoming] : _numAllocations;
   }
 
+  /*
+   * Return the index of the outgoing edge that is the same edge as the
+   * given incoming edge to the given target, or TotalEdges() if the given
+   * edge is not an incoming edge for that target.
+   */
+  EdgeIndex GetOutgoingForIncoming(Index target, EdgeIndex incoming) const {
+    return GetOutgoingEdgeIndex(GetSourceForIncoming(incoming), target);
+  }
+
   Index SourceAllocationIndex(Index target, Offset addr) const {
     if (target < _numAllocations) {
       EdgeIndex base = _firstIncoming[target];
@@ -242,6 +328,38 @@ class Graph {
     return _totalEdges;
   }
 
+  /*
+   * Return the number of bytes used for the edges, including the offsets of
+   * the first edges for each allocation.
+   */
+  size_t EdgesMemoryFootprint() const {
+    return (_outgoing.capacity() + _incoming.capacity()) * sizeof(Index) +
+           _firstOutgoing.MemoryFootprint() + _firstIncoming.MemoryFootprint();
+  }
+
+  /*
+   * Return true if the arrays of edges are mapped from temporary files, so
+   * that they need not stay resident.
+   */
+  bool EdgesAreSpilled() const { return _outgoing.get_allocator().Spills(); }
+
+  /*
+   * Return the number of bytes used for the graph, other than for the
+   * reasons given for external anchor points.
+   */
+  size_t MemoryFootprint() const {
+    return EdgesMemoryFootprint() + _staticAnchorDistances.MemoryFootprint() +
+           _stackAnchorDistances.MemoryFootprint() +
+           _registerAnchorDistances.MemoryFootprint() +
+           _externalAnchorDistances.MemoryFootprint() +
+           (_leaked.capacity() + 7) / 8 +
+           _staticAnchorPoints.MemoryFootprint() +
+           _stackAnchorPoints.MemoryFootprint() +
+           _registerAnchorPoints.MemoryFootprint() +
+           _externalAnchorPoints.capacity() *
+               sizeof(std::pair<Index, const char *>);
+  }
+
   bool IsLeaked(Index index) const {
     return index < _numAllocations && _leaked[index];
   }
@@ -269,16 +387,12 @@ class Graph {
            _staticAnchorDistances.GetDistance(index) == 1;
   }
 
-  const std::vector<Offset> *GetStaticAnchors(Index index) const {
-    const std::vector<Offset> *result = 0;
+  Anchors GetStaticAnchors(Index index) const {
     if (index < _numAllocations &&
         _staticAnchorDistances.GetDistance(index) == 1) {
-      AnchorPointMapConstIterator it = _staticAnchorPoints.find(index);
-      if (it != _staticAnchorPoints.end()) {
-        result = &(it->second);
-      }
+      return _staticAnchorPoints.Find(index);
     }
-    return result;
+    return Anchors();
   }
 
   bool IsStackAnchored(Index index) const {
@@ -291,16 +405,12 @@ class Graph {
            _stackAnchorDistances.GetDistance(index) == 1;
   }
 
-  const std::vector<Offset> *GetStackAnchors(Index index) const {
-    const std::vector<Offset> *result = 0;
+  Anchors GetStackAnchors(Index index) const {
     if (index < _numAllocations &&
         _stackAnchorDistances.GetDistance(index) == 1) {
-      AnchorPointMapConstIterator it = _stackAnchorPoints.find(index);
-      if (it != _stackAnchorPoints.end()) {
-        result = &(it->second);
-      }
+      return _stackAnchorPoints.Find(index);
     }
-    return result;
+    return Anchors();
   }
 
   bool IsRegisterAnchored(Index index) const {
@@ -319,14 +429,10 @@ class Graph {
     anchors.clear();
     if (index < _numAllocations &&
         _registerAnchorDistances.GetDistance(index) == 1) {
-      AnchorPointMapConstIterator it = _registerAnchorPoints.find(index);
-      if (it != _registerAnchorPoints.end()) {
+      Anchors encodedAnchors = _registerAnchorPoints.Find(index);
+      if (!encodedAnchors.empty()) {
         size_t numRegisters = _threadMap.GetNumRegisters();
-        const std::vector<Offset> &encodedAnchors = it->second;
-        for (typename std::vector<Offset>::const_iterator it =
-                 encodedAnchors.begin();
-             it != encodedAnchors.end(); ++it) {
-          Offset anchor = *it;
+        for (Offset anchor : encodedAnchors) {
           size_t threadNum = anchor / numRegisters;
           const char *regName =
               _threadMap.GetRegisterName(anchor % numRegisters);
@@ -369,9 +475,9 @@ class Graph {
                               const char *image) const {
     if (index < _numAllocations &&
         _staticAnchorDistances.GetDistance(index) == 1) {
-      AnchorPointMapConstIterator it = _staticAnchorPoints.find(index);
-      if (it != _staticAnchorPoints.end()) {
-        return visitor.VisitStaticAnchorChainHeader(it->second, address, size,
+      Anchors anchors = _staticAnchorPoints.Find(index);
+      if (!anchors.empty()) {
+        return visitor.VisitStaticAnchorChainHeader(anchors, address, size,
                                                     image);
       }
     }
@@ -388,9 +494,9 @@ class Graph {
                              const char *image) const {
     if (index < _numAllocations &&
         _stackAnchorDistances.GetDistance(index) == 1) {
-      AnchorPointMapConstIterator it = _stackAnchorPoints.find(index);
-      if (it != _stackAnchorPoints.end()) {
-        return visitor.VisitStackAnchorChainHeader(it->second, address, size,
+      Anchors anchors = _stackAnchorPoints.Find(index);
+      if (!anchors.empty()) {
+        return visitor.VisitStackAnchorChainHeader(anchors, address, size,
                                                    image);
       }
     }
@@ -407,15 +513,11 @@ class Graph {
                                 const char *image) const {
     if (index < _numAllocations &&
         _registerAnchorDistances.GetDistance(index) == 1) {
-      AnchorPointMapConstIterator it = _registerAnchorPoints.find(index);
-      if (it != _registerAnchorPoints.end()) {
+      Anchors encodedAnchors = _registerAnchorPoints.Find(index);
+      if (!encodedAnchors.empty()) {
         std::vector<std::pair<size_t, const char *> > anchors;
         size_t numRegisters = _threadMap.GetNumRegisters();
-        const std::vector<Offset> &encodedAnchors = it->second;
-        for (typename std::vector<Offset>::const_iterator it =
-                 encodedAnchors.begin();
-             it != encodedAnchors.end(); ++it) {
-          Offset anchor = *it;
+        for (Offset anchor : encodedAnchors) {
           size_t threadNum = anchor / numRegisters;
           const char *regName =
               _threadMap.GetRegisterName(anchor % numRegisters);
@@ -439,8 +541,8 @@ class Graph {
                                 const char *image) const {
     if (index < _numAllocations &&
         _externalAnchorDistances.GetDistance(index) == 1) {
-      typename std::map<Index, const char *>::const_iterator it =
-          _externalAnchorPoints.find(index);
+      typename ExternalAnchorPoints::const_iterator it =
+          FindExternalAnchorPoint(index);
       if (it != _externalAnchorPoints.end()) {
         return visitor.VisitExternalAnchorChainHeader(it->second, address, size,
                                                       image);
@@ -600,39 +702,115 @@ class Graph {
   }
 
  private:
-  typedef std::vector<Offset> OffsetVector;
-  typedef typename OffsetVector::iterator OffsetVectorIterator;
-  typedef typename OffsetVector::const_iterator OffsetVectorConstIterator;
-  typedef std::map<Index, OffsetVector> AnchorPointMap;
-  typedef typename AnchorPointMap::iterator AnchorPointMapIterator;
-  typedef typename AnchorPointMap::const_iterator AnchorPointMapConstIterator;
+  typedef std::vector<std::pair<Index, const char *> > ExternalAnchorPoints;
   const Directory<Offset> &_directory;
   const AddressMap &_addressMap;
   const ThreadMap<Offset> &_threadMap;
   const StackRegistry<Offset> &_stackRegistry;
   const ExternalAnchorPointChecker<Offset> *_externalAnchorPointChecker;
   const ObscuredReferenceChecker<Offset> *_obscuredReferenceChecker;
+  const PointerCandidateFilter<Offset> _candidateFilter;
   Index _numAllocations;
   EdgeIndex _totalEdges;
-  std::vector<Index> _outgoing;
-  std::vector<Index> _incoming;
-  std::vector<EdgeIndex> _firstOutgoing;
-  std::vector<EdgeIndex> _firstIncoming;
+  std::vector<Index, SpillAllocator<Index> > _outgoing;
+  std::vector<Index, SpillAllocator<Index> > _incoming;
+  DeltaEncodedOffsets<EdgeIndex> _firstOutgoing;
+  DeltaEncodedOffsets<EdgeIndex> _firstIncoming;
   IndexedDistances<Index> _staticAnchorDistances;
   IndexedDistances<Index> _stackAnchorDistances;
   IndexedDistances<Index> _registerAnchorDistances;
   IndexedDistances<Index> _externalAnchorDistances;
   std::vector<bool> _leaked;
-  AnchorPointMap _staticAnchorPoints;
-  AnchorPointMap _stackAnchorPoints;
-  AnchorPointMap _registerAnchorPoints;
-  std::map<Index, const char *> _externalAnchorPoints;
+  AnchorPoints<Index, Offset> _staticAnchorPoints;
+  AnchorPoints<Index, Offset> _stackAnchorPoints;
+  AnchorPoints<Index, Offset> _registerAnchorPoints;
+  ExternalAnchorPoints _externalAnchorPoints;
+  std::set<std::string> _cachedExternalAnchorReasons;
+  const size_t _numThreads;
+  const bool _lowMemory;
+
+  /*
+   * In low memory mode, the pages of the core that have been read to find
+   * the edges are released after roughly this many bytes of allocations
+   * have been scanned, so that the core need not fit in memory.
+   */
+  static constexpr uint64_t SCANNED_BYTES_PER_RELEASE = 0x10000000;
+
+  /*
+   * These are the tasks for finding anchor points other than static ones,
+   * which are followed by one task per static range.
+   */
+  static constexpr size_t STACK_ANCHOR_TASK = 0;
+  static constexpr size_t REGISTER_ANCHOR_TASK = 1;
+  static constexpr size_t EXTERNAL_ANCHOR_TASK = 2;
+  static constexpr size_t NUM_OTHER_ANCHOR_TASKS = 3;
+
+  typename ExternalAnchorPoints::const_iterator FindExternalAnchorPoint(
+      Index index) const {
+    typename ExternalAnchorPoints::const_iterator it = std::lower_bound(
+        _externalAnchorPoints.begin(), _externalAnchorPoints.end(), index,
+        [](const std::pair<Index, const char *> &anchorPoint, Index index) {
+          return anchorPoint.first < index;
+        });
+    return (it != _externalAnchorPoints.end() && it->first == index)
+               ? it
+               : _externalAnchorPoints.end();
+  }
+
+  bool Read(AnalysisCacheReader &reader) {
+    uint64_t numAllocations, totalEdges;
+    if (!reader.ReadValue(numAllocations) || !reader.ReadValue(totalEdges) ||
+        numAllocations != _numAllocations) {
+      return reader.Fail();
+    }
+    _totalEdges = totalEdges;
+    if (!_firstOutgoing.Read(reader) || !reader.ReadVector(_outgoing) ||
+        !_firstIncoming.Read(reader) || !reader.ReadVector(_incoming)) {
+      return false;
+    }
+    size_t expectedFirstSize = (_numAllocations == 0) ? 0 : _numAllocations + 1;
+    if (_firstOutgoing.Size() != expectedFirstSize ||
+        _firstIncoming.Size() != expectedFirstSize ||
+        _outgoing.size() != _totalEdges || _incoming.size() != _totalEdges ||
+        (_numAllocations != 0 &&
+         (_firstOutgoing[_numAllocations] != _totalEdges ||
+          _firstIncoming[_numAllocations] != _totalEdges))) {
+      return reader.Fail();
+    }
+    if (!_staticAnchorDistances.Read(reader) ||
+        !_stackAnchorDistances.Read(reader) ||
+        !_registerAnchorDistances.Read(reader) ||
+        !_externalAnchorDistances.Read(reader) || !reader.ReadBits(_leaked) ||
+        _leaked.size() != _numAllocations ||
+        !_staticAnchorPoints.Read(reader, _numAllocations) ||
+        !_stackAnchorPoints.Read(reader, _numAllocations) ||
+        !_registerAnchorPoints.Read(reader, _numAllocations)) {
+      return reader.Fail();
+    }
+    uint64_t numExternalAnchorPoints;
+    if (!reader.ReadValue(numExternalAnchorPoints)) {
+      return false;
+    }
+    for (uint64_t i = 0; i < numExternalAnchorPoints; i++) {
+      uint64_t index;
+      std::string reason;
+      if (!reader.ReadValue(index) || index >= _numAllocations ||
+          (!_externalAnchorPoints.empty() &&
+           index <= _externalAnchorPoints.back().first) ||
+          !reader.ReadString(reason)) {
+        return reader.Fail();
+      }
+      _externalAnchorPoints.emplace_back(
+          index, _cachedExternalAnchorReasons.insert(reason).first->c_str());
+    }
+    return true;
+  }
 
   /*
    * Attempt to interpret the given target candidate as a reference to
    * an allocation, returning an index for that allocation if so.
    */
-  Index EdgeTargetIndex(Offset targetCandidate) {
+  Index EdgeTargetIndex(Offset targetCandidate) const {
     Index targetIndex = _directory.AllocationIndexOf(targetCandidate);
     if (targetIndex == _numAllocations &&
         _obscuredReferenceChecker != nullptr) {
@@ -646,29 +824,201 @@ class Graph {
     if (_numAllocations == 0) {
       return;
     }
+    std::vector<EdgeIndex> firstOutgoing;
+    std::vector<EdgeIndex> firstIncoming;
+    if (_numThreads > 1 && !_lowMemory) {
+      FindEdgesInParallel(firstOutgoing, firstIncoming);
+    } else {
+      FindEdgesSerially(firstOutgoing, firstIncoming);
+    }
+    _firstOutgoing.Assign(firstOutgoing.data(), firstOutgoing.size());
+    std::vector<EdgeIndex>().swap(firstOutgoing);
+    _firstIncoming.Assign(firstIncoming.data(), firstIncoming.size());
+  }
+
+  /*
+   * Account for the scanning of the given allocation, releasing the pages of
+   * the core that have been read if enough has been scanned since the last
+   * release.  This does nothing unless in low memory mode.
+   */
+  void NoteScanned(Index index, uint64_t &bytesSinceRelease) const {
+    if (_lowMemory) {
+      bytesSinceRelease += _directory.AllocationAt(index)->Size();
+      if (bytesSinceRelease >= SCANNED_BYTES_PER_RELEASE) {
+        _addressMap.GetFileImage().ReleaseResidentPages();
+        bytesSinceRelease = 0;
+      }
+    }
+  }
+
+  /*
+   * Append to the given vector, in increasing order and without duplicates,
+   * the indices of all the allocations referenced by the allocation with the
+   * given index, returning the number appended.  The given targets vector is
+   * used only as scratch space.
+   */
+  size_t AppendOutgoing(Index source, ContiguousImage<Offset> &contiguousImage,
+                        std::vector<Index> &targets,
+                        std::vector<Index> &outgoing) const {
+    contiguousImage.SetIndex(source);
+    if (contiguousImage.IsKnownZero()) {
+      return 0;
+    }
+    targets.clear();
+    Index prevTarget = _numAllocations;
+    const Offset *offsetLimit = contiguousImage.OffsetLimit();
+    _candidateFilter.VisitCandidates(
+        contiguousImage.FirstOffset(), offsetLimit, [&](const Offset *check) {
+          Index target = EdgeTargetIndex(*check);
+          if (target != _numAllocations && target != source &&
+              target != prevTarget) {
+            targets.push_back(target);
+            prevTarget = target;
+          }
+        });
+    size_t numAppended = 0;
+    if (!targets.empty()) {
+      if (targets.size() > 1) {
+        std::sort(targets.begin(), targets.end());
+      }
+      prevTarget = _numAllocations;
+      for (Index target : targets) {
+        if (target != prevTarget) {
+          outgoing.push_back(target);
+          numAppended++;
+          prevTarget = target;
+        }
+      }
+    }
+    return numAppended;
+  }
+
+  /*
+   * Find the edges using all the allowed threads.  The allocations are split
+   * into chunks of roughly equal total size, and each chunk is scanned just
+   * once by a single worker, which keeps the outgoing edges for that chunk
+   * and the count for each source in that chunk.  A prefix sum over the
+   * counts gives the start of each source in _outgoing, and _incoming is
+   * derived from _outgoing, so the results are identical to those of
+   * FindEdgesSerially().
+   */
+  void FindEdgesInParallel(std::vector<EdgeIndex> &firstOutgoing,
+                           std::vector<EdgeIndex> &firstIncoming) {
+    size_t numWorkers = std::min(_numThreads, (size_t)(_numAllocations));
+    size_t numChunks = std::min(numWorkers * 16, (size_t)(_numAllocations));
+
+    /*
+     * Pick chunk boundaries by size rather than count because the time to
+     * scan an allocation is roughly proportional to its size.
+     */
+    uint64_t totalSize = 0;
+    for (Index i = 0; i < _numAllocations; i++) {
+      totalSize += _directory.AllocationAt(i)->Size();
+    }
+    uint64_t sizePerChunk = (totalSize / numChunks) + 1;
+    std::vector<Index> chunkStarts;
+    chunkStarts.reserve(numChunks + 1);
+    chunkStarts.push_back(0);
+    uint64_t sizeInChunk = 0;
+    for (Index i = 0; i < _numAllocations; i++) {
+      sizeInChunk += _directory.AllocationAt(i)->Size();
+      if (sizeInChunk >= sizePerChunk && i + 1 < _numAllocations) {
+        chunkStarts.push_back(i + 1);
+        sizeInChunk = 0;
+      }
+    }
+    chunkStarts.push_back(_numAllocations);
+    numChunks = chunkStarts.size() - 1;
+
+    firstOutgoing.reserve(_numAllocations + 1);
+    firstOutgoing.resize(_numAllocations + 1, 0);
+    std::vector<std::vector<Index> > chunkOutgoing(numChunks);
+    std::vector<std::unique_ptr<ContiguousImage<Offset> > > contiguousImages(
+        numWorkers);
+    std::vector<std::vector<Index> > workerTargets(numWorkers);
+
+    RunInParallel(numWorkers, numChunks, [&](size_t worker, size_t chunk) {
+      if (!contiguousImages[worker]) {
+        contiguousImages[worker].reset(
+            new ContiguousImage<Offset>(_addressMap, _directory));
+      }
+      ContiguousImage<Offset> &contiguousImage = *(contiguousImages[worker]);
+      std::vector<Index> &targets = workerTargets[worker];
+      std::vector<Index> &outgoing = chunkOutgoing[chunk];
+      Index chunkLimit = chunkStarts[chunk + 1];
+      for (Index i = chunkStarts[chunk]; i < chunkLimit; i++) {
+        firstOutgoing[i] =
+            AppendOutgoing(i, contiguousImage, targets, outgoing);
+      }
+    });
+
+    /*
+     * Convert the counts in firstOutgoing to the index of the first
+     * outgoing edge for each source, then gather the edges for all the
+     * chunks, releasing the space for each chunk as it is copied.
+     */
+    for (Index i = 0; i < _numAllocations; i++) {
+      EdgeIndex numOutgoing = firstOutgoing[i];
+      firstOutgoing[i] = _totalEdges;
+      _totalEdges += numOutgoing;
+    }
+    firstOutgoing[_numAllocations] = _totalEdges;
+    _outgoing.reserve(_totalEdges);
+    for (std::vector<Index> &outgoing : chunkOutgoing) {
+      _outgoing.insert(_outgoing.end(), outgoing.begin(), outgoing.end());
+      std::vector<Index>().swap(outgoing);
+    }
+
+    firstIncoming.reserve(_numAllocations + 1);
+    firstIncoming.resize(_numAllocations + 1, 0);
+    for (Index target : _outgoing) {
+      firstIncoming[target]++;
+    }
+    for (Index i = 0; i < _numAllocations; i++) {
+      firstIncoming[i + 1] = firstIncoming[i] + firstIncoming[i + 1];
+    }
+    _incoming.reserve(_totalEdges);
+    _incoming.resize(_totalEdges, 0);
+    for (Index i = _numAllocations; i > 0;) {
+      --i;
+      EdgeIndex outgoingLimit = firstOutgoing[i + 1];
+      for (EdgeIndex outgoing = firstOutgoing[i]; outgoing < outgoingLimit;
+           outgoing++) {
+        _incoming[--firstIncoming[_outgoing[outgoing]]] = i;
+      }
+    }
+  }
 
+  void FindEdgesSerially(std::vector<EdgeIndex> &firstOutgoing,
+                         std::vector<EdgeIndex> &firstIncoming) {
     Offset maxAllocationSize = _directory.MaxAllocationSize();
     std::vector<Index> targets;
     targets.reserve(maxAllocationSize);
 
-    _firstIncoming.reserve(_numAllocations + 1);
-    _firstIncoming.resize(_numAllocations + 1, 0);
-    _firstOutgoing.reserve(_numAllocations + 1);
-    _firstOutgoing.resize(_numAllocations + 1, 0);
+    firstIncoming.reserve(_numAllocations + 1);
+    firstIncoming.resize(_numAllocations + 1, 0);
+    firstOutgoing.reserve(_numAllocations + 1);
+    firstOutgoing.resize(_numAllocations + 1, 0);
 
     /*
      * Count all the edges, but don't store them yet.  At the end of this
-     * first pass, _firstOutgoing[i] will be set correctly to the index of
+     * first pass, firstOutgoing[i] will be set correctly to the index of
      * the first outgoing edge for allocation i in the array _outgoing,
-     * but _firstIncoming[i] will have a temporary value of the number
+     * but firstIncoming[i] will have a temporary value of the number
      * of incoming edges for allocation i, rather than the correct index
      * into _incoming.
      */
     ContiguousImage<Offset> contiguousImage(_addressMap, _directory);
     Reader reader(_addressMap);
+    const FileImage &fileImage = _addressMap.GetFileImage();
+    uint64_t bytesSinceRelease = 0;
+    if (_lowMemory) {
+      fileImage.AdviseSequentialAccess(true);
+    }
     for (Index i = 0; i < _numAllocations; i++) {
       contiguousImage.SetIndex(i);
-      _firstOutgoing[i] = _totalEdges;
+      NoteScanned(i, bytesSinceRelease);
+      firstOutgoing[i] = _totalEdges;
       // const Allocation *allocation = _directory.AllocationAt(i);
 
       /*
@@ -677,17 +1027,21 @@ class Graph {
        * check the source and/or the target when one particular usage status
        * is required.
        */
+      if (contiguousImage.IsKnownZero()) {
+        continue;
+      }
       targets.clear();
       Index prevTarget = _numAllocations;
       const Offset *offsetLimit = contiguousImage.OffsetLimit();
-      for (const Offset *check = contiguousImage.FirstOffset();
-           check < offsetLimit; check++) {
-        Index target = EdgeTargetIndex(*check);
-        if (target != _numAllocations && target != i && target != prevTarget) {
-          targets.push_back(target);
-          prevTarget = target;
-        }
-      }
+      _candidateFilter.VisitCandidates(
+          contiguousImage.FirstOffset(), offsetLimit, [&](const Offset *check) {
+            Index target = EdgeTargetIndex(*check);
+            if (target != _numAllocations && target != i &&
+                target != prevTarget) {
+              targets.push_back(target);
+              prevTarget = target;
+            }
+          });
       if (!targets.empty()) {
         if (targets.size() > 1) {
           std::sort(targets.begin(), targets.end());
@@ -695,22 +1049,28 @@ class Graph {
         Index prevTarget = _numAllocations;
         for (Offset target : targets) {
           if (target != prevTarget) {
-            _firstIncoming[target]++;
+            firstIncoming[target]++;
             _totalEdges++;
             prevTarget = target;
           }
         }
       }
     }
-    _firstOutgoing[_numAllocations] = _totalEdges;
+    firstOutgoing[_numAllocations] = _totalEdges;
+    if (_lowMemory) {
+      /*
+       * The second pass goes backwards, so read-ahead would not help.
+       */
+      fileImage.AdviseSequentialAccess(false);
+    }
 
     /*
-     * Convert values in _firstIncoming from incoming edge counts to offsets
+     * Convert values in firstIncoming from incoming edge counts to offsets
      * just after incoming edges.
      */
 
     for (Index i = 0; i < _numAllocations; i++) {
-      _firstIncoming[i + 1] = _firstIncoming[i] + _firstIncoming[i + 1];
+      firstIncoming[i + 1] = firstIncoming[i] + firstIncoming[i + 1];
     }
     _outgoing.reserve(_totalEdges);
     _outgoing.resize(_totalEdges, 0);
@@ -719,7 +1079,7 @@ class Graph {
 
     /*
      * Fill in the outgoing and incoming edges and convert values in
-     * _firstIncoming to indicate the index of the first incoming edge
+     * firstIncoming to indicate the index of the first incoming edge
      * for the corresponding node in _incoming.  Go backwards in the
      * sources so that the incoming edges in _incoming have subranges
      * in increasing order of target, where the values in each subrange
@@ -728,144 +1088,245 @@ class Graph {
 
     for (Index i = _numAllocations; i > 0;) {
       contiguousImage.SetIndex(--i);
+      NoteScanned(i, bytesSinceRelease);
       /*
        * Note that we find all the edges, regardless of whether the source
        * or target is used or free.  Code that uses the graph is expected to
        * check the source and/or the target when one particular usage status
        * is required.
        */
+      if (contiguousImage.IsKnownZero()) {
+        continue;
+      }
       targets.clear();
       Index prevTarget = _numAllocations;
       const Offset *offsetLimit = contiguousImage.OffsetLimit();
-      for (const Offset *check = contiguousImage.FirstOffset();
-           check < offsetLimit; check++) {
-        Index target = EdgeTargetIndex(*check);
-        if (target != _numAllocations && target != i && target != prevTarget) {
-          targets.push_back(target);
-          prevTarget = target;
-        }
-      }
+      _candidateFilter.VisitCandidates(
+          contiguousImage.FirstOffset(), offsetLimit, [&](const Offset *check) {
+            Index target = EdgeTargetIndex(*check);
+            if (target != _numAllocations && target != i &&
+                target != prevTarget) {
+              targets.push_back(target);
+              prevTarget = target;
+            }
+          });
       if (!targets.empty()) {
         if (targets.size() > 1) {
           std::sort(targets.begin(), targets.end());
         }
         Index prevTarget = _numAllocations;
-        EdgeIndex nextOutgoing = _firstOutgoing[i];
+        EdgeIndex nextOutgoing = firstOutgoing[i];
         for (Offset target : targets) {
           if (target != prevTarget) {
-            _incoming[--_firstIncoming[target]] = i;
+            _incoming[--firstIncoming[target]] = i;
             _outgoing[nextOutgoing++] = target;
             prevTarget = target;
           }
         }
       }
     }
+    if (_lowMemory) {
+      fileImage.ReleaseResidentPages();
+    }
   }
 
-  void MarkAnchoredChunks(AnchorPointMap &anchorPoints,
-                          IndexedDistances<Index> &anchorDistance) {
-    std::vector<bool> visited;
-    visited.reserve(_numAllocations);
-    visited.resize(_numAllocations, false);
-    for (Index index = 0; index < _numAllocations; index++) {
-      if (!_directory.AllocationAt(index)->IsUsed()) {
-        visited[index] = true;
-      }
-    }
-    std::deque<Index> toVisit;
-    AnchorPointMapConstIterator itEnd = anchorPoints.end();
-    for (AnchorPointMapConstIterator it = anchorPoints.begin(); it != itEnd;
-         ++it) {
-      Index index = it->first;
-      visited[index] = true;
-      _leaked[index] = false;
-      anchorDistance.SetDistance(index, 1);
-      toVisit.push_back(index);
-    }
-    while (!toVisit.empty()) {
-      Index sourceIndex = toVisit.front();
-      Index newDistance = anchorDistance.GetDistance(sourceIndex) + 1;
-      toVisit.pop_front();
-      EdgeIndex edgeLimit = _firstOutgoing[sourceIndex + 1];
-      for (EdgeIndex edgeIndex = _firstOutgoing[sourceIndex];
-           edgeIndex < edgeLimit; edgeIndex++) {
-        Index targetIndex = _outgoing[edgeIndex];
-        if (!visited[targetIndex]) {
-          visited[targetIndex] = true;
-          _leaked[targetIndex] = false;
-          anchorDistance.SetDistance(targetIndex, newDistance);
-          toVisit.push_back(targetIndex);
-        }
-      }
-    }
+  /*
+   * Allocations are marked as visited in bit sets with one bit per
+   * allocation, packed into 64-bit words.
+   */
+  static bool TestBit(const std::vector<uint64_t> &bits, Index index) {
+    return (bits[index / 64] & (((uint64_t)1) << (index % 64))) != 0;
+  }
+  static void SetBit(std::vector<uint64_t> &bits, Index index) {
+    bits[index / 64] |= ((uint64_t)1) << (index % 64);
   }
 
-  void MarkAnchoredChunks(std::map<Index, const char *> &anchorPoints,
+  /*
+   * A level is found bottom up once the edges from the previous level are
+   * more than 1/TOP_DOWN_RATIO of the incoming edges of the allocations not
+   * yet visited, and top down again once the previous level has fewer than
+   * 1/BOTTOM_UP_RATIO of all the allocations.
+   */
+  static constexpr EdgeIndex TOP_DOWN_RATIO = 14;
+  static constexpr size_t BOTTOM_UP_RATIO = 24;
+
+  /*
+   * Set the distance to each used allocation reachable from the given
+   * anchor points, where an anchor point is at distance 1, given the bits
+   * for allocations that are not used and the number of incoming edges for
+   * allocations that are used.  The search is breadth first, one level at a
+   * time.  Each level is found either top down, by following the outgoing
+   * edges of the previous level, or, when that would mostly reach
+   * allocations already visited, bottom up, by checking each allocation
+   * not yet visited for an incoming edge from the previous level.  Either
+   * way gives the same distances.  Nothing is changed but the given
+   * distances, so the searches for different kinds of anchor points can
+   * run at the same time.
+   */
+  template <typename AnchorPointIndexAt>
+  void MarkAnchoredChunks(size_t numAnchorPoints,
+                          AnchorPointIndexAt anchorPointIndexAt,
+                          const std::vector<uint64_t> &unused,
+                          EdgeIndex usedIncoming,
                           IndexedDistances<Index> &anchorDistance) {
-    std::vector<bool> visited;
-    visited.reserve(_numAllocations);
-    visited.resize(_numAllocations, false);
-    for (Index index = 0; index < _numAllocations; index++) {
-      if (!_directory.AllocationAt(index)->IsUsed()) {
-        visited[index] = true;
-      }
-    }
-    std::deque<Index> toVisit;
-    typename std::map<Index, const char *>::const_iterator itEnd =
-        anchorPoints.end();
-    for (typename std::map<Index, const char *>::const_iterator it =
-             anchorPoints.begin();
-         it != itEnd; ++it) {
-      Index index = it->first;
-      visited[index] = true;
-      _leaked[index] = false;
+    std::vector<uint64_t> visited(unused);
+    EdgeIndex unvisitedIncoming = usedIncoming;
+    std::vector<Index> frontier;
+    frontier.reserve(numAnchorPoints);
+    for (size_t i = 0; i < numAnchorPoints; i++) {
+      Index index = anchorPointIndexAt(i);
+      if (!TestBit(visited, index)) {
+        SetBit(visited, index);
+        unvisitedIncoming -= _firstIncoming[index + 1] - _firstIncoming[index];
+      }
       anchorDistance.SetDistance(index, 1);
-      toVisit.push_back(index);
-    }
-    while (!toVisit.empty()) {
-      Index sourceIndex = toVisit.front();
-      Index newDistance = anchorDistance.GetDistance(sourceIndex) + 1;
-      toVisit.pop_front();
-      EdgeIndex edgeLimit = _firstOutgoing[sourceIndex + 1];
-      for (EdgeIndex edgeIndex = _firstOutgoing[sourceIndex];
-           edgeIndex < edgeLimit; edgeIndex++) {
-        Index targetIndex = _outgoing[edgeIndex];
-        if (!visited[targetIndex]) {
-          visited[targetIndex] = true;
-          _leaked[targetIndex] = false;
-          anchorDistance.SetDistance(targetIndex, newDistance);
-          toVisit.push_back(targetIndex);
+      frontier.push_back(index);
+    }
+    std::vector<Index> nextFrontier;
+    std::vector<uint64_t> inFrontier;
+    bool bottomUp = false;
+    for (Index distance = 2; !frontier.empty(); distance++) {
+      if (bottomUp) {
+        bottomUp = frontier.size() * BOTTOM_UP_RATIO >= _numAllocations;
+      } else {
+        EdgeIndex frontierOutgoing = 0;
+        for (Index source : frontier) {
+          frontierOutgoing +=
+              _firstOutgoing[source + 1] - _firstOutgoing[source];
         }
+        bottomUp = frontierOutgoing > unvisitedIncoming / TOP_DOWN_RATIO;
       }
+      nextFrontier.clear();
+      if (bottomUp) {
+        inFrontier.assign(visited.size(), 0);
+        for (Index source : frontier) {
+          SetBit(inFrontier, source);
+        }
+        for (size_t word = 0; word < visited.size(); word++) {
+          for (uint64_t unvisited = ~visited[word]; unvisited != 0;
+               unvisited &= unvisited - 1) {
+            Index target =
+                (Index)(word * 64 + __builtin_ctzll(unvisited));
+            EdgeIndex edgeLimit = _firstIncoming[target + 1];
+            for (EdgeIndex edgeIndex = _firstIncoming[target];
+                 edgeIndex < edgeLimit; edgeIndex++) {
+              if (TestBit(inFrontier, _incoming[edgeIndex])) {
+                SetBit(visited, target);
+                nextFrontier.push_back(target);
+                break;
+              }
+            }
+          }
+        }
+      } else {
+        for (Index source : frontier) {
+          EdgeIndex edgeLimit = _firstOutgoing[source + 1];
+          for (EdgeIndex edgeIndex = _firstOutgoing[source];
+               edgeIndex < edgeLimit; edgeIndex++) {
+            Index target = _outgoing[edgeIndex];
+            if (!TestBit(visited, target)) {
+              SetBit(visited, target);
+              nextFrontier.push_back(target);
+            }
+          }
+        }
+      }
+      for (Index target : nextFrontier) {
+        anchorDistance.SetDistance(target, distance);
+        unvisitedIncoming -=
+            _firstIncoming[target + 1] - _firstIncoming[target];
+      }
+      frontier.swap(nextFrontier);
     }
   }
 
+  /*
+   * Find the anchor points referenced from the given range.  Each imaged
+   * region that overlaps the range is scanned directly so that the candidate
+   * filter can be applied to whole blocks of words.  As with reading one
+   * word at a time, a word is skipped unless it is entirely within a single
+   * imaged region.
+   */
   void FindAnchorPoints(Offset rangeBase, Offset rangeEnd,
-                        AnchorPointMap &anchorPoints) {
-    Reader reader(_addressMap);
-    for (Offset anchor = rangeBase; anchor < rangeEnd;
-         anchor += sizeof(Offset)) {
-      try {
-        Offset candidateTarget = reader.ReadOffset(anchor);
-        Index targetIndex = EdgeTargetIndex(candidateTarget);
-        const Allocation *target = _directory.AllocationAt(targetIndex);
-        if ((target != 0) && target->IsUsed()) {
-          anchorPoints.try_emplace(targetIndex).first->second.push_back(anchor);
-        }
-      } catch (NotMapped &) {
+                        AnchorPoints<Index, Offset> &anchorPoints) const {
+    typename AddressMap::const_iterator itEnd = _addressMap.end();
+    for (typename AddressMap::const_iterator it =
+             _addressMap.upper_bound(rangeBase);
+         it != itEnd && it.Base() < rangeEnd; ++it) {
+      const char *image = it.GetImage();
+      if (image == nullptr) {
+        continue;
+      }
+      Offset regionBase = it.Base();
+      /*
+       * Any part of the region known to contain only zeros can't have
+       * anchors.
+       */
+      Offset regionLimit = it.KnownZeroBase();
+      Offset firstAnchor = rangeBase;
+      if (firstAnchor < regionBase) {
+        firstAnchor += (regionBase - rangeBase + sizeof(Offset) - 1) &
+                       ~(sizeof(Offset) - 1);
       }
+      if (firstAnchor >= rangeEnd || firstAnchor >= regionLimit ||
+          regionLimit - firstAnchor < sizeof(Offset)) {
+        continue;
+      }
+      Offset numAnchors = (regionLimit - firstAnchor) / sizeof(Offset);
+      Offset numBeforeEnd =
+          (rangeEnd - firstAnchor + sizeof(Offset) - 1) / sizeof(Offset);
+      if (numAnchors > numBeforeEnd) {
+        numAnchors = numBeforeEnd;
+      }
+      const Offset *first =
+          (const Offset *)(image + (firstAnchor - regionBase));
+      _candidateFilter.VisitCandidates(
+          first, first + numAnchors, [&](const Offset *check) {
+            Index targetIndex = EdgeTargetIndex(*check);
+            const Allocation *target = _directory.AllocationAt(targetIndex);
+            if ((target != 0) && target->IsUsed()) {
+              anchorPoints.Add(targetIndex,
+                               firstAnchor + (check - first) * sizeof(Offset));
+            }
+          });
     }
   }
 
-  void FindStaticAnchorPoints(
+  /*
+   * Find the anchor points of all kinds.  The stack, register and external
+   * anchor points are found at the same time as each other and as the
+   * static anchor points, for which each static range is scanned
+   * separately and the results are combined in order.
+   */
+  void FindAllAnchorPoints(
       const std::map<Offset, Offset> &staticAnchorLimits) {
-    typename std::map<Offset, Offset>::const_iterator itEnd =
-        staticAnchorLimits.end();
-    for (typename std::map<Offset, Offset>::const_iterator it =
-             staticAnchorLimits.begin();
-         it != itEnd; ++it) {
-      FindAnchorPoints(it->first, it->second, _staticAnchorPoints);
+    std::vector<std::pair<Offset, Offset> > staticRanges(
+        staticAnchorLimits.begin(), staticAnchorLimits.end());
+    std::vector<AnchorPoints<Index, Offset> > staticPieces(
+        staticRanges.size());
+    RunInParallel(
+        (_numThreads > 1 && !_lowMemory) ? _numThreads : 1,
+        NUM_OTHER_ANCHOR_TASKS + staticRanges.size(),
+        [&](size_t, size_t task) {
+          if (task == STACK_ANCHOR_TASK) {
+            FindStackAnchorPoints();
+          } else if (task == REGISTER_ANCHOR_TASK) {
+            FindRegisterAnchorPoints();
+          } else if (task == EXTERNAL_ANCHOR_TASK) {
+            FindExternalAnchorPoints();
+          } else {
+            const std::pair<Offset, Offset> &range =
+                staticRanges[task - NUM_OTHER_ANCHOR_TASKS];
+            FindAnchorPoints(range.first, range.second,
+                             staticPieces[task - NUM_OTHER_ANCHOR_TASKS]);
+          }
+        });
+    for (AnchorPoints<Index, Offset> &piece : staticPieces) {
+      _staticAnchorPoints.Append(piece);
     }
+    _staticAnchorPoints.Finish();
+    _stackAnchorPoints.Finish();
+    _registerAnchorPoints.Finish();
   }
 
   void FindStackAnchorPoints() {
@@ -903,8 +1364,8 @@ class Graph {
           Index targetIndex = _directory.AllocationIndexOf(candidateTarget);
           const Allocation *target = _directory.AllocationAt(targetIndex);
           if ((target != 0) && target->IsUsed()) {
-            _registerAnchorPoints.try_emplace(targetIndex)
-                .first->second.push_back(it->_threadNum * numRegisters + i);
+            _registerAnchorPoints.Add(targetIndex,
+                                      it->_threadNum * numRegisters + i);
           }
         }
       }
@@ -921,7 +1382,7 @@ class Graph {
               _externalAnchorPointChecker->GetExternalAnchorReason(
                   i, contiguousImage);
           if (externalAnchorReason != (const char *)0) {
-            _externalAnchorPoints[i] = externalAnchorReason;
+            _externalAnchorPoints.emplace_back(i, externalAnchorReason);
           }
         }
       }
@@ -929,17 +1390,52 @@ class Graph {
   }
 
   void MarkLeakedChunks() {
-    _leaked.reserve(_numAllocations);
-    _leaked.resize(_numAllocations, true);
+    std::vector<uint64_t> unused((_numAllocations + 63) / 64, 0);
+    EdgeIndex usedIncoming = 0;
     for (Index i = 0; i < _numAllocations; i++) {
       if (!_directory.AllocationAt(i)->IsUsed()) {
-        _leaked[i] = false;
+        SetBit(unused, i);
+      } else {
+        usedIncoming += _firstIncoming[i + 1] - _firstIncoming[i];
       }
     }
-    MarkAnchoredChunks(_staticAnchorPoints, _staticAnchorDistances);
-    MarkAnchoredChunks(_stackAnchorPoints, _stackAnchorDistances);
-    MarkAnchoredChunks(_registerAnchorPoints, _registerAnchorDistances);
-    MarkAnchoredChunks(_externalAnchorPoints, _externalAnchorDistances);
+    for (Index i = _numAllocations; i < unused.size() * 64; i++) {
+      SetBit(unused, i);
+    }
+    RunInParallel(
+        (_numThreads > 1 && !_lowMemory) ? _numThreads : 1, 4,
+        [&](size_t, size_t kind) {
+          if (kind == 0) {
+            MarkAnchoredChunks(
+                _staticAnchorPoints.Size(),
+                [this](size_t i) { return _staticAnchorPoints.IndexAt(i); },
+                unused, usedIncoming, _staticAnchorDistances);
+          } else if (kind == 1) {
+            MarkAnchoredChunks(
+                _stackAnchorPoints.Size(),
+                [this](size_t i) { return _stackAnchorPoints.IndexAt(i); },
+                unused, usedIncoming, _stackAnchorDistances);
+          } else if (kind == 2) {
+            MarkAnchoredChunks(
+                _registerAnchorPoints.Size(),
+                [this](size_t i) { return _registerAnchorPoints.IndexAt(i); },
+                unused, usedIncoming, _registerAnchorDistances);
+          } else {
+            MarkAnchoredChunks(
+                _externalAnchorPoints.size(),
+                [this](size_t i) { return _externalAnchorPoints[i].first; },
+                unused, usedIncoming, _externalAnchorDistances);
+          }
+        });
+    _leaked.reserve(_numAllocations);
+    _leaked.resize(_numAllocations, false);
+    for (Index i = 0; i < _numAllocations; i++) {
+      _leaked[i] = !TestBit(unused, i) &&
+                   _staticAnchorDistances.GetDistance(i) == 0 &&
+                   _stackAnchorDistances.GetDistance(i) == 0 &&
+                   _registerAnchorDistances.GetDistance(i) == 0 &&
+                   _externalAnchorDistances.GetDistance(i) == 0;
+    }
   }
 };
 }  // namespace Allocations
@@ -3,6 +3,7 @@
 // SPDX-License-Identifier: GPL-2.0
 
 #pragma once
+#include "../AnalysisCache.h"
 namespace chap {
 namespace Allocations {
 template <typename Index>
@@ -65,6 +66,58 @@ class IndexedDistances {
     }
   }
 
+  void Write(AnalysisCacheWriter &writer) const {
+    writer.WriteValue<uint64_t>(_distanceBits);
+    if (_distanceBits == 8) {
+      writer.WriteVector(_distances8);
+    } else if (_distanceBits == 16) {
+      writer.WriteVector(_distances16);
+    } else {
+      writer.WriteVector(_distances32);
+    }
+  }
+
+  size_t MemoryFootprint() const {
+    return _distances8.capacity() + _distances16.capacity() * sizeof(uint16_t) +
+           _distances32.capacity() * sizeof(uint32_t);
+  }
+
+  bool Read(AnalysisCacheReader &reader) {
+    uint64_t distanceBits;
+    if (!reader.ReadValue(distanceBits)) {
+      return false;
+    }
+    std::vector<uint8_t> distances8;
+    std::vector<uint16_t> distances16;
+    std::vector<uint32_t> distances32;
+    size_t numRead = 0;
+    Index maxDistance = 0;
+    if (distanceBits == 8) {
+      reader.ReadVector(distances8);
+      numRead = distances8.size();
+      maxDistance = 0xFF;
+    } else if (distanceBits == 16) {
+      reader.ReadVector(distances16);
+      numRead = distances16.size();
+      maxDistance = 0xFFFF;
+    } else if (distanceBits == 32) {
+      reader.ReadVector(distances32);
+      numRead = distances32.size();
+      maxDistance = 0xFFFFFFFF;
+    } else {
+      return reader.Fail();
+    }
+    if (!reader.Ok() || numRead != _numIndices) {
+      return reader.Fail();
+    }
+    _distanceBits = distanceBits;
+    _maxDistance = maxDistance;
+    _distances8.swap(distances8);
+    _distances16.swap(distances16);
+    _distances32.swap(distances32);
+    return true;
+  }
+
  private:
   Index _numIndices;
   uint16_t _distanceBits;
@@ -1,10 +1,11 @@
-// Copyright (c) 2017,2020 Broadcom. All Rights Reserved.
+// Copyright (c) 2017,2020,2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
 #pragma once
 #include "../../Commands/Runner.h"
 #include "../../Commands/Subcommand.h"
+#include "../ChainWalker.h"
 #include "../Directory.h"
 #include "../SetCache.h"
 namespace chap {
@@ -39,12 +40,18 @@ class Chain {
                 << " is not a offset for the link field.\n";
         } else {
           AllocationIndex index = directory.AllocationIndexOf(address);
+          bool showChainStatistics = false;
           if (index == numAllocations) {
             error << context.Positional(2)
                   << " is not part of an allocation.\n";
-          } else {
+          } else if (context.ParseBooleanSwitch("showChainStatistics",
+                                                showChainStatistics)) {
             iterator = new Chain(directory, processImage.GetVirtualAddressMap(),
-                                 index, numAllocations, linkOffset);
+                                 index, linkOffset, error);
+            if (showChainStatistics) {
+              iterator->GetWalker().Measure();
+              iterator->GetWalker().ShowStatistics(context);
+            }
           }
         }
       }
@@ -62,7 +69,11 @@ class Chain {
                 " links at the given\n"
                 "offset until the link offset doesn't fit in the allocation or"
                 " the target is not\n"
-                "in an allocation.\n";
+                "in an allocation.  A chain that loops back on itself ends"
+                " just before the\n"
+                "first allocation that would be visited twice.  Use"
+                " \"/showChainStatistics true\" to\n"
+                "show the length of the chain before visiting it.\n";
     }
 
    private:
@@ -74,40 +85,17 @@ class Chain {
 
   Chain(const Directory<Offset>& directory,
         const VirtualAddressMap<Offset>& addressMap, AllocationIndex index,
-        AllocationIndex numAllocations, Offset linkOffset)
-      : _directory(directory),
-        _addressMap(addressMap),
-        _index(index),
-        _numAllocations(numAllocations),
-        _linkOffset(linkOffset) {}
-  AllocationIndex Next() {
-    AllocationIndex returnValue = _index;
-    if (_index != _numAllocations) {
-      const Allocation* allocation = _directory.AllocationAt(_index);
-      if (allocation == 0) {
-        abort();
-      }
-      _index = _numAllocations;
-      Offset size = allocation->Size();
-      Offset bytesNeeded = _linkOffset + sizeof(Offset);
-      if (size >= bytesNeeded) {
-        const char* image;
-        Offset numBytesFound = _addressMap.FindMappedMemoryImage(
-            allocation->Address() + _linkOffset, &image);
-        if (numBytesFound >= sizeof(Offset)) {
-          _index = _directory.AllocationIndexOf(*((Offset*)(image)));
-        }
-      }
-    }
-    return returnValue;
+        Offset linkOffset, Commands::Error& error)
+      : _follower(directory, addressMap, linkOffset),
+        _walker(directory, _follower, index, error) {}
+  AllocationIndex Next() { return _walker.Next(); }
+  ChainWalker<Offset, LinkFollower<Offset> >& GetWalker() {
+    return _walker;
   }
 
  private:
-  const Directory<Offset>& _directory;
-  const VirtualAddressMap<Offset>& _addressMap;
-  AllocationIndex _index;
-  AllocationIndex _numAllocations;
-  Offset _linkOffset;
+  LinkFollower<Offset> _follower;
+  ChainWalker<Offset, LinkFollower<Offset> > _walker;
 };
 }  // namespace Iterators
 }  // namespace Allocations
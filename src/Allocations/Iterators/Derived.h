@@ -1,4 +1,4 @@
-// Copyright (c) 2020 Broadcom. All Rights Reserved.
+// Copyright (c) 2020,2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
@@ -13,28 +13,56 @@ namespace Iterators {
 template <class Offset>
 class Derived {
  public:
+  /*
+   * The same kind of iterator is used both for the derived set and, given
+   * useSavedSets, for any set saved by name, in which case the name is the
+   * first argument.
+   */
   class Factory {
    public:
-    Factory() : _setName("derived") {}
-    Derived* MakeIterator(Commands::Context& /* context */,
+    Factory(bool useSavedSets = false)
+        : _setName(useSavedSets ? "saved" : "derived"),
+          _useSavedSets(useSavedSets) {}
+    Derived* MakeIterator(Commands::Context& context,
                           const ProcessImage<Offset>& /* processImage */,
                           const Directory<Offset>& directory,
                           const SetCache<Offset>& setCache) {
-      return new Derived(directory, directory.NumAllocations(),
-                         setCache.GetDerived());
+      if (!_useSavedSets) {
+        return new Derived(directory, directory.NumAllocations(),
+                           setCache.GetDerived());
+      }
+      Commands::Error& error = context.GetError();
+      if (context.GetNumPositionals() < 3) {
+        error << "No name was specified for the saved set.\n";
+        return nullptr;
+      }
+      const std::string& name = context.Positional(2);
+      const Set<Offset>* saved = setCache.FindSaved(name);
+      if (saved == nullptr) {
+        error << "There is no saved set named \"" << name << "\".\n";
+        return nullptr;
+      }
+      return new Derived(directory, directory.NumAllocations(), *saved);
     }
     // TODO: allow adding taints
     const std::string& GetSetName() const { return _setName; }
-    size_t GetNumArguments() { return 0; }
+    size_t GetNumArguments() { return _useSavedSets ? 1 : 0; }
     const std::vector<std::string>& GetTaints() const { return _taints; }
     void ShowHelpMessage(Commands::Context& context) {
       Commands::Output& output = context.GetOutput();
-      output << "Use \"derived\" to specify the derived set.\n";
+      if (_useSavedSets) {
+        output << "Use \"saved <name>\" to specify a set saved by using"
+                  " \"/setOperation save:<name>\"\nor any other set"
+                  " operation with \":<name>\" appended.\n";
+      } else {
+        output << "Use \"derived\" to specify the derived set.\n";
+      }
     }
 
    private:
     const std::vector<std::string> _taints;
     const std::string _setName;
+    const bool _useSavedSets;
   };
   typedef typename Directory<Offset>::AllocationIndex AllocationIndex;
 
@@ -121,7 +121,8 @@ class ExactIncoming {
 
   AllocationIndex Next() {
     for (; _nextIncoming != _pastIncoming; _nextIncoming++) {
-      if (_skipTaintedReferences && _edgeIsTainted.ForIncoming(_nextIncoming)) {
+      if (_skipTaintedReferences &&
+          _edgeIsTainted.ForIncoming(_index, _nextIncoming)) {
         continue;
       }
       /*
@@ -130,7 +131,7 @@ class ExactIncoming {
        * not to support favored references.
        */
       if (_skipUnfavoredReferences &&
-          !_edgeIsFavored.ForIncoming(_nextIncoming)) {
+          !_edgeIsFavored.ForIncoming(_index, _nextIncoming)) {
         continue;
       }
       AllocationIndex index = _graph.GetSourceForIncoming(_nextIncoming);
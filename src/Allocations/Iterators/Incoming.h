@@ -114,7 +114,8 @@ class Incoming {
   }
   AllocationIndex Next() {
     for (; _nextIncoming != _pastIncoming; _nextIncoming++) {
-      if (_skipTaintedReferences && _edgeIsTainted.ForIncoming(_nextIncoming)) {
+      if (_skipTaintedReferences &&
+          _edgeIsTainted.ForIncoming(_index, _nextIncoming)) {
         continue;
       }
       /*
@@ -122,7 +123,7 @@ class Incoming {
        * determined not to support favored references.
        */
       if (_skipUnfavoredReferences &&
-          !_edgeIsFavored.ForIncoming(_nextIncoming)) {
+          !_edgeIsFavored.ForIncoming(_index, _nextIncoming)) {
         continue;
       }
       AllocationIndex index = _graph.GetSourceForIncoming(_nextIncoming);
@@ -1,10 +1,11 @@
-// Copyright (c) 2017,2020 Broadcom. All Rights Reserved.
+// Copyright (c) 2017,2020,2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
 #pragma once
 #include "../../Commands/Runner.h"
 #include "../../Commands/Subcommand.h"
+#include "../ChainWalker.h"
 #include "../Directory.h"
 #include "../Graph.h"
 #include "../SetCache.h"
@@ -47,17 +48,23 @@ class ReverseChain {
                 << " is not a valid offset for the edge target.\n";
         } else {
           AllocationIndex index = directory.AllocationIndexOf(address);
+          bool showChainStatistics = false;
           if (index == numAllocations) {
             error << context.Positional(2)
                   << " is not part of an allocation.\n";
-          } else {
+          } else if (context.ParseBooleanSwitch("showChainStatistics",
+                                                showChainStatistics)) {
             const Graph<Offset>* allocationGraph =
                 processImage.GetAllocationGraph();
             if (allocationGraph != 0) {
-              iterator =
-                  new ReverseChain(directory, *allocationGraph,
-                                   processImage.GetVirtualAddressMap(), index,
-                                   numAllocations, linkOffset, targetOffset);
+              iterator = new ReverseChain(directory, *allocationGraph,
+                                          processImage.GetVirtualAddressMap(),
+                                          index, linkOffset, targetOffset,
+                                          error);
+              if (showChainStatistics) {
+                iterator->GetWalker().Measure();
+                iterator->GetWalker().ShowStatistics(context);
+              }
             }
           }
         }
@@ -82,7 +89,10 @@ class ReverseChain {
              "target. This is intended for following long singly linked lists"
              " backwards.  The\n"
              "chain is terminated either when no suitable"
-             " incoming edge exists or when\nmultiple such edges do.\n";
+             " incoming edge exists or when\nmultiple such edges do, or just"
+             " before the first allocation that would be\nvisited twice.  Use"
+             " \"/showChainStatistics true\" to show the length of the"
+             " chain\nbefore visiting it.\n";
     }
 
    private:
@@ -94,64 +104,18 @@ class ReverseChain {
 
   ReverseChain(const Directory<Offset>& directory, const Graph<Offset>& graph,
                const VirtualAddressMap<Offset>& addressMap,
-               AllocationIndex index, AllocationIndex numAllocations,
-               Offset linkOffset, Offset targetOffset)
-      : _directory(directory),
-        _graph(graph),
-        _addressMap(addressMap),
-        _index(index),
-        _numAllocations(numAllocations),
-        _linkOffset(linkOffset),
-        _targetOffset(targetOffset) {}
-  AllocationIndex Next() {
-    AllocationIndex returnValue = _index;
-    if (_index != _numAllocations) {
-      const Allocation* target = _directory.AllocationAt(_index);
-      if (target == 0) {
-        abort();
-      }
-      if (target->Size() >= _targetOffset) {
-        Offset targetAddress = target->Address();
-        const AllocationIndex* pNextIncoming;
-        const AllocationIndex* pPastIncoming;
-        _graph.GetIncoming(_index, &pNextIncoming, &pPastIncoming);
-
-        _index = _numAllocations;
-        bool suitableIncomingFound = false;
-        typename VirtualAddressMap<Offset>::Reader reader(_addressMap);
-        while (pNextIncoming != pPastIncoming) {
-          AllocationIndex index = *(pNextIncoming++);
-          const Allocation* source = _directory.AllocationAt(index);
-          if (source == ((Allocation*)(0))) {
-            abort();
-          }
-          if ((source->Size() >= _linkOffset + sizeof(Offset)) &&
-              (reader.ReadOffset(source->Address() + _linkOffset) ==
-               (targetAddress + _targetOffset))) {
-            if (!suitableIncomingFound) {
-              suitableIncomingFound = true;
-              _index = index;
-            } else {
-              _index = _numAllocations;
-              break;
-            }
-          }
-        }
-      } else {
-        _index = _numAllocations;
-      }
-    }
-    return returnValue;
+               AllocationIndex index, Offset linkOffset, Offset targetOffset,
+               Commands::Error& error)
+      : _follower(directory, graph, addressMap, linkOffset, targetOffset),
+        _walker(directory, _follower, index, error) {}
+  AllocationIndex Next() { return _walker.Next(); }
+  ChainWalker<Offset, IncomingLinkFollower<Offset> >& GetWalker() {
+    return _walker;
   }
 
  private:
-  const Directory<Offset>& _directory;
-  const Graph<Offset>& _graph;
-  const VirtualAddressMap<Offset>& _addressMap;
-  AllocationIndex _index;
-  AllocationIndex _numAllocations;
-  Offset _linkOffset;
-  Offset _targetOffset;
+  IncomingLinkFollower<Offset> _follower;
+  ChainWalker<Offset, IncomingLinkFollower<Offset> > _walker;
 };
 }  // namespace Iterators
 }  // namespace Allocations
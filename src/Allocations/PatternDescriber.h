@@ -1,4 +1,4 @@
-// Copyright (c) 2017-2020 Broadcom. All Rights Reserved.
+// Copyright (c) 2017-2020,2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
@@ -18,9 +18,7 @@ class PatternDescriber {
         _processImage(processImage),
         _addressMap(processImage.GetVirtualAddressMap()),
         _directory(processImage.GetAllocationDirectory()),
-        _graph(processImage.GetAllocationGraph()),
-        _moduleDirectory(processImage.GetModuleDirectory()),
-        _tagHolder(*(processImage.GetAllocationTagHolder())) {}
+        _moduleDirectory(processImage.GetModuleDirectory()) {}
 
   const std::string& GetName() const { return _name; }
 
@@ -32,13 +30,24 @@ class PatternDescriber {
                         const Allocation& allocation, bool explain) const = 0;
 
  protected:
+  /*
+   * The graph and tags are calculated the first time they are needed, which
+   * may be well after the describer is constructed, so they are fetched from
+   * the process image as needed.
+   */
+  const Graph<Offset>& GetGraph() const {
+    return *(_processImage.GetAllocationGraph());
+  }
+
+  const TagHolder<Offset>& GetTagHolder() const {
+    return *(_processImage.GetAllocationTagHolder());
+  }
+
   const std::string _name;
   const ProcessImage<Offset>& _processImage;
   const VirtualAddressMap<Offset>& _addressMap;
   const Directory<Offset>& _directory;
-  const Graph<Offset>* _graph;
   const ModuleDirectory<Offset>& _moduleDirectory;
-  const Allocations::TagHolder<Offset>& _tagHolder;
 };
 }  // namespace Allocations
 }  // namespace chap
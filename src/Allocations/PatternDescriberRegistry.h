@@ -1,8 +1,9 @@
-// Copyright (c) 2017-2020 Broadcom. All Rights Reserved.
+// Copyright (c) 2017-2020,2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
 #pragma once
+#include <mutex>
 #include "../ProcessImage.h"
 #include "Directory.h"
 #include "Graph.h"
@@ -20,22 +21,10 @@ class PatternDescriberRegistry {
   typedef typename std::multimap<std::string, PatternDescriber<Offset>*>
       DescriberMap;
   PatternDescriberRegistry(const ProcessImage<Offset>& processImage)
-      : _tagHolder(*(processImage.GetAllocationTagHolder())),
-        _numTags(_tagHolder.GetNumTags()) {
-    _tagToDescribers.reserve(_numTags);
-    _tagToDescribers.resize(_numTags);
-  }
+      : _processImage(processImage) {}
 
   void Register(PatternDescriber<Offset>& describer) {
-    std::string fullTagName("%");
-    fullTagName.append(describer.GetName());
-    const typename TagHolder<Offset>::TagIndices* indices =
-        _tagHolder.GetTagIndices(fullTagName);
-    if (indices != nullptr) {
-      for (TagIndex tagIndex : *indices) {
-        _tagToDescribers[(size_t)(tagIndex)].push_back(&describer);
-      }
-    }
+    _describers.push_back(&describer);
   }
 
   /*
@@ -47,7 +36,7 @@ class PatternDescriberRegistry {
   void Describe(Commands::Context& context, AllocationIndex index,
                 const Allocation& allocation, bool /* isUnsigned */,
                 bool explain) const {
-    for (auto describer : _tagToDescribers[_tagHolder.GetTagIndex(index)]) {
+    for (auto describer : GetTagToDescribers()[GetTagIndex(index)]) {
       describer->Describe(context, index, allocation, explain);
     }
   }
@@ -58,18 +47,44 @@ class PatternDescriberRegistry {
    */
   const TagIndices* GetTagIndices(const std::string& tagName) const {
     return (!tagName.empty() && tagName[0] == '%')
-               ? _tagHolder.GetTagIndices(tagName)
+               ? _processImage.GetAllocationTagHolder()->GetTagIndices(tagName)
                : nullptr;
   }
 
   const TagIndex GetTagIndex(AllocationIndex index) const {
-    return _tagHolder.GetTagIndex(index);
+    return _processImage.GetAllocationTagHolder()->GetTagIndex(index);
   }
 
  private:
-  const TagHolder<Offset>& _tagHolder;
-  size_t _numTags;
-  std::vector<std::list<PatternDescriber<Offset>*> > _tagToDescribers;
+  typedef std::vector<std::list<PatternDescriber<Offset>*> > TagToDescribers;
+  const ProcessImage<Offset>& _processImage;
+  std::vector<PatternDescriber<Offset>*> _describers;
+  mutable std::once_flag _tagToDescribersOnce;
+  mutable TagToDescribers _tagToDescribers;
+
+  /*
+   * The tags are not known until the allocations have been tagged, which
+   * happens the first time the tags are needed, so the mapping from each tag
+   * to the describers for it is also built the first time it is needed.
+   */
+  const TagToDescribers& GetTagToDescribers() const {
+    std::call_once(_tagToDescribersOnce, [this]() {
+      const TagHolder<Offset>& tagHolder =
+          *(_processImage.GetAllocationTagHolder());
+      _tagToDescribers.resize(tagHolder.GetNumTags());
+      for (PatternDescriber<Offset>* describer : _describers) {
+        std::string fullTagName("%");
+        fullTagName.append(describer->GetName());
+        const TagIndices* indices = tagHolder.GetTagIndices(fullTagName);
+        if (indices != nullptr) {
+          for (TagIndex tagIndex : *indices) {
+            _tagToDescribers[(size_t)(tagIndex)].push_back(describer);
+          }
+        }
+      }
+    });
+    return _tagToDescribers;
+  }
 };
 }  // namespace Allocations
 }  // namespace chap
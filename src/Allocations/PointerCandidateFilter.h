@@ -0,0 +1,271 @@
+// Copyright (c) 2024 Broadcom. All Rights Reserved.
+// The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
+// SPDX-License-Identifier: GPL-2.0
+
+#pragma once
+#include <cstdint>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include "Directory.h"
+
+namespace chap {
+namespace Allocations {
+/*
+ * A PointerCandidateFilter is used to quickly reject values that cannot
+ * possibly be addresses within any allocation, so that the much more
+ * expensive search of the Directory is done only for plausible candidates.
+ * It never rejects an address that is within an allocation but may accept
+ * values that are not.
+ *
+ * The filter is based on the lowest allocation address, the highest
+ * allocation limit and a bitmap with one bit per granule of the address
+ * range between them, where a bit is set if any allocation overlaps the
+ * corresponding granule.  Blocks of values are checked against the bounds
+ * using AVX2 or SSE2 where available and the bitmap is checked only for
+ * values within the bounds.
+ */
+template <class Offset>
+class PointerCandidateFilter {
+ public:
+  typedef typename Directory<Offset>::AllocationIndex Index;
+  typedef typename Directory<Offset>::Allocation Allocation;
+
+  /*
+   * The filter accepts every value if acceptAll is set, which is needed,
+   * for example, if references may be obscured such that they don't point
+   * directly into allocations.
+   */
+  PointerCandidateFilter(const Directory<Offset>& directory, bool acceptAll)
+      : _acceptAll(acceptAll),
+        _base(0),
+        _span(0),
+        _granuleShift(MIN_GRANULE_SHIFT),
+        _inRangeMask(&PointerCandidateFilter::InRangeMaskScalar) {
+    if (_acceptAll) {
+      return;
+    }
+    Index numAllocations = directory.NumAllocations();
+    Offset minAddress = ~((Offset)0);
+    Offset maxLimit = 0;
+    for (Index i = 0; i < numAllocations; i++) {
+      const Allocation* allocation = directory.AllocationAt(i);
+      if (allocation->Size() == 0) {
+        continue;
+      }
+      Offset address = allocation->Address();
+      Offset limit = address + allocation->Size();
+      if (minAddress > address) {
+        minAddress = address;
+      }
+      if (maxLimit < limit) {
+        maxLimit = limit;
+      }
+    }
+    if (maxLimit <= minAddress) {
+      return;
+    }
+    _base = minAddress;
+    _span = maxLimit - minAddress;
+    while (((_span - 1) >> _granuleShift) >= MAX_GRANULES) {
+      _granuleShift++;
+    }
+    _granules.resize((((_span - 1) >> _granuleShift) / 64) + 1, 0);
+    for (Index i = 0; i < numAllocations; i++) {
+      const Allocation* allocation = directory.AllocationAt(i);
+      if (allocation->Size() == 0) {
+        continue;
+      }
+      Offset relative = allocation->Address() - _base;
+      Offset granuleLimit =
+          ((relative + allocation->Size() - 1) >> _granuleShift) + 1;
+      for (Offset granule = relative >> _granuleShift; granule < granuleLimit;
+           granule++) {
+        _granules[granule / 64] |= ((uint64_t)1) << (granule % 64);
+      }
+    }
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("avx2")) {
+      _inRangeMask = &PointerCandidateFilter::InRangeMaskAVX2;
+    } else if (__builtin_cpu_supports("sse2")) {
+      _inRangeMask = &PointerCandidateFilter::InRangeMaskSSE2;
+    }
+#endif
+  }
+
+  /*
+   * Return true if the given value might be an address in some allocation.
+   */
+  bool Accepts(Offset value) const {
+    if (_acceptAll) {
+      return true;
+    }
+    Offset relative = value - _base;
+    return relative < _span && InGranuleMap(relative);
+  }
+
+  /*
+   * Call the given visitor with a pointer to each value in [first, limit)
+   * that might be an address in some allocation, in increasing order of
+   * position.
+   */
+  template <typename Visitor>
+  void VisitCandidates(const Offset* first, const Offset* limit,
+                       Visitor visitor) const {
+    if (_acceptAll) {
+      for (const Offset* check = first; check < limit; check++) {
+        visitor(check);
+      }
+      return;
+    }
+    while (first < limit) {
+      size_t numInBlock = limit - first;
+      if (numInBlock > BLOCK_SIZE) {
+        numInBlock = BLOCK_SIZE;
+      }
+      uint64_t mask = (this->*_inRangeMask)(first, numInBlock);
+      while (mask != 0) {
+        const Offset* check = first + __builtin_ctzll(mask);
+        mask &= mask - 1;
+        if (InGranuleMap(*check - _base)) {
+          visitor(check);
+        }
+      }
+      first += numInBlock;
+    }
+  }
+
+ private:
+  /*
+   * The bitmap is limited to 2 MB so that it mostly stays in cache, and
+   * granules are never smaller than a page.
+   */
+  static constexpr Offset MAX_GRANULES = ((Offset)1) << 24;
+  static constexpr unsigned int MIN_GRANULE_SHIFT = 12;
+  static constexpr size_t BLOCK_SIZE = 64;
+  typedef uint64_t (PointerCandidateFilter::*InRangeMaskFunction)(
+      const Offset*, size_t) const;
+
+  bool _acceptAll;
+  Offset _base;
+  Offset _span;
+  unsigned int _granuleShift;
+  std::vector<uint64_t> _granules;
+  InRangeMaskFunction _inRangeMask;
+
+  bool InGranuleMap(Offset relative) const {
+    Offset granule = relative >> _granuleShift;
+    return (_granules[granule / 64] & (((uint64_t)1) << (granule % 64))) != 0;
+  }
+
+  /*
+   * Return a mask with bit i set if and only if values[i] is within the
+   * bounds, for i < numValues <= BLOCK_SIZE.
+   */
+  uint64_t InRangeMaskScalar(const Offset* values, size_t numValues) const {
+    uint64_t mask = 0;
+    for (size_t i = 0; i < numValues; i++) {
+      if ((Offset)(values[i] - _base) < _span) {
+        mask |= ((uint64_t)1) << i;
+      }
+    }
+    return mask;
+  }
+
+#if defined(__x86_64__) || defined(__i386__)
+  /*
+   * The vector forms use signed comparisons, so the sign bit is flipped
+   * on both sides to get the unsigned comparison of (value - _base) against
+   * _span.
+   */
+  __attribute__((target("avx2"))) uint64_t InRangeMaskAVX2(
+      const Offset* values, size_t numValues) const {
+    uint64_t mask = 0;
+    size_t i = 0;
+    if (sizeof(Offset) == 8) {
+      const __m256i signBit = _mm256_set1_epi64x((long long)(1ULL << 63));
+      const __m256i base = _mm256_set1_epi64x((long long)_base);
+      const __m256i span =
+          _mm256_xor_si256(_mm256_set1_epi64x((long long)_span), signBit);
+      for (; i + 4 <= numValues; i += 4) {
+        __m256i relative = _mm256_xor_si256(
+            _mm256_sub_epi64(
+                _mm256_loadu_si256((const __m256i*)(values + i)), base),
+            signBit);
+        __m256i inRange = _mm256_cmpgt_epi64(span, relative);
+        mask |= ((uint64_t)_mm256_movemask_pd(_mm256_castsi256_pd(inRange)))
+                << i;
+      }
+    } else {
+      const __m256i signBit = _mm256_set1_epi32((int)(1U << 31));
+      const __m256i base = _mm256_set1_epi32((int)_base);
+      const __m256i span =
+          _mm256_xor_si256(_mm256_set1_epi32((int)_span), signBit);
+      for (; i + 8 <= numValues; i += 8) {
+        __m256i relative = _mm256_xor_si256(
+            _mm256_sub_epi32(
+                _mm256_loadu_si256((const __m256i*)(values + i)), base),
+            signBit);
+        __m256i inRange = _mm256_cmpgt_epi32(span, relative);
+        mask |= ((uint64_t)_mm256_movemask_ps(_mm256_castsi256_ps(inRange)))
+                << i;
+      }
+    }
+    if (i < numValues) {
+      mask |= InRangeMaskScalar(values + i, numValues - i) << i;
+    }
+    return mask;
+  }
+
+  /*
+   * SSE2 lacks a 64-bit comparison, so for 64-bit values the comparison is
+   * built from 32-bit comparisons of the high and low halves.
+   */
+  __attribute__((target("sse2"))) uint64_t InRangeMaskSSE2(
+      const Offset* values, size_t numValues) const {
+    uint64_t mask = 0;
+    size_t i = 0;
+    if (sizeof(Offset) == 8) {
+      const __m128i signBit = _mm_set1_epi64x((long long)(1ULL << 63));
+      const __m128i lowSignBit = _mm_set1_epi64x(0x80000000LL);
+      const __m128i base = _mm_set1_epi64x((long long)_base);
+      const __m128i span =
+          _mm_xor_si128(_mm_set1_epi64x((long long)_span), signBit);
+      const __m128i spanLow = _mm_xor_si128(span, lowSignBit);
+      for (; i + 2 <= numValues; i += 2) {
+        __m128i relative = _mm_xor_si128(
+            _mm_sub_epi64(_mm_loadu_si128((const __m128i*)(values + i)),
+                          base),
+            signBit);
+        __m128i highGreater = _mm_cmpgt_epi32(span, relative);
+        __m128i highEqual = _mm_cmpeq_epi32(span, relative);
+        __m128i lowGreater = _mm_cmpgt_epi32(
+            spanLow, _mm_xor_si128(relative, lowSignBit));
+        lowGreater = _mm_shuffle_epi32(lowGreater, _MM_SHUFFLE(2, 2, 0, 0));
+        __m128i inRange =
+            _mm_or_si128(highGreater, _mm_and_si128(highEqual, lowGreater));
+        mask |= ((uint64_t)_mm_movemask_pd(_mm_castsi128_pd(inRange))) << i;
+      }
+    } else {
+      const __m128i signBit = _mm_set1_epi32((int)(1U << 31));
+      const __m128i base = _mm_set1_epi32((int)_base);
+      const __m128i span = _mm_xor_si128(_mm_set1_epi32((int)_span), signBit);
+      for (; i + 4 <= numValues; i += 4) {
+        __m128i relative = _mm_xor_si128(
+            _mm_sub_epi32(_mm_loadu_si128((const __m128i*)(values + i)),
+                          base),
+            signBit);
+        __m128i inRange = _mm_cmpgt_epi32(span, relative);
+        mask |= ((uint64_t)_mm_movemask_ps(_mm_castsi128_ps(inRange))) << i;
+      }
+    }
+    if (i < numValues) {
+      mask |= InRangeMaskScalar(values + i, numValues - i) << i;
+    }
+    return mask;
+  }
+#endif
+};
+}  // namespace Allocations
+}  // namespace chap
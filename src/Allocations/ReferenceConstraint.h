@@ -72,11 +72,11 @@ class ReferenceConstraint {
       for (EdgeIndex nextIncoming = firstIncoming; nextIncoming != pastIncoming;
            nextIncoming++) {
         if (_skipTaintedReferences &&
-            _edgeIsTainted.ForIncoming(nextIncoming)) {
+            _edgeIsTainted.ForIncoming(index, nextIncoming)) {
           continue;
         }
         if (skipUnfavoredReferences &&
-            !_edgeIsFavored.ForIncoming(nextIncoming)) {
+            !_edgeIsFavored.ForIncoming(index, nextIncoming)) {
           continue;
         }
         AllocationIndex sourceIndex = _graph.GetSourceForIncoming(nextIncoming);
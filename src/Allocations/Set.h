@@ -1,13 +1,22 @@
-// Copyright (c) 2020 Broadcom. All Rights Reserved.
+// Copyright (c) 2020,2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
 #pragma once
 #include <string.h>
 #include <memory>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 #include "Directory.h"
 namespace chap {
 namespace Allocations {
+/*
+ * A Set holds one bit per allocation.  Searching for members is done a
+ * 64-bit word at a time, using the count of trailing zeros to find the
+ * member within a word, and the operations that combine whole sets use AVX2
+ * where available.
+ */
 template <class Offset>
 class Set {
  public:
@@ -30,57 +39,93 @@ class Set {
             ((uint64_t)(1) << (((uint64_t)(index) & ((uint64_t)(63)))))) != 0;
   }
 
+  /*
+   * Return the smallest member that is at least startFrom, or the number of
+   * allocations if there is none.
+   */
   AllocationIndex NextUsed(AllocationIndex startFrom) const {
-    AllocationIndex retVal = _numAllocations;
+    if (startFrom >= _numAllocations) {
+      return _numAllocations;
+    }
     AllocationIndex u64Index = startFrom / (AllocationIndex)(64);
     uint64_t u64 =
         _asU64[u64Index] >> (((uint64_t)(startFrom) & ((uint64_t)(63))));
     if (u64 != 0) {
-      retVal = startFrom;
-    } else {
-      do {
-        if (++u64Index == _numU64) {
-          return retVal;
-        }
-        u64 = _asU64[u64Index];
-      } while (u64 == 0);
-      retVal = u64Index * (AllocationIndex)(64);
-    }
-    while ((u64 & (uint64_t)(1)) == 0) {
-      u64 = u64 >> 1;
-      retVal++;
+      return startFrom + (AllocationIndex)(__builtin_ctzll(u64));
     }
-    return retVal;
+    do {
+      if (++u64Index == _numU64) {
+        return _numAllocations;
+      }
+      u64 = _asU64[u64Index];
+    } while (u64 == 0);
+    return u64Index * (AllocationIndex)(64) +
+           (AllocationIndex)(__builtin_ctzll(u64));
   }
 
   void Assign(const Set<Offset> &other) {
-    uint64_t *to = _asU64.get();
-    const uint64_t *from = other._asU64.get();
-    for (AllocationIndex i = 0; i < _numU64; i++) {
-      *to++ = *from++;
-    }
-  }
-  void Add(const Set<Offset> &other) {
-    uint64_t *to = _asU64.get();
-    const uint64_t *from = other._asU64.get();
-    for (AllocationIndex i = 0; i < _numU64; i++) {
-      *to++ |= *from++;
-    }
-  }
-  void Subtract(const Set<Offset> &other) {
-    uint64_t *to = _asU64.get();
-    const uint64_t *from = other._asU64.get();
-    for (AllocationIndex i = 0; i < _numU64; i++) {
-      *to++ &= ~(*from++);
-    }
+    memcpy(_asU64.get(), other._asU64.get(), _numU8);
   }
+  void Add(const Set<Offset> &other) { Combine<UNION>(other); }
+  void Subtract(const Set<Offset> &other) { Combine<DIFFERENCE>(other); }
+  void Intersect(const Set<Offset> &other) { Combine<INTERSECTION>(other); }
 
  private:
+  enum Operation { UNION, DIFFERENCE, INTERSECTION };
   AllocationIndex _numAllocations;
   AllocationIndex _numU64;
   AllocationIndex _numU8;
 
   std::unique_ptr<uint64_t[]> _asU64;
+
+  template <Operation operation>
+  static uint64_t CombineWord(uint64_t to, uint64_t from) {
+    return (operation == UNION)
+               ? (to | from)
+               : (operation == DIFFERENCE) ? (to & ~from) : (to & from);
+  }
+
+  template <Operation operation>
+  void Combine(const Set<Offset> &other) {
+    uint64_t *to = _asU64.get();
+    const uint64_t *from = other._asU64.get();
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("avx2")) {
+      CombineWordsAVX2<operation>(to, from, _numU64);
+      return;
+    }
+#endif
+    CombineWords<operation>(to, from, _numU64);
+  }
+
+  template <Operation operation>
+  static void CombineWords(uint64_t *to, const uint64_t *from,
+                           AllocationIndex numWords) {
+    for (AllocationIndex i = 0; i < numWords; i++) {
+      to[i] = CombineWord<operation>(to[i], from[i]);
+    }
+  }
+
+#if defined(__x86_64__) || defined(__i386__)
+  template <Operation operation>
+  __attribute__((target("avx2"))) static void CombineWordsAVX2(
+      uint64_t *to, const uint64_t *from, AllocationIndex numWords) {
+    AllocationIndex i = 0;
+    for (; i + 4 <= numWords; i += 4) {
+      __m256i toWords = _mm256_loadu_si256((const __m256i *)(to + i));
+      __m256i fromWords = _mm256_loadu_si256((const __m256i *)(from + i));
+      if (operation == UNION) {
+        toWords = _mm256_or_si256(toWords, fromWords);
+      } else if (operation == DIFFERENCE) {
+        toWords = _mm256_andnot_si256(fromWords, toWords);
+      } else {
+        toWords = _mm256_and_si256(toWords, fromWords);
+      }
+      _mm256_storeu_si256((__m256i *)(to + i), toWords);
+    }
+    CombineWords<operation>(to + i, from + i, numWords - i);
+  }
+#endif
 };
 }  // namespace Allocations
 }  // namespace chap
@@ -1,9 +1,11 @@
-// Copyright (c) 2020 Broadcom. All Rights Reserved.
+// Copyright (c) 2020,2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
 #pragma once
+#include <map>
 #include <memory>
+#include <string>
 #include "Directory.h"
 #include "Set.h"
 namespace chap {
@@ -13,16 +15,35 @@ class SetCache {
  public:
   SetCache(typename Directory<Offset>::AllocationIndex numAllocations)
       : _numAllocations(numAllocations),
-        _visited(numAllocations),
         _derived(numAllocations) {}
-  Set<Offset>& GetVisited() { return _visited; }
   Set<Offset>& GetDerived() { return _derived; }
   const Set<Offset>& GetDerived() const { return _derived; }
 
+  /*
+   * Return the set saved with the given name, creating an empty one if
+   * there was none.
+   */
+  Set<Offset>& GetSaved(const std::string& name) {
+    std::unique_ptr<Set<Offset> >& saved = _saved[name];
+    if (!saved) {
+      saved.reset(new Set<Offset>(_numAllocations));
+    }
+    return *saved;
+  }
+
+  /*
+   * Return the set saved with the given name, or nullptr if there is none.
+   */
+  const Set<Offset>* FindSaved(const std::string& name) const {
+    typename SavedSets::const_iterator it = _saved.find(name);
+    return (it == _saved.end()) ? nullptr : it->second.get();
+  }
+
  private:
+  typedef std::map<std::string, std::unique_ptr<Set<Offset> > > SavedSets;
   typename Directory<Offset>::AllocationIndex _numAllocations;
-  Set<Offset> _visited;
   Set<Offset> _derived;
+  SavedSets _saved;
 };
 }  // namespace Allocations
 }  // namespace chap
@@ -1,4 +1,4 @@
-// Copyright (c) 2017,2023 Broadcom. All Rights Reserved.
+// Copyright (c) 2017,2023-2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
@@ -6,6 +6,7 @@
 #include <iostream>
 #include <set>
 #include <sstream>
+#include <unordered_set>
 #include "../CPlusPlus/TypeInfoDirectory.h"
 #include "../VirtualAddressMap.h"
 #include "Directory.h"
@@ -65,7 +66,9 @@ class SignatureChecker {
       return;
     }
 
-    _signatures = _directory.Signatures(signature);
+    const std::set<Offset>& signaturesForName =
+        _directory.Signatures(signature);
+    _signatures.insert(signaturesForName.begin(), signaturesForName.end());
     Offset numericSignature;
     if (_signatures.empty()) {
       // The directory doesn't have the signature by name.  Check if the
@@ -160,7 +163,13 @@ class SignatureChecker {
   const VirtualAddressMap<Offset>& _addressMap;
   const std::string _signature;
   const std::string _patternName;
-  std::set<Offset> _signatures;
+  /*
+   * This holds every signature that matches, including, if a type name was
+   * given, any signature of a type derived from that type, so that checking
+   * the signature of an allocation takes the same constant time whether or
+   * not derived types are involved.
+   */
+  std::unordered_set<Offset> _signatures;
   const typename PatternDescriberRegistry<Offset>::TagIndices* _tagIndices;
 };
 }  // namespace Allocations
@@ -1,10 +1,12 @@
-// Copyright (c) 2017,2020 Broadcom. All Rights Reserved.
+// Copyright (c) 2017,2020,2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
 #pragma once
 #include <map>
 #include <set>
+#include <string>
+#include "../AnalysisCache.h"
 
 /*
  * This keeps mappings from signature to name and name to set of signatures.
@@ -26,7 +28,9 @@ class SignatureDirectory {
     WRITABLE_VTABLE_WITH_NAME_FROM_PROCESS_IMAGE,
     VTABLE_WITH_NAME_FROM_BINARY,
     WRITABLE_MODULE_REFERENCE,
-    VTABLE_WITH_NAME_FROM_BINDEFS
+    VTABLE_WITH_NAME_FROM_BINDEFS,
+    VTABLE_WITH_NAME_FROM_SYMBOL_TABLE,
+    UNWRITABLE_WITH_NAME_FROM_SYMBOL_TABLE
   };
 
   typedef std::map<Offset, std::pair<std::string, Status> >
@@ -121,6 +125,10 @@ class SignatureDirectory {
           return false;
         case VTABLE_WITH_NAME_FROM_BINDEFS:
           return false;
+        case VTABLE_WITH_NAME_FROM_SYMBOL_TABLE:
+          return true;
+        case UNWRITABLE_WITH_NAME_FROM_SYMBOL_TABLE:
+          return false;
       }
     }
     return false;
@@ -153,6 +161,34 @@ class SignatureDirectory {
     return _signatureToName.end();
   }
 
+  void Write(AnalysisCacheWriter& writer) const {
+    writer.WriteValue<uint64_t>(_signatureToName.size());
+    for (const auto& signatureNameAndStatus : _signatureToName) {
+      writer.WriteValue<Offset>(signatureNameAndStatus.first);
+      writer.WriteString(signatureNameAndStatus.second.first);
+      writer.WriteValue<uint64_t>(signatureNameAndStatus.second.second);
+    }
+  }
+
+  bool Read(AnalysisCacheReader& reader) {
+    uint64_t numSignatures;
+    if (!reader.ReadValue(numSignatures)) {
+      return false;
+    }
+    for (uint64_t i = 0; i < numSignatures; i++) {
+      Offset signature;
+      std::string name;
+      uint64_t status;
+      if (!reader.ReadValue(signature) || !reader.ReadString(name) ||
+          !reader.ReadValue(status) ||
+          status > UNWRITABLE_WITH_NAME_FROM_SYMBOL_TABLE) {
+        return reader.Fail();
+      }
+      MapSignatureNameAndStatus(signature, name, (Status)status);
+    }
+    return true;
+  }
+
  private:
   bool _multipleSignaturesPerName;
   SignatureNameAndStatusMap _signatureToName;
@@ -4,8 +4,10 @@
 
 #pragma once
 #include <algorithm>
-#include <map>
-#include <set>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
 #include "Directory.h"
 #include "SignatureDirectory.h"
 #include "TagHolder.h"
@@ -22,10 +24,14 @@ class SignatureSummary {
       _count++;
       _bytes += size;
     }
+    void Add(const Tally& other) {
+      _count += other._count;
+      _bytes += other._bytes;
+    }
     Offset _count;
     Offset _bytes;
   };
-  typedef std::map<Offset, Offset> SizeToCount;
+  typedef std::unordered_map<Offset, Offset> SizeToCount;
   struct TallyWithSizeSubtotals {
     Tally _tally;
     SizeToCount _sizeToCount;
@@ -33,13 +39,14 @@ class SignatureSummary {
       _tally.Bump(size);
       ++(_sizeToCount.try_emplace(size, 0).first->second);
     }
+    void Add(const TallyWithSizeSubtotals& other) {
+      _tally.Add(other._tally);
+      for (const auto& sizeAndCount : other._sizeToCount) {
+        _sizeToCount.try_emplace(sizeAndCount.first, 0).first->second +=
+            sizeAndCount.second;
+      }
+    }
   };
-  typedef std::map<Offset, Tally> OffsetToTally;
-  typedef typename OffsetToTally::iterator OffsetToTallyIterator;
-  typedef typename OffsetToTally::const_iterator OffsetToTallyConstIterator;
-  typedef std::map<std::string, Tally> NameToTally;
-  typedef typename NameToTally::iterator NameToTallyIterator;
-  typedef typename NameToTally::const_iterator NameToTallyConstIterator;
   typedef typename Directory<Offset>::AllocationIndex AllocationIndex;
   struct Item {
     std::string _name;
@@ -50,35 +57,109 @@ class SignatureSummary {
     }
   };
 
+  /*
+   * The counts for one part of a summary, kept in flat arrays indexed by
+   * the dense ids the summary gives to signatures and tag names, so that
+   * separate parts can be tallied concurrently and then added together.
+   */
+  struct Tallies {
+    std::vector<Tally> _bySignature;
+    std::vector<TallyWithSizeSubtotals> _byTagName;
+    TallyWithSizeSubtotals _unsigned;
+    void Add(const Tallies& other) {
+      for (size_t i = 0; i < _bySignature.size(); i++) {
+        _bySignature[i].Add(other._bySignature[i]);
+      }
+      for (size_t i = 0; i < _byTagName.size(); i++) {
+        _byTagName[i].Add(other._byTagName[i]);
+      }
+      _unsigned.Add(other._unsigned);
+    }
+  };
+
   SignatureSummary(const SignatureDirectory<Offset>& directory,
                    const TagHolder<Offset>& tagHolder)
-      : _directory(directory), _tagHolder(tagHolder) {}
+      : _directory(directory), _tagHolder(tagHolder) {
+    /*
+     * Give each signature and each distinct signature name a dense id.  The
+     * signatures come from the directory in increasing order, so the ids
+     * of the signatures with a given name are also in increasing order.
+     */
+    std::unordered_map<std::string, uint32_t> nameToId;
+    for (auto it = directory.BeginSignatures(); it != directory.EndSignatures();
+         ++it) {
+      uint32_t signatureId = _signatures.size();
+      _signatures.push_back(it->first);
+      _signatureToId[it->first] = signatureId;
+      const std::string& name = it->second.first;
+      uint32_t nameId = NO_NAME;
+      if (!name.empty()) {
+        auto result = nameToId.try_emplace(name, _signatureNames.size());
+        nameId = result.first->second;
+        if (result.second) {
+          _signatureNames.push_back(name);
+          _signatureIdsByName.emplace_back();
+        }
+        _signatureIdsByName[nameId].push_back(signatureId);
+      }
+      _signatureNameIds.push_back(nameId);
+    }
 
-  bool AdjustTally(AllocationIndex index, Offset size, const char* image) {
-    const std::string& tagName = _tagHolder.GetTagName(index);
-    if (!tagName.empty()) {
+    /*
+     * Likewise give each distinct tag name a dense id, because more than one
+     * tag may have the same name.  Tag 0 means that the allocation is not
+     * tagged.
+     */
+    nameToId.clear();
+    size_t numTags = tagHolder.GetNumTags();
+    _tagToTagNameId.resize(numTags, NO_NAME);
+    for (typename TagHolder<Offset>::TagIndex tagIndex = 1; tagIndex < numTags;
+         tagIndex++) {
+      const std::string& name = tagHolder.GetTagNameByIndex(tagIndex);
+      auto result = nameToId.try_emplace(name, _tagNames.size());
+      if (result.second) {
+        _tagNames.push_back(name);
+      }
+      _tagToTagNameId[tagIndex] = result.first->second;
+    }
+    ClearTallies(_tallies);
+  }
+
+  void ClearTallies(Tallies& tallies) const {
+    tallies._bySignature.assign(_signatures.size(), Tally());
+    tallies._byTagName.assign(_tagNames.size(), TallyWithSizeSubtotals());
+    tallies._unsigned = TallyWithSizeSubtotals();
+  }
+
+  void AdjustTally(Tallies& tallies, AllocationIndex index, Offset size,
+                   const char* image) const {
+    uint32_t tagNameId = _tagToTagNameId[_tagHolder.GetTagIndex(index)];
+    if (tagNameId != NO_NAME) {
       /*
        * Tags take precedent over any signature.
        */
-      _talliesWithSizeSubtotals[tagName].Bump(size);
+      tallies._byTagName[tagNameId].Bump(size);
     } else {
       Offset signature = 0;
       if (size >= sizeof(Offset)) {
         signature = *((Offset*)image);
       }
-      if (_directory.IsMapped(signature)) {
-        TallyBySignature(signature, size);
-        std::string name = _directory.Name(signature);
-        if (!name.empty()) {
-          TallyByName(name, size);
-        }
+      auto it = _signatureToId.find(signature);
+      if (it != _signatureToId.end()) {
+        tallies._bySignature[it->second].Bump(size);
       } else {
-        _unsignedTallyWithSizeSubtotals.Bump(size);
+        tallies._unsigned.Bump(size);
       }
     }
+  }
+
+  bool AdjustTally(AllocationIndex index, Offset size, const char* image) {
+    AdjustTally(_tallies, index, size, image);
     return false;
   }
 
+  void AddTallies(const Tallies& tallies) { _tallies.Add(tallies); }
+
   void SummarizeByCount(std::vector<Item>& items) const {
     FillItems(items);
     for (auto& item : items) {
@@ -102,48 +183,42 @@ class SignatureSummary {
   }
 
  private:
+  static constexpr uint32_t NO_NAME = ~((uint32_t)0);
   const SignatureDirectory<Offset>& _directory;
   const TagHolder<Offset>& _tagHolder;
-  OffsetToTally _signatureToTally;
-  NameToTally _nameToTally;
-  TallyWithSizeSubtotals _unsignedTallyWithSizeSubtotals;
-  std::unordered_map<std::string, TallyWithSizeSubtotals>
-      _talliesWithSizeSubtotals;
-
-  void TallyBySignature(Offset signature, Offset size) {
-    Tally& tally = _signatureToTally.try_emplace(signature).first->second;
-    tally._count++;
-    tally._bytes += size;
-  }
+  std::vector<Offset> _signatures;
+  std::unordered_map<Offset, uint32_t> _signatureToId;
+  std::vector<uint32_t> _signatureNameIds;
+  std::vector<std::string> _signatureNames;
+  std::vector<std::vector<uint32_t> > _signatureIdsByName;
+  std::vector<uint32_t> _tagToTagNameId;
+  std::vector<std::string> _tagNames;
+  Tallies _tallies;
 
-  void TallyByName(std::string name, Offset size) {
-    Tally& tally = _nameToTally.try_emplace(name).first->second;
-    tally._count++;
-    tally._bytes += size;
+  static void AddSizeSubtotals(Item& item,
+                               const TallyWithSizeSubtotals& tally) {
+    for (const auto& sizeAndCount : tally._sizeToCount) {
+      item.AddSubtotal(sizeAndCount.first,
+                       Tally(sizeAndCount.second,
+                             sizeAndCount.first * sizeAndCount.second));
+    }
   }
 
   void FillItems(std::vector<Item>& items) const {
     items.clear();
-    if (_unsignedTallyWithSizeSubtotals._tally._count > 0) {
+    if (_tallies._unsigned._tally._count > 0) {
       Item& item = items.emplace_back();
       item._name = "?";
-      item._totals = _unsignedTallyWithSizeSubtotals._tally;
-      for (const auto& sizeAndCount :
-           _unsignedTallyWithSizeSubtotals._sizeToCount) {
-        item.AddSubtotal(sizeAndCount.first,
-                         Tally(sizeAndCount.second,
-                               sizeAndCount.first * sizeAndCount.second));
-      }
+      item._totals = _tallies._unsigned._tally;
+      AddSizeSubtotals(item, _tallies._unsigned);
     }
-    for (const auto nameAndTally : _talliesWithSizeSubtotals) {
-      Item& item = items.emplace_back();
-      item._name = nameAndTally.first;
-      TallyWithSizeSubtotals tallyWithSizeSubtotals = nameAndTally.second;
-      item._totals = tallyWithSizeSubtotals._tally;
-      for (const auto& sizeAndCount : tallyWithSizeSubtotals._sizeToCount) {
-        item.AddSubtotal(sizeAndCount.first,
-                         Tally(sizeAndCount.second,
-                               sizeAndCount.first * sizeAndCount.second));
+    for (size_t tagNameId = 0; tagNameId < _tagNames.size(); tagNameId++) {
+      const TallyWithSizeSubtotals& tally = _tallies._byTagName[tagNameId];
+      if (tally._tally._count > 0) {
+        Item& item = items.emplace_back();
+        item._name = _tagNames[tagNameId];
+        item._totals = tally._tally;
+        AddSizeSubtotals(item, tally);
       }
     }
     FillUnnamedSignatures(items);
@@ -151,27 +226,32 @@ class SignatureSummary {
   }
 
   void FillUnnamedSignatures(std::vector<Item>& items) const {
-    for (const auto& signatureAndTally: _signatureToTally) {
-      std::string name = _directory.Name(signatureAndTally.first);
-      if (name.empty()) {
+    for (size_t signatureId = 0; signatureId < _signatures.size();
+         signatureId++) {
+      const Tally& tally = _tallies._bySignature[signatureId];
+      if (tally._count > 0 && _signatureNameIds[signatureId] == NO_NAME) {
         Item& item = items.emplace_back();
-        item._totals = signatureAndTally.second;
-        item.AddSubtotal(signatureAndTally.first, signatureAndTally.second);
+        item._totals = tally;
+        item.AddSubtotal(_signatures[signatureId], tally);
       }
     }
   }
   void FillNamedSignatures(std::vector<Item>& items) const {
-    for (NameToTallyConstIterator it = _nameToTally.begin();
-         it != _nameToTally.end(); ++it) {
-      const std::string& name = it->first;
+    for (size_t nameId = 0; nameId < _signatureNames.size(); nameId++) {
+      Tally totals;
+      for (uint32_t signatureId : _signatureIdsByName[nameId]) {
+        totals.Add(_tallies._bySignature[signatureId]);
+      }
+      if (totals._count == 0) {
+        continue;
+      }
       Item& item = items.emplace_back();
-      item._name = name;
-      item._totals = it->second;
-
-      for (Offset signature: _directory.Signatures(name)) {
-        OffsetToTallyConstIterator itTally = _signatureToTally.find(signature);
-        if (itTally != _signatureToTally.end()) {
-          item.AddSubtotal(signature, itTally->second);
+      item._name = _signatureNames[nameId];
+      item._totals = totals;
+      for (uint32_t signatureId : _signatureIdsByName[nameId]) {
+        const Tally& tally = _tallies._bySignature[signatureId];
+        if (tally._count > 0) {
+          item.AddSubtotal(_signatures[signatureId], tally);
         }
       }
     }
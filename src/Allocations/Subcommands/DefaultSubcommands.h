@@ -48,8 +48,8 @@ class DefaultSubcommands {
       const ProcessImage<Offset> &processImage,
       const Describer<Offset> &describer,
       const PatternDescriberRegistry<Offset> &patternDescriberRegistry,
-      const AnnotatorRegistry<Offset> &annotatorRegistry)
-      : _defaultVisitorFactories(describer),
+      const AnnotatorRegistry<Offset> &annotatorRegistry, size_t numThreads)
+      : _defaultVisitorFactories(describer, numThreads),
         _setCache(processImage.GetAllocationDirectory().NumAllocations()),
         _singleAllocationSubcommands(
             processImage, _singleAllocationIteratorFactory,
@@ -145,7 +145,11 @@ class DefaultSubcommands {
                                  _setCache),
         _derivedSubcommands(processImage, _derivedIteratorFactory,
                             _defaultVisitorFactories, patternDescriberRegistry,
-                            annotatorRegistry, _setCache) {}
+                            annotatorRegistry, _setCache),
+        _savedIteratorFactory(true),
+        _savedSubcommands(processImage, _savedIteratorFactory,
+                          _defaultVisitorFactories, patternDescriberRegistry,
+                          annotatorRegistry, _setCache) {}
 
   void RegisterSubcommands(Commands::Runner &runner) {
     _singleAllocationSubcommands.RegisterSubcommands(runner);
@@ -174,6 +178,7 @@ class DefaultSubcommands {
     _chainSubcommands.RegisterSubcommands(runner);
     _reverseChainSubcommands.RegisterSubcommands(runner);
     _derivedSubcommands.RegisterSubcommands(runner);
+    _savedSubcommands.RegisterSubcommands(runner);
   }
 
  private:
@@ -312,6 +317,9 @@ class DefaultSubcommands {
   typedef typename Iterators::Derived<Offset> DerivedIterator;
   typename DerivedIterator::Factory _derivedIteratorFactory;
   SubcommandsForOneIterator<Offset, DerivedIterator> _derivedSubcommands;
+
+  typename DerivedIterator::Factory _savedIteratorFactory;
+  SubcommandsForOneIterator<Offset, DerivedIterator> _savedSubcommands;
 };
 }  // namespace Subcommands
 }  // namespace Allocations
@@ -8,6 +8,7 @@
 #include <sstream>
 #include "../../AnnotatorRegistry.h"
 #include "../../CPlusPlus/TypeInfoDirectory.h"
+#include "../../Commands/RecordWriter.h"
 #include "../../Commands/Runner.h"
 #include "../../Commands/Subcommand.h"
 #include "../Directory.h"
@@ -26,7 +27,13 @@ class Subcommand : public Commands::Subcommand {
  public:
   typedef typename Directory<Offset>::AllocationIndex AllocationIndex;
   typedef typename Directory<Offset>::Allocation Allocation;
-  enum SetOperationType { ASSIGN, ADD, SUBTRACT };
+  enum SetOperationType {
+    NO_SET_OPERATION,
+    ASSIGN,
+    ADD,
+    SUBTRACT,
+    INTERSECT
+  };
   Subcommand(const ProcessImage<Offset>& processImage,
              typename Visitor::Factory& visitorFactory,
              typename Iterator::Factory& iteratorFactory,
@@ -74,9 +81,18 @@ class Subcommand : public Commands::Subcommand {
         do {
           error << "\"" << context.Positional(nextPositional++) << "\"\n";
         } while (nextPositional < numPositionals);
+        ExplainSetNameAsPositional(context, numPositionals - 1);
         return;
       }
       signatureString = context.Positional(signaturePositional);
+      if (_setCache.FindSaved(signatureString) != nullptr &&
+          HasUnnamedSetOperation(context)) {
+        error << "\"" << signatureString
+              << "\" is the name of a saved set but is taken here as a"
+                 " signature.\n";
+        ExplainSetNameAsPositional(context, signaturePositional);
+        return;
+      }
     }
 
     bool skipTaintedReferences = false;
@@ -105,6 +121,7 @@ class Subcommand : public Commands::Subcommand {
     if (signatureChecker.UnrecognizedSignature()) {
       if (!allowMissingSignatures) {
         error << "Signature \"" << signatureString << "\" is not recognized.\n";
+        ExplainSetNameAsPositional(context, numPositionals - 1);
         signatureOrPatternError = true;
       }
     }
@@ -161,6 +178,26 @@ class Subcommand : public Commands::Subcommand {
       }
     }
 
+    /*
+     * A machine readable format has no room for the comments and annotations
+     * that can otherwise be mixed with the output for the members.
+     */
+    Commands::RecordWriter::Format format = Commands::RecordWriter::TEXT;
+    if (!Commands::RecordWriter::ParseFormatSwitch(context, format)) {
+      switchError = true;
+    } else if (format != Commands::RecordWriter::TEXT) {
+      if (!_visitorFactory.SupportsRecordFormats()) {
+        error << "The /format switch is not supported by \""
+              << _visitorFactory.GetCommandName() << "\".\n";
+        switchError = true;
+      } else if (context.GetNumArguments("annotate") != 0 ||
+                 context.GetNumArguments("commentExtensions") != 0) {
+        error << "The /format switch cannot be combined with /annotate or"
+                 " /commentExtensions.\n";
+        switchError = true;
+      }
+    }
+
     Offset geometricSampleBase = 0;
     size_t numGeometricSampleArguments =
         context.GetNumArguments("geometricSample");
@@ -182,7 +219,8 @@ class Subcommand : public Commands::Subcommand {
       }
     }
 
-    SetOperationType setOperationType;
+    SetOperationType setOperationType = SetOperationType::NO_SET_OPERATION;
+    std::string setOperationName;
 
     size_t numSetOperationArguments = context.GetNumArguments("setOperation");
     if (numSetOperationArguments > 0) {
@@ -190,20 +228,38 @@ class Subcommand : public Commands::Subcommand {
         std::cerr << "At most one /setOperation switch is allowed.\n";
         switchError = true;
       }
-      const std::string& operation = context.Argument("setOperation", 0);
+      std::string operation = context.Argument("setOperation", 0);
+      size_t colonPos = operation.find(':');
+      if (colonPos != std::string::npos) {
+        setOperationName = operation.substr(colonPos + 1);
+        operation.erase(colonPos);
+        if (setOperationName.empty()) {
+          std::cerr << "No name was given after \"" << operation
+                    << ":\".\n";
+          switchError = true;
+        }
+      }
       if (operation == "assign") {
         setOperationType = SetOperationType::ASSIGN;
+      } else if (operation == "save") {
+        setOperationType = SetOperationType::ASSIGN;
+        if (setOperationName.empty()) {
+          std::cerr << "Use \"save:<name>\" to save a set by name.\n";
+          switchError = true;
+        }
       } else if (operation == "add") {
         setOperationType = SetOperationType::ADD;
       } else if (operation == "subtract") {
         setOperationType = SetOperationType::SUBTRACT;
+      } else if (operation == "intersect") {
+        setOperationType = SetOperationType::INTERSECT;
       } else {
         std::cerr << "Set operation " << operation << " is not supported.\n";
         switchError = true;
       }
     }
 
-    Set<Offset>& visited = _setCache.GetVisited();
+    Set<Offset> visited(numAllocations);
 
     std::vector<ReferenceConstraint<Offset> > referenceConstraints;
     const Graph<Offset>* graph = _processImage.GetAllocationGraph();
@@ -293,13 +349,13 @@ class Subcommand : public Commands::Subcommand {
     const std::vector<std::string>& taints = _iteratorFactory.GetTaints();
     if (!taints.empty()) {
       error << "The output of this command cannot be trusted:\n";
-      if (isRedirected) {
+      if (isRedirected && format == Commands::RecordWriter::TEXT) {
         output << "The output of this command cannot be trusted:\n";
       }
       for (std::vector<std::string>::const_iterator it = taints.begin();
            it != taints.end(); ++it) {
         error << *it;
-        if (isRedirected) {
+        if (isRedirected && format == Commands::RecordWriter::TEXT) {
           error << *it;
         }
       }
@@ -347,19 +403,42 @@ class Subcommand : public Commands::Subcommand {
 
       extendedVisitor.Visit(index, *allocation, visitorRef);
     }
+    visitorRef.FinishVisits();
+    if (setOperationType == SetOperationType::NO_SET_OPERATION) {
+      return;
+    }
+    Set<Offset>& target = setOperationName.empty()
+                              ? _setCache.GetDerived()
+                              : _setCache.GetSaved(setOperationName);
     switch (setOperationType) {
       case SetOperationType::ASSIGN:
-        _setCache.GetDerived().Assign(visited);
+        target.Assign(visited);
         break;
       case SetOperationType::ADD:
-        _setCache.GetDerived().Add(visited);
+        target.Add(visited);
         break;
       case SetOperationType::SUBTRACT:
-        _setCache.GetDerived().Subtract(visited);
+        target.Subtract(visited);
+        break;
+      case SetOperationType::INTERSECT:
+        target.Intersect(visited);
+        break;
+      case SetOperationType::NO_SET_OPERATION:
         break;
     }
   }
 
+  /*
+   * Only the derived set is changed by running the subcommand, and some
+   * visitors and annotators keep state between allocations, so only the
+   * subcommands that use none of these are allowed to run concurrently.
+   */
+  bool CanRunConcurrently(Commands::Context& context) const {
+    return _visitorFactory.CanRunConcurrently() &&
+           context.GetNumArguments("setOperation") == 0 &&
+           context.GetNumArguments("annotate") == 0;
+  }
+
   void ShowHelpMessage(Commands::Context& context) {
     Commands::Output& output = context.GetOutput();
     _visitorFactory.ShowHelpMessage(context);
@@ -397,13 +476,41 @@ class Subcommand : public Commands::Subcommand {
            "use \"/setOperation <operation>\" to derive a custome set.\n"
            " assign: initialize the derived set based on some calculated set.\n"
            " add: add some calculated set to the derived set.\n"
-           " subtrace: subtract some calculated set from the derived set.\n\n"
+           " subtrace: subtract some calculated set from the derived set.\n"
+           " intersect: keep only the part of the derived set that is also in"
+           " some\n calculated set.\n"
+           "Any of these operations can be followed by \":<name>\" to act on"
+           " the set saved\n with that name, which can be used later as"
+           " \"saved <name>\", instead of the\n derived set.  \"save:<name>\""
+           " is the same as \"assign:<name>\".\n\n"
            "After restrictions have been applied, the /extend switch can be"
            " used to extend\n"
            " the set to adjacent allocations.  See USERGUIDE.md for details.\n";
   }
 
  private:
+  bool HasUnnamedSetOperation(Commands::Context& context) const {
+    return context.GetNumArguments("setOperation") == 1 &&
+           context.Argument("setOperation", 0).find(':') == std::string::npos;
+  }
+
+  /*
+   * A name given after the operation in /setOperation, as in
+   * "/setOperation intersect a", is taken as a positional argument, so
+   * explain how to give the name in the case that some positional argument
+   * was not understood.
+   */
+  void ExplainSetNameAsPositional(Commands::Context& context,
+                                  size_t positional) {
+    if (!HasUnnamedSetOperation(context)) {
+      return;
+    }
+    context.GetError() << "To act on a saved set, give its name after"
+                          " the operation, as in\n\"/setOperation "
+                       << context.Argument("setOperation", 0) << ":"
+                       << context.Positional(positional) << "\".\n";
+  }
+
   typename Visitor::Factory& _visitorFactory;
   typename Iterator::Factory& _iteratorFactory;
   const PatternDescriberRegistry<Offset>& _patternDescriberRegistry;
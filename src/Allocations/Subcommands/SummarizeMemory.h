@@ -0,0 +1,102 @@
+// Copyright (c) 2024 Broadcom. All Rights Reserved.
+// The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
+// SPDX-License-Identifier: GPL-2.0
+
+#pragma once
+#include "../../Commands/Runner.h"
+#include "../../Commands/Subcommand.h"
+#include "../../ReferenceScanner.h"
+#include "../../ResourceUsage.h"
+#include "../Directory.h"
+#include "../EdgePredicate.h"
+#include "../Graph.h"
+#include "../TagHolder.h"
+namespace chap {
+namespace Allocations {
+namespace Subcommands {
+template <class Offset>
+class SummarizeMemory : public Commands::Subcommand {
+ public:
+  SummarizeMemory(const ProcessImage<Offset>& processImage,
+                  const ReferenceScanner<Offset>& referenceScanner)
+      : Commands::Subcommand("summarize", "memory"),
+        _processImage(processImage),
+        _directory(processImage.GetAllocationDirectory()),
+        _referenceScanner(referenceScanner) {}
+
+  void ShowHelpMessage(Commands::Context& context) {
+    context.GetOutput()
+        << "This command summarizes the memory used by chap itself for the "
+           "analysis of\nallocations, broken down by the part of chap "
+           "that uses it, along with the peak\nresident set size of chap, "
+           "which may help in choosing a host for analyzing\nvery large "
+           "process images.\n";
+  }
+
+  void Run(Commands::Context& context) {
+    Commands::Output& output = context.GetOutput();
+    output << std::dec << _directory.NumAllocations()
+           << " allocations use 0x" << std::hex
+           << _directory.AllocationsMemoryFootprint() << " bytes.\n";
+    if (_directory.HasAddressIndex()) {
+      output << "The index to find allocations by address uses 0x"
+             << _directory.AddressIndexMemoryFootprint() << " bytes.\n";
+    } else {
+      output << "There is no index to find allocations by address.\n";
+    }
+    if (_referenceScanner.IndexIsBuilt()) {
+      output << "The index of pointers uses 0x"
+             << _referenceScanner.IndexMemoryFootprint() << " bytes.\n";
+    } else if (_referenceScanner.IndexIsRefused()) {
+      output << "The index of pointers was not built because it would have "
+                "used about 0x"
+             << _referenceScanner.EstimatedIndexSize() << " bytes.\n";
+    } else if (_referenceScanner.UsesIndex()) {
+      output << "The index of pointers has not been built.\n";
+    } else {
+      output << "There is no index of pointers.\n";
+    }
+    output << "The peak resident set size of chap so far is 0x"
+           << PeakResidentSetSize() << " bytes.\n";
+    /*
+     * Summarizing the memory should not itself cause the graph and tags to
+     * be calculated.
+     */
+    if (!_processImage.AllocationAnalysisIsResolved()) {
+      output << "The allocation graph and tags have not been calculated.\n";
+      return;
+    }
+    const Graph<Offset>* graph = _processImage.GetAllocationGraph();
+    const EdgePredicate<Offset>* edgeIsTainted =
+        _processImage.GetEdgeIsTainted();
+    const EdgePredicate<Offset>* edgeIsFavored =
+        _processImage.GetEdgeIsFavored();
+    const TagHolder<Offset>* tagHolder = _processImage.GetAllocationTagHolder();
+    if (graph != nullptr) {
+      output << "The allocation graph uses 0x" << graph->MemoryFootprint()
+             << " bytes, of which 0x" << graph->EdgesMemoryFootprint()
+             << " bytes are for 0x" << graph->TotalEdges() << " edges.\n";
+      if (graph->EdgesAreSpilled()) {
+        output << "The edges are mapped from temporary files.\n";
+      }
+    }
+    if (edgeIsTainted != nullptr && edgeIsFavored != nullptr) {
+      output << "The flags for tainted and favored edges use 0x"
+             << (edgeIsTainted->MemoryFootprint() +
+                 edgeIsFavored->MemoryFootprint())
+             << " bytes.\n";
+    }
+    if (tagHolder != nullptr) {
+      output << "The allocation tags use 0x" << tagHolder->MemoryFootprint()
+             << " bytes.\n";
+    }
+  }
+
+ private:
+  const ProcessImage<Offset>& _processImage;
+  const Directory<Offset>& _directory;
+  const ReferenceScanner<Offset>& _referenceScanner;
+};
+}  // namespace Subcommands
+}  // namespace Allocations
+}  // namespace chap
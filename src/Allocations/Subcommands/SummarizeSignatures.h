@@ -1,4 +1,4 @@
-// Copyright (c) 2018-2019 Broadcom. All Rights Reserved.
+// Copyright (c) 2018-2019,2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
@@ -15,7 +15,7 @@ class SummarizeSignatures : public Commands::Subcommand {
  public:
   SummarizeSignatures(const ProcessImage<Offset>& processImage)
       : Commands::Subcommand("summarize", "signatures"),
-        _signatureDirectory(processImage.GetSignatureDirectory()) {}
+        _processImage(processImage) {}
 
   void ShowHelpMessage(Commands::Context& context) {
     context.GetOutput()
@@ -24,15 +24,18 @@ class SummarizeSignatures : public Commands::Subcommand {
 
   void Run(Commands::Context& context) {
     Commands::Output& output = context.GetOutput();
+    const SignatureDirectory<Offset>& signatureDirectory =
+        _processImage.GetSignatureDirectory();
     Offset numSignatures = 0;
     std::vector<size_t> counts;
-    counts.resize(SignatureDirectory<Offset>::VTABLE_WITH_NAME_FROM_BINDEFS + 1,
-                  0);
+    counts.resize(
+        SignatureDirectory<Offset>::UNWRITABLE_WITH_NAME_FROM_SYMBOL_TABLE + 1,
+        0);
     typename SignatureDirectory<Offset>::SignatureNameAndStatusConstIterator
-        itEnd = _signatureDirectory.EndSignatures();
+        itEnd = signatureDirectory.EndSignatures();
     for (typename SignatureDirectory<
              Offset>::SignatureNameAndStatusConstIterator it =
-             _signatureDirectory.BeginSignatures();
+             signatureDirectory.BeginSignatures();
          it != itEnd; ++it) {
       typename SignatureDirectory<Offset>::Status status = it->second.second;
       counts[status]++;
@@ -87,12 +90,24 @@ class SummarizeSignatures : public Commands::Subcommand {
       output << count << " signatures are vtable pointers "
                          "with names from the .bindefs file.\n";
     }
+    count =
+        counts[SignatureDirectory<Offset>::VTABLE_WITH_NAME_FROM_SYMBOL_TABLE];
+    if (count > 0) {
+      output << count << " signatures are vtable pointers "
+                         "with names from module symbol tables.\n";
+    }
+    count = counts[SignatureDirectory<
+        Offset>::UNWRITABLE_WITH_NAME_FROM_SYMBOL_TABLE];
+    if (count > 0) {
+      output << count << " signatures are unwritable addresses "
+                         "with names from module symbol tables.\n";
+    }
 
     output << numSignatures << " signatures in total were found.\n";
   }
 
  private:
-  const SignatureDirectory<Offset>& _signatureDirectory;
+  const ProcessImage<Offset>& _processImage;
 };
 }  // namespace Subcommands
 }  // namespace Allocations
@@ -74,7 +74,7 @@ class TagHolder {
         }
         _edgeIsTainted.SetAllOutgoing(allocationIndex, false);
       }
-      _tags[allocationIndex] = tagIndex;
+      _tags[allocationIndex] = (uint16_t)tagIndex;
       return true;
     }
     return false;
@@ -96,6 +96,10 @@ class TagHolder {
     return _indexToName[_tags[allocationIndex]];
   }
 
+  const std::string& GetTagNameByIndex(TagIndex tagIndex) const {
+    return _indexToName[tagIndex];
+  }
+
   const TagIndices* GetTagIndices(std::string tagName) const {
     std::unordered_map<std::string, TagIndices>::const_iterator it =
         _nameToTagIndices.find(tagName);
@@ -114,11 +118,68 @@ class TagHolder {
             _tagIsStrong[_tags[allocationIndex]]);
   }
 
+  /*
+   * Write the tag names and the tag for each allocation to the given
+   * analysis cache.
+   */
+  void Write(AnalysisCacheWriter& writer) const {
+    size_t numTags = _indexToName.size();
+    writer.WriteValue<uint64_t>(numTags);
+    for (TagIndex tagIndex = 1; tagIndex < numTags; tagIndex++) {
+      writer.WriteString(_indexToName[tagIndex]);
+      writer.WriteValue<uint8_t>(_tagIsStrong[tagIndex] ? 1 : 0);
+      writer.WriteValue<uint8_t>(
+          _tagSupportsFavoredReferences[tagIndex] ? 1 : 0);
+    }
+    writer.WriteVector(_tags);
+  }
+
+  /*
+   * Restore tags previously written to an analysis cache.  This is used
+   * in place of registering any tags or running any taggers.
+   */
+  bool Read(AnalysisCacheReader& reader) {
+    uint64_t numTags;
+    if (!reader.ReadValue(numTags) || numTags == 0 ||
+        _indexToName.size() != 1) {
+      return reader.Fail();
+    }
+    for (TagIndex tagIndex = 1; tagIndex < numTags; tagIndex++) {
+      std::string name;
+      uint8_t tagIsStrong, tagSupportsFavoredReferences;
+      if (!reader.ReadString(name) || !reader.ReadValue(tagIsStrong) ||
+          !reader.ReadValue(tagSupportsFavoredReferences)) {
+        return false;
+      }
+      RegisterTag(name.c_str(), tagIsStrong != 0,
+                  tagSupportsFavoredReferences != 0);
+    }
+    std::vector<uint16_t> tags;
+    if (!reader.ReadVector(tags) || tags.size() != _numAllocations) {
+      return reader.Fail();
+    }
+    for (AllocationIndex i = 0; i < _numAllocations; i++) {
+      if (tags[i] >= numTags) {
+        return reader.Fail();
+      }
+      _tags[i] = tags[i];
+    }
+    return true;
+  }
+
+  size_t MemoryFootprint() const {
+    return _tags.capacity() * sizeof(uint16_t);
+  }
+
  private:
   const AllocationIndex _numAllocations;
   EdgePredicate<Offset>& _edgeIsFavored;
   EdgePredicate<Offset>& _edgeIsTainted;
-  std::vector<TagIndex> _tags;
+  /*
+   * The number of tags is limited well below 0x10000, so the tag index for
+   * each allocation is kept in 16 bits.
+   */
+  std::vector<uint16_t> _tags;
   std::vector<std::string> _indexToName;
   std::vector<bool> _tagIsStrong;
   std::vector<bool> _tagSupportsFavoredReferences;
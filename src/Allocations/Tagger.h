@@ -3,6 +3,7 @@
 // SPDX-License-Identifier: GPL-2.0
 
 #pragma once
+#include <string>
 #include "ContiguousImage.h"
 #include "Directory.h"
 #include "Graph.h"
@@ -42,9 +43,14 @@ class Tagger {
     WEAK_CHECK            // May be expensive, weak results OK
   };
 
-  Tagger() {}
+  Tagger(const std::string& name) : _name(name) {}
   virtual ~Tagger() {}
 
+  /*
+   * Return a short name for the tagger, used in reporting.
+   */
+  const std::string& GetName() const { return _name; }
+
   /*
    * Look at the allocation to figure out if the contents of this allocation
    * can be used to resolve information about this allocation and possibly
@@ -79,6 +85,9 @@ class Tagger {
       Reader& /* reader */, AllocationIndex /* index */,
       const Allocation& /* allocation */,
       const EdgeIndex* /* outgoingEdgeIndices */) {}
+
+ private:
+  const std::string _name;
 };
 }  // namespace Allocations
 }  // namespace chap
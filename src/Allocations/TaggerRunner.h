@@ -1,8 +1,15 @@
-// Copyright (c) 2019-2021 Broadcom. All Rights Reserved.
+// Copyright (c) 2019-2021,2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
 #pragma once
+#include <chrono>
+#include <condition_variable>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include "ContiguousImage.h"
 #include "Directory.h"
 #include "Graph.h"
@@ -20,6 +27,15 @@ namespace Allocations {
  * and/or possibly tagging allocations reached from that allocation by following
  * references.  An attempt here is to avoid the most expensive checks when
  * possible and to pick the best match when there is some minor ambiguity.
+ *
+ * The taggers depend on the tags already applied, so they are always run
+ * on one allocation at a time, in order of allocation index, so that the
+ * results do not depend on the number of threads.  What can be done in
+ * parallel is the part of the work for each allocation that does not depend
+ * on any tags, such as finding which words of the allocation correspond to
+ * outgoing edges.  That work is done for a window of allocations at a time,
+ * split across worker threads, while the taggers are run on the previous
+ * window.
  */
 template <typename Offset>
 class TaggerRunner {
@@ -30,17 +46,29 @@ class TaggerRunner {
   typedef typename Tagger<Offset>::Phase Phase;
   typedef typename VirtualAddressMap<Offset>::Reader Reader;
 
+  /*
+   * The given number of threads includes the one calling
+   * ResolveAllAllocationTags.  If reportTimes is set, the time spent in each
+   * pass and by each tagger in each phase is reported to standard error.
+   */
   TaggerRunner(const Graph<Offset>& graph, const TagHolder<Offset>& tagHolder,
                const EdgePredicate<Offset>& edgeIsTainted,
-               const SignatureDirectory<Offset>& signatureDirectory)
+               const SignatureDirectory<Offset>& signatureDirectory,
+               size_t numThreads, bool reportTimes)
       : _addressMap(graph.GetAddressMap()),
         _graph(graph),
         _directory(graph.GetAllocationDirectory()),
         _contiguousImage(_addressMap, _directory),
+        _candidateFilter(graph.GetCandidateFilter()),
         _numAllocations(_directory.NumAllocations()),
+        _totalEdges(graph.TotalEdges()),
         _tagHolder(tagHolder),
         _edgeIsTainted(edgeIsTainted),
-        _signatureDirectory(signatureDirectory) {}
+        _signatureDirectory(signatureDirectory),
+        _numThreads(numThreads == 0 ? 1 : numThreads),
+        _reportTimes(reportTimes),
+        _workerImages(_numThreads),
+        _workerReaders(_numThreads) {}
 
   ~TaggerRunner() {
     for (auto tagger : _taggers) {
@@ -53,24 +81,337 @@ class TaggerRunner {
     _numTaggers = _taggers.size();
     _finishedWithPass.reserve(_numTaggers);
     _finishedWithPass.resize(_numTaggers, false);
-    TagFromAllocations();
-    TagFromReferenced();
-    MarkFavoredReferences();
+    _taggerSeconds.assign(_numTaggers * NUM_PASSES * NUM_PHASES, 0.0);
+    for (size_t pass = 0; pass < NUM_PASSES; pass++) {
+      auto start = std::chrono::steady_clock::now();
+      RunPass((Pass)pass);
+      _passSeconds[pass] = SecondsSince(start);
+    }
+    if (_reportTimes) {
+      ReportTimes();
+    }
   }
 
  private:
+  enum Pass {
+    TAG_FROM_ALLOCATION,
+    TAG_FROM_REFERENCED,
+    MARK_FAVORED,
+    NUM_PASSES
+  };
+  static constexpr size_t NUM_PHASES = Phase::WEAK_CHECK + 1;
+  static constexpr AllocationIndex WINDOW_SIZE = 0x10000;
+  static constexpr size_t SHARDS_PER_WORKER = 4;
+
+  /*
+   * A Candidate is a word in an allocation, identified by position in
+   * words, that corresponds to an outgoing edge from that allocation.
+   */
+  struct Candidate {
+    Offset _position;
+    EdgeIndex _edgeIndex;
+  };
+
+  /*
+   * A Window holds the results of the work that doesn't depend on tags for
+   * a range of allocations.  The allocations in the window are split into
+   * shards of _shardSize allocations, each with its own candidates.
+   */
+  struct Window {
+    AllocationIndex _base;
+    AllocationIndex _limit;
+    AllocationIndex _shardSize;
+    std::vector<uint8_t> _isUnsigned;
+    std::vector<std::pair<size_t, size_t> > _candidateRanges;
+    std::vector<std::vector<Candidate> > _shardCandidates;
+  };
+
+  /*
+   * A Pipeline holds the two windows used for a pass and the state, guarded
+   * by _mutex, that the workers preparing them and the thread running the
+   * taggers on them use to hand the windows back and forth.
+   */
+  struct Pipeline {
+    Pipeline()
+        : _numWindows(0),
+          _nextWindow(0),
+          _nextShard(0),
+          _numShards(0),
+          _numConsumed(0),
+          _shardsLeft{0, 0},
+          _isReady{false, false} {}
+    Window _windows[2];
+    std::mutex _mutex;
+    std::condition_variable _changed;
+    size_t _numWindows;
+    size_t _nextWindow;
+    size_t _nextShard;
+    size_t _numShards;
+    size_t _numConsumed;
+    size_t _shardsLeft[2];
+    bool _isReady[2];
+  };
+
   const VirtualAddressMap<Offset> _addressMap;
   const Graph<Offset>& _graph;
   const Directory<Offset>& _directory;
   ContiguousImage<Offset> _contiguousImage;
+  const PointerCandidateFilter<Offset>& _candidateFilter;
   const AllocationIndex _numAllocations;
+  const EdgeIndex _totalEdges;
   const TagHolder<Offset>& _tagHolder;
   const EdgePredicate<Offset>& _edgeIsTainted;
   const SignatureDirectory<Offset>& _signatureDirectory;
+  const size_t _numThreads;
+  const bool _reportTimes;
+  std::vector<std::unique_ptr<ContiguousImage<Offset> > > _workerImages;
+  std::vector<std::unique_ptr<Reader> > _workerReaders;
   std::vector<Tagger<Offset>*> _taggers;
   size_t _numTaggers;
   std::vector<bool> _finishedWithPass;
   size_t _numFinishedWithPass;
+  double _passSeconds[NUM_PASSES];
+  std::vector<double> _taggerSeconds;
+
+  static double SecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         start)
+        .count();
+  }
+
+  double& TaggerSeconds(size_t taggerIndex, Pass pass, Phase phase) {
+    return _taggerSeconds[(taggerIndex * NUM_PASSES + pass) * NUM_PHASES +
+                          phase];
+  }
+
+  /*
+   * Run the given pass over all the allocations, a window at a time.  If
+   * there are multiple threads, one set of workers, started once for the
+   * pass, prepares the windows in order, at most two ahead of the one on
+   * which the taggers are being run, while the calling thread runs the
+   * taggers.
+   */
+  void RunPass(Pass pass) {
+    if (_numAllocations == 0) {
+      return;
+    }
+    if (_numThreads == 1) {
+      Window window;
+      for (AllocationIndex base = 0; base < _numAllocations;
+           base = window._limit) {
+        SizeWindow(window, pass, base, 1);
+        size_t numShards =
+            (window._limit - base + window._shardSize - 1) / window._shardSize;
+        for (size_t shard = 0; shard < numShards; shard++) {
+          PrepareShard(window, pass, shard, 0);
+        }
+        RunTaggersOnWindow(window, pass);
+      }
+      return;
+    }
+    Pipeline pipeline;
+    pipeline._numWindows = (_numAllocations + WINDOW_SIZE - 1) / WINDOW_SIZE;
+    std::vector<std::thread> workers;
+    size_t numWorkers = _numThreads - 1;
+    workers.reserve(numWorkers);
+    for (size_t worker = 0; worker < numWorkers; worker++) {
+      workers.emplace_back([this, &pipeline, pass, worker]() {
+        PrepareWindows(pipeline, pass, worker);
+      });
+    }
+    for (size_t windowIndex = 0; windowIndex < pipeline._numWindows;
+         windowIndex++) {
+      size_t slot = windowIndex % 2;
+      {
+        std::unique_lock<std::mutex> lock(pipeline._mutex);
+        pipeline._changed.wait(lock,
+                               [&]() { return pipeline._isReady[slot]; });
+      }
+      RunTaggersOnWindow(pipeline._windows[slot], pass);
+      {
+        std::lock_guard<std::mutex> lock(pipeline._mutex);
+        pipeline._isReady[slot] = false;
+        pipeline._numConsumed++;
+      }
+      pipeline._changed.notify_all();
+    }
+    for (std::thread& worker : workers) {
+      worker.join();
+    }
+  }
+
+  /*
+   * Claim and prepare shards of windows, in order of window, until all the
+   * windows for the pass have been claimed.  A window is sized by the first
+   * worker to claim a shard of it, once the taggers are done with the window
+   * that last used the same slot, and is ready once all its shards are done.
+   */
+  void PrepareWindows(Pipeline& pipeline, Pass pass, size_t worker) {
+    std::unique_lock<std::mutex> lock(pipeline._mutex);
+    while (pipeline._nextWindow < pipeline._numWindows) {
+      size_t windowIndex = pipeline._nextWindow;
+      size_t slot = windowIndex % 2;
+      Window& window = pipeline._windows[slot];
+      if (pipeline._nextShard == 0) {
+        if (windowIndex >= pipeline._numConsumed + 2) {
+          pipeline._changed.wait(lock);
+          continue;
+        }
+        SizeWindow(window, pass, windowIndex * WINDOW_SIZE, _numThreads - 1);
+        pipeline._numShards = (window._limit - window._base +
+                               window._shardSize - 1) /
+                              window._shardSize;
+        pipeline._shardsLeft[slot] = pipeline._numShards;
+      }
+      size_t shard = pipeline._nextShard++;
+      if (pipeline._nextShard == pipeline._numShards) {
+        pipeline._nextShard = 0;
+        pipeline._nextWindow++;
+      }
+      lock.unlock();
+      PrepareShard(window, pass, shard, worker);
+      lock.lock();
+      if (--pipeline._shardsLeft[slot] == 0) {
+        pipeline._isReady[slot] = true;
+        pipeline._changed.notify_all();
+      }
+    }
+  }
+
+  /*
+   * Set the range of the window of allocations starting at the given base,
+   * and size the results, so that the shards can be prepared independently
+   * by the given number of workers.
+   */
+  void SizeWindow(Window& window, Pass pass, AllocationIndex base,
+                  size_t numWorkers) {
+    window._base = base;
+    window._limit = (_numAllocations - base > WINDOW_SIZE)
+                        ? base + WINDOW_SIZE
+                        : _numAllocations;
+    size_t numInWindow = window._limit - base;
+    size_t numShards = numWorkers * SHARDS_PER_WORKER;
+    if (numShards > numInWindow) {
+      numShards = numInWindow;
+    }
+    window._shardSize = (numInWindow + numShards - 1) / numShards;
+    numShards = (numInWindow + window._shardSize - 1) / window._shardSize;
+    if (pass == TAG_FROM_ALLOCATION) {
+      window._isUnsigned.assign(numInWindow, 1);
+    } else {
+      window._candidateRanges.assign(numInWindow, std::make_pair(0, 0));
+      window._shardCandidates.resize(numShards);
+    }
+  }
+
+  /*
+   * Do the work that doesn't depend on tags for the given shard of the
+   * window, using the state kept for the given worker.
+   */
+  void PrepareShard(Window& window, Pass pass, size_t shard, size_t worker) {
+    if (!_workerImages[worker]) {
+      _workerImages[worker].reset(
+          new ContiguousImage<Offset>(_addressMap, _directory));
+      _workerReaders[worker].reset(new Reader(_addressMap));
+    }
+    size_t numInWindow = window._limit - window._base;
+    size_t first = shard * window._shardSize;
+    size_t limit = first + window._shardSize;
+    if (limit > numInWindow) {
+      limit = numInWindow;
+    }
+    if (pass == TAG_FROM_ALLOCATION) {
+      FindUnsigned(window, first, limit, *(_workerReaders[worker]));
+    } else {
+      FindCandidates(window, first, limit, window._shardCandidates[shard],
+                     *(_workerImages[worker]));
+    }
+  }
+
+  void FindUnsigned(Window& window, size_t first, size_t limit,
+                    Reader& reader) {
+    for (size_t j = first; j < limit; j++) {
+      const Allocation* allocation = _directory.AllocationAt(window._base + j);
+      if (allocation->IsUsed() && allocation->Size() >= sizeof(Offset) &&
+          _signatureDirectory.IsMapped(
+              reader.ReadOffset(allocation->Address(), 0xbad))) {
+        window._isUnsigned[j] = 0;
+      }
+    }
+  }
+
+  void FindCandidates(Window& window, size_t first, size_t limit,
+                      std::vector<Candidate>& candidates,
+                      ContiguousImage<Offset>& contiguousImage) {
+    candidates.clear();
+    for (size_t j = first; j < limit; j++) {
+      AllocationIndex i = window._base + j;
+      const Allocation* allocation = _directory.AllocationAt(i);
+      EdgeIndex nextOutgoing;
+      EdgeIndex pastOutgoing;
+      _graph.GetOutgoing(i, nextOutgoing, pastOutgoing);
+      window._candidateRanges[j].first = candidates.size();
+      if (allocation->IsUsed() && nextOutgoing != pastOutgoing) {
+        contiguousImage.SetIndex(i);
+        const Offset* firstOffset = contiguousImage.FirstOffset();
+        _candidateFilter.VisitCandidates(
+            firstOffset, contiguousImage.OffsetLimit(),
+            [&](const Offset* check) {
+              EdgeIndex edgeIndex = _graph.TargetEdgeIndex(i, *check);
+              if (edgeIndex != _totalEdges) {
+                candidates.push_back(
+                    {(Offset)(check - firstOffset), edgeIndex});
+              }
+            });
+      }
+      window._candidateRanges[j].second = candidates.size();
+    }
+  }
+
+  void RunTaggersOnWindow(Window& window, Pass pass) {
+    switch (pass) {
+      case TAG_FROM_ALLOCATION:
+        TagFromAllocations(window);
+        break;
+      case TAG_FROM_REFERENCED:
+        TagFromReferenced(window);
+        break;
+      default:
+        MarkFavoredReferences(window);
+        break;
+    }
+  }
+
+  void ReportTimes() const {
+    std::ios_base::fmtflags oldFlags = std::cerr.flags();
+    std::streamsize oldPrecision = std::cerr.precision();
+    std::cerr << std::fixed << std::setprecision(3)
+              << "Tagging took " << _passSeconds[TAG_FROM_ALLOCATION]
+              << "s to tag from allocations, "
+              << _passSeconds[TAG_FROM_REFERENCED]
+              << "s to tag from references and " << _passSeconds[MARK_FAVORED]
+              << "s to mark favored references.\n"
+              << "Seconds used by each tagger, by phase (quick/medium/slow/"
+                 "weak):\n";
+    for (size_t taggerIndex = 0; taggerIndex < _numTaggers; taggerIndex++) {
+      const double* seconds =
+          &_taggerSeconds[taggerIndex * NUM_PASSES * NUM_PHASES];
+      std::cerr << _taggers[taggerIndex]->GetName() << ": from allocations ";
+      for (size_t phase = 0; phase < NUM_PHASES; phase++) {
+        std::cerr << (phase == 0 ? "" : "/")
+                  << seconds[TAG_FROM_ALLOCATION * NUM_PHASES + phase];
+      }
+      std::cerr << ", from references ";
+      for (size_t phase = 0; phase < NUM_PHASES; phase++) {
+        std::cerr << (phase == 0 ? "" : "/")
+                  << seconds[TAG_FROM_REFERENCED * NUM_PHASES + phase];
+      }
+      std::cerr << ", favored references "
+                << seconds[MARK_FAVORED * NUM_PHASES] << "\n";
+    }
+    std::cerr.flags(oldFlags);
+    std::cerr.precision(oldPrecision);
+  }
 
   /*
    * For each used allocation, attempt to tag it and any referenced
@@ -78,9 +419,9 @@ class TaggerRunner {
    * of the newly added tag.
    */
 
-  void TagFromAllocations() {
+  void TagFromAllocations(const Window& window) {
     Reader reader(_addressMap);
-    for (AllocationIndex i = 0; i < _numAllocations; i++) {
+    for (AllocationIndex i = window._base; i < window._limit; i++) {
       const Allocation* allocation = _directory.AllocationAt(i);
       if (!allocation->IsUsed()) {
         continue;
@@ -91,14 +432,7 @@ class TaggerRunner {
         _finishedWithPass[taggersIndex] = false;
       }
       _numFinishedWithPass = 0;
-      bool isUnsigned = true;
-      if (allocation->Size() >= sizeof(Offset)) {
-        Offset signatureCandidate =
-            reader.ReadOffset(allocation->Address(), 0xbad);
-        if (_signatureDirectory.IsMapped(signatureCandidate)) {
-          isUnsigned = false;
-        }
-      }
+      bool isUnsigned = window._isUnsigned[i - window._base] != 0;
       if (!RunTagFromAllocationPhase(reader, i, Phase::QUICK_INITIAL_CHECK,
                                      *allocation, isUnsigned) &&
           !RunTagFromAllocationPhase(reader, i, Phase::MEDIUM_CHECK,
@@ -117,30 +451,34 @@ class TaggerRunner {
    * allocations referenced by it that have not yet been tagged.
    */
 
-  void TagFromReferenced() {
+  void TagFromReferenced(const Window& window) {
     Reader reader(_addressMap);
     std::vector<AllocationIndex> unresolvedOutgoing;
     unresolvedOutgoing.reserve(_directory.MaxAllocationSize());
-    for (AllocationIndex i = 0; i < _numAllocations; i++) {
+    for (AllocationIndex i = window._base; i < window._limit; i++) {
       const Allocation* allocation = _directory.AllocationAt(i);
       if (!allocation->IsUsed()) {
         continue;
       }
+      size_t j = i - window._base;
+      const Candidate* candidates =
+          window._shardCandidates[j / window._shardSize].data();
+      const Candidate* candidate =
+          candidates + window._candidateRanges[j].first;
+      const Candidate* candidateLimit =
+          candidates + window._candidateRanges[j].second;
       _contiguousImage.SetIndex(i);
-      unresolvedOutgoing.clear();
       size_t numUnresolved = 0;
-      const Offset* offsetLimit = _contiguousImage.OffsetLimit();
-      for (const Offset* check = _contiguousImage.FirstOffset();
-           check < offsetLimit; check++) {
-        AllocationIndex targetIndex = _graph.TargetAllocationIndex(i, *check);
-        if (targetIndex != _numAllocations) {
-          if (_tagHolder.IsStronglyTagged(targetIndex)) {
-            targetIndex = _numAllocations;
-          } else {
-            numUnresolved++;
-          }
+      unresolvedOutgoing.assign(
+          _contiguousImage.OffsetLimit() - _contiguousImage.FirstOffset(),
+          _numAllocations);
+      for (; candidate < candidateLimit; ++candidate) {
+        AllocationIndex targetIndex =
+            _graph.GetTargetForOutgoing(candidate->_edgeIndex);
+        if (!_tagHolder.IsStronglyTagged(targetIndex)) {
+          unresolvedOutgoing[candidate->_position] = targetIndex;
+          numUnresolved++;
         }
-        unresolvedOutgoing.push_back(targetIndex);
       }
       if (numUnresolved == 0) {
         continue;
@@ -172,8 +510,18 @@ class TaggerRunner {
         ++resolvedIndex;
         continue;
       }
-      if (tagger->TagFromAllocation(_contiguousImage, reader, index, phase,
-                                    allocation, isUnsigned)) {
+      bool finished;
+      if (_reportTimes) {
+        auto start = std::chrono::steady_clock::now();
+        finished = tagger->TagFromAllocation(_contiguousImage, reader, index,
+                                             phase, allocation, isUnsigned);
+        TaggerSeconds(resolvedIndex, TAG_FROM_ALLOCATION, phase) +=
+            SecondsSince(start);
+      } else {
+        finished = tagger->TagFromAllocation(_contiguousImage, reader, index,
+                                             phase, allocation, isUnsigned);
+      }
+      if (finished) {
         _finishedWithPass[resolvedIndex] = true;
         if (++_numFinishedWithPass == _numTaggers) {
           return true;
@@ -193,8 +541,20 @@ class TaggerRunner {
         ++resolvedIndex;
         continue;
       }
-      if (tagger->TagFromReferenced(_contiguousImage, reader, index, phase,
-                                    allocation, unresolvedOutgoing)) {
+      bool finished;
+      if (_reportTimes) {
+        auto start = std::chrono::steady_clock::now();
+        finished = tagger->TagFromReferenced(_contiguousImage, reader, index,
+                                             phase, allocation,
+                                             unresolvedOutgoing);
+        TaggerSeconds(resolvedIndex, TAG_FROM_REFERENCED, phase) +=
+            SecondsSince(start);
+      } else {
+        finished = tagger->TagFromReferenced(_contiguousImage, reader, index,
+                                             phase, allocation,
+                                             unresolvedOutgoing);
+      }
+      if (finished) {
         _finishedWithPass[resolvedIndex] = true;
         if (++_numFinishedWithPass == _numTaggers) {
           return true;
@@ -205,12 +565,11 @@ class TaggerRunner {
     return false;
   }
 
-  void MarkFavoredReferences() {
+  void MarkFavoredReferences(const Window& window) {
     Reader reader(_addressMap);
     std::vector<EdgeIndex> outgoingEdgeIndices;
-    EdgeIndex totalEdges = _graph.TotalEdges();
     outgoingEdgeIndices.reserve(_directory.MaxAllocationSize());
-    for (AllocationIndex i = 0; i < _numAllocations; i++) {
+    for (AllocationIndex i = window._base; i < window._limit; i++) {
       const Allocation* allocation = _directory.AllocationAt(i);
       if (!allocation->IsUsed()) {
         continue;
@@ -232,24 +591,38 @@ class TaggerRunner {
       if (!hasMarkableOutgoing) {
         continue;
       }
+      size_t j = i - window._base;
+      const Candidate* candidates =
+          window._shardCandidates[j / window._shardSize].data();
+      const Candidate* candidate =
+          candidates + window._candidateRanges[j].first;
+      const Candidate* candidateLimit =
+          candidates + window._candidateRanges[j].second;
       _contiguousImage.SetIndex(i);
-      outgoingEdgeIndices.clear();
-      const Offset* offsetLimit = _contiguousImage.OffsetLimit();
-      for (const Offset* check = _contiguousImage.FirstOffset();
-           check < offsetLimit; check++) {
-        EdgeIndex edgeIndex = _graph.TargetEdgeIndex(i, *check);
-        if (edgeIndex != totalEdges) {
-          if (_edgeIsTainted.ForOutgoing(edgeIndex) ||
-              !_tagHolder.SupportsFavoredReferences(
-                  _graph.GetTargetForOutgoing(edgeIndex))) {
-            edgeIndex = totalEdges;
-          }
+      outgoingEdgeIndices.assign(
+          _contiguousImage.OffsetLimit() - _contiguousImage.FirstOffset(),
+          _totalEdges);
+      for (; candidate < candidateLimit; ++candidate) {
+        EdgeIndex edgeIndex = candidate->_edgeIndex;
+        if (!_edgeIsTainted.ForOutgoing(edgeIndex) &&
+            _tagHolder.SupportsFavoredReferences(
+                _graph.GetTargetForOutgoing(edgeIndex))) {
+          outgoingEdgeIndices[candidate->_position] = edgeIndex;
         }
-        outgoingEdgeIndices.push_back(edgeIndex);
       }
+      size_t taggerIndex = 0;
       for (auto tagger : _taggers) {
-        tagger->MarkFavoredReferences(_contiguousImage, reader, i, *allocation,
-                                      &(outgoingEdgeIndices[0]));
+        if (_reportTimes) {
+          auto start = std::chrono::steady_clock::now();
+          tagger->MarkFavoredReferences(_contiguousImage, reader, i,
+                                        *allocation, &(outgoingEdgeIndices[0]));
+          TaggerSeconds(taggerIndex, MARK_FAVORED,
+                        Phase::QUICK_INITIAL_CHECK) += SecondsSince(start);
+        } else {
+          tagger->MarkFavoredReferences(_contiguousImage, reader, i,
+                                        *allocation, &(outgoingEdgeIndices[0]));
+        }
+        ++taggerIndex;
       }
     }
   }
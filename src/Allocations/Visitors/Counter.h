@@ -1,4 +1,4 @@
-// Copyright (c) 2017,2020 Broadcom. All Rights Reserved.
+// Copyright (c) 2017,2020,2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
@@ -23,6 +23,8 @@ class Counter {
       return new Counter(context);
     }
     const std::string& GetCommandName() const { return _commandName; }
+    bool CanRunConcurrently() const { return true; }
+    bool SupportsRecordFormats() const { return false; }
     // TODO: allow adding taints
     const std::vector<std::string>& GetTaints() const { return _taints; }
     void ShowHelpMessage(Commands::Context& context) {
@@ -42,6 +44,7 @@ class Counter {
   void Visit(AllocationIndex /* index */, const Allocation& allocation) {
     _sizedTally.AdjustTally(allocation.Size());
   }
+  void FinishVisits() {}
 
  private:
   Commands::Context& _context;
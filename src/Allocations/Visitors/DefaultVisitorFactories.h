@@ -17,8 +17,11 @@ namespace Visitors {
 template <class Offset>
 class DefaultVisitorFactories {
  public:
-  DefaultVisitorFactories(const Allocations::Describer<Offset>& describer)
-      : _describerFactory(describer), _explainerFactory(describer) {}
+  DefaultVisitorFactories(const Allocations::Describer<Offset>& describer,
+                          size_t numThreads)
+      : _summarizerFactory(numThreads),
+        _describerFactory(describer),
+        _explainerFactory(describer) {}
   typename Visitors::Counter<Offset>::Factory _counterFactory;
   typename Visitors::Summarizer<Offset>::Factory _summarizerFactory;
   typename Visitors::Enumerator<Offset>::Factory _enumeratorFactory;
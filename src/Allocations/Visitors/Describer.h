@@ -57,6 +57,8 @@ class Describer {
                            showAscii);
     }
     const std::string& GetCommandName() const { return _commandName; }
+    bool CanRunConcurrently() const { return false; }
+    bool SupportsRecordFormats() const { return false; }
     // TODO: allow adding taints
     const std::vector<std::string>& GetTaints() const { return _taints; }
     void ShowHelpMessage(Commands::Context& context) {
@@ -100,6 +102,7 @@ class Describer {
       output.HexDump((const Offset*)image, numToShow, _showAscii);
     }
   }
+  void FinishVisits() {}
 
  private:
   Commands::Context& _context;
@@ -1,8 +1,10 @@
-// Copyright (c) 2017,2020 Broadcom. All Rights Reserved.
+// Copyright (c) 2017,2020,2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
 #pragma once
+#include <memory>
+#include "../../Commands/RecordWriter.h"
 #include "../../Commands/Runner.h"
 #include "../../Commands/Subcommand.h"
 #include "../Directory.h"
@@ -19,15 +21,23 @@ class Enumerator {
     Factory() : _commandName("enumerate") {}
     Enumerator* MakeVisitor(Commands::Context& context,
                             const ProcessImage<Offset>& /* processImage */) {
-      return new Enumerator(context);
+      Commands::RecordWriter::Format format;
+      if (!Commands::RecordWriter::ParseFormatSwitch(context, format)) {
+        return nullptr;
+      }
+      return new Enumerator(context, format);
     }
     const std::string& GetCommandName() const { return _commandName; }
+    bool CanRunConcurrently() const { return true; }
+    bool SupportsRecordFormats() const { return true; }
     // TODO: allow adding taints
     const std::vector<std::string>& GetTaints() const { return _taints; }
     void ShowHelpMessage(Commands::Context& context) {
       Commands::Output& output = context.GetOutput();
       output << "In this case \"enumerate\" means show the address of "
-                "each allocation in the set.\n";
+                "each allocation in the set.  Use \"/format json\",\n"
+                "\"/format csv\" or \"/format binary\" to get the addresses"
+                " in a machine readable\nformat.\n";
     }
 
    private:
@@ -35,13 +45,27 @@ class Enumerator {
     const std::vector<std::string> _taints;
   };
 
-  Enumerator(Commands::Context& context) : _context(context) {}
+  Enumerator(Commands::Context& context, Commands::RecordWriter::Format format)
+      : _context(context) {
+    if (format != Commands::RecordWriter::TEXT) {
+      _recordWriter.reset(new Commands::RecordWriter(
+          context.GetOutput(), format,
+          {{"address", Commands::RecordWriter::ADDRESS}}));
+    }
+  }
   void Visit(AllocationIndex /* index */, const Allocation& allocation) {
+    if (_recordWriter) {
+      _recordWriter->AddAddress(allocation.Address());
+      _recordWriter->EndRecord();
+      return;
+    }
     _context.GetOutput() << std::hex << allocation.Address() << "\n";
   }
+  void FinishVisits() {}
 
  private:
   Commands::Context& _context;
+  std::unique_ptr<Commands::RecordWriter> _recordWriter;
 };
 }  // namespace Visitors
 }  // namespace Allocations
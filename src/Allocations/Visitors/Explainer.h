@@ -1,4 +1,4 @@
-// Copyright (c) 2017,2020 Broadcom. All Rights Reserved.
+// Copyright (c) 2017,2020,2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
@@ -25,6 +25,8 @@ class Explainer {
       return new Explainer(context, _describer);
     }
     const std::string& GetCommandName() const { return _commandName; }
+    bool CanRunConcurrently() const { return false; }
+    bool SupportsRecordFormats() const { return false; }
     // TODO: allow adding taints
     const std::vector<std::string>& GetTaints() const { return _taints; }
     void ShowHelpMessage(Commands::Context& context) {
@@ -51,6 +53,7 @@ class Explainer {
     _sizedTally.AdjustTally(size);
     _describer.Describe(_context, index, allocation, true, 0, false);
   }
+  void FinishVisits() {}
 
  private:
   Commands::Context& _context;
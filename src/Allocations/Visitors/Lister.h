@@ -1,8 +1,10 @@
-// Copyright (c) 2017,2020 Broadcom. All Rights Reserved.
+// Copyright (c) 2017,2020,2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
 #pragma once
+#include <memory>
+#include "../../Commands/RecordWriter.h"
 #include "../../Commands/Runner.h"
 #include "../../Commands/Subcommand.h"
 #include "../../SizedTally.h"
@@ -21,17 +23,26 @@ class Lister {
     Factory() : _commandName("list") {}
     Lister* MakeVisitor(Commands::Context& context,
                         const ProcessImage<Offset>& processImage) {
+      Commands::RecordWriter::Format format;
+      if (!Commands::RecordWriter::ParseFormatSwitch(context, format)) {
+        return nullptr;
+      }
       return new Lister(context, processImage.GetSignatureDirectory(),
-                        processImage.GetVirtualAddressMap());
+                        processImage.GetVirtualAddressMap(), format);
     }
     const std::string& GetCommandName() const { return _commandName; }
+    bool CanRunConcurrently() const { return true; }
+    bool SupportsRecordFormats() const { return true; }
     // TODO: allow adding taints
     const std::vector<std::string>& GetTaints() const { return _taints; }
     void ShowHelpMessage(Commands::Context& context) {
       Commands::Output& output = context.GetOutput();
       output << "In this case \"list\" means show the address, size,"
                 " used/free status\n"
-                "and type if known.\n";
+                "and type if known.  Use \"/format json\", \"/format csv\" or"
+                " \"/format binary\"\n"
+                "to get one record per allocation, with fields address, size,"
+                " used, signature\nand name, in a machine readable format.\n";
     }
 
    private:
@@ -41,14 +52,30 @@ class Lister {
 
   Lister(Commands::Context& context,
          const SignatureDirectory<Offset>& signatureDirectory,
-         const VirtualAddressMap<Offset>& addressMap)
+         const VirtualAddressMap<Offset>& addressMap,
+         Commands::RecordWriter::Format format)
       : _context(context),
         _signatureDirectory(signatureDirectory),
-        _addressMap(addressMap),
-        _sizedTally(context, "allocations") {}
+        _addressMap(addressMap) {
+    if (format == Commands::RecordWriter::TEXT) {
+      _sizedTally.reset(new SizedTally<Offset>(context, "allocations"));
+    } else {
+      _recordWriter.reset(new Commands::RecordWriter(
+          context.GetOutput(), format,
+          {{"address", Commands::RecordWriter::ADDRESS},
+           {"size", Commands::RecordWriter::COUNT},
+           {"used", Commands::RecordWriter::BOOLEAN},
+           {"signature", Commands::RecordWriter::ADDRESS},
+           {"name", Commands::RecordWriter::STRING}}));
+    }
+  }
   void Visit(AllocationIndex /* index */, const Allocation& allocation) {
+    if (_recordWriter) {
+      WriteRecord(allocation);
+      return;
+    }
     size_t size = allocation.Size();
-    _sizedTally.AdjustTally(size);
+    _sizedTally->AdjustTally(size);
     Commands::Output& output = _context.GetOutput();
     if (allocation.IsUsed()) {
       output << "Used allocation at ";
@@ -72,12 +99,38 @@ class Lister {
     }
     output << "\n";
   }
+  void FinishVisits() {}
 
  private:
   Commands::Context& _context;
   const SignatureDirectory<Offset>& _signatureDirectory;
   const VirtualAddressMap<Offset>& _addressMap;
-  SizedTally<Offset> _sizedTally;
+  std::unique_ptr<SizedTally<Offset> > _sizedTally;
+  std::unique_ptr<Commands::RecordWriter> _recordWriter;
+
+  void WriteRecord(const Allocation& allocation) {
+    Offset address = allocation.Address();
+    Offset size = allocation.Size();
+    _recordWriter->AddAddress(address);
+    _recordWriter->AddCount(size);
+    _recordWriter->AddBoolean(allocation.IsUsed());
+    const char* image;
+    (void)_addressMap.FindMappedMemoryImage(address, &image);
+    Offset signature = (size >= sizeof(Offset)) ? *((Offset*)image) : 0;
+    if (size >= sizeof(Offset) && _signatureDirectory.IsMapped(signature)) {
+      _recordWriter->AddAddress(signature);
+      const std::string& name = _signatureDirectory.Name(signature);
+      if (name.empty()) {
+        _recordWriter->AddMissing();
+      } else {
+        _recordWriter->AddString(name);
+      }
+    } else {
+      _recordWriter->AddMissing();
+      _recordWriter->AddMissing();
+    }
+    _recordWriter->EndRecord();
+  }
 };
 }  // namespace Visitors
 }  // namespace Allocations
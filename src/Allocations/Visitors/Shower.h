@@ -1,8 +1,10 @@
-// Copyright (c) 2017,2020 Broadcom. All Rights Reserved.
+// Copyright (c) 2017,2020,2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
 #pragma once
+#include <memory>
+#include "../../Commands/RecordWriter.h"
 #include "../../Commands/Runner.h"
 #include "../../Commands/Subcommand.h"
 #include "../../SizedTally.h"
@@ -25,10 +27,17 @@ class Shower {
       if (!context.ParseBooleanSwitch("showAscii", showAscii)) {
         return nullptr;
       }
+      Commands::RecordWriter::Format format;
+      if (!Commands::RecordWriter::ParseFormatSwitch(context, format)) {
+        return nullptr;
+      }
       return new Shower(context, processImage.GetSignatureDirectory(),
-                        processImage.GetVirtualAddressMap(), showAscii);
+                        processImage.GetVirtualAddressMap(), showAscii,
+                        format);
     }
     const std::string& GetCommandName() const { return _commandName; }
+    bool CanRunConcurrently() const { return false; }
+    bool SupportsRecordFormats() const { return true; }
     // TODO: allow adding taints
     const std::vector<std::string>& GetTaints() const { return _taints; }
     void ShowHelpMessage(Commands::Context& context) {
@@ -37,7 +46,11 @@ class Shower {
                 " type if known, and contents of\n"
                 "each allocation in the set.  For this process image,"
                 " an allocation is shown as\nunsigned "
-             << std::dec << (sizeof(Offset) * 8) << "-bit words.\n";
+             << std::dec << (sizeof(Offset) * 8)
+             << "-bit words.  Use \"/format json\",\n"
+                "\"/format csv\" or \"/format binary\" to get one record per"
+                " allocation, with fields\naddress, size, used, signature,"
+                " name and contents, in a machine readable\nformat.\n";
     }
 
    private:
@@ -47,15 +60,32 @@ class Shower {
 
   Shower(Commands::Context& context,
          const SignatureDirectory<Offset>& signatureDirectory,
-         const VirtualAddressMap<Offset>& addressMap, bool showAscii)
+         const VirtualAddressMap<Offset>& addressMap, bool showAscii,
+         Commands::RecordWriter::Format format)
       : _context(context),
         _signatureDirectory(signatureDirectory),
         _addressMap(addressMap),
-        _showAscii(showAscii),
-        _sizedTally(context, "allocations") {}
+        _showAscii(showAscii) {
+    if (format == Commands::RecordWriter::TEXT) {
+      _sizedTally.reset(new SizedTally<Offset>(context, "allocations"));
+    } else {
+      _recordWriter.reset(new Commands::RecordWriter(
+          context.GetOutput(), format,
+          {{"address", Commands::RecordWriter::ADDRESS},
+           {"size", Commands::RecordWriter::COUNT},
+           {"used", Commands::RecordWriter::BOOLEAN},
+           {"signature", Commands::RecordWriter::ADDRESS},
+           {"name", Commands::RecordWriter::STRING},
+           {"contents", Commands::RecordWriter::BYTES}}));
+    }
+  }
   void Visit(AllocationIndex /* index */, const Allocation& allocation) {
+    if (_recordWriter) {
+      WriteRecord(allocation);
+      return;
+    }
     size_t size = allocation.Size();
-    _sizedTally.AdjustTally(size);
+    _sizedTally->AdjustTally(size);
     Commands::Output& output = _context.GetOutput();
 
     if (allocation.IsUsed()) {
@@ -89,13 +119,43 @@ class Shower {
     }
     output << "\n";
   }
+  void FinishVisits() {}
 
  private:
   Commands::Context& _context;
   const SignatureDirectory<Offset>& _signatureDirectory;
   const VirtualAddressMap<Offset>& _addressMap;
   const bool _showAscii;
-  SizedTally<Offset> _sizedTally;
+  std::unique_ptr<SizedTally<Offset> > _sizedTally;
+  std::unique_ptr<Commands::RecordWriter> _recordWriter;
+
+  void WriteRecord(const Allocation& allocation) {
+    Offset address = allocation.Address();
+    Offset size = allocation.Size();
+    _recordWriter->AddAddress(address);
+    _recordWriter->AddCount(size);
+    _recordWriter->AddBoolean(allocation.IsUsed());
+    const char* image;
+    Offset numBytesFound = _addressMap.FindMappedMemoryImage(address, &image);
+    if (numBytesFound < size) {
+      size = numBytesFound;
+    }
+    Offset signature = (size >= sizeof(Offset)) ? *((Offset*)image) : 0;
+    if (size >= sizeof(Offset) && _signatureDirectory.IsMapped(signature)) {
+      _recordWriter->AddAddress(signature);
+      const std::string& name = _signatureDirectory.Name(signature);
+      if (name.empty()) {
+        _recordWriter->AddMissing();
+      } else {
+        _recordWriter->AddString(name);
+      }
+    } else {
+      _recordWriter->AddMissing();
+      _recordWriter->AddMissing();
+    }
+    _recordWriter->AddBytes(image, size);
+    _recordWriter->EndRecord();
+  }
 };
 }  // namespace Visitors
 }  // namespace Allocations
@@ -1,10 +1,13 @@
-// Copyright (c) 2017,2020 Broadcom. All Rights Reserved.
+// Copyright (c) 2017,2020,2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
 #pragma once
+#include <algorithm>
+#include <vector>
 #include "../../Commands/Runner.h"
 #include "../../Commands/Subcommand.h"
+#include "../../Parallel.h"
 #include "../../SizedTally.h"
 #include "../Directory.h"
 #include "../SignatureSummary.h"
@@ -20,7 +23,12 @@ class Summarizer {
   typedef typename SignatureSummary<Offset>::Item SummaryItem;
   class Factory {
    public:
-    Factory() : _commandName("summarize") {}
+    /*
+     * At most the given number of threads is used to tally the visited
+     * allocations once they are all known.
+     */
+    Factory(size_t numThreads)
+        : _commandName("summarize"), _numThreads(numThreads) {}
     Summarizer* MakeVisitor(Commands::Context& context,
                             const ProcessImage<Offset>& processImage) {
       bool sortByCount = true;
@@ -43,9 +51,12 @@ class Summarizer {
       }
       return new Summarizer(context, processImage.GetSignatureDirectory(),
                             *(processImage.GetAllocationTagHolder()),
-                            processImage.GetVirtualAddressMap(), sortByCount);
+                            processImage.GetVirtualAddressMap(), sortByCount,
+                            _numThreads);
     }
     const std::string& GetCommandName() const { return _commandName; }
+    bool CanRunConcurrently() const { return true; }
+    bool SupportsRecordFormats() const { return false; }
     // TODO: allow adding taints
     const std::vector<std::string>& GetTaints() const { return _taints; }
     void ShowHelpMessage(Commands::Context& context) {
@@ -61,18 +72,32 @@ class Summarizer {
    private:
     const std::string _commandName;
     const std::vector<std::string> _taints;
+    const size_t _numThreads;
   };
 
   Summarizer(Commands::Context& context,
              const SignatureDirectory<Offset>& signatureDirectory,
              const TagHolder<Offset>& tagHolder,
-             const VirtualAddressMap<Offset>& addressMap, bool sortByCount)
+             const VirtualAddressMap<Offset>& addressMap, bool sortByCount,
+             size_t numThreads)
       : _context(context),
         _signatureSummary(signatureDirectory, tagHolder),
         _addressMap(addressMap),
         _sizedTally(context, "allocations"),
-        _sortByCount(sortByCount) {}
-  ~Summarizer() {
+        _sortByCount(sortByCount),
+        _numThreads(ThreadsAllowed(numThreads)) {}
+  void Visit(AllocationIndex index, const Allocation& allocation) {
+    const char* image;
+    Offset size = ImagedSize(allocation, &image);
+    _sizedTally.AdjustTally(size);
+    if (_numThreads > 1) {
+      _visited.push_back({index, size, image});
+    } else {
+      _signatureSummary.AdjustTally(index, size, image);
+    }
+  }
+  void FinishVisits() {
+    TallyVisited();
     std::vector<SummaryItem> items;
     if (_sortByCount) {
       _signatureSummary.SummarizeByCount(items);
@@ -81,25 +106,63 @@ class Summarizer {
     }
     DumpSummaryItems(items);
   }
-  void Visit(AllocationIndex index, const Allocation& allocation) {
-    size_t size = allocation.Size();
-    const char* image;
-    Offset numBytesFound =
-        _addressMap.FindMappedMemoryImage(allocation.Address(), &image);
-    if (numBytesFound < size) {
-      // This is not expected to happen on Linux.
-      size = numBytesFound;
-    }
-    _sizedTally.AdjustTally(size);
-    _signatureSummary.AdjustTally(index, size, image);
-  }
 
  private:
+  static constexpr size_t CHUNK_SIZE = 0x10000;
+  struct VisitedAllocation {
+    AllocationIndex _index;
+    Offset _size;
+    const char* _image;
+  };
   Commands::Context& _context;
   SignatureSummary<Offset> _signatureSummary;
   const VirtualAddressMap<Offset>& _addressMap;
   SizedTally<Offset> _sizedTally;
   bool _sortByCount;
+  const size_t _numThreads;
+  std::vector<VisitedAllocation> _visited;
+
+  Offset ImagedSize(const Allocation& allocation, const char** image) const {
+    Offset size = allocation.Size();
+    Offset numBytesFound =
+        _addressMap.FindMappedMemoryImage(allocation.Address(), image);
+    if (numBytesFound < size) {
+      // This is not expected to happen on Linux.
+      size = numBytesFound;
+    }
+    return size;
+  }
+
+  /*
+   * Tally the visited allocations a chunk at a time, with separate tallies
+   * for each worker, then add the tallies to the summary.
+   */
+  void TallyVisited() {
+    if (_visited.empty()) {
+      return;
+    }
+    size_t numChunks = (_visited.size() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    size_t numWorkers = std::min(_numThreads, numChunks);
+    std::vector<typename SignatureSummary<Offset>::Tallies> tallies(
+        numWorkers);
+    for (auto& workerTallies : tallies) {
+      _signatureSummary.ClearTallies(workerTallies);
+    }
+    RunInParallel(numWorkers, numChunks, [&](size_t worker, size_t chunk) {
+      typename SignatureSummary<Offset>::Tallies& workerTallies =
+          tallies[worker];
+      size_t limit = std::min((chunk + 1) * CHUNK_SIZE, _visited.size());
+      for (size_t i = chunk * CHUNK_SIZE; i < limit; i++) {
+        const VisitedAllocation& visited = _visited[i];
+        _signatureSummary.AdjustTally(workerTallies, visited._index,
+                                      visited._size, visited._image);
+      }
+    });
+    for (const auto& workerTallies : tallies) {
+      _signatureSummary.AddTallies(workerTallies);
+    }
+    std::vector<VisitedAllocation>().swap(_visited);
+  }
   static std::string InDecimalWithCommas(Offset n) {  // treat as positive
     if (n == 0) {
       return "0";
@@ -0,0 +1,318 @@
+// Copyright (c) 2024 Broadcom. All Rights Reserved.
+// The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
+// SPDX-License-Identifier: GPL-2.0
+
+#pragma once
+extern "C" {
+#include <stdio.h>
+#include <sys/stat.h>
+};
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "FileImage.h"
+
+/*
+ * Support for persisting the expensive results of analyzing a process image,
+ * such as the allocation graph and the allocation tags, in a file next to
+ * that process image so that subsequent runs of chap on the same process
+ * image can start much faster.
+ *
+ * The file is written in host byte order.  Each scalar value occupies 8 bytes
+ * and each array is padded to a multiple of 8 bytes, so that arrays in the
+ * mapped file are suitably aligned for direct access.
+ */
+
+namespace chap {
+class AnalysisCacheWriter {
+ public:
+  AnalysisCacheWriter(std::ostream& stream) : _stream(stream) {}
+
+  template <typename T>
+  void WriteValue(T value) {
+    uint64_t padded = 0;
+    memcpy(&padded, &value, sizeof(T));
+    _stream.write((const char*)(&padded), sizeof(padded));
+  }
+
+  template <typename T>
+  void WriteArray(const T* values, uint64_t numValues) {
+    WriteValue<uint64_t>(numValues);
+    size_t numBytes = numValues * sizeof(T);
+    if (numBytes != 0) {
+      _stream.write((const char*)(values), numBytes);
+    }
+    Pad(numBytes);
+  }
+
+  template <typename T, typename A>
+  void WriteVector(const std::vector<T, A>& values) {
+    WriteArray(values.data(), values.size());
+  }
+
+  void WriteBits(const std::vector<bool>& bits) {
+    size_t numBits = bits.size();
+    std::vector<uint64_t> words((numBits + 63) / 64, 0);
+    for (size_t i = 0; i < numBits; i++) {
+      if (bits[i]) {
+        words[i / 64] |= ((uint64_t)1) << (i % 64);
+      }
+    }
+    WriteValue<uint64_t>(numBits);
+    WriteVector(words);
+  }
+
+  void WriteString(const std::string& value) {
+    WriteArray(value.data(), value.size());
+  }
+
+  bool Ok() const { return _stream.good(); }
+
+ private:
+  std::ostream& _stream;
+  void Pad(size_t numBytes) {
+    static const char zeros[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    size_t remainder = numBytes & 7;
+    if (remainder != 0) {
+      _stream.write(zeros, 8 - remainder);
+    }
+  }
+};
+
+class AnalysisCacheReader {
+ public:
+  AnalysisCacheReader(const char* image, uint64_t size)
+      : _next(image), _limit(image + size), _failed(false) {}
+
+  template <typename T>
+  bool ReadValue(T& value) {
+    if (_failed || (_limit - _next) < 8) {
+      _failed = true;
+      return false;
+    }
+    memcpy(&value, _next, sizeof(T));
+    _next += 8;
+    return true;
+  }
+
+  /*
+   * Return a pointer to an array in the mapped cache, setting numValues to
+   * the number of values in the array, or return 0 on failure.
+   */
+  template <typename T>
+  const T* ReadArray(uint64_t& numValues) {
+    numValues = 0;
+    uint64_t numElements;
+    if (!ReadValue(numElements)) {
+      return (const T*)0;
+    }
+    uint64_t available = (_limit - _next);
+    if (numElements > available / sizeof(T)) {
+      _failed = true;
+      return (const T*)0;
+    }
+    const T* values = (const T*)(_next);
+    _next += (numElements * sizeof(T) + 7) & ~((uint64_t)7);
+    if (_next > _limit) {
+      _failed = true;
+      return (const T*)0;
+    }
+    numValues = numElements;
+    return values;
+  }
+
+  template <typename T, typename A>
+  bool ReadVector(std::vector<T, A>& values) {
+    uint64_t numValues;
+    const T* array = ReadArray<T>(numValues);
+    if (_failed) {
+      return false;
+    }
+    values.resize(numValues);
+    if (numValues != 0) {
+      memcpy(values.data(), array, numValues * sizeof(T));
+    }
+    return true;
+  }
+
+  bool ReadBits(std::vector<bool>& bits) {
+    uint64_t numBits;
+    uint64_t numWords;
+    if (!ReadValue(numBits)) {
+      return false;
+    }
+    const uint64_t* words = ReadArray<uint64_t>(numWords);
+    if (_failed || numWords != (numBits + 63) / 64) {
+      _failed = true;
+      return false;
+    }
+    bits.clear();
+    bits.resize(numBits, false);
+    for (size_t i = 0; i < numBits; i++) {
+      if ((words[i / 64] & (((uint64_t)1) << (i % 64))) != 0) {
+        bits[i] = true;
+      }
+    }
+    return true;
+  }
+
+  bool ReadString(std::string& value) {
+    uint64_t numChars;
+    const char* chars = ReadArray<char>(numChars);
+    if (_failed) {
+      return false;
+    }
+    value.assign(chars, numChars);
+    return true;
+  }
+
+  /*
+   * Mark the cache as unusable, for example because some value read from it
+   * is inconsistent with the process image.
+   */
+  bool Fail() {
+    _failed = true;
+    return false;
+  }
+
+  bool Ok() const { return !_failed; }
+
+ private:
+  const char* _next;
+  const char* _limit;
+  bool _failed;
+};
+
+template <typename Offset>
+class AnalysisCache {
+ public:
+  static constexpr uint64_t MAGIC = 0x4843414350414843ULL;  // "CHAPCACH"
+  /*
+   * The version must be changed any time the layout of the cache or the
+   * results of the analysis that are stored there change.
+   */
+  static constexpr uint64_t VERSION = 4;
+
+  /*
+   * Prepare to use the cache associated with the given process image, where
+   * the given headers are the part of that image used, along with the size
+   * and modification time, to recognize whether a cache is stale.  The cache
+   * is kept in a file with the path of the image plus ".chapcache", unless
+   * some other path is given.
+   */
+  AnalysisCache(const FileImage& processImage, const char* headers,
+                size_t headersSize)
+      : AnalysisCache(processImage, headers, headersSize,
+                      processImage.GetFileName() + ".chapcache") {}
+
+  AnalysisCache(const FileImage& processImage, const char* headers,
+                size_t headersSize, const std::string& path)
+      : _path(path),
+        _processImageSize(processImage.GetFileSize()),
+        _modificationSeconds(0),
+        _modificationNanoseconds(0),
+        _headersHash(0xcbf29ce484222325ULL) {
+    struct stat statBuf;
+    if (fstat(processImage._fd, &statBuf) == 0) {
+      _modificationSeconds = statBuf.st_mtim.tv_sec;
+      _modificationNanoseconds = statBuf.st_mtim.tv_nsec;
+    }
+    const unsigned char* next = (const unsigned char*)(headers);
+    const unsigned char* limit = next + headersSize;
+    for (; next < limit; ++next) {
+      _headersHash = (_headersHash ^ *next) * 0x100000001b3ULL;
+    }
+  }
+
+  const std::string& GetPath() const { return _path; }
+
+  /*
+   * Map the cache, returning a reader positioned just after the header or
+   * null if there is no cache or it does not match the process image.
+   */
+  AnalysisCacheReader* Open() {
+    try {
+      _cacheImage.reset(new FileImage(_path.c_str(), false));
+    } catch (...) {
+      return (AnalysisCacheReader*)0;
+    }
+    _reader.reset(new AnalysisCacheReader(_cacheImage->GetImage(),
+                                          _cacheImage->GetFileSize()));
+    uint64_t magic, version, offsetSize, processImageSize;
+    uint64_t modificationSeconds, modificationNanoseconds, headersHash;
+    if (!_reader->ReadValue(magic) || !_reader->ReadValue(version) ||
+        !_reader->ReadValue(offsetSize) ||
+        !_reader->ReadValue(processImageSize) ||
+        !_reader->ReadValue(modificationSeconds) ||
+        !_reader->ReadValue(modificationNanoseconds) ||
+        !_reader->ReadValue(headersHash) || magic != MAGIC ||
+        version != VERSION || offsetSize != sizeof(Offset) ||
+        processImageSize != _processImageSize ||
+        modificationSeconds != _modificationSeconds ||
+        modificationNanoseconds != _modificationNanoseconds ||
+        headersHash != _headersHash) {
+      std::cerr << "Ignoring stale analysis cache \"" << _path << "\".\n";
+      Close();
+      return (AnalysisCacheReader*)0;
+    }
+    return _reader.get();
+  }
+
+  /*
+   * Release the mapping of the cache.  Any data needed from the cache must
+   * have been copied out before this is called.
+   */
+  void Close() {
+    _reader.reset();
+    _cacheImage.reset();
+  }
+
+  /*
+   * Write a new cache, using the given function to write everything after
+   * the header.  The cache is written to a temporary file then renamed so
+   * that a partially written cache is never mistaken for a valid one.
+   */
+  bool Write(std::function<void(AnalysisCacheWriter&)> writeBody) {
+    Close();
+    std::string tempPath(_path);
+    tempPath.append(".tmp");
+    std::ofstream stream(tempPath.c_str(), std::ios::out | std::ios::binary |
+                                               std::ios::trunc);
+    if (stream.fail()) {
+      std::cerr << "Warning: cannot create analysis cache \"" << _path
+                << "\".\n";
+      return false;
+    }
+    AnalysisCacheWriter writer(stream);
+    writer.WriteValue<uint64_t>(MAGIC);
+    writer.WriteValue<uint64_t>(VERSION);
+    writer.WriteValue<uint64_t>(sizeof(Offset));
+    writer.WriteValue<uint64_t>(_processImageSize);
+    writer.WriteValue<uint64_t>(_modificationSeconds);
+    writer.WriteValue<uint64_t>(_modificationNanoseconds);
+    writer.WriteValue<uint64_t>(_headersHash);
+    writeBody(writer);
+    stream.close();
+    if (stream.fail() || rename(tempPath.c_str(), _path.c_str()) != 0) {
+      std::cerr << "Warning: failed to write analysis cache \"" << _path
+                << "\".\n";
+      (void)unlink(tempPath.c_str());
+      return false;
+    }
+    return true;
+  }
+
+ private:
+  const std::string _path;
+  const uint64_t _processImageSize;
+  uint64_t _modificationSeconds;
+  uint64_t _modificationNanoseconds;
+  uint64_t _headersHash;
+  std::unique_ptr<FileImage> _cacheImage;
+  std::unique_ptr<AnalysisCacheReader> _reader;
+};
+}  // namespace chap
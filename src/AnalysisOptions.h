@@ -0,0 +1,62 @@
+// Copyright (c) 2024 Broadcom. All Rights Reserved.
+// The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
+// SPDX-License-Identifier: GPL-2.0
+
+#pragma once
+#include <cstddef>
+
+namespace chap {
+/*
+ * This holds the choices, normally made on the command line, that affect
+ * how a file is analyzed, as opposed to what is done with the results.
+ */
+struct AnalysisOptions {
+  AnalysisOptions()
+      : truncationCheckOnly(false),
+        useAnalysisCache(false),
+        numThreads(0),
+        lowMemory(false),
+        verbose(false),
+        omittedPagesAreZero(false) {}
+
+  /*
+   * Only check whether the file is truncated, skipping the rest of the
+   * analysis.
+   */
+  bool truncationCheckOnly;
+
+  /*
+   * Load the results of the expensive part of the analysis from a cache
+   * file next to the process image if one is present and still valid,
+   * otherwise create or refresh that cache file.
+   */
+  bool useAnalysisCache;
+
+  /*
+   * The maximum number of threads to use for analysis steps that can be
+   * split across threads, where 0 means one per available processor and 1
+   * forces every such step to be done serially.
+   */
+  size_t numThreads;
+
+  /*
+   * Favor using less memory over speed, for example by not building
+   * optional indexes, by releasing the pages of the core as it is scanned
+   * for references and by keeping the edges of the graph in temporary files.
+   */
+  bool lowMemory;
+
+  /*
+   * Report on standard error how long the various parts of the analysis
+   * take.
+   */
+  bool verbose;
+
+  /*
+   * Treat the part of any writable region of a core that is beyond the part
+   * stored in the core as known to contain only zeros, rather than as
+   * missing, for cores written by tools that omit trailing zero pages.
+   */
+  bool omittedPagesAreZero;
+};
+}  // namespace chap
@@ -0,0 +1,626 @@
+// Copyright (c) 2024 Broadcom. All Rights Reserved.
+// The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
+// SPDX-License-Identifier: GPL-2.0
+
+#pragma once
+extern "C" {
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <zlib.h>
+};
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Parallel.h"
+
+/*
+ * Support for reading a file, typically a core, from a block compressed copy
+ * of that file, without ever decompressing the whole copy.
+ *
+ * A block compressed copy starts with a header, followed by the blocks of
+ * the original file, each compressed separately with zlib, followed by a
+ * table of the offsets in the copy of the compressed blocks, with one extra
+ * entry for the offset just past the last block.  All blocks but the last
+ * have the size given in the header.  The copy is written in host byte
+ * order.
+ *
+ * So that the rest of chap can keep using plain pointers into the image,
+ * the image is reserved as inaccessible memory, and each block is
+ * decompressed by a SIGSEGV handler the first time it is touched.
+ * Only a limited number of blocks are kept decompressed, beyond which the
+ * block decompressed longest ago is discarded, to be decompressed again if
+ * it is touched again.
+ *
+ * An image with a zero tail, as made by ImageWithZeroTail, is handled the
+ * same way.  The part of it taken from the image is divided into blocks
+ * that are numbered after those of the image, and are filled in on demand
+ * and count against the same limit.
+ */
+
+namespace chap {
+class BlockCompressedImage {
+ public:
+  static constexpr uint64_t MAGIC = 0x4b4c425a50414843ULL;  // "CHAPZBLK"
+  static constexpr uint32_t VERSION = 1;
+  static constexpr uint32_t DEFAULT_BLOCK_SIZE = 0x40000;
+  static constexpr uint64_t DEFAULT_CACHE_SIZE = 0x40000000;
+
+  /*
+   * Return true if the given open file starts like a block compressed copy.
+   */
+  static bool IsBlockCompressed(int fd) {
+    uint64_t magic;
+    return ReadFully(fd, (char*)(&magic), sizeof(magic), 0) && magic == MAGIC;
+  }
+
+  /*
+   * Prepare to read the block compressed copy open with the given file
+   * descriptor, which must stay open until the image is destroyed, keeping
+   * up to about cacheSize bytes of the image decompressed at once.  Any
+   * failure is reported on standard error if so requested, and results in
+   * an exception.
+   */
+  BlockCompressedImage(int fd, uint64_t fileSize, uint64_t cacheSize,
+                       bool verboseOnFailure)
+      : _fd(fd),
+        _image((char*)(MAP_FAILED)),
+        _imageSize(0),
+        _blockSize(0),
+        _numBlocks(0),
+        _arenaUsed(0),
+        _maxResident(0),
+        _numResident(0),
+        _oldestResident(0),
+        _slot(MAX_IMAGES) {
+    Header header;
+    if (!ReadFully(fd, (char*)(&header), sizeof(header), 0) ||
+        header._magic != MAGIC) {
+      Reject("is not block compressed", verboseOnFailure);
+    }
+    if (header._version != VERSION) {
+      Reject("has an unsupported block compression version",
+             verboseOnFailure);
+    }
+    uint64_t pageSize = (uint64_t)(sysconf(_SC_PAGESIZE));
+    _blockSize = header._blockSize;
+    _imageSize = header._imageSize;
+    _numBlocks = header._numBlocks;
+    if (_blockSize == 0 || (_blockSize % pageSize) != 0 || _imageSize == 0 ||
+        _numBlocks != (_imageSize + _blockSize - 1) / _blockSize ||
+        header._tableOffset < sizeof(header) ||
+        header._tableOffset > fileSize ||
+        (fileSize - header._tableOffset) / sizeof(uint64_t) <= _numBlocks) {
+      Reject("has an invalid block compression header", verboseOnFailure);
+    }
+    _blockStarts.resize(_numBlocks + 1);
+    if (!ReadFully(fd, (char*)(_blockStarts.data()),
+                   (_numBlocks + 1) * sizeof(uint64_t),
+                   header._tableOffset)) {
+      Reject("has an unreadable block table", verboseOnFailure);
+    }
+    uint64_t maxCompressedSize = 0;
+    uint64_t blockLimit = compressBound(_blockSize);
+    for (uint64_t block = 0; block < _numBlocks; block++) {
+      uint64_t start = _blockStarts[block];
+      uint64_t limit = _blockStarts[block + 1];
+      if (start < sizeof(header) || limit < start ||
+          limit > header._tableOffset || limit - start > blockLimit) {
+        Reject("has an invalid block table", verboseOnFailure);
+      }
+      if (maxCompressedSize < limit - start) {
+        maxCompressedSize = limit - start;
+      }
+    }
+    _compressed.resize(maxCompressedSize);
+
+    /*
+     * Always keep enough blocks that every thread can be touching two
+     * blocks at once, as when a read straddles a block boundary.
+     */
+    _residentLimit = cacheSize / _blockSize;
+    uint64_t minResident = 2 * NumWorkerThreads(0) + 2;
+    if (_residentLimit < minResident) {
+      _residentLimit = minResident;
+    }
+    _isResident.resize(_numBlocks, false);
+    AdjustMaxResident();
+
+    _stream.zalloc = AllocateFromArena;
+    _stream.zfree = FreeToArena;
+    _stream.opaque = this;
+    _stream.next_in = Z_NULL;
+    _stream.avail_in = 0;
+    if (inflateInit(&_stream) != Z_OK) {
+      Reject("cannot be decompressed", verboseOnFailure);
+    }
+
+    _image = (char*)(mmap(nullptr, _imageSize, PROT_NONE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1,
+                          0));
+    if (_image == (char*)(MAP_FAILED)) {
+      (void)inflateEnd(&_stream);
+      Reject("cannot be given an address range", verboseOnFailure);
+    }
+    if (!Register()) {
+      (void)munmap(_image, _imageSize);
+      (void)inflateEnd(&_stream);
+      Reject("cannot be opened with so many other compressed files open",
+             verboseOnFailure);
+    }
+  }
+
+  ~BlockCompressedImage() {
+    _registered[_slot].store(nullptr);
+    for (const ZeroTailImage& zeroTailImage : _zeroTailImages) {
+      (void)munmap(zeroTailImage._image, zeroTailImage._size);
+    }
+    (void)munmap(_image, _imageSize);
+    (void)inflateEnd(&_stream);
+  }
+
+  const char* GetImage() const { return _image; }
+  uint64_t GetImageSize() const { return _imageSize; }
+
+  /*
+   * Return a new image of the given size, lasting as long as this one, that
+   * starts with sizeInFile bytes at the given offset in this image and is
+   * all zeros after that, or null if no such image can be made.  The zeros
+   * use no memory beyond page tables.  All such images must be made before
+   * the image is read by more than one thread.
+   */
+  const char* ImageWithZeroTail(uint64_t offset, uint64_t sizeInFile,
+                                uint64_t size) {
+    if (size == 0 || sizeInFile > size || offset > _imageSize ||
+        sizeInFile > _imageSize - offset) {
+      return nullptr;
+    }
+    uint64_t pageSize = (uint64_t)(sysconf(_SC_PAGESIZE));
+    uint64_t filledSize = (sizeInFile + pageSize - 1) & ~(pageSize - 1);
+    if (filledSize > size) {
+      filledSize = size;
+    }
+    char* image = (char*)(mmap(nullptr, size, PROT_NONE,
+                               MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                               -1, 0));
+    if (image == (char*)(MAP_FAILED)) {
+      return nullptr;
+    }
+    if (filledSize < size &&
+        mprotect(image + filledSize, size - filledSize, PROT_READ) != 0) {
+      (void)munmap(image, size);
+      return nullptr;
+    }
+    std::lock_guard<std::mutex> guard(_mutex);
+    if (_scratch.empty()) {
+      _scratch.resize(_blockSize);
+    }
+    uint64_t firstBlock = _isResident.size();
+    _zeroTailImages.push_back(
+        {image, size, offset, sizeInFile, filledSize, firstBlock});
+    _isResident.resize(firstBlock + (filledSize + _blockSize - 1) / _blockSize,
+                       false);
+    AdjustMaxResident();
+    return image;
+  }
+
+  /*
+   * Discard all the decompressed blocks.  Any block that is touched again
+   * will be decompressed again.
+   */
+  void DiscardAll() {
+    std::lock_guard<std::mutex> guard(_mutex);
+    while (_numResident > 0) {
+      DiscardOldest();
+    }
+  }
+
+  /*
+   * Write a block compressed copy of the given image to the given path,
+   * compressing up to numThreads blocks at a time.  The copy is written to
+   * a temporary file then renamed, so that a partial copy is never left at
+   * the given path.  Any failure is reported on standard error.
+   */
+  static bool Write(const char* image, uint64_t imageSize,
+                    const std::string& path, size_t numThreads) {
+    std::string tempPath(path);
+    tempPath.append(".tmp");
+    std::ofstream stream(tempPath.c_str(), std::ios::out | std::ios::binary |
+                                               std::ios::trunc);
+    if (stream.fail()) {
+      std::cerr << "Cannot create \"" << tempPath << "\".\n";
+      return false;
+    }
+    Header header;
+    header._magic = MAGIC;
+    header._version = VERSION;
+    header._blockSize = DEFAULT_BLOCK_SIZE;
+    header._imageSize = imageSize;
+    header._numBlocks =
+        (imageSize + DEFAULT_BLOCK_SIZE - 1) / DEFAULT_BLOCK_SIZE;
+    header._tableOffset = 0;
+    stream.write((const char*)(&header), sizeof(header));
+
+    /*
+     * The blocks are compressed a batch at a time, where each batch has
+     * enough blocks to keep all the threads busy, and written in order.
+     */
+    std::vector<uint64_t> blockStarts;
+    blockStarts.reserve(header._numBlocks + 1);
+    uint64_t nextStart = sizeof(header);
+    size_t blocksPerBatch = numThreads * 4;
+    std::vector<std::vector<Bytef> > compressedBlocks(blocksPerBatch);
+    std::vector<uLongf> compressedSizes(blocksPerBatch);
+    std::atomic<bool> compressionFailed(false);
+    for (uint64_t firstBlock = 0; firstBlock < header._numBlocks;
+         firstBlock += blocksPerBatch) {
+      size_t numBlocks = blocksPerBatch;
+      if (numBlocks > header._numBlocks - firstBlock) {
+        numBlocks = header._numBlocks - firstBlock;
+      }
+      RunInParallel(numThreads, numBlocks, [&](size_t, size_t i) {
+        uint64_t blockOffset = (firstBlock + i) * DEFAULT_BLOCK_SIZE;
+        uint64_t blockSize = imageSize - blockOffset;
+        if (blockSize > DEFAULT_BLOCK_SIZE) {
+          blockSize = DEFAULT_BLOCK_SIZE;
+        }
+        std::vector<Bytef>& compressed = compressedBlocks[i];
+        compressed.resize(compressBound(DEFAULT_BLOCK_SIZE));
+        compressedSizes[i] = compressed.size();
+        if (compress2(compressed.data(), &compressedSizes[i],
+                      (const Bytef*)(image + blockOffset), blockSize,
+                      Z_DEFAULT_COMPRESSION) != Z_OK) {
+          compressionFailed.store(true);
+        }
+      });
+      if (compressionFailed.load()) {
+        break;
+      }
+      for (size_t i = 0; i < numBlocks; i++) {
+        blockStarts.push_back(nextStart);
+        stream.write((const char*)(compressedBlocks[i].data()),
+                     compressedSizes[i]);
+        nextStart += compressedSizes[i];
+      }
+    }
+    blockStarts.push_back(nextStart);
+    header._tableOffset = nextStart;
+    stream.write((const char*)(blockStarts.data()),
+                 blockStarts.size() * sizeof(uint64_t));
+    stream.seekp(0);
+    stream.write((const char*)(&header), sizeof(header));
+    stream.close();
+    if (compressionFailed.load() || stream.fail() ||
+        rename(tempPath.c_str(), path.c_str()) != 0) {
+      std::cerr << "Failed to write \"" << path << "\".\n";
+      (void)unlink(tempPath.c_str());
+      return false;
+    }
+    return true;
+  }
+
+ private:
+  struct Header {
+    uint64_t _magic;
+    uint32_t _version;
+    uint32_t _blockSize;
+    uint64_t _imageSize;
+    uint64_t _numBlocks;
+    uint64_t _tableOffset;
+  };
+
+  /*
+   * This is enough for the state and window that zlib allocates once when
+   * a stream is first used for decompression.
+   */
+  static constexpr size_t ARENA_SIZE = 0x10000;
+  static constexpr size_t MAX_IMAGES = 16;
+
+  static inline std::atomic<BlockCompressedImage*> _registered[MAX_IMAGES];
+  static inline std::mutex _registrationMutex;
+  static inline bool _handlerInstalled = false;
+  static inline struct sigaction _previousAction;
+
+  int _fd;
+  char* _image;
+  uint64_t _imageSize;
+  uint64_t _blockSize;
+  uint64_t _numBlocks;
+  std::vector<uint64_t> _blockStarts;
+  struct ZeroTailImage {
+    char* _image;
+    uint64_t _size;
+    uint64_t _offset;
+    uint64_t _sizeInFile;
+    uint64_t _filledSize;  // rounded up to a page, and filled on demand
+    uint64_t _firstBlock;
+  };
+  std::vector<ZeroTailImage> _zeroTailImages;
+  std::vector<char> _scratch;
+  std::vector<char> _compressed;
+  z_stream _stream;
+  alignas(16) char _arena[ARENA_SIZE];
+  size_t _arenaUsed;
+  std::mutex _mutex;
+  std::vector<bool> _isResident;
+  std::vector<uint64_t> _residentBlocks;
+  uint64_t _residentLimit;
+  uint64_t _maxResident;
+  uint64_t _numResident;
+  uint64_t _oldestResident;
+  size_t _slot;
+
+  static bool ReadFully(int fd, char* buffer, uint64_t numBytes,
+                        uint64_t offset) {
+    while (numBytes > 0) {
+      ssize_t numRead = pread(fd, buffer, numBytes, (off_t)(offset));
+      if (numRead <= 0) {
+        return false;
+      }
+      buffer += numRead;
+      numBytes -= numRead;
+      offset += numRead;
+    }
+    return true;
+  }
+
+  static void Reject(const char* problem, bool verboseOnFailure) {
+    if (verboseOnFailure) {
+      std::cerr << "The compressed file " << problem << ".\n";
+    }
+    throw "invalid compressed file";
+  }
+
+  /*
+   * The arena is used, rather than malloc, for anything zlib allocates,
+   * because blocks are decompressed from a signal handler.  Nothing
+   * allocated from the arena is freed before the stream is ended.
+   */
+  static voidpf AllocateFromArena(voidpf opaque, uInt items, uInt size) {
+    BlockCompressedImage* image = (BlockCompressedImage*)(opaque);
+    size_t numBytes = (((size_t)(items) * size) + 15) & ~((size_t)(15));
+    if (numBytes > ARENA_SIZE - image->_arenaUsed) {
+      return Z_NULL;
+    }
+    voidpf allocated = image->_arena + image->_arenaUsed;
+    image->_arenaUsed += numBytes;
+    return allocated;
+  }
+  static void FreeToArena(voidpf, voidpf) {}
+
+  bool Register() {
+    std::lock_guard<std::mutex> guard(_registrationMutex);
+    for (size_t slot = 0; slot < MAX_IMAGES; slot++) {
+      if (_registered[slot].load() == nullptr) {
+        if (!_handlerInstalled) {
+          struct sigaction action;
+          memset(&action, 0, sizeof(action));
+          action.sa_sigaction = HandleFault;
+          action.sa_flags = SA_SIGINFO;
+          sigemptyset(&action.sa_mask);
+          if (sigaction(SIGSEGV, &action, &_previousAction) != 0) {
+            return false;
+          }
+          _handlerInstalled = true;
+        }
+        _slot = slot;
+        _registered[slot].store(this);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  static void HandleFault(int, siginfo_t* info, void*) {
+    const char* address = (const char*)(info->si_addr);
+    for (size_t slot = 0; slot < MAX_IMAGES; slot++) {
+      BlockCompressedImage* image = _registered[slot].load();
+      uint64_t block;
+      if (image != nullptr && image->FindBlock(address, block)) {
+        image->MakeResident(block);
+        return;
+      }
+    }
+    /*
+     * The fault has nothing to do with any compressed image, so restore
+     * the previous handling, which applies when the faulting instruction
+     * is retried.
+     */
+    (void)sigaction(SIGSEGV, &_previousAction, nullptr);
+  }
+
+  /*
+   * Find the block, of the image or of an image with a zero tail, that
+   * contains the given address, returning false if there is none.
+   */
+  bool FindBlock(const char* address, uint64_t& block) const {
+    if (address >= _image && address < _image + _imageSize) {
+      block = (address - _image) / _blockSize;
+      return true;
+    }
+    for (const ZeroTailImage& zeroTailImage : _zeroTailImages) {
+      if (address >= zeroTailImage._image &&
+          address < zeroTailImage._image + zeroTailImage._filledSize) {
+        block = zeroTailImage._firstBlock +
+                (address - zeroTailImage._image) / _blockSize;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  const ZeroTailImage& ZeroTailImageOf(uint64_t block) const {
+    size_t i = _zeroTailImages.size() - 1;
+    while (block < _zeroTailImages[i]._firstBlock) {
+      i--;
+    }
+    return _zeroTailImages[i];
+  }
+
+  /*
+   * Find where the given block lives and how large it is.
+   */
+  void LocateBlock(uint64_t block, char*& blockImage,
+                   uint64_t& blockSize) const {
+    if (block < _numBlocks) {
+      blockImage = _image + block * _blockSize;
+      blockSize = BlockSize(block);
+      return;
+    }
+    const ZeroTailImage& zeroTailImage = ZeroTailImageOf(block);
+    uint64_t start = (block - zeroTailImage._firstBlock) * _blockSize;
+    blockImage = zeroTailImage._image + start;
+    blockSize = zeroTailImage._filledSize - start;
+    if (blockSize > _blockSize) {
+      blockSize = _blockSize;
+    }
+  }
+
+  /*
+   * Allow as many blocks to be resident as the cache size allows, but no
+   * more than there are blocks.
+   */
+  void AdjustMaxResident() {
+    uint64_t maxResident = _isResident.size();
+    if (maxResident > _residentLimit) {
+      maxResident = _residentLimit;
+    }
+    if (maxResident == _maxResident) {
+      return;
+    }
+    std::vector<uint64_t> residentBlocks(maxResident);
+    for (uint64_t i = 0; i < _numResident; i++) {
+      uint64_t j = _oldestResident + i;
+      if (j >= _maxResident) {
+        j -= _maxResident;
+      }
+      residentBlocks[i] = _residentBlocks[j];
+    }
+    _residentBlocks.swap(residentBlocks);
+    _oldestResident = 0;
+    _maxResident = maxResident;
+  }
+
+  /*
+   * Decompress the given block, unless another thread already did so.  The
+   * block is decompressed into separate memory that is then moved into
+   * place, because other threads may touch the block at any time and must
+   * either fault or see the whole block.
+   */
+  void MakeResident(uint64_t block) {
+    std::lock_guard<std::mutex> guard(_mutex);
+    if (_isResident[block]) {
+      return;
+    }
+    if (_numResident == _maxResident) {
+      DiscardOldest();
+    }
+    char* blockImage;
+    uint64_t blockSize;
+    LocateBlock(block, blockImage, blockSize);
+    char* filled = (char*)(mmap(nullptr, blockSize, PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (filled == (char*)(MAP_FAILED) || !Fill(block, filled, blockSize) ||
+        mprotect(filled, blockSize, PROT_READ) != 0 ||
+        mremap(filled, blockSize, blockSize, MREMAP_MAYMOVE | MREMAP_FIXED,
+               blockImage) == MAP_FAILED) {
+      static const char message[] =
+          "Failed to decompress a block of the compressed file.\n";
+      (void)write(2, message, sizeof(message) - 1);
+      abort();
+    }
+    _isResident[block] = true;
+    uint64_t newest = _oldestResident + _numResident;
+    if (newest >= _maxResident) {
+      newest -= _maxResident;
+    }
+    _residentBlocks[newest] = block;
+    _numResident++;
+  }
+
+  void DiscardOldest() {
+    uint64_t block = _residentBlocks[_oldestResident];
+    char* blockImage;
+    uint64_t blockSize;
+    LocateBlock(block, blockImage, blockSize);
+    (void)mmap(blockImage, blockSize, PROT_NONE,
+               MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+    _isResident[block] = false;
+    if (++_oldestResident == _maxResident) {
+      _oldestResident = 0;
+    }
+    _numResident--;
+  }
+
+  uint64_t BlockSize(uint64_t block) const {
+    uint64_t blockOffset = block * _blockSize;
+    return (_imageSize - blockOffset < _blockSize) ? (_imageSize - blockOffset)
+                                                   : _blockSize;
+  }
+
+  /*
+   * Fill the given block into the given memory, which has room for the given
+   * number of bytes and is initially all zeros.  A block of an image with a
+   * zero tail is copied from the corresponding blocks of the image, taken
+   * from where they are resident or else decompressed just for this.
+   */
+  bool Fill(uint64_t block, char* filled, uint64_t size) {
+    if (block < _numBlocks) {
+      return Decompress(block, filled, size);
+    }
+    const ZeroTailImage& zeroTailImage = ZeroTailImageOf(block);
+    uint64_t start = (block - zeroTailImage._firstBlock) * _blockSize;
+    uint64_t numToCopy = zeroTailImage._sizeInFile - start;
+    if (numToCopy > size) {
+      numToCopy = size;
+    }
+    uint64_t offset = zeroTailImage._offset + start;
+    while (numToCopy > 0) {
+      uint64_t sourceBlock = offset / _blockSize;
+      uint64_t sourceSize = BlockSize(sourceBlock);
+      uint64_t offsetInSource = offset - sourceBlock * _blockSize;
+      uint64_t numFromSource = sourceSize - offsetInSource;
+      if (numFromSource > numToCopy) {
+        numFromSource = numToCopy;
+      }
+      if (_isResident[sourceBlock]) {
+        memcpy(filled, _image + offset, numFromSource);
+      } else {
+        if (!Decompress(sourceBlock, _scratch.data(), sourceSize)) {
+          return false;
+        }
+        memcpy(filled, _scratch.data() + offsetInSource, numFromSource);
+      }
+      filled += numFromSource;
+      offset += numFromSource;
+      numToCopy -= numFromSource;
+    }
+    return true;
+  }
+
+  /*
+   * Decompress the given block into the given memory, which has room for
+   * the given number of bytes.
+   */
+  bool Decompress(uint64_t block, char* blockImage, uint64_t blockSize) {
+    uint64_t start = _blockStarts[block];
+    uint64_t compressedSize = _blockStarts[block + 1] - start;
+    if (!ReadFully(_fd, _compressed.data(), compressedSize, start) ||
+        inflateReset(&_stream) != Z_OK) {
+      return false;
+    }
+    _stream.next_in = (Bytef*)(_compressed.data());
+    _stream.avail_in = compressedSize;
+    _stream.next_out = (Bytef*)(blockImage);
+    _stream.avail_out = blockSize;
+    return inflate(&_stream, Z_FINISH) == Z_STREAM_END &&
+           _stream.avail_out == 0;
+  }
+};
+}  // namespace chap
@@ -1,4 +1,4 @@
-// Copyright (c) 2019-2023 Broadcom. All Rights Reserved.
+// Copyright (c) 2019-2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
@@ -17,6 +17,7 @@ template <typename Offset>
 class COWStringAllocationsTagger : public Allocations::Tagger<Offset> {
  public:
   typedef typename Allocations::Graph<Offset> Graph;
+  typedef typename Graph::Anchors Anchors;
   typedef typename Graph::EdgeIndex EdgeIndex;
   typedef typename Allocations::Directory<Offset> Directory;
   typedef typename Allocations::Tagger<Offset> Tagger;
@@ -32,7 +33,8 @@ class COWStringAllocationsTagger : public Allocations::Tagger<Offset> {
                              EdgePredicate& edgeIsTainted,
                              EdgePredicate& edgeIsFavored,
                              const ModuleDirectory<Offset>& moduleDirectory)
-      : _graph(graph),
+      : Allocations::Tagger<Offset>("COWString"),
+        _graph(graph),
         _tagHolder(tagHolder),
         _edgeIsTainted(edgeIsTainted),
         _edgeIsFavored(edgeIsFavored),
@@ -279,11 +281,11 @@ class COWStringAllocationsTagger : public Allocations::Tagger<Offset> {
   bool TallyAnchorVotes(AllocationIndex bodyIndex,
                         const Allocation& bodyAllocation,
 
-                        const std::vector<Offset>* anchors,
+                        const Anchors& anchors,
                         Reader& anchorReader) {
     Offset charsAddress = bodyAllocation.Address() + (3 * sizeof(Offset));
-    if (anchors != nullptr) {
-      for (Offset anchor : *anchors) {
+    if (!anchors.empty()) {
+      for (Offset anchor : anchors) {
         if (anchorReader.ReadOffset(anchor, 0xbad) == charsAddress) {
           if (--(_votesNeeded[bodyIndex]) == 0) {
             _tagHolder.TagAllocation(bodyIndex, _tagIndex);
@@ -1,4 +1,4 @@
-// Copyright (c) 2019-2022 Broadcom. All Rights Reserved.
+// Copyright (c) 2019-2022,2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
@@ -16,6 +16,7 @@ template <typename Offset>
 class DequeAllocationsTagger : public Allocations::Tagger<Offset> {
  public:
   typedef typename Allocations::Graph<Offset> Graph;
+  typedef typename Graph::Anchors Anchors;
   typedef typename Allocations::Directory<Offset> Directory;
   typedef typename Allocations::Tagger<Offset> Tagger;
   typedef typename Allocations::ContiguousImage<Offset> ContiguousImage;
@@ -30,7 +31,8 @@ class DequeAllocationsTagger : public Allocations::Tagger<Offset> {
   DequeAllocationsTagger(Graph& graph, TagHolder& tagHolder,
                          EdgePredicate& edgeIsTainted,
                          EdgePredicate& edgeIsFavored)
-      : _graph(graph),
+      : Allocations::Tagger<Offset>("Deque"),
+        _graph(graph),
         _tagHolder(tagHolder),
         _edgeIsTainted(edgeIsTainted),
         _edgeIsFavored(edgeIsFavored),
@@ -130,11 +132,11 @@ class DequeAllocationsTagger : public Allocations::Tagger<Offset> {
 
   bool CheckDequeMapAnchorIn(Reader& reader, AllocationIndex index,
                              const Allocation& allocation,
-                             const std::vector<Offset>* anchors) {
+                             const Anchors& anchors) {
     Offset address = allocation.Address();
-    if (anchors != nullptr) {
+    if (!anchors.empty()) {
       typename VirtualAddressMap<Offset>::Reader dequeReader(_addressMap);
-      for (Offset anchor : *anchors) {
+      for (Offset anchor : anchors) {
         if (_anchorIterator == _endIterator ||
             anchor < _anchorIterator.Base() ||
             anchor + sizeof(Offset) > _anchorIterator.Limit()) {
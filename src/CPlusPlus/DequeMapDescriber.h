@@ -1,4 +1,4 @@
-// Copyright (c) 2019-2022 Broadcom. All Rights Reserved.
+// Copyright (c) 2019-2022,2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
@@ -16,6 +16,7 @@ class DequeMapDescriber : public Allocations::PatternDescriber<Offset> {
       typename Allocations::Directory<Offset>::AllocationIndex AllocationIndex;
   typedef typename Allocations::PatternDescriber<Offset> Base;
   typedef typename Allocations::Directory<Offset>::Allocation Allocation;
+  typedef typename Allocations::Graph<Offset>::Anchors Anchors;
   DequeMapDescriber(const ProcessImage<Offset>& processImage)
       : Allocations::PatternDescriber<Offset>(processImage, "DequeMap") {}
 
@@ -32,9 +33,9 @@ class DequeMapDescriber : public Allocations::PatternDescriber<Offset> {
     Offset allocationAddress = allocation.Address();
     Offset allocationLimit = allocationAddress + allocationSize;
     FindDeques(InStaticMemory, allocationAddress, allocationLimit,
-               Base::_graph->GetStaticAnchors(index), deques);
+               Base::GetGraph().GetStaticAnchors(index), deques);
     FindDeques(OnStack, allocationAddress, allocationLimit,
-               Base::_graph->GetStackAnchors(index), deques);
+               Base::GetGraph().GetStackAnchors(index), deques);
     FindDeques(allocationAddress, allocationLimit, index, deques);
     if (deques.size() == 1) {
       const DequeInfo& dequeInfo = deques[0];
@@ -151,11 +152,11 @@ class DequeMapDescriber : public Allocations::PatternDescriber<Offset> {
   }
 
   void FindDeques(LocationType locationType, Offset mapAddress, Offset mapLimit,
-                  const std::vector<Offset>* anchors,
+                  const Anchors& anchors,
                   std::vector<DequeInfo>& deques) const {
-    if (anchors != nullptr) {
+    if (!anchors.empty()) {
       typename VirtualAddressMap<Offset>::Reader reader(Base::_addressMap);
-      for (Offset anchor : *anchors) {
+      for (Offset anchor : anchors) {
         const char* image;
         Offset numBytesFound =
             Base::_addressMap.FindMappedMemoryImage(anchor, &image);
@@ -175,7 +176,7 @@ class DequeMapDescriber : public Allocations::PatternDescriber<Offset> {
                   std::vector<DequeInfo>& deques) const {
     const AllocationIndex* pFirstIncoming;
     const AllocationIndex* pPastIncoming;
-    Base::_graph->GetIncoming(index, &pFirstIncoming, &pPastIncoming);
+    Base::GetGraph().GetIncoming(index, &pFirstIncoming, &pPastIncoming);
 
     for (const AllocationIndex* pNextIncoming = pFirstIncoming;
          pNextIncoming < pPastIncoming; pNextIncoming++) {
@@ -16,6 +16,7 @@ template <typename Offset>
 class ListAllocationsTagger : public Allocations::Tagger<Offset> {
  public:
   typedef typename Allocations::Graph<Offset> Graph;
+  typedef typename Graph::Anchors Anchors;
   typedef typename Allocations::Directory<Offset> Directory;
   typedef typename Allocations::Tagger<Offset> Tagger;
   typedef typename Allocations::ContiguousImage<Offset> ContiguousImage;
@@ -29,7 +30,8 @@ class ListAllocationsTagger : public Allocations::Tagger<Offset> {
   ListAllocationsTagger(Graph& graph, TagHolder& tagHolder,
                         EdgePredicate& edgeIsTainted,
                         EdgePredicate& edgeIsFavored)
-      : _graph(graph),
+      : Allocations::Tagger<Offset>("List"),
+        _graph(graph),
         _tagHolder(tagHolder),
         _edgeIsTainted(edgeIsTainted),
         _edgeIsFavored(edgeIsFavored),
@@ -345,10 +347,10 @@ class ListAllocationsTagger : public Allocations::Tagger<Offset> {
     return listHead;
   }
 
-  bool HasAnchorToStart(const std::vector<Offset>* anchors, Offset node,
+  bool HasAnchorToStart(const Anchors& anchors, Offset node,
                         Reader& refReader) {
-    if (anchors != nullptr) {
-      for (auto anchor : (*anchors)) {
+    if (!anchors.empty()) {
+      for (auto anchor : anchors) {
         if (refReader.ReadOffset(anchor, 0xbad) == node) {
           return true;
         }
@@ -17,6 +17,7 @@ template <typename Offset>
 class LongStringAllocationsTagger : public Allocations::Tagger<Offset> {
  public:
   typedef typename Allocations::Graph<Offset> Graph;
+  typedef typename Graph::Anchors Anchors;
   typedef typename Allocations::Directory<Offset> Directory;
   typedef typename Allocations::Tagger<Offset> Tagger;
   typedef typename Allocations::ContiguousImage<Offset> ContiguousImage;
@@ -34,7 +35,8 @@ class LongStringAllocationsTagger : public Allocations::Tagger<Offset> {
       const ModuleDirectory<Offset>& moduleDirectory,
       const typename Allocations::SignatureDirectory<Offset>&
           signatureDirectory)
-      : _graph(graph),
+      : Allocations::Tagger<Offset>("LongString"),
+        _graph(graph),
         _tagHolder(tagHolder),
         _edgeIsTainted(edgeIsTainted),
         _edgeIsFavored(edgeIsFavored),
@@ -195,9 +197,9 @@ class LongStringAllocationsTagger : public Allocations::Tagger<Offset> {
   void TagIfLongStringCharsAnchorPoint(const ContiguousImage& contiguousImage,
                                        AllocationIndex index,
                                        const Allocation& allocation) {
-    const std::vector<Offset>* staticAnchors = _graph.GetStaticAnchors(index);
-    const std::vector<Offset>* stackAnchors = _graph.GetStackAnchors(index);
-    if (staticAnchors == nullptr && stackAnchors == nullptr) {
+    Anchors staticAnchors = _graph.GetStaticAnchors(index);
+    Anchors stackAnchors = _graph.GetStackAnchors(index);
+    if (staticAnchors.empty() && stackAnchors.empty()) {
       return;
     }
 
@@ -229,10 +231,10 @@ class LongStringAllocationsTagger : public Allocations::Tagger<Offset> {
   bool CheckLongStringAnchorIn(AllocationIndex charsIndex, Offset charsAddress,
                                Offset stringLength, Offset minCapacity,
                                Offset maxCapacity,
-                               const std::vector<Offset>* anchors,
+                               const Anchors& anchors,
                                Reader& anchorReader) {
-    if (anchors != nullptr) {
-      for (Offset anchor : *anchors) {
+    if (!anchors.empty()) {
+      for (Offset anchor : anchors) {
         if (anchorReader.ReadOffset(anchor, 0xbad) != charsAddress) {
           continue;
         }
@@ -29,7 +29,8 @@ class MapOrSetAllocationsTagger : public Allocations::Tagger<Offset> {
   MapOrSetAllocationsTagger(Graph& graph, TagHolder& tagHolder,
                             EdgePredicate& edgeIsTainted,
                             EdgePredicate& edgeIsFavored)
-      : _graph(graph),
+      : Allocations::Tagger<Offset>("MapOrSet"),
+        _graph(graph),
         _tagHolder(tagHolder),
         _edgeIsTainted(edgeIsTainted),
         _edgeIsFavored(edgeIsFavored),
@@ -1,4 +1,4 @@
-// Copyright (c) 2023 Broadcom. All Rights Reserved.
+// Copyright (c) 2023-2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
@@ -31,7 +31,6 @@ class SummarizeStringUsers : public Commands::Subcommand {
       : Commands::Subcommand("summarize", "stringusers"),
         _processImage(processImage),
         _directory(processImage.GetAllocationDirectory()),
-        _signatureDirectory(processImage.GetSignatureDirectory()),
         _virtualAddressMap(processImage.GetVirtualAddressMap()),
         _contiguousImage(_virtualAddressMap, _directory) {}
 
@@ -82,6 +81,8 @@ class SummarizeStringUsers : public Commands::Subcommand {
     }
     const AllocationIndex numAllocations = _directory.NumAllocations();
     const TagHolder& tagHolder = *(_processImage.GetAllocationTagHolder());
+    const SignatureDirectory& signatureDirectory =
+        _processImage.GetSignatureDirectory();
     const TagIndices* longStringTagIndices =
         tagHolder.GetTagIndices("%LongString");
     if (longStringTagIndices == nullptr) {
@@ -150,7 +151,7 @@ class SummarizeStringUsers : public Commands::Subcommand {
       bool isUnsigned = true;
       Offset signature = *firstOffset;
 
-      if (_signatureDirectory.IsMapped(signature)) {
+      if (signatureDirectory.IsMapped(signature)) {
         isUnsigned = false;
       }
 
@@ -302,7 +303,7 @@ class SummarizeStringUsers : public Commands::Subcommand {
     for (auto const& signatureAndMap : stringStatsForSignature) {
       Offset signature = signatureAndMap.first;
       output << "String usage for signature 0x" << std::hex << signature;
-      std::string signatureName = _signatureDirectory.Name(signature);
+      std::string signatureName = signatureDirectory.Name(signature);
       if (!signatureName.empty()) {
         output << " (" << signatureName << ")";
       }
@@ -357,7 +358,6 @@ class SummarizeStringUsers : public Commands::Subcommand {
  private:
   const ProcessImage<Offset>& _processImage;
   const Allocations::Directory<Offset>& _directory;
-  const SignatureDirectory& _signatureDirectory;
   const VirtualAddressMap<Offset>& _virtualAddressMap;
   ContiguousImage _contiguousImage;
 };
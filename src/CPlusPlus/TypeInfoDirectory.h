@@ -1,15 +1,18 @@
-// Copyright (c) 2022-2023 Broadcom. All Rights Reserved.
+// Copyright (c) 2022-2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
 #pragma once
+#include <algorithm>
+#include <deque>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 #include "../Allocations/Directory.h"
 #include "../ModuleDirectory.h"
 #include "../ModuleImageReader.h"
 #include "../VirtualAddressMap.h"
-#include "Unmangler.h"
+#include "UnmangledNameCache.h"
 
 namespace chap {
 namespace CPlusPlus {
@@ -18,10 +21,12 @@ class TypeInfoDirectory {
  public:
   TypeInfoDirectory(const ModuleDirectory<Offset>& moduleDirectory,
                     const VirtualAddressMap<Offset>& virtualAddressMap,
-                    const Allocations::Directory<Offset>& allocationDirectory)
+                    const Allocations::Directory<Offset>& allocationDirectory,
+                    UnmangledNameCache<Offset>& unmangledNameCache)
       : _moduleDirectory(moduleDirectory),
         _virtualAddressMap(virtualAddressMap),
         _allocationDirectory(allocationDirectory),
+        _unmangledNameCache(unmangledNameCache),
         _isResolved(false),
         _classTypeTypeInfo(0),
         _singleInheritanceTypeInfo(0),
@@ -40,9 +45,9 @@ class TypeInfoDirectory {
         FindRemainingTypeInfoInstances(nameAndModuleInfo.second);
       }
       FindTypeNames();
-      FillInDerivedTypeInfos();
+      AssignTypeIds();
+      FillInDerivedTypeIds();
       ResolveUsedDirectSignatures();
-      ResolveUsedSignatures();
     }
     // TODO: Possibly complain if a C++ library is present but the
     // typeinfo objects are not found.
@@ -55,21 +60,27 @@ class TypeInfoDirectory {
     return _typeNameToTypeInfos.find(name) != _typeNameToTypeInfos.end();
   }
 
+  /*
+   * Add to the given set every signature used by some allocation for which
+   * the type of the allocation is the given type or is derived from it.
+   */
+  template <class SignatureSet>
   void AddSignatures(const std::string& name,
-                     std::set<Offset>& signatures) const {
+                     SignatureSet& signatures) const {
     const auto it = _typeNameToTypeInfos.find(name);
     if (it == _typeNameToTypeInfos.end()) {
       return;
     }
-    const std::vector<Offset>& typeInfos = it->second;
-    for(Offset typeInfo: typeInfos) {
-      const auto itDetails = _detailsMap.find(typeInfo);
-      const Details& details = itDetails->second;
-      if (details._usedSignatures == nullptr) {
-        return;
+    for (Offset typeInfo : it->second) {
+      const auto itTypeId = _typeInfoToTypeId.find(typeInfo);
+      if (itTypeId == _typeInfoToTypeId.end()) {
+        continue;
       }
-      for (Offset signature: *(details._usedSignatures)) {
-        signatures.insert(signature);
+      TypeId typeId = itTypeId->second;
+      AddDirectSignatures(typeId, signatures);
+      for (const TypeId* pDerived = _derivedTypeIds.Begin(typeId);
+           pDerived != _derivedTypeIds.End(typeId); ++pDerived) {
+        AddDirectSignatures(*pDerived, signatures);
       }
     }
   }
@@ -79,49 +90,100 @@ class TypeInfoDirectory {
   typedef typename VirtualAddressMap<Offset>::RangeAttributes RangeAttributes;
   struct Details {
     Details(Offset address)
-      : _address(address), _mangledNameAddress(0), _nameReadFromCore(false), _usedSignatures(nullptr) {}
+        : _address(address),
+          _mangledNameAddress(0),
+          _unmangledName(nullptr),
+          _nameReadFromCore(false) {}
     Details(Offset address, Offset mangledNameAddress)
         : _address(address),
           _mangledNameAddress(mangledNameAddress),
-          _nameReadFromCore(false), _usedSignatures(nullptr) {}
+          _unmangledName(nullptr),
+          _nameReadFromCore(false) {}
     Offset _address;
     Offset _mangledNameAddress;
     std::string _mangledName;
-    std::string _unmangledName;
+    // This is shared with any other users of the unmangled name cache.
+    const std::string* _unmangledName;
     bool _nameReadFromCore;
-    std::unordered_set<Offset> *_usedDirectSignatures;
-    std::unordered_set<Offset> *_usedSignatures;
   };
+  typedef uint32_t TypeId;
+  typedef uint32_t SignatureId;
+
+  /*
+   * A FlatAdjacency holds, for each of a dense range of ids, a list of
+   * other ids, all in one array, in the style of a compressed sparse row
+   * matrix.
+   */
+  struct FlatAdjacency {
+    void Build(size_t numIds,
+               const std::vector<std::pair<uint32_t, uint32_t> >& pairs) {
+      _starts.assign(numIds + 1, 0);
+      for (const auto& pair : pairs) {
+        _starts[pair.first + 1]++;
+      }
+      for (size_t id = 0; id < numIds; id++) {
+        _starts[id + 1] += _starts[id];
+      }
+      _values.resize(pairs.size());
+      std::vector<uint32_t> next(_starts.begin(), _starts.end() - 1);
+      for (const auto& pair : pairs) {
+        _values[next[pair.first]++] = pair.second;
+      }
+    }
+    size_t Size(uint32_t id) const { return _starts[id + 1] - _starts[id]; }
+    const uint32_t* Begin(uint32_t id) const {
+      return _values.data() + _starts[id];
+    }
+    const uint32_t* End(uint32_t id) const {
+      return _values.data() + _starts[id + 1];
+    }
+    std::vector<uint32_t> _starts;
+    std::vector<uint32_t> _values;
+  };
+
   const ModuleDirectory<Offset>& _moduleDirectory;
   const VirtualAddressMap<Offset>& _virtualAddressMap;
   const Allocations::Directory<Offset>& _allocationDirectory;
+  UnmangledNameCache<Offset>& _unmangledNameCache;
   bool _isResolved;
   Offset _classTypeTypeInfo;
   Offset _singleInheritanceTypeInfo;
   Offset _multipleInheritanceTypeInfo;
   std::unordered_map<Offset, Details> _detailsMap;
   std::unordered_map<std::string, std::vector<Offset> > _typeNameToTypeInfos;
-  /*
-   * Map from a given typeinfo to the set of typeinfo entries for any
-   * directly derived types.  To save space, in the common case that
-   * there are no direct descendants, there should be no corresponding
-   * entry in the unordered_map.
-   */
-  std::unordered_map<Offset, std::unordered_set<Offset> > _directlyDerived;
   /*
    * Map from a given typeinfo to the set of typeinfo entries for any
    * direct base types.  To save space, in the common case that
    * there are no direct bases, there should be no corresponding
-   * entry in the unordered_map.
+   * entry in the unordered_map.  This is used only until the hierarchy is
+   * converted to the flat tables below.
    */
   std::unordered_map<Offset, std::unordered_set<Offset> > _directBases;
   /*
-   * Map from a given typeinfo to the set of typeinfo entries for any
-   * derived types.  To save space, in the common case that
-   * there are no descendants, there should be no corresponding
-   * entry in the unordered_map.
+   * Once all the typeinfos are known, each is given a dense id, in order by
+   * address, so that the hierarchy and the signatures used for each type
+   * can be kept in flat tables indexed by id.
    */
-  std::unordered_map<Offset, std::unordered_set<Offset> > _derivedTypeInfos;
+  std::vector<Offset> _typeInfos;
+  std::unordered_map<Offset, TypeId> _typeInfoToTypeId;
+  FlatAdjacency _directBaseTypeIds;
+  FlatAdjacency _directlyDerivedTypeIds;
+  // This holds all the types derived from each type, directly or not.
+  FlatAdjacency _derivedTypeIds;
+  /*
+   * The signatures used by allocations that have a known typeinfo are also
+   * given dense ids, in order by address, and listed by type.
+   */
+  std::vector<Offset> _usedSignatures;
+  FlatAdjacency _directSignatureIds;
+
+  template <class SignatureSet>
+  void AddDirectSignatures(TypeId typeId, SignatureSet& signatures) const {
+    for (const SignatureId* pSignature = _directSignatureIds.Begin(typeId);
+         pSignature != _directSignatureIds.End(typeId); ++pSignature) {
+      signatures.insert(_usedSignatures[*pSignature]);
+    }
+  }
 
   bool FindBaseTypeInfoInstances(
       const typename ModuleDirectory<Offset>::ModuleInfo& moduleInfo) {
@@ -303,7 +365,6 @@ class TypeInfoDirectory {
         return false;
       }
       _directBases[typeInfo].insert(baseTypeInfo);
-      _directlyDerived[baseTypeInfo].insert(typeInfo);
       _detailsMap.emplace(typeInfo, typeInfo)
           .first->second._mangledNameAddress = typeName;
       return true;
@@ -333,7 +394,6 @@ class TypeInfoDirectory {
       for (; listEntry < listLimit; listEntry += 2 * sizeof(Offset)) {
         Offset baseTypeInfo = reader.ReadOffset(listEntry, 0);
         _directBases[typeInfo].insert(baseTypeInfo);
-        _directlyDerived[baseTypeInfo].insert(typeInfo);
       }
     }
     _detailsMap.emplace(typeInfo, typeInfo).first->second._mangledNameAddress =
@@ -420,13 +480,12 @@ class TypeInfoDirectory {
     for (const auto& mangledNameAndTypeInfos : mangledNameToTypeInfos) {
       const std::string& mangledName = mangledNameAndTypeInfos.first;
       const std::vector<Offset>& typeInfos = mangledNameAndTypeInfos.second;
-      Unmangler<Offset> unmangler(mangledName.c_str(), false);
-      const std::string& typeName = unmangler.Unmangled();
+      const std::string& typeName = _unmangledNameCache.Unmangled(mangledName);
       for (Offset typeInfo : typeInfos) {
         auto it = _detailsMap.find(typeInfo);
         it->second._mangledName = mangledName;
         if (!typeName.empty()) {
-          it->second._unmangledName = typeName;
+          it->second._unmangledName = &typeName;
         }
       }
       if (!typeName.empty()) {
@@ -436,50 +495,101 @@ class TypeInfoDirectory {
       }
     }
   }
-  void FillInDerivedTypeInfos() {
-    std::deque<Offset> readyToResolveDirectBases;
-    std::unordered_map<Offset, size_t> numUnresolvedDirectlyDerived;
-    for (auto& kv : _detailsMap) {
-      Offset typeInfo = kv.first;
-      const auto itDirectlyDerived = _directlyDerived.find(typeInfo);
-      if (itDirectlyDerived == _directlyDerived.end()) {
-        if (_directBases.find(typeInfo) != _directBases.end()) {
-          readyToResolveDirectBases.push_back(typeInfo);
+  void AssignTypeIds() {
+    _typeInfos.reserve(_detailsMap.size());
+    for (const auto& typeInfoAndDetails : _detailsMap) {
+      _typeInfos.push_back(typeInfoAndDetails.first);
+    }
+    std::sort(_typeInfos.begin(), _typeInfos.end());
+    TypeId numTypes = _typeInfos.size();
+    for (TypeId typeId = 0; typeId < numTypes; typeId++) {
+      _typeInfoToTypeId[_typeInfos[typeId]] = typeId;
+    }
+
+    std::vector<std::pair<TypeId, TypeId> > derivedAndBase;
+    std::vector<std::pair<TypeId, TypeId> > baseAndDerived;
+    for (const auto& typeInfoAndBases : _directBases) {
+      const auto itDerived = _typeInfoToTypeId.find(typeInfoAndBases.first);
+      if (itDerived == _typeInfoToTypeId.end()) {
+        continue;
+      }
+      for (Offset base : typeInfoAndBases.second) {
+        const auto itBase = _typeInfoToTypeId.find(base);
+        if (itBase == _typeInfoToTypeId.end()) {
+          continue;
         }
-      } else {
-        numUnresolvedDirectlyDerived[typeInfo] =
-            itDirectlyDerived->second.size();
-      }
-    }
-    while (!readyToResolveDirectBases.empty()) {
-      Offset derived = readyToResolveDirectBases.front();
-      std::unordered_set<Offset>& bases = _directBases[derived];
-      readyToResolveDirectBases.pop_front();
-      const auto itDerived = _derivedTypeInfos.find(derived);
-      bool derivedHasDerived = (itDerived != _derivedTypeInfos.end());
-      for (Offset base : bases) {
-        std::unordered_set<Offset>& derivedFromBase = _derivedTypeInfos[base];
-        derivedFromBase.insert(derived);
-        if (derivedHasDerived) {
-          for (Offset indirectlyDerived : itDerived->second) {
-            derivedFromBase.insert(indirectlyDerived);
-          }
+        derivedAndBase.emplace_back(itDerived->second, itBase->second);
+        baseAndDerived.emplace_back(itBase->second, itDerived->second);
+      }
+    }
+    _directBases.clear();
+    _directBaseTypeIds.Build(numTypes, derivedAndBase);
+    _directlyDerivedTypeIds.Build(numTypes, baseAndDerived);
+  }
+
+  /*
+   * Find all the types derived from each type, visiting each type only
+   * after all the types directly derived from it.  Any types in a cycle,
+   * and any of their bases, are never visited and so are left with no
+   * derived types.
+   */
+  void FillInDerivedTypeIds() {
+    TypeId numTypes = _typeInfos.size();
+    std::deque<TypeId> readyToVisit;
+    std::vector<uint32_t> numUnvisitedDirectlyDerived(numTypes);
+    for (TypeId typeId = 0; typeId < numTypes; typeId++) {
+      numUnvisitedDirectlyDerived[typeId] =
+          _directlyDerivedTypeIds.Size(typeId);
+      if (numUnvisitedDirectlyDerived[typeId] == 0) {
+        readyToVisit.push_back(typeId);
+      }
+    }
+    std::vector<std::vector<TypeId> > derivedTypeIds(numTypes);
+    std::vector<TypeId> lastAddedFor(numTypes, numTypes);
+    while (!readyToVisit.empty()) {
+      TypeId typeId = readyToVisit.front();
+      readyToVisit.pop_front();
+      std::vector<TypeId>& derived = derivedTypeIds[typeId];
+      for (const TypeId* pDirectlyDerived =
+               _directlyDerivedTypeIds.Begin(typeId);
+           pDirectlyDerived != _directlyDerivedTypeIds.End(typeId);
+           ++pDirectlyDerived) {
+        if (lastAddedFor[*pDirectlyDerived] != typeId) {
+          lastAddedFor[*pDirectlyDerived] = typeId;
+          derived.push_back(*pDirectlyDerived);
         }
-        if (--(numUnresolvedDirectlyDerived[base]) == 0) {
-          if (_directBases.find(base) != _directBases.end()) {
-            readyToResolveDirectBases.push_back(base);
+        for (TypeId indirectlyDerived : derivedTypeIds[*pDirectlyDerived]) {
+          if (lastAddedFor[indirectlyDerived] != typeId) {
+            lastAddedFor[indirectlyDerived] = typeId;
+            derived.push_back(indirectlyDerived);
           }
-          numUnresolvedDirectlyDerived.erase(base);
+        }
+      }
+      for (const TypeId* pBase = _directBaseTypeIds.Begin(typeId);
+           pBase != _directBaseTypeIds.End(typeId); ++pBase) {
+        if (--(numUnvisitedDirectlyDerived[*pBase]) == 0) {
+          readyToVisit.push_back(*pBase);
         }
       }
     }
-    if (!numUnresolvedDirectlyDerived.empty()) {
-      std::cerr << "Warning, some calculated type_info entries appear to be in "
-                   "cycles:\n";
-      for (const auto typeInfoAndCount : numUnresolvedDirectlyDerived) {
-        std::cerr << "0x" << std::hex << typeInfoAndCount.first << "\n";
+
+    std::vector<std::pair<TypeId, TypeId> > baseAndDerived;
+    bool foundCycle = false;
+    for (TypeId typeId = 0; typeId < numTypes; typeId++) {
+      for (TypeId derived : derivedTypeIds[typeId]) {
+        baseAndDerived.emplace_back(typeId, derived);
+      }
+      if (numUnvisitedDirectlyDerived[typeId] != 0) {
+        if (!foundCycle) {
+          foundCycle = true;
+          std::cerr << "Warning, some calculated type_info entries appear to "
+                       "be in cycles:\n";
+        }
+        std::cerr << "0x" << std::hex << _typeInfos[typeId] << "\n";
       }
     }
+    derivedTypeIds.clear();
+    _derivedTypeIds.Build(numTypes, baseAndDerived);
   }
 
   void ResolveUsedDirectSignatures() {
@@ -489,6 +599,7 @@ class TypeInfoDirectory {
     AllocationIndex numAllocations = _allocationDirectory.NumAllocations();
     Reader allocationReader(_virtualAddressMap);
     Reader moduleReader(_virtualAddressMap);
+    std::unordered_map<Offset, TypeId> signatureToTypeId;
     std::unordered_set<Offset> foundSignatures;
     for (AllocationIndex i = 0; i < numAllocations; ++i) {
       const Allocation* allocation = _allocationDirectory.AllocationAt(i);
@@ -502,7 +613,7 @@ class TypeInfoDirectory {
       if (signature == 0) {
         continue;
       }
-      if (foundSignatures.find(signature) != foundSignatures.end()) {
+      if (!foundSignatures.insert(signature).second) {
         continue;
       }
       Offset typeInfoCandidate =
@@ -510,81 +621,28 @@ class TypeInfoDirectory {
       if (typeInfoCandidate == 0) {
         continue;
       }
-      auto it = _detailsMap.find(typeInfoCandidate);
-      if (it == _detailsMap.end()) {
+      auto it = _typeInfoToTypeId.find(typeInfoCandidate);
+      if (it == _typeInfoToTypeId.end()) {
         continue;
       }
-      Details& details = it->second;
-      if (details._usedSignatures == nullptr) {
-        details._usedSignatures = new std::unordered_set<Offset>;
-      }
-      details._usedSignatures->insert(signature);
-      
-    }
-  }
-  void ResolveUsedSignatures() {
-    std::deque<Offset> readyToResolveDirectBases;
-    std::unordered_map<Offset, size_t> numUnresolvedDirectlyDerived;
-    for (const auto& kv : _detailsMap) {
-      Offset typeInfo = kv.first;
-      const auto itDirectlyDerived = _directlyDerived.find(typeInfo);
-      if (itDirectlyDerived == _directlyDerived.end()) {
-        if (_directBases.find(typeInfo) != _directBases.end()) {
-          readyToResolveDirectBases.push_back(typeInfo);
-        }
-      } else {
-        numUnresolvedDirectlyDerived[typeInfo] =
-            itDirectlyDerived->second.size();
-      }
+      signatureToTypeId[signature] = it->second;
     }
-    while (!readyToResolveDirectBases.empty()) {
-      Offset derived = readyToResolveDirectBases.front();
-      std::unordered_set<Offset>& bases = _directBases[derived];
-      readyToResolveDirectBases.pop_front();
 
-      auto itDerived = _detailsMap.find(derived);
-      if (itDerived == _detailsMap.end()) {
-        continue;
-      }
-      Details& details = itDerived->second;
-
-
-
-      bool derivedHasUsedSignatures = (details._usedSignatures != nullptr);
-      for (Offset base : bases) {
-        if (derivedHasUsedSignatures) {
-          auto itBase = _detailsMap.find(base);
-          if (itBase == _detailsMap.end()) {
-            continue;
-          }
-          Details& detailsForBase = itBase->second;
-
-          if (detailsForBase._usedSignatures == nullptr) {
-            detailsForBase._usedSignatures = new std::unordered_set<Offset>;
-          }
-          std::unordered_set<Offset>& signaturesForBase = *(detailsForBase._usedSignatures);
-
-          for (Offset signature : *(details._usedSignatures)) {
-            signaturesForBase.insert(signature);
-          }
-        }
-        if (--(numUnresolvedDirectlyDerived[base]) == 0) {
-          if (_directBases.find(base) != _directBases.end()) {
-            readyToResolveDirectBases.push_back(base);
-          }
-          numUnresolvedDirectlyDerived.erase(base);
-        }
-      }
+    _usedSignatures.reserve(signatureToTypeId.size());
+    for (const auto& signatureAndTypeId : signatureToTypeId) {
+      _usedSignatures.push_back(signatureAndTypeId.first);
     }
-    if (!numUnresolvedDirectlyDerived.empty()) {
-      std::cerr << "Warning, some calculated type_info entries appear to be in "
-                   "cycles:\n";
-      for (const auto typeInfoAndCount : numUnresolvedDirectlyDerived) {
-        std::cerr << "0x" << std::hex << typeInfoAndCount.first << "\n";
-      }
+    std::sort(_usedSignatures.begin(), _usedSignatures.end());
+    std::vector<std::pair<TypeId, SignatureId> > typeAndSignature;
+    typeAndSignature.reserve(_usedSignatures.size());
+    SignatureId numSignatures = _usedSignatures.size();
+    for (SignatureId signatureId = 0; signatureId < numSignatures;
+         signatureId++) {
+      typeAndSignature.emplace_back(
+          signatureToTypeId[_usedSignatures[signatureId]], signatureId);
     }
+    _directSignatureIds.Build(_typeInfos.size(), typeAndSignature);
   }
-
 };
 }  // namespace CPlusPlus
 }  // namespace chap
@@ -0,0 +1,127 @@
+// Copyright (c) 2024 Broadcom. All Rights Reserved.
+// The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
+// SPDX-License-Identifier: GPL-2.0
+
+#pragma once
+#include <string.h>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "Unmangler.h"
+
+namespace chap {
+namespace CPlusPlus {
+/*
+ * An UnmangledNameCache unmangles each distinct mangled type name just once
+ * and keeps just one copy of each distinct unmangled name, so that the many
+ * requests for the same names, such as for the vtables of instances of the
+ * same template in different modules, are cheap.  The mangled names are
+ * copied into large blocks, rather than allocated one at a time, because
+ * they are never released until the cache is.
+ */
+template <typename Offset>
+class UnmangledNameCache {
+ public:
+  UnmangledNameCache()
+      : _blockUsed(BLOCK_SIZE),
+        _numRequests(0),
+        _mangledBytes(0),
+        _unmangledBytes(0),
+        _secondsUnmangling(0.0) {}
+  UnmangledNameCache(const UnmangledNameCache&) = delete;
+  UnmangledNameCache& operator=(const UnmangledNameCache&) = delete;
+
+  /*
+   * Return the unmangled form of the given mangled name, which need not be
+   * null terminated, or an empty string if the name cannot be unmangled.
+   * The result remains valid as long as the cache does.
+   */
+  const std::string& Unmangled(const char* mangled, size_t length) {
+    ++_numRequests;
+    std::string_view mangledView(mangled, length);
+    typename MangledToUnmangled::const_iterator it =
+        _mangledToUnmangled.find(mangledView);
+    if (it != _mangledToUnmangled.end()) {
+      return *(it->second);
+    }
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    const char* copy = Copy(mangled, length);
+    Unmangler<Offset> unmangler(copy, false);
+    auto insertResult = _unmangledNames.insert(unmangler.Unmangled());
+    if (insertResult.second) {
+      _unmangledBytes += insertResult.first->size();
+    }
+    const std::string* unmangled = &(*(insertResult.first));
+    _mangledToUnmangled.emplace(std::string_view(copy, length), unmangled);
+    _secondsUnmangling += std::chrono::duration<double>(
+                              std::chrono::steady_clock::now() - start)
+                              .count();
+    return *unmangled;
+  }
+
+  const std::string& Unmangled(const std::string& mangled) {
+    return Unmangled(mangled.data(), mangled.size());
+  }
+
+  void ReportUsage() const {
+    std::ios_base::fmtflags oldFlags = std::cerr.flags();
+    std::streamsize oldPrecision = std::cerr.precision();
+    std::cerr << std::fixed << std::setprecision(3) << "Unmangling took "
+              << _secondsUnmangling << "s for " << std::dec
+              << _mangledToUnmangled.size() << " distinct names of "
+              << _numRequests << " requested, keeping 0x" << std::hex
+              << _mangledBytes << " bytes of mangled names and 0x"
+              << _unmangledBytes << " bytes of unmangled names.\n";
+    std::cerr.flags(oldFlags);
+    std::cerr.precision(oldPrecision);
+  }
+
+ private:
+  typedef std::unordered_map<std::string_view, const std::string*>
+      MangledToUnmangled;
+  static constexpr size_t BLOCK_SIZE = 0x10000;
+  std::vector<std::unique_ptr<char[]> > _blocks;
+  size_t _blockUsed;
+  MangledToUnmangled _mangledToUnmangled;
+  // The elements of an unordered_set don't move when it grows.
+  std::unordered_set<std::string> _unmangledNames;
+  size_t _numRequests;
+  size_t _mangledBytes;
+  size_t _unmangledBytes;
+  double _secondsUnmangling;
+
+  /*
+   * Return a null terminated copy of the given name, placed in the current
+   * block if there is room or in a new block otherwise.
+   */
+  const char* Copy(const char* name, size_t length) {
+    size_t needed = length + 1;
+    char* copy;
+    if (needed > BLOCK_SIZE) {
+      _blocks.emplace_back(new char[needed]);
+      copy = _blocks.back().get();
+      // The name fills the new last block, so the next name needs another.
+      _blockUsed = BLOCK_SIZE;
+    } else {
+      if (_blockUsed + needed > BLOCK_SIZE) {
+        _blocks.emplace_back(new char[BLOCK_SIZE]);
+        _blockUsed = 0;
+      }
+      copy = _blocks.back().get() + _blockUsed;
+      _blockUsed += needed;
+    }
+    memcpy(copy, name, length);
+    copy[length] = '\000';
+    _mangledBytes += needed;
+    return copy;
+  }
+};
+}  // namespace CPlusPlus
+}  // namespace chap
@@ -1,4 +1,4 @@
-// Copyright (c) 2019-2023 Broadcom. All Rights Reserved.
+// Copyright (c) 2019-2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
@@ -24,6 +24,7 @@ class UnorderedMapOrSetAllocationsTagger : public Allocations::Tagger<Offset> {
    */
   static constexpr int MIN_OFFSETS_IN_HEADER = 6;
   typedef typename Allocations::Graph<Offset> Graph;
+  typedef typename Graph::Anchors Anchors;
   typedef typename Allocations::Directory<Offset> Directory;
   typedef typename Allocations::Tagger<Offset> Tagger;
   typedef typename Allocations::ContiguousImage<Offset> ContiguousImage;
@@ -37,7 +38,8 @@ class UnorderedMapOrSetAllocationsTagger : public Allocations::Tagger<Offset> {
   UnorderedMapOrSetAllocationsTagger(Graph& graph, TagHolder& tagHolder,
                                      EdgePredicate& edgeIsTainted,
                                      EdgePredicate& edgeIsFavored)
-      : _graph(graph),
+      : Allocations::Tagger<Offset>("UnorderedMapOrSet"),
+        _graph(graph),
         _tagHolder(tagHolder),
         _edgeIsTainted(edgeIsTainted),
         _edgeIsFavored(edgeIsFavored),
@@ -432,10 +434,10 @@ class UnorderedMapOrSetAllocationsTagger : public Allocations::Tagger<Offset> {
   }
 
   bool CheckAnchors(Reader& bucketsReader, Reader& anchorReader,
-                    const std::vector<Offset>* anchors, AllocationIndex index,
+                    const Anchors& anchors, AllocationIndex index,
                     Offset address, Offset size) {
-    if (anchors != nullptr) {
-      for (Offset anchor : *anchors) {
+    if (!anchors.empty()) {
+      for (Offset anchor : anchors) {
         if (anchorReader.ReadOffset(anchor, 0xbad) != address) {
           continue;
         }
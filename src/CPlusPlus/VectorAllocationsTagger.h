@@ -1,4 +1,4 @@
-// Copyright (c) 2019-2022 Broadcom. All Rights Reserved.
+// Copyright (c) 2019-2022,2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
@@ -16,6 +16,7 @@ template <typename Offset>
 class VectorAllocationsTagger : public Allocations::Tagger<Offset> {
  public:
   typedef typename Allocations::Graph<Offset> Graph;
+  typedef typename Graph::Anchors Anchors;
   typedef typename Allocations::Directory<Offset> Directory;
   typedef typename Allocations::Tagger<Offset> Tagger;
   typedef typename Allocations::ContiguousImage<Offset> ContiguousImage;
@@ -31,7 +32,8 @@ class VectorAllocationsTagger : public Allocations::Tagger<Offset> {
       Graph& graph, TagHolder& tagHolder, EdgePredicate& edgeIsTainted,
       EdgePredicate& edgeIsFavored,
       const Allocations::SignatureDirectory<Offset>& signatureDirectory)
-      : _graph(graph),
+      : Allocations::Tagger<Offset>("Vector"),
+        _graph(graph),
         _tagHolder(tagHolder),
         _edgeIsTainted(edgeIsTainted),
         _edgeIsFavored(edgeIsFavored),
@@ -153,16 +155,16 @@ class VectorAllocationsTagger : public Allocations::Tagger<Offset> {
 
   bool CheckVectorBodyAnchorIn(AllocationIndex bodyIndex,
                                const Allocation& bodyAllocation,
-                               const std::vector<Offset>* anchors) {
+                               const Anchors& anchors) {
     Offset bodyAddress = bodyAllocation.Address();
     Offset bodyLimit = bodyAddress + bodyAllocation.Size();
     Offset minCapacity = _directory.MinRequestSize(bodyIndex);
     if (minCapacity < 1) {
       minCapacity = 1;
     }
-    if (anchors != nullptr) {
+    if (!anchors.empty()) {
       typename VirtualAddressMap<Offset>::Reader dequeReader(_addressMap);
-      for (Offset anchor : *anchors) {
+      for (Offset anchor : anchors) {
         const char* image;
         Offset numBytesFound =
             _addressMap.FindMappedMemoryImage(anchor, &image);
@@ -17,6 +17,7 @@ class VectorBodyDescriber : public Allocations::PatternDescriber<Offset> {
       typename Allocations::Directory<Offset>::AllocationIndex AllocationIndex;
   typedef typename Allocations::PatternDescriber<Offset> Base;
   typedef typename Allocations::Directory<Offset>::Allocation Allocation;
+  typedef typename Allocations::Graph<Offset>::Anchors Anchors;
   VectorBodyDescriber(const ProcessImage<Offset>& processImage)
       : Allocations::PatternDescriber<Offset>(processImage, "VectorBody") {}
 
@@ -32,7 +33,7 @@ class VectorBodyDescriber : public Allocations::PatternDescriber<Offset> {
 
     const AllocationIndex* pFirstIncoming;
     const AllocationIndex* pPastIncoming;
-    Base::_graph->GetIncoming(index, &pFirstIncoming, &pPastIncoming);
+    Base::GetGraph().GetIncoming(index, &pFirstIncoming, &pPastIncoming);
 
     std::vector<VectorInfo> vectors;
     for (const AllocationIndex* pNextIncoming = pFirstIncoming;
@@ -73,9 +74,9 @@ class VectorBodyDescriber : public Allocations::PatternDescriber<Offset> {
     }
 
     FindVectors(InStaticMemory, allocationAddress, allocationLimit,
-                Base::_graph->GetStaticAnchors(index), vectors);
+                Base::GetGraph().GetStaticAnchors(index), vectors);
     FindVectors(OnStack, allocationAddress, allocationLimit,
-                Base::_graph->GetStackAnchors(index), vectors);
+                Base::GetGraph().GetStackAnchors(index), vectors);
 
     if (vectors.empty()) {
       return;
@@ -166,11 +167,11 @@ class VectorBodyDescriber : public Allocations::PatternDescriber<Offset> {
     Offset _offsetInAllocation;
   };
   void FindVectors(LocationType locationType, Offset allocationAddress,
-                   Offset allocationLimit, const std::vector<Offset>* anchors,
+                   Offset allocationLimit, const Anchors& anchors,
                    std::vector<VectorInfo>& vectors) const {
-    if (anchors != nullptr) {
+    if (!anchors.empty()) {
       typename VirtualAddressMap<Offset>::Reader reader(Base::_addressMap);
-      for (Offset anchor : *anchors) {
+      for (Offset anchor : anchors) {
         if (reader.ReadOffset(anchor, 0xbad) == allocationAddress) {
           Offset endUsed = reader.ReadOffset(anchor + sizeof(Offset), 0xbad);
           Offset endUsable =
@@ -0,0 +1,325 @@
+// Copyright (c) 2024 Broadcom. All Rights Reserved.
+// The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
+// SPDX-License-Identifier: GPL-2.0
+
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Runner.h"
+
+namespace chap {
+namespace Commands {
+/*
+ * A RecordWriter writes one record, with a fixed list of fields, for each
+ * member of a set, in the machine readable format requested by the /format
+ * switch, so that other programs can read the results without parsing the
+ * text meant for people:
+ *
+ * json: a JSON array with one object per line.  Addresses are strings of
+ *       the form "0x..." so that readers that keep numbers as doubles do not
+ *       lose precision, and missing values are null.
+ * csv: a header line with the field names followed by one line per record.
+ *       Missing values are empty.
+ * binary: the 8 byte header "CHAPREC\0", the version as 4 bytes and the
+ *       number of fields as 4 bytes, then the type (as 1 byte) and the
+ *       length (as 1 byte) and the characters of the name of each field,
+ *       then the records, one field after another.  All integers are
+ *       little-endian.  Addresses and counts take 8 bytes, booleans 1 byte,
+ *       and strings and byte arrays are preceded by their length as 4 bytes.
+ *       Missing values are written as 0 or as empty.
+ */
+class RecordWriter {
+ public:
+  enum Format { TEXT, JSON, CSV, BINARY };
+  enum FieldType : uint8_t { ADDRESS = 1, COUNT, BOOLEAN, STRING, BYTES };
+  struct Field {
+    const char* _name;
+    FieldType _type;
+  };
+  static constexpr uint32_t BINARY_VERSION = 1;
+
+  /*
+   * Set the format requested by the /format switch, which is TEXT if there
+   * is no such switch, or return false after reporting a bad switch.
+   */
+  static bool ParseFormatSwitch(Context& context, Format& format) {
+    size_t numArguments = context.GetNumArguments("format");
+    format = TEXT;
+    if (numArguments == 0) {
+      return true;
+    }
+    Error& error = context.GetError();
+    if (numArguments > 1) {
+      error << "At most one /format switch is allowed.\n";
+      return false;
+    }
+    const std::string& name = context.Argument("format", 0);
+    if (name == "json") {
+      format = JSON;
+    } else if (name == "csv") {
+      format = CSV;
+    } else if (name == "binary") {
+      format = BINARY;
+    } else if (name != "text") {
+      error << "Unexpected argument \"" << name
+            << "\" to /format switch.\n"
+               "Use text, json, csv or binary.\n";
+      return false;
+    }
+    return true;
+  }
+
+  RecordWriter(Output& output, Format format, const std::vector<Field>& fields)
+      : _output(output),
+        _format(format),
+        _fields(fields),
+        _numRecords(0),
+        _nextField(0) {
+    switch (_format) {
+      case JSON:
+        _output.Write("[\n", 2);
+        break;
+      case CSV:
+        for (size_t i = 0; i < _fields.size(); i++) {
+          if (i != 0) {
+            _output.Put(',');
+          }
+          _output.Write(_fields[i]._name);
+        }
+        _output.Put('\n');
+        break;
+      case BINARY:
+        _output.Write("CHAPREC", 8);
+        WriteLittleEndian<uint32_t>(BINARY_VERSION);
+        WriteLittleEndian<uint32_t>(_fields.size());
+        for (const Field& field : _fields) {
+          std::string_view name(field._name);
+          WriteLittleEndian<uint8_t>(field._type);
+          WriteLittleEndian<uint8_t>(name.size());
+          _output.Write(name);
+        }
+        break;
+      case TEXT:
+        break;
+    }
+  }
+
+  ~RecordWriter() {
+    if (_format == JSON) {
+      if (_numRecords != 0) {
+        _output.Put('\n');
+      }
+      _output.Write("]\n", 2);
+    }
+  }
+
+  /*
+   * The values of each record must be added in the order of the fields,
+   * followed by a call to EndRecord.
+   */
+  void AddAddress(uint64_t address) {
+    StartField();
+    switch (_format) {
+      case JSON:
+        _output.Write("\"0x", 3);
+        _output.WriteHex(address);
+        _output.Put('"');
+        break;
+      case CSV:
+        _output.Write("0x", 2);
+        _output.WriteHex(address);
+        break;
+      case BINARY:
+        WriteLittleEndian<uint64_t>(address);
+        break;
+      case TEXT:
+        break;
+    }
+  }
+
+  void AddCount(uint64_t count) {
+    StartField();
+    if (_format == BINARY) {
+      WriteLittleEndian<uint64_t>(count);
+    } else {
+      _output.WriteDecimal(count);
+    }
+  }
+
+  void AddBoolean(bool value) {
+    StartField();
+    if (_format == BINARY) {
+      WriteLittleEndian<uint8_t>(value ? 1 : 0);
+    } else {
+      _output.Write(value ? std::string_view("true")
+                          : std::string_view("false"));
+    }
+  }
+
+  void AddString(std::string_view value) {
+    StartField();
+    switch (_format) {
+      case JSON:
+        WriteJsonString(value);
+        break;
+      case CSV:
+        WriteCsvString(value);
+        break;
+      case BINARY:
+        WriteLittleEndian<uint32_t>(value.size());
+        _output.Write(value);
+        break;
+      case TEXT:
+        break;
+    }
+  }
+
+  void AddBytes(const char* bytes, size_t numBytes) {
+    StartField();
+    switch (_format) {
+      case JSON:
+        _output.Put('"');
+        WriteHexBytes(bytes, numBytes);
+        _output.Put('"');
+        break;
+      case CSV:
+        WriteHexBytes(bytes, numBytes);
+        break;
+      case BINARY:
+        WriteLittleEndian<uint32_t>(numBytes);
+        _output.Write(bytes, numBytes);
+        break;
+      case TEXT:
+        break;
+    }
+  }
+
+  void AddMissing() {
+    FieldType type = _fields[_nextField]._type;
+    StartField();
+    switch (_format) {
+      case JSON:
+        _output.Write("null", 4);
+        break;
+      case BINARY:
+        if (type == ADDRESS || type == COUNT) {
+          WriteLittleEndian<uint64_t>(0);
+        } else if (type == BOOLEAN) {
+          WriteLittleEndian<uint8_t>(0);
+        } else {
+          WriteLittleEndian<uint32_t>(0);
+        }
+        break;
+      case CSV:
+      case TEXT:
+        break;
+    }
+  }
+
+  void EndRecord() {
+    if (_format == JSON) {
+      _output.Put('}');
+    } else if (_format == CSV) {
+      _output.Put('\n');
+    }
+    _nextField = 0;
+    _numRecords++;
+  }
+
+ private:
+  static constexpr size_t HEX_BYTES_PER_CHUNK = 0x1000;
+  Output& _output;
+  const Format _format;
+  const std::vector<Field> _fields;
+  uint64_t _numRecords;
+  size_t _nextField;
+
+  void StartField() {
+    if (_format == JSON) {
+      if (_nextField == 0) {
+        if (_numRecords != 0) {
+          _output.Write(",\n", 2);
+        }
+        _output.Put('{');
+      } else {
+        _output.Put(',');
+      }
+      _output.Put('"');
+      _output.Write(_fields[_nextField]._name);
+      _output.Write("\":", 2);
+    } else if (_format == CSV && _nextField != 0) {
+      _output.Put(',');
+    }
+    _nextField++;
+  }
+
+  template <typename T>
+  void WriteLittleEndian(T value) {
+    char bytes[sizeof(T)];
+    for (size_t i = 0; i < sizeof(T); i++) {
+      bytes[i] = (char)(((uint64_t)value) >> (8 * i));
+    }
+    _output.Write(bytes, sizeof(T));
+  }
+
+  void WriteHexBytes(const char* bytes, size_t numBytes) {
+    static const char hexDigits[] = "0123456789abcdef";
+    while (numBytes > 0) {
+      size_t chunkSize =
+          (numBytes < HEX_BYTES_PER_CHUNK) ? numBytes : HEX_BYTES_PER_CHUNK;
+      char* out = _output.Reserve(2 * chunkSize);
+      for (size_t i = 0; i < chunkSize; i++) {
+        unsigned char b = (unsigned char)(bytes[i]);
+        out[2 * i] = hexDigits[b >> 4];
+        out[2 * i + 1] = hexDigits[b & 0xf];
+      }
+      _output.Commit(2 * chunkSize);
+      bytes += chunkSize;
+      numBytes -= chunkSize;
+    }
+  }
+
+  /*
+   * Anything outside of printable ascii is escaped, so that the output is
+   * valid UTF-8 even where a name is not.
+   */
+  void WriteJsonString(std::string_view value) {
+    static const char hexDigits[] = "0123456789abcdef";
+    _output.Put('"');
+    for (char c : value) {
+      unsigned char u = (unsigned char)c;
+      if (c == '"' || c == '\\') {
+        _output.Put('\\');
+        _output.Put(c);
+      } else if (u < 0x20 || u > 0x7e) {
+        char* out = _output.Reserve(6);
+        memcpy(out, "\\u00", 4);
+        out[4] = hexDigits[u >> 4];
+        out[5] = hexDigits[u & 0xf];
+        _output.Commit(6);
+      } else {
+        _output.Put(c);
+      }
+    }
+    _output.Put('"');
+  }
+
+  void WriteCsvString(std::string_view value) {
+    if (value.find_first_of(",\"\r\n") == std::string_view::npos) {
+      _output.Write(value);
+      return;
+    }
+    _output.Put('"');
+    for (char c : value) {
+      if (c == '"') {
+        _output.Put('"');
+      }
+      _output.Put(c);
+    }
+    _output.Put('"');
+  }
+};
+}  // namespace Commands
+}  // namespace chap
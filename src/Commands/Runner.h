@@ -3,15 +3,22 @@
 // SPDX-License-Identifier: GPL-2.0
 
 #pragma once
+#include <string.h>
+#include <sys/stat.h>
+#include <charconv>
 #include <fstream>
 #include <functional>
 #include <iostream>
 #include <list>
 #include <map>
+#include <memory>
 #include <sstream>
 #include <stack>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <vector>
+#include "../Parallel.h"
 #include "LineInfo.h"
 
 #include <replxx.h>
@@ -168,10 +175,22 @@ class Input {
   std::stack<std::istream*> _inputStack;
 };
 
+/*
+ * An Output collects the text of a command in a large buffer that is written
+ * to the current target only when the buffer fills, when the target changes
+ * or when the command finishes, and formats integers itself, so that commands
+ * that write millions of lines do not pay for a stream call per value.  The
+ * base used for integers is kept per target, as it would be by the streams,
+ * and std::hex and std::dec change it for the current target.
+ */
 class Output {
  public:
-  Output() { _outputStack.push(&std::cout); }
-  ~Output() {}
+  static constexpr size_t BUFFER_SIZE = 0x40000;
+  Output() : Output(std::cout) {}
+  Output(std::ostream& baseOutput) : _used(0), _width(0) {
+    _targets.push({&baseOutput, 10});
+  }
+  ~Output() { Flush(); }
   bool PushTarget(const std::string& outputPath) {
     std::ofstream* output = new std::ofstream();
 
@@ -180,156 +199,289 @@ class Output {
       delete output;
       return false;
     }
-    _outputStack.push(output);
+    Flush();
+    _targets.push({output, 10});
     return true;
   }
   void PopTarget() {
-    delete _outputStack.top();
-    _outputStack.pop();
+    Flush();
+    delete _targets.top()._stream;
+    _targets.pop();
+  }
+
+  /*
+   * Return the current target, with anything buffered for it already
+   * written and with its base matching that of the Output.
+   */
+  std::ostream& GetTopOutputStream() {
+    Flush();
+    Target& target = _targets.top();
+    target._stream->setf((target._base == 16)
+                             ? std::ios_base::hex
+                             : (target._base == 8) ? std::ios_base::oct
+                                                   : std::ios_base::dec,
+                         std::ios_base::basefield);
+    return *(target._stream);
+  }
+
+  void Flush() {
+    if (_used != 0) {
+      _targets.top()._stream->write(_buffer.get(), _used);
+      _used = 0;
+    }
+  }
+
+  void width(int width) { _width = (width > 0) ? width : 0; }
+
+  void Manipulate(std::ios_base& (*manipulator)(std::ios_base&)) {
+    int& base = _targets.top()._base;
+    if (manipulator == static_cast<std::ios_base& (*)(std::ios_base&)>(
+                           std::hex)) {
+      base = 16;
+    } else if (manipulator ==
+               static_cast<std::ios_base& (*)(std::ios_base&)>(std::dec)) {
+      base = 10;
+    } else {
+      std::ostream& stream = GetTopOutputStream();
+      manipulator(stream);
+      std::ios_base::fmtflags baseFlags =
+          stream.flags() & std::ios_base::basefield;
+      base = (baseFlags == std::ios_base::hex)
+                 ? 16
+                 : (baseFlags == std::ios_base::oct) ? 8 : 10;
+    }
   }
-  std::ostream& GetTopOutputStream() { return *(_outputStack.top()); }
 
-  void width(int width) { _outputStack.top()->width(width); }
+  /*
+   * Return room in the buffer for the given number of characters, which
+   * must not exceed BUFFER_SIZE, to be filled in by the caller and then
+   * claimed with Commit.
+   */
+  char* Reserve(size_t numChars) {
+    if (!_buffer) {
+      _buffer.reset(new char[BUFFER_SIZE]);
+    }
+    if (_used + numChars > BUFFER_SIZE) {
+      Flush();
+    }
+    return _buffer.get() + _used;
+  }
+  void Commit(size_t numChars) { _used += numChars; }
+
+  void Put(char c) {
+    if (!_buffer || _used == BUFFER_SIZE) {
+      Reserve(1);
+    }
+    _buffer[_used++] = c;
+  }
+
+  void Write(const char* chars, size_t numChars) {
+    if (numChars >= BUFFER_SIZE) {
+      Flush();
+      _targets.top()._stream->write(chars, numChars);
+      return;
+    }
+    memcpy(Reserve(numChars), chars, numChars);
+    _used += numChars;
+  }
+  void Write(std::string_view chars) { Write(chars.data(), chars.size()); }
+
+  /*
+   * Write the given value in hexadecimal, without a prefix, padded on the
+   * left with blanks to the given width.
+   */
+  void WriteHex(uint64_t value, size_t width = 0) {
+    WriteDigits(value, 16, width);
+  }
+  void WriteDecimal(uint64_t value) { WriteDigits(value, 10, 0); }
+
+  /*
+   * Write text or an integer as the streams would, honoring the current base
+   * and any width set since the last such value.
+   */
+  void WriteText(std::string_view chars) {
+    PadToWidth(chars.size());
+    Write(chars);
+  }
+  template <typename T>
+  void WriteInteger(T value) {
+    static_assert(sizeof(T) <= sizeof(uint64_t), "integer is too wide");
+    int base = _targets.top()._base;
+    char digits[MAX_DIGITS];
+    std::to_chars_result result =
+        (base == 10)
+            ? std::to_chars(digits, digits + MAX_DIGITS, value)
+            : std::to_chars(digits, digits + MAX_DIGITS,
+                            static_cast<std::make_unsigned_t<T> >(value), base);
+    size_t numDigits = result.ptr - digits;
+    PadToWidth(numDigits);
+    Write(digits, numDigits);
+  }
 
   void HexDump(const uint64_t* image, uint64_t numBytes,
                bool showTrailingAscii) {
-    int headerWidth = 0;
-    if (numBytes > 0x20) {
-      headerWidth = 1;
-      for (size_t widthLimit = 0x10; numBytes > widthLimit; widthLimit <<= 4) {
-        headerWidth++;
-      }
-    }
-    int offset = 0;
-    std::ostream& topStream = *_outputStack.top();
-    topStream << std::hex;
-    for (const uint64_t* limit =
-             image + ((numBytes + sizeof(uint64_t) - 1) / sizeof(uint64_t));
-         image < limit; image++) {
-      if ((offset & 0x1f) == 0 && headerWidth != 0) {
-        topStream.width(headerWidth);
-        topStream << offset << ": ";
-      }
-      topStream.width(sizeof(uint64_t) * 2);
-      topStream << *image;
-      offset += sizeof(uint64_t);
-      if (offset & 0x1f) {
-        topStream << " ";
+    HexDumpWords(image, numBytes, showTrailingAscii);
+  }
+
+  void HexDump(const uint32_t* image, uint32_t numBytes,
+               bool showTrailingAscii) {
+    HexDumpWords(image, numBytes, showTrailingAscii);
+  }
+
+  /*
+   * The goal here is not to escape things in some reversable way but only
+   * to make it so the output is all printable ascii.
+   */
+  void ShowEscapedAscii(const char* chars, size_t numBytes) {
+    static const char hexDigits[] = "0123456789abcdef";
+    const char* limit = chars + numBytes;
+    bool escaped = false;
+    while (chars < limit) {
+      char c = *(chars++);
+      if ((c < ' ' || c > '~') && (c != '\t') && (c != '\r') && (c != '\n')) {
+        char* out = Reserve(4);
+        out[0] = '\\';
+        out[1] = 'x';
+        out[2] = hexDigits[(c >> 4) & 0xf];
+        out[3] = hexDigits[c & 0xf];
+        Commit(4);
+        escaped = true;
       } else {
-        if (showTrailingAscii) {
-          ShowTrailingAscii(topStream, 3, ((const char*)(image + 1)) - 0x20,
-                            0x20);
-        }
-        topStream << std::endl;
+        Put(c);
       }
     }
-    size_t trailing = offset & 0x1f;
-    if (trailing != 0) {
-      if (showTrailingAscii) {
-        size_t missing =
-            (0x20 - trailing) / sizeof(uint64_t) * (2 * sizeof(uint64_t) + 1) +
-            2;
-        ShowTrailingAscii(topStream, missing, ((const char*)(image)) - trailing,
-                          trailing);
-      }
-      topStream << std::endl;
+    if (escaped) {
+      // The escapes used to leave the stream in hexadecimal.
+      _targets.top()._base = 16;
     }
   }
 
-  void HexDump(const uint32_t* image, uint32_t numBytes,
-               bool showTrailingAscii) {
-    int headerWidth = 0;
+ private:
+  static constexpr size_t MAX_DIGITS = 24;
+  struct Target {
+    std::ostream* _stream;
+    int _base;
+  };
+  std::stack<Target> _targets;
+  std::unique_ptr<char[]> _buffer;
+  size_t _used;
+  size_t _width;
+
+  void PadToWidth(size_t numChars) {
+    if (_width > numChars) {
+      size_t numBlanks = _width - numChars;
+      memset(Reserve(numBlanks), ' ', numBlanks);
+      _used += numBlanks;
+    }
+    _width = 0;
+  }
+
+  void WriteDigits(uint64_t value, int base, size_t width) {
+    char* out = Reserve(MAX_DIGITS + width);
+    char digits[MAX_DIGITS];
+    size_t numDigits =
+        std::to_chars(digits, digits + MAX_DIGITS, value, base).ptr - digits;
+    size_t numBlanks = (width > numDigits) ? (width - numDigits) : 0;
+    memset(out, ' ', numBlanks);
+    memcpy(out + numBlanks, digits, numDigits);
+    _used += numBlanks + numDigits;
+  }
+
+  template <typename Word>
+  void HexDumpWords(const Word* image, Word numBytes, bool showTrailingAscii) {
+    size_t headerWidth = 0;
     if (numBytes > 0x20) {
       headerWidth = 1;
       for (size_t widthLimit = 0x10; numBytes > widthLimit; widthLimit <<= 4) {
         headerWidth++;
       }
     }
-    int offset = 0;
-    std::ostream& topStream = *_outputStack.top();
-    topStream << std::hex;
-    for (const uint32_t* limit =
-             image + ((numBytes + sizeof(uint32_t) - 1) / sizeof(uint32_t));
+    size_t offset = 0;
+    for (const Word* limit =
+             image + ((numBytes + sizeof(Word) - 1) / sizeof(Word));
          image < limit; image++) {
       if ((offset & 0x1f) == 0 && headerWidth != 0) {
-        topStream.width(headerWidth);
-        topStream << offset << ": ";
+        WriteHex(offset, headerWidth);
+        Write(": ", 2);
       }
-      topStream.width(sizeof(uint32_t) * 2);
-      topStream << *image;
-      offset += sizeof(uint32_t);
+      WriteHex(*image, sizeof(Word) * 2);
+      offset += sizeof(Word);
       if (offset & 0x1f) {
-        topStream << " ";
+        Put(' ');
       } else {
         if (showTrailingAscii) {
-          ShowTrailingAscii(topStream, 3, ((const char*)(image + 1)) - 0x20,
-                            0x20);
+          ShowTrailingAscii(3, ((const char*)(image + 1)) - 0x20, 0x20);
         }
-        topStream << std::endl;
+        Put('\n');
       }
     }
     size_t trailing = offset & 0x1f;
     if (trailing != 0) {
       if (showTrailingAscii) {
         size_t missing =
-            (0x20 - trailing) / sizeof(uint32_t) * (2 * sizeof(uint32_t) + 1) +
-            2;
-        ShowTrailingAscii(topStream, missing, ((const char*)(image)) - trailing,
+            (0x20 - trailing) / sizeof(Word) * (2 * sizeof(Word) + 1) + 2;
+        ShowTrailingAscii(missing, ((const char*)(image)) - trailing,
                           trailing);
       }
-      topStream << std::endl;
+      Put('\n');
     }
+    // The dump used to leave the stream in hexadecimal.
+    _targets.top()._base = 16;
   }
 
-  /*
-   * The goal here is not to escape things in some reversable way but only
-   * to make it so the output is all printable ascii.
-   */
-  void ShowEscapedAscii(const char* chars, size_t numBytes) {
-    std::ostream& topStream = *_outputStack.top();
-    const char* limit = chars + numBytes;
-    while (chars < limit) {
-      char c = *(chars++);
-      if ((c < ' ' || c > '~') && (c != '\t') && (c != '\r') && (c != '\n')) {
-        topStream << "\\x";
-        topStream << std::hex << (((int)(c >> 4)) & 0xf);
-        topStream << std::hex << (((int)(c)) & 0xf);
-      } else {
-        topStream << c;
-      }
-    }
-  }
-
- private:
-  std::stack<std::ostream*> _outputStack;
-  void ShowTrailingAscii(std::ostream& topStream, size_t numBlanks,
-                         const char* chars, size_t numBytes) {
-    for (size_t i = 0; i < numBlanks; i++) {
-      topStream << ' ';
-    }
-    const char* limit = chars + numBytes;
-    while (chars < limit) {
-      char c = *(chars++);
-      if (c < ' ' || c > '~') {
-        c = '.';
-      }
-      topStream << c;
+  void ShowTrailingAscii(size_t numBlanks, const char* chars,
+                         size_t numBytes) {
+    char* out = Reserve(numBlanks + numBytes);
+    memset(out, ' ', numBlanks);
+    out += numBlanks;
+    for (size_t i = 0; i < numBytes; i++) {
+      char c = chars[i];
+      out[i] = (c < ' ' || c > '~') ? '.' : c;
     }
+    _used += numBlanks + numBytes;
   }
 };
 
 template <typename T>
-Output& operator<<(Output& output, T v) {
-  output.GetTopOutputStream() << v;
+Output& operator<<(Output& output, const T& v) {
+  if constexpr (std::is_same_v<T, char> || std::is_same_v<T, signed char> ||
+                std::is_same_v<T, unsigned char>) {
+    output.WriteText(std::string_view((const char*)(&v), 1));
+  } else if constexpr (std::is_same_v<T, bool>) {
+    output.WriteText(v ? "1" : "0");
+  } else if constexpr (std::is_integral_v<T>) {
+    output.WriteInteger(v);
+  } else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+    output.WriteText(v);
+  } else {
+    output.GetTopOutputStream() << v;
+  }
+  return output;
+}
+
+inline Output& operator<<(Output& output,
+                          std::ios_base& (*manipulator)(std::ios_base&)) {
+  output.Manipulate(manipulator);
   return output;
 }
 
 class Error {
  public:
-  Error(const ScriptContext& scriptContext)
-      : _scriptContext(scriptContext), _contextWritePending(false) {}
+  /*
+   * If an Output is given, anything it has buffered is written before each
+   * error so that errors still follow the output that preceded them.
+   */
+  Error(const ScriptContext& scriptContext, Output* output = nullptr)
+      : _scriptContext(scriptContext),
+        _output(output),
+        _contextWritePending(false) {}
   ~Error() {}
   void SetContextWritePending() { _contextWritePending = true; }
+  void FlushOutput() {
+    if (_output != nullptr) {
+      _output->Flush();
+    }
+  }
   void FlushPendingErrorContext() {
     if (_contextWritePending) {
       if (!_scriptContext.empty()) {
@@ -349,6 +501,7 @@ class Error {
 
  private:
   const ScriptContext& _scriptContext;
+  Output* _output;
   bool _contextWritePending;
 };
 
@@ -358,6 +511,7 @@ class Error {
 //      of _error and output.
 template <typename T>
 Error& operator<<(Error& error, T v) {
+  error.FlushOutput();
   error.FlushPendingErrorContext();
   std::cerr << v;
   return error;
@@ -367,57 +521,26 @@ class Context {
  public:
   Context(Input& input, Output& output, Error& error,
           const std::string& redirectPrefix)
-      : _input(input),
-        _output(output),
+      : _output(output),
         _error(error),
         _redirectPrefix(redirectPrefix),
         _hasIllFormedSwitch(false) {
-    _input.GetTokens(_tokens);
-    _error.SetContextWritePending();
-    std::string switchName;
-    size_t argNum = 0;
-    for (std::vector<std::string>::const_iterator it = _tokens.begin();
-         it != _tokens.end(); ++it) {
-      const std::string& token = *it;
-      if (token.find('/') == 0) {
-        if (!switchName.empty()) {
-          /*
-           * For now all switches are expected to take an
-           * argument.  If at some point this needs to be changed
-           * we can add some way to declare switches that don't take
-           * arguments.
-           */
-          _error << "Expected argument for switch " << switchName << "\n";
-          _hasIllFormedSwitch = true;
-        } else if (argNum == 0) {
-          _error << "No switches are allowed before the command name.\n";
-          _hasIllFormedSwitch = true;
-        }
-        switchName = token.substr(1);
-        if (switchName.empty()) {
-          _error << "An unexpected empty switch name was found.\n";
-          _hasIllFormedSwitch = true;
-        }
-      } else {
-        if (switchName.empty()) {
-          _positionalArguments.push_back(token);
-        } else {
-          _switchedArguments[switchName].push_back(token);
-          switchName = "";
-        }
-      }
-      argNum++;
-    }
-    if (!switchName.empty()) {
-      /*
-       * For now all switches are expected to take an
-       * argument.  If at some point this needs to be changed
-       * we can add some way to declare switches that don't take
-       * arguments.
-       */
-      _error << "Expected argument for switch " << switchName << "\n";
-      _hasIllFormedSwitch = true;
-    }
+    input.GetTokens(_tokens);
+    ParseTokens();
+  }
+
+  /*
+   * Create a context for a command that has already been split into
+   * tokens, as is done for commands run in batch mode.
+   */
+  Context(const Tokens& tokens, Output& output, Error& error,
+          const std::string& redirectPrefix)
+      : _output(output),
+        _error(error),
+        _redirectPrefix(redirectPrefix),
+        _hasIllFormedSwitch(false),
+        _tokens(tokens) {
+    ParseTokens();
   }
 
   ~Context() {
@@ -425,6 +548,7 @@ class Context {
       _output.PopTarget();
       _output << "Wrote results to " << _redirectPath << "\n";
     }
+    _output.Flush();
   }
 
   bool SetRedirectPathBySuffix() {
@@ -457,23 +581,41 @@ class Context {
     }
   }
 
+  /*
+   * Return the path to which output for the command would be redirected,
+   * based on the redirect prefix and either the /redirectSuffix switch or
+   * the arguments.  This is expected to be called only when the output is
+   * not already redirected.
+   */
+  std::string DefaultRedirectPath() {
+    _redirectPath = _redirectPrefix;
+    if (!SetRedirectPathBySuffix()) {
+      SetRedirectPathByArguments();
+    }
+
+    if (_redirectPath.size() > 255) {
+      /*
+       * Paths that are too long cause an error in the attempt to open them.
+       * This is typically exposed using large numbers of switches, as might
+       * happen with use of the /extend switch.  For now, just handle this
+       * by truncation.
+       */
+      _redirectPath.resize(255);
+    }
+    std::string redirectPath;
+    redirectPath.swap(_redirectPath);
+    return redirectPath;
+  }
+
   void StartRedirect() {
     if (_redirectPath.empty()) {
-      _redirectPath = _redirectPrefix;
-      if (!SetRedirectPathBySuffix()) {
-        SetRedirectPathByArguments();
-      }
-
-      if (_redirectPath.size() > 255) {
-        /*
-         * Paths that are too long cause an error in the attempt to open them.
-         * This is typically exposed using large numbers of switches, as might
-         * happen with use of the /extend switch.  For now, just handle this
-         * by truncation.
-         */
-        _redirectPath.resize(255);
-      }
+      StartRedirect(DefaultRedirectPath());
+    }
+  }
 
+  void StartRedirect(const std::string& redirectPath) {
+    if (_redirectPath.empty()) {
+      _redirectPath = redirectPath;
       if (!_output.PushTarget(_redirectPath)) {
         _error << "Failed to open " << _redirectPath << " for writing.\n";
         char* openFailCause = strerror(errno);
@@ -663,8 +805,55 @@ class Context {
   bool HasIllFormedSwitch() const { return _hasIllFormedSwitch; }
 
  private:
+  void ParseTokens() {
+    _error.SetContextWritePending();
+    std::string switchName;
+    size_t argNum = 0;
+    for (std::vector<std::string>::const_iterator it = _tokens.begin();
+         it != _tokens.end(); ++it) {
+      const std::string& token = *it;
+      if (token.find('/') == 0) {
+        if (!switchName.empty()) {
+          /*
+           * For now all switches are expected to take an
+           * argument.  If at some point this needs to be changed
+           * we can add some way to declare switches that don't take
+           * arguments.
+           */
+          _error << "Expected argument for switch " << switchName << "\n";
+          _hasIllFormedSwitch = true;
+        } else if (argNum == 0) {
+          _error << "No switches are allowed before the command name.\n";
+          _hasIllFormedSwitch = true;
+        }
+        switchName = token.substr(1);
+        if (switchName.empty()) {
+          _error << "An unexpected empty switch name was found.\n";
+          _hasIllFormedSwitch = true;
+        }
+      } else {
+        if (switchName.empty()) {
+          _positionalArguments.push_back(token);
+        } else {
+          _switchedArguments[switchName].push_back(token);
+          switchName = "";
+        }
+      }
+      argNum++;
+    }
+    if (!switchName.empty()) {
+      /*
+       * For now all switches are expected to take an
+       * argument.  If at some point this needs to be changed
+       * we can add some way to declare switches that don't take
+       * arguments.
+       */
+      _error << "Expected argument for switch " << switchName << "\n";
+      _hasIllFormedSwitch = true;
+    }
+  }
+
   ScriptContext _scriptContext;
-  Input& _input;
   Output& _output;
   Error& _error;
   const std::string& _redirectPrefix;
@@ -683,6 +872,16 @@ class Command {
   virtual void Run(Context& context) = 0;
   virtual void ShowHelpMessage(Context& context) = 0;
   const virtual std::string& GetName() const = 0;
+
+  /*
+   * Return true if the command, with the arguments in the given context,
+   * only reads state that is fixed once the analysis is done, so that it
+   * may be run at the same time as other such commands.
+   */
+  virtual bool CanRunConcurrently(Context& /* context */) const {
+    return false;
+  }
+
   virtual void GetSecondTokenCompletions(
       const std::
           string& /* prefix - commented out to avoid compiler warnings */,
@@ -705,7 +904,7 @@ class Runner {
       : _redirectPrefix(redirectPrefix),
         _redirect(false),
         _input(_scriptContext),
-        _error(_scriptContext),
+        _error(_scriptContext, &_output),
         _preCommandCallback(nullptr) {}
 
   void CompletionHook(char const* pref,
@@ -763,42 +962,43 @@ class Runner {
     }
   }
 
-  void ShowHelpMessage() {
-    _output << "Supported commands are:\nhelp\nredirect\nsource\n";
+  void ShowHelpMessage(Output& output) {
+    output << "Supported commands are:\nhelp\nredirect\nsource\n";
     for (std::map<std::string, Command*>::iterator it = _commands.begin();
          it != _commands.end(); ++it) {
-      _output << it->first << "\n";
+      output << it->first << "\n";
     }
-    _output << "Use \"help <command-name>\" for help on a specific"
-               " command.\n";
+    output << "Use \"help <command-name>\" for help on a specific"
+              " command.\n";
   }
 
   void HandleHelpCommand(Context& context) {
+    Output& output = context.GetOutput();
     size_t numTokens = context.GetNumTokens();
     if (numTokens == 1) {
-      ShowHelpMessage();
+      ShowHelpMessage(output);
     } else {
       const std::string& topic = context.TokenAt(1);
       if (topic == "redirect") {
-        _output << "Use \"redirect on\" to enable redirection"
-                   " of output to separate files per command.\n";
-        _output << "Use \"redirect off\" to disable redirection"
-                   " of output to separate files per\ncommand.\n";
+        output << "Use \"redirect on\" to enable redirection"
+                  " of output to separate files per command.\n";
+        output << "Use \"redirect off\" to disable redirection"
+                  " of output to separate files per\ncommand.\n";
       } else if (topic == "source") {
-        _output << "Use \"source <path>\" to run commands"
-                   " from the specified file.\n";
+        output << "Use \"source <path>\" to run commands"
+                  " from the specified file.\n";
       } else if (topic == "help") {
-        _output << "Use \"help <command-name>\" for help on"
-                   " the specified command.\n";
-        _output << "Use \"help\" with no arguments to see"
-                   " the following:\n";
-        ShowHelpMessage();
+        output << "Use \"help <command-name>\" for help on"
+                  " the specified command.\n";
+        output << "Use \"help\" with no arguments to see"
+                  " the following:\n";
+        ShowHelpMessage(output);
       } else {
         std::map<std::string, Command*>::iterator itCommands =
             _commands.find(topic);
         if (itCommands == _commands.end()) {
-          _output << "\"" << topic << "\" is not a valid command name.\n";
-          ShowHelpMessage();
+          output << "\"" << topic << "\" is not a valid command name.\n";
+          ShowHelpMessage(output);
         } else {
           itCommands->second->ShowHelpMessage(context);
         }
@@ -870,20 +1070,10 @@ class Runner {
           HandleSourceCommand(context);
         } else {
           bool redirectStarted = false;
-          std::map<std::string, std::list<CommandCallback> >::iterator it =
-              _commandCallbacks.find(command);
-          if (it != _commandCallbacks.end()) {
-            size_t mostTokensAccepted = 0;
-            std::list<CommandCallback>::iterator itBest = it->second.end();
-            for (std::list<CommandCallback>::iterator itCheck =
-                     it->second.begin();
-                 itCheck != it->second.end(); ++itCheck) {
-              size_t numTokensAccepted = (*itCheck)(context, true);
-              if (numTokensAccepted > mostTokensAccepted) {
-                mostTokensAccepted = numTokensAccepted;
-                itBest = itCheck;
-              }
-            }
+          size_t mostTokensAccepted = 0;
+          CommandCallback* bestCallback =
+              FindCommandCallback(context, mostTokensAccepted);
+          if (_commandCallbacks.find(command) != _commandCallbacks.end()) {
             if (mostTokensAccepted == 0) {
               _error << "unknown command " << command << "\n";
               _input.TerminateAllScripts();
@@ -902,7 +1092,7 @@ class Runner {
                 context.StartRedirect();
               }
               if (mostTokensAccepted == numTokens || mostTokensAccepted >= 2) {
-                (*itBest)(context, false);
+                (*bestCallback)(context, false);
                 continue;
               }
             }
@@ -935,6 +1125,57 @@ class Runner {
     replxx_history_free();
   }
 
+  /*
+   * Run the commands from the given files without prompting, against the
+   * same analysis, writing the output for each command to its own file in
+   * the given directory.  Consecutive commands that can run concurrently
+   * are run using at most the given number of threads, and the remaining
+   * commands are run one at a time, in order.
+   */
+  void RunBatch(const std::vector<std::string>& commandPaths,
+                const std::string& outputDirectory, size_t numThreads) {
+    if (mkdir(outputDirectory.c_str(), 0777) != 0 && errno != EEXIST) {
+      std::cerr << "Failed to create directory \"" << outputDirectory
+                << "\".\n";
+      return;
+    }
+    std::string redirectPrefix = outputDirectory;
+    redirectPrefix.append("/");
+    std::string::size_type slashPos = _redirectPrefix.find_last_of('/');
+    redirectPrefix.append((slashPos == std::string::npos)
+                              ? _redirectPrefix
+                              : _redirectPrefix.substr(slashPos + 1));
+
+    std::vector<std::unique_ptr<BatchCommand> > commands;
+    for (const std::string& commandPath : commandPaths) {
+      ReadBatchCommands(commandPath, redirectPrefix, commands);
+    }
+
+    size_t numCommands = commands.size();
+    size_t next = 0;
+    while (next < numCommands) {
+      if (_preCommandCallback != nullptr) {
+        _preCommandCallback();
+      }
+      size_t limit = next + 1;
+      if (commands[next]->_canRunConcurrently) {
+        while (limit < numCommands && commands[limit]->_canRunConcurrently) {
+          limit++;
+        }
+      }
+      RunInParallel(numThreads, limit - next, [&](size_t, size_t command) {
+        BatchCommand& batchCommand = *(commands[next + command]);
+        RunBatchCommand(batchCommand);
+        // This finishes any redirection, closing the output file.
+        batchCommand._context.reset();
+      });
+      for (; next < limit; next++) {
+        std::cout << commands[next]->_log.str();
+        commands[next].reset();
+      }
+    }
+  }
+
   ScriptContext _scriptContext;
   const std::string _redirectPrefix;
   bool _redirect;
@@ -944,6 +1185,143 @@ class Runner {
   std::map<std::string, std::list<CommandCallback> > _commandCallbacks;
   std::map<std::string, Command*> _commands;
   std::function<void()> _preCommandCallback;
+
+ private:
+  /*
+   * A BatchCommand holds everything needed to run one command in batch
+   * mode, so that commands can be run concurrently.  Anything written to the
+   * base output, such as the name of the file that holds the results, is
+   * kept in _log so that it can be shown in the order of the commands.
+   */
+  struct BatchCommand {
+    BatchCommand(const Tokens& tokens, const ScriptContext& scriptContext,
+                 const std::string& redirectPrefix)
+        : _scriptContext(scriptContext),
+          _output(_log),
+          _error(_scriptContext),
+          _context(new Context(tokens, _output, _error, redirectPrefix)),
+          _canRunConcurrently(false) {}
+    ScriptContext _scriptContext;
+    std::ostringstream _log;
+    Output _output;
+    Error _error;
+    std::unique_ptr<Context> _context;
+    std::string _redirectPath;
+    bool _canRunConcurrently;
+  };
+
+  /*
+   * Return the old style callback that accepts the most tokens of the
+   * command in the given context, setting mostTokensAccepted, or return
+   * nullptr if no callback accepts any tokens.
+   */
+  CommandCallback* FindCommandCallback(Context& context,
+                                       size_t& mostTokensAccepted) {
+    CommandCallback* bestCallback = nullptr;
+    mostTokensAccepted = 0;
+    std::map<std::string, std::list<CommandCallback> >::iterator it =
+        _commandCallbacks.find(context.TokenAt(0));
+    if (it != _commandCallbacks.end()) {
+      for (CommandCallback& callback : it->second) {
+        size_t numTokensAccepted = callback(context, true);
+        if (numTokensAccepted > mostTokensAccepted) {
+          mostTokensAccepted = numTokensAccepted;
+          bestCallback = &callback;
+        }
+      }
+    }
+    return bestCallback;
+  }
+
+  /*
+   * Append the commands from the given file, and from any files that it
+   * sources, to the given vector.  Each command is given a distinct path
+   * for its output, based on the given prefix.
+   */
+  void ReadBatchCommands(
+      const std::string& commandPath, const std::string& redirectPrefix,
+      std::vector<std::unique_ptr<BatchCommand> >& commands) {
+    ScriptContext scriptContext;
+    Input input(scriptContext);
+    if (!input.StartScript(commandPath)) {
+      return;
+    }
+    Tokens tokens;
+    while (true) {
+      input.GetTokens(tokens);
+      if (tokens.empty()) {
+        if (input.IsInScript()) {
+          // A sourced script just finished.
+          continue;
+        }
+        return;
+      }
+      const std::string& command = tokens[0];
+      if (command == "source") {
+        if (tokens.size() != 2) {
+          std::cerr << "usage:  source <chap-command-file-path>\n";
+        } else {
+          input.StartScript(tokens[1]);
+        }
+        continue;
+      }
+      if (command == "redirect") {
+        // The output of each command is always redirected in batch mode.
+        continue;
+      }
+      std::unique_ptr<BatchCommand> batchCommand(
+          new BatchCommand(tokens, scriptContext, redirectPrefix));
+      Context& context = *(batchCommand->_context);
+      if (context.HasIllFormedSwitch() && command.find('/') == 0) {
+        continue;
+      }
+      std::string redirectPath = context.DefaultRedirectPath();
+      size_t& numUses = _batchRedirectPathUses[redirectPath];
+      if (numUses++ != 0) {
+        redirectPath.append(".");
+        redirectPath.append(std::to_string(numUses));
+      }
+      batchCommand->_redirectPath = redirectPath;
+      if (!context.HasIllFormedSwitch() &&
+          _commandCallbacks.find(command) == _commandCallbacks.end()) {
+        Command* c = FindCommand(command);
+        batchCommand->_canRunConcurrently =
+            (c != nullptr) && c->CanRunConcurrently(context);
+      }
+      commands.push_back(std::move(batchCommand));
+    }
+  }
+
+  void RunBatchCommand(BatchCommand& batchCommand) {
+    Context& context = *(batchCommand._context);
+    Error& error = batchCommand._error;
+    context.StartRedirect(batchCommand._redirectPath);
+    if (!context.IsRedirected()) {
+      return;
+    }
+    const std::string& command = context.TokenAt(0);
+    if (command == "help") {
+      HandleHelpCommand(context);
+      return;
+    }
+    size_t mostTokensAccepted = 0;
+    CommandCallback* bestCallback =
+        FindCommandCallback(context, mostTokensAccepted);
+    if (bestCallback != nullptr &&
+        (mostTokensAccepted == context.GetNumTokens() ||
+         mostTokensAccepted >= 2)) {
+      (*bestCallback)(context, false);
+      return;
+    }
+    Command* c = FindCommand(command);
+    if (c == (Command*)(0)) {
+      error << "Command " << command << " is not recognized\n";
+    } else if (!context.HasIllFormedSwitch()) {
+      c->Run(context);
+    }
+  }
+
+  std::map<std::string, size_t> _batchRedirectPathUses;
 };
 
 }  // namespace Commands
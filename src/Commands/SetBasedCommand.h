@@ -49,6 +49,13 @@ class SetBasedCommand : public Command {
     }
   }
 
+  bool CanRunConcurrently(Context& context) const override {
+    std::map<std::string, Subcommand*>::const_iterator it =
+        _subcommands.find(context.Positional(1));
+    return (it != _subcommands.end()) &&
+           it->second->CanRunConcurrently(context);
+  }
+
   void ShowAvailableSets(Context& context) {
     Output& output = context.GetOutput();
     if (_subcommands.empty()) {
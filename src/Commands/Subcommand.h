@@ -1,4 +1,4 @@
-// Copyright (c) 2017 Broadcom. All Rights Reserved.
+// Copyright (c) 2017,2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
@@ -16,6 +16,14 @@ class Subcommand {
 
   virtual void ShowHelpMessage(Context& context) = 0;
 
+  /*
+   * Return true if the subcommand, with the arguments in the given context,
+   * may be run at the same time as other such subcommands.
+   */
+  virtual bool CanRunConcurrently(Context& /* context */) const {
+    return false;
+  }
+
   const std::string& GetCommandName() const { return _commandName; }
 
   const std::string& GetSetName() const { return _setName; }
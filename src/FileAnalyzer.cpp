@@ -1,4 +1,4 @@
-// Copyright (c) 2017,2021 Broadcom. All Rights Reserved.
+// Copyright (c) 2017,2021,2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
@@ -25,9 +25,34 @@ void FileAnalyzer::AddCommandCallbacks(Commands::Runner & /* r */) {}
 
 void PrintUsageAndExit(int exitCode,
                        const vector<string> supportedFileFormats) {
-  cerr << "Usage: chap [-t] <file>\n\n"
+  cerr << "Usage: chap [-t] [-c] [-j <threads>] [-l] [-v] [-Z] "
+          "[-m <megabytes>]\n"
+          "            [-b <commands>]... [-o <directory>] <file>\n"
+          "       chap [-j <threads>] -z <compressed-file> <file>\n\n"
           "-t means to just do truncation check then stop\n"
-          "   0 exit code means no truncation was found\n\n"
+          "   0 exit code means no truncation was found\n"
+          "-c means to use <file>.chapcache to save the results of the\n"
+          "   analysis, or to reuse those results if the cache is valid,\n"
+          "   and to keep signature names found in each module in\n"
+          "   $XDG_CACHE_HOME/chap (by default $HOME/.cache/chap)\n"
+          "-j sets the maximum number of threads used for analysis\n"
+          "   1 means to do all the analysis serially\n"
+          "   the default is one thread per processor\n"
+          "-l means to favor using less memory over speed, for example\n"
+          "   by not building an index to find allocations by address\n"
+          "   and by keeping the allocation graph in temporary files\n"
+          "-v means to report how long parts of the analysis take\n"
+          "   and the peak resident set size\n"
+          "-Z means that any part of a writable region that is missing\n"
+          "   from the end of its image in the core contains only zeros\n"
+          "-b means to run the commands in the given file, without\n"
+          "   prompting, and may be given more than once\n"
+          "-o sets the directory for the output of each command run\n"
+          "   because of -b, which is the current directory by default\n"
+          "-m sets how many megabytes of a compressed file are kept\n"
+          "   decompressed at once, which is 1024 by default\n"
+          "-z means to write a compressed copy of <file> that chap can\n"
+          "   open directly, then stop\n\n"
           "Supported file types include the following:\n\n";
   for (vector<string>::const_iterator it = supportedFileFormats.begin();
        it != supportedFileFormats.end(); ++it) {
@@ -61,16 +86,69 @@ int main(int argc, char **argv, char ** /* envp */) {
     supportedFileFormats.push_back((*it)->GetSupportedFileFormat());
   }
 
+  if (argc < 2) {
+    PrintUsageAndExit(1, supportedFileFormats);
+  }
   string path(argv[argc - 1]);
-  if ((argc < 2) || (argc > 3) || ((argc == 3) && (strcmp(argv[1], "-t"))) ||
-      (path[0] == '-')) {
+  if (path[0] == '-') {
     PrintUsageAndExit(1, supportedFileFormats);
   }
 
-  bool truncationCheckOnly = (argc == 3);
+  AnalysisOptions options;
+  vector<string> commandPaths;
+  string outputDirectory(".");
+  bool outputDirectorySet = false;
+  string compressedPath;
+  uint64_t compressedCacheSize = BlockCompressedImage::DEFAULT_CACHE_SIZE;
+  for (int i = 1; i < argc - 1; i++) {
+    if (!strcmp(argv[i], "-t")) {
+      options.truncationCheckOnly = true;
+    } else if (!strcmp(argv[i], "-c")) {
+      options.useAnalysisCache = true;
+    } else if (!strcmp(argv[i], "-l")) {
+      options.lowMemory = true;
+    } else if (!strcmp(argv[i], "-v")) {
+      options.verbose = true;
+    } else if (!strcmp(argv[i], "-Z")) {
+      options.omittedPagesAreZero = true;
+    } else if (!strcmp(argv[i], "-b") && i + 1 < argc - 1) {
+      commandPaths.push_back(argv[++i]);
+    } else if (!strcmp(argv[i], "-o") && i + 1 < argc - 1) {
+      outputDirectory = argv[++i];
+      outputDirectorySet = true;
+    } else if (!strcmp(argv[i], "-z") && i + 1 < argc - 1) {
+      compressedPath = argv[++i];
+    } else if (!strcmp(argv[i], "-m") && i + 1 < argc - 1) {
+      char *megabytesEnd;
+      uint64_t megabytes = strtoull(argv[++i], &megabytesEnd, 10);
+      if (*megabytesEnd != '\0' || megabytes == 0) {
+        PrintUsageAndExit(1, supportedFileFormats);
+      }
+      compressedCacheSize = megabytes << 20;
+    } else if (!strcmp(argv[i], "-j") && i + 1 < argc - 1) {
+      char *numThreadsEnd;
+      options.numThreads = strtoul(argv[++i], &numThreadsEnd, 10);
+      if (*numThreadsEnd != '\0' || options.numThreads == 0) {
+        PrintUsageAndExit(1, supportedFileFormats);
+      }
+    } else {
+      PrintUsageAndExit(1, supportedFileFormats);
+    }
+  }
+  if (outputDirectorySet && commandPaths.empty()) {
+    PrintUsageAndExit(1, supportedFileFormats);
+  }
+  bool truncationCheckOnly = options.truncationCheckOnly;
 
   try {
-    FileImage fileImage(path.c_str());
+    FileImage fileImage(path.c_str(), true, compressedCacheSize);
+    if (!compressedPath.empty()) {
+      exit(BlockCompressedImage::Write(fileImage.GetImage(),
+                                       fileImage.GetFileSize(), compressedPath,
+                                       NumWorkerThreads(options.numThreads))
+               ? 0
+               : 1);
+    }
     for (vector<FileAnalyzerFactory *>::iterator it = factories.begin();
          it != factories.end(); ++it) {
       /*
@@ -78,7 +156,7 @@ int main(int argc, char **argv, char ** /* envp */) {
        * find allocations eagerly unless we are only checking for truncation.
        */
       FileAnalyzer *analyzer =
-          (*it)->MakeFileAnalyzer(fileImage, truncationCheckOnly);
+          (*it)->MakeFileAnalyzer(fileImage, options);
       if (analyzer == 0) {
         continue;
       }
@@ -107,7 +185,12 @@ int main(int argc, char **argv, char ** /* envp */) {
         // TODO - the call to AddCommandCallbacks will become obsolete
         analyzer->AddCommandCallbacks(commandsRunner);
 
-        commandsRunner.RunCommands();
+        if (commandPaths.empty()) {
+          commandsRunner.RunCommands();
+        } else {
+          commandsRunner.RunBatch(commandPaths, outputDirectory,
+                                  NumWorkerThreads(options.numThreads));
+        }
       }
       delete analyzer;
       exit(0);
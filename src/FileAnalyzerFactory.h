@@ -5,6 +5,7 @@
 #pragma once
 
 #include <string>
+#include "AnalysisOptions.h"
 #include "FileAnalyzer.h"
 #include "FileImage.h"
 
@@ -29,7 +30,7 @@ class FileAnalyzerFactory {
    */
 
   virtual FileAnalyzer* MakeFileAnalyzer(const FileImage& fileImage,
-                                         bool truncationCheckOnly) = 0;
+                                         const AnalysisOptions& options) = 0;
 
  protected:
   const std::string _supportedFileFormat;
@@ -1,4 +1,4 @@
-// Copyright (c) 2017 Broadcom. All Rights Reserved.
+// Copyright (c) 2017,2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
@@ -13,10 +13,25 @@ extern "C" {
 #include <time.h>
 #include <unistd.h>
 };
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "BlockCompressedImage.h"
 namespace chap {
+/*
+ * A FileImage makes the contents of a file available as a read-only image
+ * in memory.  Normally the file is mapped directly, but if the file is a
+ * block compressed copy, as written by BlockCompressedImage::Write, the
+ * image is of the original file, and is decompressed on demand, keeping up
+ * to about compressedCacheSize bytes decompressed at once.
+ */
 class FileImage {
  public:
-  FileImage(const char *filePath, bool verboseOnFailure = true)
+  FileImage(const char *filePath, bool verboseOnFailure = true,
+            uint64_t compressedCacheSize =
+                BlockCompressedImage::DEFAULT_CACHE_SIZE)
       : _filePath(filePath),
         _fileSize(0)
 
@@ -66,6 +81,19 @@ class FileImage {
     }
     _fileSize = (uint64_t)fileSize;
 
+    if (_fileSize != 0 && BlockCompressedImage::IsBlockCompressed(_fd)) {
+      try {
+        _compressedImage.reset(new BlockCompressedImage(
+            _fd, _fileSize, compressedCacheSize, verboseOnFailure));
+      } catch (...) {
+        close(_fd);
+        throw;
+      }
+      _image = (char *)(_compressedImage->GetImage());
+      _fileSize = _compressedImage->GetImageSize();
+      return;
+    }
+
     if (_fileSize == 0) {
       if (verboseOnFailure) {
         std::cerr << "File " << _filePath << " is empty." << std::endl;
@@ -89,19 +117,106 @@ class FileImage {
     }
   }
   ~FileImage() {
-    (void)munmap(_image, _fileSize);
+    for (const auto &imageAndSize : _imagesWithZeroTails) {
+      (void)munmap(imageAndSize.first, imageAndSize.second);
+    }
+    if (_compressedImage) {
+      _compressedImage.reset();
+    } else {
+      (void)munmap(_image, _fileSize);
+    }
     if (_fd >= 0) {
       close(_fd);
     }
   }
   int _fd;
   const char *GetImage() const { return _image; }
+  /*
+   * Return the size of the image, which for a block compressed copy is the
+   * size of the original file.
+   */
   uint64_t GetFileSize() const { return _fileSize; }
   const std::string &GetFileName() const { return _filePath; }
 
+  /*
+   * Return a new image of the given size, lasting as long as this one, that
+   * starts with sizeInFile bytes at the given offset in this image and is
+   * all zeros after that, or null if no such image can be made.  The zeros
+   * use no memory beyond page tables.  Where possible the start of the new
+   * image is mapped from the file rather than copied.  For a block
+   * compressed copy, the start of the new image is filled in on demand,
+   * within the same limit as the rest of the decompressed image.
+   */
+  const char *ImageWithZeroTail(uint64_t offset, uint64_t sizeInFile,
+                                uint64_t size) const {
+    if (_compressedImage) {
+      return _compressedImage->ImageWithZeroTail(offset, sizeInFile, size);
+    }
+    if (size == 0 || sizeInFile > size || offset > _fileSize ||
+        sizeInFile > _fileSize - offset) {
+      return nullptr;
+    }
+    char *image = (char *)mmap(nullptr, size, PROT_READ,
+                               MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                               -1, 0);
+    if (image == (char *)(-1)) {
+      return nullptr;
+    }
+    uint64_t pageSize = (uint64_t)(sysconf(_SC_PAGESIZE));
+    uint64_t sizeMapped = 0;
+    if ((offset % pageSize) == 0) {
+      sizeMapped = sizeInFile & ~(pageSize - 1);
+      if (sizeMapped != 0 &&
+          mmap(image, sizeMapped, PROT_READ, MAP_PRIVATE | MAP_FIXED, _fd,
+               (off_t)(offset)) == MAP_FAILED) {
+        sizeMapped = 0;
+      }
+    }
+    if (sizeMapped < sizeInFile) {
+      char *copyStart = image + sizeMapped;
+      uint64_t sizeToCopy = sizeInFile - sizeMapped;
+      if (mprotect(copyStart, sizeToCopy, PROT_READ | PROT_WRITE) != 0) {
+        (void)munmap(image, size);
+        return nullptr;
+      }
+      memcpy(copyStart, _image + offset + sizeMapped, sizeToCopy);
+      (void)mprotect(copyStart, sizeToCopy, PROT_READ);
+    }
+    _imagesWithZeroTails.emplace_back(image, size);
+    return image;
+  }
+
+  /*
+   * Tell the kernel that the image is about to be read mostly in increasing
+   * order of address, or, if sequential is false, that it is back to being
+   * read at random.
+   */
+  void AdviseSequentialAccess(bool sequential) const {
+    if (_compressedImage) {
+      return;
+    }
+    (void)madvise(_image, _fileSize,
+                  sequential ? MADV_SEQUENTIAL : MADV_NORMAL);
+  }
+
+  /*
+   * Drop any pages of the image that are resident in the address space.
+   * This is safe at any time because the image is never written, so any
+   * page that is needed again is just read, or decompressed, again.
+   */
+  void ReleaseResidentPages() const {
+    if (_compressedImage) {
+      _compressedImage->DiscardAll();
+      return;
+    }
+    (void)madvise(_image, _fileSize, MADV_DONTNEED);
+  }
+
  private:
   std::string _filePath;
   uint64_t _fileSize;
   char *_image;
+  std::unique_ptr<BlockCompressedImage> _compressedImage;
+  mutable std::vector<std::pair<char *, uint64_t> > _imagesWithZeroTails;
 };
 }  // namespace chap
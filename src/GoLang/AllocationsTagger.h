@@ -35,7 +35,8 @@ class AllocationsTagger : public Allocations::Tagger<Offset> {
                     const InfrastructureFinder<Offset>& infrastructureFinder,
                     size_t mappedPageRangeAllocationFinderIndex,
                     const VirtualAddressMap<Offset>& virtualAddressMap)
-      : _graph(graph),
+      : Allocations::Tagger<Offset>("GoLang"),
+        _graph(graph),
         _directory(graph.GetAllocationDirectory()),
         _numAllocations(_directory.NumAllocations()),
         _tagHolder(tagHolder),
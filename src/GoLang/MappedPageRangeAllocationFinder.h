@@ -58,59 +58,22 @@ class MappedPageRangeAllocationFinder
   virtual ~MappedPageRangeAllocationFinder() {}
 
   /*
-   * Return true if there are no more allocations available.
+   * Append all the allocations found by this finder, in increasing order of
+   * address, to the given buffer.
    */
-  virtual bool Finished() { return _rangeIterator->Finished(); }
-
-  /*
-   * Return the address of the next allocation (in increasing order of
-   * address) to be reported by this finder, without advancing to the next
-   * allocation.  The return value is undefined if there are no more
-   * allocations available.  Note that at the time this function is called
-   * any allocations already reported by this allocation finder have already
-   * been assigned allocation indices in the Directory.
-   */
-  virtual Offset NextAddress() { return _allocationAddress; }
-  /*
-   * Return the size of the next allocation (in increasing order of
-   * address) to be reported by this finder, without advancing to the next
-   * allocation.  The return value is undefined if there are no more
-   * allocations available.
-   */
-  virtual Offset NextSize() { return _allocationSize; }
-  /*
-   * Return true if the next allocation (in increasing order of address) to
-   * address) to be reported by this finder is considered used, without
-   * advancing to the next allocation.
-   */
-  virtual bool NextIsUsed() { return _allocationIsUsed; }
-  /*
-   * Advance to the next allocation.
-   */
-  virtual void Advance() {
-    if (_rangeIterator->Finished()) {
-      return;
+  virtual void FindAllocations(
+      typename Allocations::Directory<Offset>::FoundAllocations& found) {
+    while (!(_rangeIterator->Finished())) {
+      found.emplace_back(_allocationAddress, _allocationSize,
+                         _allocationIsUsed);
+      Advance();
     }
-
-    if (++_indexInRange < _numAllocationsInRange) {
-      _allocationAddress += _allocationSize;
-      if (_allocBits != 0) {
-        _allocationIsUsed =
-            ((_allocBitsReader.ReadU8(_allocBits + _indexInRange / 8, 0) &
-              (1 << (_indexInRange & 7))) != 0);
-      }
-      return;
-    }
-
-    _rangeIterator->Advance();
-    if (_rangeIterator->Finished()) {
-      CorrectAllocationFreeStatus();
-      return;
-    }
-
-    SetFirstAllocationFromIterator();
   }
-
+  /*
+   * Correct the free status of allocations that are on free lists, now
+   * that all the allocations have been assigned indices.
+   */
+  virtual void AllocationsResolved() { CorrectAllocationFreeStatus(); }
   /*
    * Return the smallest request size that might reasonably have resulted
    * in an allocation of the given size.
@@ -257,6 +220,32 @@ class MappedPageRangeAllocationFinder
       }
     }
   }
+
+  /*
+   * Advance to the next allocation.
+   */
+  void Advance() {
+    if (_rangeIterator->Finished()) {
+      return;
+    }
+
+    if (++_indexInRange < _numAllocationsInRange) {
+      _allocationAddress += _allocationSize;
+      if (_allocBits != 0) {
+        _allocationIsUsed =
+            ((_allocBitsReader.ReadU8(_allocBits + _indexInRange / 8, 0) &
+              (1 << (_indexInRange & 7))) != 0);
+      }
+      return;
+    }
+
+    _rangeIterator->Advance();
+    if (_rangeIterator->Finished()) {
+      return;
+    }
+
+    SetFirstAllocationFromIterator();
+  }
 };
 
 }  // namespace GoLang
@@ -1,4 +1,4 @@
-// Copyright (c) 2017-2019 Broadcom. All Rights Reserved.
+// Copyright (c) 2017-2019,2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
@@ -113,6 +113,10 @@ class KnownAddressDescriber : public Describer<Offset> {
       if ((flags & Attributes::IS_TRUNCATED) != 0) {
         output << "\nand is missing due to truncation of "
                   "the process image";
+      } else if ((flags & Attributes::IS_KNOWN_ZERO) != 0 &&
+                 address >= itMap.KnownZeroBase()) {
+        output << "\nand is known to contain only zeros, which are not "
+                  "stored in the process image";
       } else {
         output << "\nand is mapped into the process image";
       }
@@ -129,6 +133,9 @@ class KnownAddressDescriber : public Describer<Offset> {
       if ((flags & Attributes::IS_MAPPED) != 0) {
         if (flags & Attributes::IS_TRUNCATED) {
           output << "The region is missing due to a truncated process image.\n";
+        } else if (flags & Attributes::IS_KNOWN_ZERO) {
+          output << "The region is mapped in the process image except for "
+                    "zeros omitted\nfrom its end.\n";
         } else {
           output << "The region is fully mapped in the process image.\n";
         }
@@ -1,4 +1,4 @@
-// Copyright (c) 2020 Broadcom. All Rights Reserved.
+// Copyright (c) 2020,2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
@@ -6,6 +6,7 @@
 #include "../Allocations/Directory.h"
 #include "../CompoundDescriber.h"
 #include "../ModuleDirectory.h"
+#include "../Parallel.h"
 #include "../ThreadMap.h"
 #include "../UnfilledImages.h"
 #include "../VirtualAddressMap.h"
@@ -36,7 +37,7 @@ class FinderGroup {
               const ModuleDirectory<Offset>& moduleDirectory,
               Allocations::Directory<Offset>& allocationDirectory,
               const ThreadMap<Offset>& threadMap,
-              UnfilledImages<Offset>& unfilledImages)
+              UnfilledImages<Offset>& unfilledImages, size_t numThreads)
       : _virtualMemoryPartition(virtualMemoryPartition),
         _virtualAddressMap(virtualMemoryPartition.GetAddressMap()),
         _moduleDirectory(moduleDirectory),
@@ -63,6 +64,9 @@ class FinderGroup {
             _fastBinFreeStatusFixer, _doublyLinkedListCorruptionChecker,
             allocationDirectory));
       }
+      if (numThreads > 1) {
+        WalkRunsAndHeapsAhead(numThreads);
+      }
     }
     /*
      * Finding mmapped() allocations used for libc does not depend
@@ -94,6 +98,33 @@ class FinderGroup {
   }
 
  private:
+  /*
+   * Walk each main arena run and each heap into its own buffer, using up to
+   * the given number of threads.  The runs and heaps are disjoint and each
+   * finder reports its runs or heaps in increasing order of address, so the
+   * buffers, taken in order, are already sorted and need no further merging.
+   */
+  void WalkRunsAndHeapsAhead(size_t numThreads) {
+    size_t numRuns = _mainArenaAllocationFinder->NumRuns();
+    size_t numHeaps =
+        _heapAllocationFinder ? _heapAllocationFinder->NumHeaps() : 0;
+    if (numRuns + numHeaps < 2) {
+      return;
+    }
+    _mainArenaAllocationFinder->PrepareToWalkAhead();
+    if (numHeaps > 0) {
+      _heapAllocationFinder->PrepareToWalkAhead();
+    }
+    RunInParallel(numThreads, numRuns + numHeaps,
+                  [this, numRuns](size_t, size_t task) {
+                    if (task < numRuns) {
+                      _mainArenaAllocationFinder->WalkRunAhead(task);
+                    } else {
+                      _heapAllocationFinder->WalkHeapAhead(task - numRuns);
+                    }
+                  });
+  }
+
   VirtualMemoryPartition<Offset>& _virtualMemoryPartition;
   const VirtualAddressMap<Offset>& _virtualAddressMap;
   const ModuleDirectory<Offset>& _moduleDirectory;
@@ -1,8 +1,9 @@
-// Copyright (c) 2017-2020,2023 Broadcom. All Rights Reserved.
+// Copyright (c) 2017-2020,2023-2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
 #pragma once
+#include <vector>
 #include "../Allocations/Directory.h"
 #include "../VirtualAddressMap.h"
 #include "CorruptionSkipper.h"
@@ -10,6 +11,18 @@
 
 namespace chap {
 namespace LibcMalloc {
+/*
+ * This finds the allocations in the heaps used by libc malloc for arenas
+ * other than the main arena.  The heaps are normally walked one after
+ * another when the Directory asks for the allocations, but because each
+ * heap can be walked without knowing anything about any other heap, the
+ * caller may instead ask for the heaps to be walked ahead, possibly
+ * concurrently, into a buffer per heap, after which the finder just
+ * reports the buffered allocations in order of address.  A heap that is
+ * found to be corrupt while being walked ahead is walked again when the
+ * finder reaches it, so that any corruption is reported, and skipped, in
+ * the same order as before.
+ */
 template <class Offset>
 class HeapAllocationFinder : public Allocations::Directory<Offset>::Finder {
  public:
@@ -18,6 +31,9 @@ class HeapAllocationFinder : public Allocations::Directory<Offset>::Finder {
   typedef typename VirtualAddressMap<Offset>::RangeAttributes RangeAttributes;
   typedef typename std::set<Offset> OffsetSet;
 
+  typedef typename Allocations::Directory<Offset>::FoundAllocations
+      FoundAllocations;
+
   HeapAllocationFinder(const VirtualAddressMap<Offset>& addressMap,
                        const InfrastructureFinder<Offset>& infrastructureFinder,
                        CorruptionSkipper<Offset>& corruptionSkipper,
@@ -34,70 +50,98 @@ class HeapAllocationFinder : public Allocations::Directory<Offset>::Finder {
         _maxHeapSize(_infrastructureFinder.GetMaxHeapSize()),
         _heapHeaderSize(_infrastructureFinder.GetHeapHeaderSize()),
         _heapMap(_infrastructureFinder.GetHeaps()),
-        _heapMapIterator(_heapMap.begin()),
         _corruptionSkipper(corruptionSkipper),
         _fastBinFreeStatusFixer(fastBinFreeStatusFixer),
         _doublyLinkedListCorruptionChecker(doublyLinkedListCorruptionChecker) {
-    if (_heapMapIterator != _heapMap.end()) {
-      SkipHeaders();
-      Advance();
-    }
     _finderIndex = allocationDirectory.AddFinder(this);
   }
 
   virtual ~HeapAllocationFinder() {}
 
   /*
-   * Return true if there are no more allocations available.
+   * Return the number of heaps, each of which may be walked ahead
+   * separately.
    */
-  virtual bool Finished() { return _heapMapIterator == _heapMap.end(); }
+  size_t NumHeaps() const { return _heapMap.size(); }
 
   /*
-   * Return the address of the next allocation (in increasing order of
-   * address) to be reported by this finder, without advancing to the next
-   * allocation.  The return value is undefined if there are no more
-   * allocations available.  Note that at the time this function is called
-   * any allocations already reported by this allocation finder have already
-   * been assigned allocation indices in the Directory.
+   * Allow the heaps to be walked ahead.  This must be called, by a single
+   * thread, before any calls to WalkHeapAhead.
    */
-  virtual Offset NextAddress() { return _allocationAddress; }
+  void PrepareToWalkAhead() {
+    _walkedAhead.resize(_heapMap.size());
+    size_t heapIndex = 0;
+    for (auto it = _heapMap.begin(); it != _heapMap.end(); ++it) {
+      _walkedAhead[heapIndex++]._heapMapIterator = it;
+    }
+  }
+
   /*
-   * Return the size of the next allocation (in increasing order of
-   * address) to be reported by this finder, without advancing to the next
-   * allocation.  The return value is undefined if there are no more
-   * allocations available.
+   * Walk the given heap into its own buffer.  This may be called at the same
+   * time for different heaps, but must finish for all heaps before the
+   * allocations are found.
    */
-  virtual Offset NextSize() { return _allocationSize; }
+  void WalkHeapAhead(size_t heapIndex) {
+    WalkedAheadHeap& walkedAhead = _walkedAhead[heapIndex];
+    Reader reader(_addressMap);
+    HeapCursor cursor;
+    try {
+      SkipHeaders(walkedAhead._heapMapIterator, reader, false, cursor);
+      while (AdvanceToNextAllocationOfHeap(walkedAhead._heapMapIterator,
+                                           reader, false, cursor,
+                                           walkedAhead._found)) {
+      }
+    } catch (NotMapped&) {
+      cursor._corruptionFound = true;
+    }
+    if (cursor._corruptionFound) {
+      FoundAllocations().swap(walkedAhead._found);
+    } else {
+      walkedAhead._isComplete = true;
+    }
+  }
+
   /*
-   * Return true if the next allocation (in increasing order of address) to
-   * address) to be reported by this finder is considered used, without
-   * advancing to the next allocation.
+   * Append all the allocations in the heaps, in increasing order of
+   * address, to the given buffer.
    */
-  virtual bool NextIsUsed() { return _allocationIsUsed; }
+  virtual void FindAllocations(FoundAllocations& found) {
+    size_t heapIndex = 0;
+    for (auto it = _heapMap.begin(); it != _heapMap.end(); ++it) {
+      HeapCursor cursor;
+      SkipHeaders(it, _reader, true, cursor);
+      if (heapIndex < _walkedAhead.size() &&
+          _walkedAhead[heapIndex]._isComplete) {
+        FoundAllocations& walkedAheadFound = _walkedAhead[heapIndex]._found;
+        found.insert(found.end(), walkedAheadFound.begin(),
+                     walkedAheadFound.end());
+        FoundAllocations().swap(walkedAheadFound);
+      } else {
+        while (AdvanceToNextAllocationOfHeap(it, _reader, true, cursor,
+                                             found)) {
+        }
+      }
+      heapIndex++;
+    }
+  }
+
   /*
-   * Advance to the next allocation.
+   * Correct the free status of allocations on the fast bin lists of the
+   * non-main arenas and check the doubly linked free lists of those arenas.
    */
-  virtual void Advance() {
-    if (_heapMapIterator != _heapMap.end()) {
-      while (!AdvanceToNextAllocationOfHeap()) {
-        if (++_heapMapIterator == _heapMap.end()) {
-          for (auto keyAndValue : _arenas) {
-            if (keyAndValue.first != _mainArenaAddress) {
-              const typename InfrastructureFinder<Offset>::Arena& arena =
-                  keyAndValue.second;
-              _fastBinFreeStatusFixer.MarkFastBinItemsAsFree(arena, false,
-                                                             _finderIndex);
-              _doublyLinkedListCorruptionChecker
-                  .CheckDoublyLinkedListCorruption(arena);
-            }
-          }
-          return;
-        } else {
-          SkipHeaders();
-        }
+  virtual void AllocationsResolved() {
+    for (auto keyAndValue : _arenas) {
+      if (keyAndValue.first != _mainArenaAddress) {
+        const typename InfrastructureFinder<Offset>::Arena& arena =
+            keyAndValue.second;
+        _fastBinFreeStatusFixer.MarkFastBinItemsAsFree(arena, false,
+                                                       _finderIndex);
+        _doublyLinkedListCorruptionChecker.CheckDoublyLinkedListCorruption(
+            arena);
       }
     }
   }
+
   /*
    * Return the smallest request size that might reasonably have resulted
    * in an allocation of the given size.
@@ -107,6 +151,29 @@ class HeapAllocationFinder : public Allocations::Directory<Offset>::Finder {
   }
 
  private:
+  typedef typename InfrastructureFinder<Offset>::HeapMap::const_iterator
+      HeapMapConstIterator;
+  /*
+   * This holds the state of a walk through the chunks of a single heap.
+   */
+  struct HeapCursor {
+    HeapCursor() : _corruptionFound(false) {}
+    Offset _base;
+    Offset _limit;
+    Offset _chunkSize;
+    Offset _prevCheck;
+    Offset _check;
+    Offset _checkLimit;
+    Offset _sizeAndFlags;
+    Offset _top;
+    bool _corruptionFound;
+  };
+  struct WalkedAheadHeap {
+    WalkedAheadHeap() : _isComplete(false) {}
+    HeapMapConstIterator _heapMapIterator;
+    FoundAllocations _found;
+    bool _isComplete;
+  };
   const VirtualAddressMap<Offset>& _addressMap;
   typename VirtualAddressMap<Offset>::Reader _reader;
   const InfrastructureFinder<Offset>& _infrastructureFinder;
@@ -116,110 +183,122 @@ class HeapAllocationFinder : public Allocations::Directory<Offset>::Finder {
   const Offset _maxHeapSize;
   const Offset _heapHeaderSize;
   const typename InfrastructureFinder<Offset>::HeapMap& _heapMap;
-  typename InfrastructureFinder<Offset>::HeapMap::const_iterator
-      _heapMapIterator;
-  Offset _allocationAddress;
-  Offset _allocationSize;
-  bool _allocationIsUsed;
-  Offset _base;
-  Offset _limit;
-  Offset _chunkSize;
-  Offset _prevCheck;
-  Offset _check;
-  Offset _checkLimit;
-  Offset _sizeAndFlags;
-  Offset _top;
+  std::vector<WalkedAheadHeap> _walkedAhead;
   CorruptionSkipper<Offset>& _corruptionSkipper;
   FastBinFreeStatusFixer<Offset>& _fastBinFreeStatusFixer;
   DoublyLinkedListCorruptionChecker<Offset>& _doublyLinkedListCorruptionChecker;
   size_t _finderIndex;
 
-  void SkipHeaders() {
+  void SkipHeaders(HeapMapConstIterator heapMapIterator, Reader& reader,
+                   bool reportUnmappedHeap, HeapCursor& cursor) {
     const typename InfrastructureFinder<Offset>::Heap& heap =
-        _heapMapIterator->second;
-    _base = heap._address;
+        heapMapIterator->second;
+    cursor._base = heap._address;
     Offset size = heap._size;
     const char* heapImage;
-    Offset numBytesFound = _addressMap.FindMappedMemoryImage(_base, &heapImage);
+    Offset numBytesFound =
+        _addressMap.FindMappedMemoryImage(cursor._base, &heapImage);
     if (numBytesFound < size) {
-      std::cerr << "Heap at 0x" << std::hex << _base
-                << " is not fully mapped in the core.\n";
+      if (reportUnmappedHeap) {
+        std::cerr << "Heap at 0x" << std::hex << cursor._base
+                  << " is not fully mapped in the core.\n";
+      }
       size = numBytesFound;
     }
-    _limit = _base + size;
+    cursor._limit = cursor._base + size;
 
-    if ((heap._arenaAddress & ~(_maxHeapSize - 1)) == _base) {
-      _base += _heapHeaderSize + _arenaStructSize;
+    if ((heap._arenaAddress & ~(_maxHeapSize - 1)) == cursor._base) {
+      cursor._base += _heapHeaderSize + _arenaStructSize;
     } else {
-      _base += _heapHeaderSize;
+      cursor._base += _heapHeaderSize;
     }
 
-    _top = 0;
+    cursor._top = 0;
     typename InfrastructureFinder<Offset>::ArenaMap::const_iterator itArena =
         _arenas.find(heap._arenaAddress);
     if (itArena == _arenas.end()) {
       abort();
     }
-    _top = itArena->second._top;
+    cursor._top = itArena->second._top;
 
-    _sizeAndFlags = _reader.ReadOffset(_base + sizeof(Offset));
-    _chunkSize = 0;
-    _prevCheck = _base;
-    _check = _base;
-    _checkLimit = _limit - 4 * sizeof(Offset);
+    cursor._sizeAndFlags = reader.ReadOffset(cursor._base + sizeof(Offset));
+    cursor._chunkSize = 0;
+    cursor._prevCheck = cursor._base;
+    cursor._check = cursor._base;
+    cursor._checkLimit = cursor._limit - 4 * sizeof(Offset);
   }
 
-  bool AdvanceToNextAllocationOfHeap() {
+  /*
+   * Append the next chunk of the given heap to the given buffer, returning
+   * false if there are no more.  If corruption is found and skipCorruption
+   * is false, the walk just stops and the corruption is noted in the cursor.
+   */
+  bool AdvanceToNextAllocationOfHeap(HeapMapConstIterator heapMapIterator,
+                                     Reader& reader, bool skipCorruption,
+                                     HeapCursor& cursor,
+                                     FoundAllocations& found) {
     const typename InfrastructureFinder<Offset>::Heap& heap =
-        _heapMapIterator->second;
-    while (_check < _checkLimit) {
-      if (((_sizeAndFlags & 2) != 0) ||
-          ((sizeof(Offset) == 8) && ((_sizeAndFlags & sizeof(Offset)) != 0))) {
-        _check = HandleNonMainArenaCorruption(heap, _prevCheck);
-        if (_check != 0) {
-          _chunkSize = 0;
-          _sizeAndFlags = _reader.ReadOffset(_check + sizeof(Offset), 0xbadbad);
-          if (_sizeAndFlags != 0xbadbad) {
-            _prevCheck = _check;
+        heapMapIterator->second;
+    while (cursor._check < cursor._checkLimit) {
+      if (((cursor._sizeAndFlags & 2) != 0) ||
+          ((sizeof(Offset) == 8) &&
+           ((cursor._sizeAndFlags & sizeof(Offset)) != 0))) {
+        if (!skipCorruption) {
+          cursor._corruptionFound = true;
+          return false;
+        }
+        cursor._check = HandleNonMainArenaCorruption(heap, cursor._prevCheck);
+        if (cursor._check != 0) {
+          cursor._chunkSize = 0;
+          cursor._sizeAndFlags =
+              reader.ReadOffset(cursor._check + sizeof(Offset), 0xbadbad);
+          if (cursor._sizeAndFlags != 0xbadbad) {
+            cursor._prevCheck = cursor._check;
             continue;
           }
         }
         return false;
       }
-      _chunkSize = _sizeAndFlags & ~7;
-      if ((_chunkSize == 0) || (_chunkSize >= 0x10000000) ||
-          (_chunkSize > (_limit - _check))) {
-        _check = HandleNonMainArenaCorruption(heap, _prevCheck);
-        if (_check != 0) {
-          _chunkSize = 0;
-          _sizeAndFlags = _reader.ReadOffset(_check + sizeof(Offset), 0xbadbad);
-          if (_sizeAndFlags != 0xbadbad) {
-            _prevCheck = _check;
+      cursor._chunkSize = cursor._sizeAndFlags & ~7;
+      if ((cursor._chunkSize == 0) || (cursor._chunkSize >= 0x10000000) ||
+          (cursor._chunkSize > (cursor._limit - cursor._check))) {
+        if (!skipCorruption) {
+          cursor._corruptionFound = true;
+          return false;
+        }
+        cursor._check = HandleNonMainArenaCorruption(heap, cursor._prevCheck);
+        if (cursor._check != 0) {
+          cursor._chunkSize = 0;
+          cursor._sizeAndFlags =
+              reader.ReadOffset(cursor._check + sizeof(Offset), 0xbadbad);
+          if (cursor._sizeAndFlags != 0xbadbad) {
+            cursor._prevCheck = cursor._check;
             continue;
           }
         }
         return false;
       }
-      _allocationSize = _chunkSize - sizeof(Offset);
+      Offset allocationSize = cursor._chunkSize - sizeof(Offset);
       bool isFree = true;
-      if (_check + _chunkSize == _limit) {
-        _allocationSize -= sizeof(Offset);
+      if (cursor._check + cursor._chunkSize == cursor._limit) {
+        allocationSize -= sizeof(Offset);
       } else {
-        _sizeAndFlags =
-            _reader.ReadOffset(_check + sizeof(Offset) + _chunkSize, 0xbadbad);
-        if (_sizeAndFlags == 0xbadbad) {
+        cursor._sizeAndFlags = reader.ReadOffset(
+            cursor._check + sizeof(Offset) + cursor._chunkSize, 0xbadbad);
+        if (cursor._sizeAndFlags == 0xbadbad) {
           return false;
         }
-        isFree = ((_sizeAndFlags & 1) == 0) ||
-                 (_allocationSize < 3 * sizeof(Offset));
+        isFree = ((cursor._sizeAndFlags & 1) == 0) ||
+                 (allocationSize < 3 * sizeof(Offset));
       }
-      if ((_check + _allocationSize + 3 * sizeof(Offset) == _limit) &&
-          ((_sizeAndFlags & ~7) == 0)) {
+      if ((cursor._check + allocationSize + 3 * sizeof(Offset) ==
+           cursor._limit) &&
+          ((cursor._sizeAndFlags & ~7) == 0)) {
         break;
       }
-      _allocationAddress = _check + 2 * sizeof(Offset);
+      Offset allocationAddress = cursor._check + 2 * sizeof(Offset);
       if (isFree) {
-        if (_check == _top) {
+        if (cursor._check == cursor._top) {
           /*
            * If the entry is the top value for an arena, we want the size of the
            * allocation to include any writable bytes in the heap that follow
@@ -230,20 +309,18 @@ class HeapAllocationFinder : public Allocations::Directory<Offset>::Finder {
            * the heap, the total free count will be misleading.
            */
           typename VirtualAddressMap<Offset>::const_iterator itMap =
-              _addressMap.find(_top);
+              _addressMap.find(cursor._top);
           Offset endWritableInHeap = itMap.Limit();
-          Offset endHeapRange = _heapMapIterator->first + _maxHeapSize;
+          Offset endHeapRange = heapMapIterator->first + _maxHeapSize;
           if (endWritableInHeap > endHeapRange) {
             endWritableInHeap = endHeapRange;
           }
-          _allocationSize = endWritableInHeap - _allocationAddress;
+          allocationSize = endWritableInHeap - allocationAddress;
         }
-        _allocationIsUsed = false;
-      } else {
-        _allocationIsUsed = true;
       }
-      _prevCheck = _check;
-      _check += _chunkSize;
+      found.emplace_back(allocationAddress, allocationSize, !isFree);
+      cursor._prevCheck = cursor._check;
+      cursor._check += cursor._chunkSize;
       return true;
     }
     return false;
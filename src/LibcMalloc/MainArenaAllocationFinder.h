@@ -1,8 +1,9 @@
-// Copyright (c) 2017-2020 Broadcom. All Rights Reserved.
+// Copyright (c) 2017-2020,2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
 #pragma once
+#include <vector>
 #include "../Allocations/Directory.h"
 #include "../VirtualAddressMap.h"
 #include "CorruptionSkipper.h"
@@ -10,6 +11,13 @@
 
 namespace chap {
 namespace LibcMalloc {
+/*
+ * This finds the allocations in the runs of memory used by the main arena
+ * of libc malloc.  As with the HeapAllocationFinder, each run may be walked
+ * ahead into its own buffer, possibly at the same time as other runs or
+ * heaps are walked, and a run in which corruption is found while walking
+ * ahead is walked again when the allocations are found.
+ */
 template <class Offset>
 class MainArenaAllocationFinder
     : public Allocations::Directory<Offset>::Finder {
@@ -19,6 +27,9 @@ class MainArenaAllocationFinder
   typedef typename VirtualAddressMap<Offset>::RangeAttributes RangeAttributes;
   typedef typename std::set<Offset> OffsetSet;
 
+  typedef typename Allocations::Directory<Offset>::FoundAllocations
+      FoundAllocations;
+
   MainArenaAllocationFinder(
       const VirtualAddressMap<Offset>& addressMap,
       const InfrastructureFinder<Offset>& infrastructureFinder,
@@ -34,66 +45,93 @@ class MainArenaAllocationFinder
         _mainArena(
             _infrastructureFinder.GetArenas().find(_mainArenaAddress)->second),
         _mainArenaRuns(_infrastructureFinder.GetMainArenaRuns()),
-        _mainArenaRunsIterator(_mainArenaRuns.begin()),
         _corruptionSkipper(corruptionSkipper),
         _fastBinFreeStatusFixer(fastBinFreeStatusFixer),
         _doublyLinkedListCorruptionChecker(doublyLinkedListCorruptionChecker) {
-    if (_mainArenaRunsIterator != _mainArenaRuns.end()) {
-      StartMainArenaRun();
-      Advance();
-    }
     _finderIndex = allocationDirectory.AddFinder(this);
   }
 
   virtual ~MainArenaAllocationFinder() {}
 
   /*
-   * Return true if there are no more allocations available.
+   * Return the number of main arena runs, each of which may be walked ahead
+   * separately.
    */
-  virtual bool Finished() {
-    return _mainArenaRunsIterator == _mainArenaRuns.end();
-  }
+  size_t NumRuns() const { return _mainArenaRuns.size(); }
 
   /*
-   * Return the address of the next allocation (in increasing order of
-   * address) to be reported by this finder, without advancing to the next
-   * allocation.  The return value is undefined if there are no more
-   * allocations available.  Note that at the time this function is called
-   * any allocations already reported by this allocation finder have already
-   * been assigned allocation indices in the Directory.
+   * Allow the runs to be walked ahead.  This must be called, by a single
+   * thread, before any calls to WalkRunAhead.
    */
-  virtual Offset NextAddress() { return _allocationAddress; }
-  /*
-   * Return the size of the next allocation (in increasing order of
-   * address) to be reported by this finder, without advancing to the next
-   * allocation.  The return value is undefined if there are no more
-   * allocations available.
-   */
-  virtual Offset NextSize() { return _allocationSize; }
+  void PrepareToWalkAhead() {
+    _walkedAhead.resize(_mainArenaRuns.size());
+    size_t runIndex = 0;
+    for (auto it = _mainArenaRuns.begin(); it != _mainArenaRuns.end(); ++it) {
+      _walkedAhead[runIndex++]._mainArenaRunsIterator = it;
+    }
+  }
+
   /*
-   * Return true if the next allocation (in increasing order of address) to
-   * address) to be reported by this finder is considered used, without
-   * advancing to the next allocation.
+   * Walk the given run into its own buffer.  This may be called at the same
+   * time for different runs, but must finish for all runs before the
+   * allocations are found.
    */
-  virtual bool NextIsUsed() { return _allocationIsUsed; }
+  void WalkRunAhead(size_t runIndex) {
+    WalkedAheadRun& walkedAhead = _walkedAhead[runIndex];
+    Reader reader(_addressMap);
+    RunCursor cursor;
+    try {
+      StartMainArenaRun(walkedAhead._mainArenaRunsIterator, reader, cursor);
+      while (AdvanceToNextAllocationOfRun(reader, false, cursor,
+                                          walkedAhead._found)) {
+      }
+    } catch (NotMapped&) {
+      cursor._corruptionFound = true;
+    }
+    if (cursor._corruptionFound) {
+      FoundAllocations().swap(walkedAhead._found);
+    } else {
+      walkedAhead._isComplete = true;
+    }
+  }
+
   /*
-   * Advance to the next allocation.
+   * Append all the allocations in the main arena runs, in increasing order
+   * of address, to the given buffer.
    */
-  virtual void Advance() {
-    if (_mainArenaRunsIterator != _mainArenaRuns.end()) {
-      while (!AdvanceToNextAllocationOfRun()) {
-        if (++_mainArenaRunsIterator == _mainArenaRuns.end()) {
-          _fastBinFreeStatusFixer.MarkFastBinItemsAsFree(_mainArena, true,
-                                                         _finderIndex);
-          _doublyLinkedListCorruptionChecker.CheckDoublyLinkedListCorruption(
-              _mainArena);
-          return;
-        } else {
-          StartMainArenaRun();
+  virtual void FindAllocations(FoundAllocations& found) {
+    size_t runIndex = 0;
+    for (auto it = _mainArenaRuns.begin(); it != _mainArenaRuns.end(); ++it) {
+      RunCursor cursor;
+      StartMainArenaRun(it, _reader, cursor);
+      if (runIndex < _walkedAhead.size() &&
+          _walkedAhead[runIndex]._isComplete) {
+        FoundAllocations& walkedAheadFound = _walkedAhead[runIndex]._found;
+        found.insert(found.end(), walkedAheadFound.begin(),
+                     walkedAheadFound.end());
+        FoundAllocations().swap(walkedAheadFound);
+      } else {
+        while (AdvanceToNextAllocationOfRun(_reader, true, cursor, found)) {
         }
       }
+      runIndex++;
     }
   }
+
+  /*
+   * Correct the free status of allocations on the fast bin lists of the
+   * main arena and check the doubly linked free lists of that arena.
+   */
+  virtual void AllocationsResolved() {
+    if (_mainArenaRuns.empty()) {
+      return;
+    }
+    _fastBinFreeStatusFixer.MarkFastBinItemsAsFree(_mainArena, true,
+                                                   _finderIndex);
+    _doublyLinkedListCorruptionChecker.CheckDoublyLinkedListCorruption(
+        _mainArena);
+  }
+
   /*
    * Return the smallest request size that might reasonably have resulted
    * in an allocation of the given size.
@@ -103,75 +141,107 @@ class MainArenaAllocationFinder
   }
 
  private:
+  typedef typename InfrastructureFinder<Offset>::MainArenaRuns::const_iterator
+      MainArenaRunsConstIterator;
+  /*
+   * This holds the state of a walk through the chunks of a single run.
+   */
+  struct RunCursor {
+    RunCursor() : _corruptionFound(false) {}
+    Offset _base;
+    Offset _size;
+    Offset _limit;
+    Offset _chunkSize;
+    Offset _prevCheck;
+    Offset _check;
+    Offset _sizeAndFlags;
+    bool _corruptionFound;
+  };
+  struct WalkedAheadRun {
+    WalkedAheadRun() : _isComplete(false) {}
+    MainArenaRunsConstIterator _mainArenaRunsIterator;
+    FoundAllocations _found;
+    bool _isComplete;
+  };
   const VirtualAddressMap<Offset>& _addressMap;
   typename VirtualAddressMap<Offset>::Reader _reader;
   const InfrastructureFinder<Offset>& _infrastructureFinder;
   const Offset _mainArenaAddress;
   const typename InfrastructureFinder<Offset>::Arena& _mainArena;
   const typename InfrastructureFinder<Offset>::MainArenaRuns& _mainArenaRuns;
-  typename InfrastructureFinder<Offset>::MainArenaRuns::const_iterator
-      _mainArenaRunsIterator;
-  Offset _allocationAddress;
-  Offset _allocationSize;
-  bool _allocationIsUsed;
-  Offset _base;
-  Offset _size;
-  Offset _limit;
-  Offset _chunkSize;
-  Offset _prevCheck;
-  Offset _check;
-  Offset _checkLimit;
-  Offset _sizeAndFlags;
+  std::vector<WalkedAheadRun> _walkedAhead;
   CorruptionSkipper<Offset>& _corruptionSkipper;
   FastBinFreeStatusFixer<Offset>& _fastBinFreeStatusFixer;
   DoublyLinkedListCorruptionChecker<Offset>& _doublyLinkedListCorruptionChecker;
   size_t _finderIndex;
-  void StartMainArenaRun() {
-    _base = _mainArenaRunsIterator->first;
-    _size = _mainArenaRunsIterator->second;
-    _limit = _base + _size;
-    _sizeAndFlags = _reader.ReadOffset(_base + sizeof(Offset));
-    _chunkSize = 0;
-    _prevCheck = _base;
-    _check = _base;
+  void StartMainArenaRun(MainArenaRunsConstIterator mainArenaRunsIterator,
+                         Reader& reader, RunCursor& cursor) {
+    cursor._base = mainArenaRunsIterator->first;
+    cursor._size = mainArenaRunsIterator->second;
+    cursor._limit = cursor._base + cursor._size;
+    cursor._sizeAndFlags = reader.ReadOffset(cursor._base + sizeof(Offset));
+    cursor._chunkSize = 0;
+    cursor._prevCheck = cursor._base;
+    cursor._check = cursor._base;
   }
 
-  bool AdvanceToNextAllocationOfRun() {
-    while (_check < _limit) {
-      if ((_sizeAndFlags & (sizeof(Offset) | 6)) != 0) {
-        _check = HandleMainArenaCorruption(_prevCheck, _limit);
-        if (_check != 0) {
-          _chunkSize = 0;
-          _prevCheck = _check;
-          _sizeAndFlags = _reader.ReadOffset(_check + sizeof(Offset));
+  /*
+   * Append the next chunk of the run to the given buffer, returning false if
+   * there are no more.  If corruption is found and skipCorruption is false,
+   * the walk just stops and the corruption is noted in the cursor.
+   */
+  bool AdvanceToNextAllocationOfRun(Reader& reader, bool skipCorruption,
+                                    RunCursor& cursor,
+                                    FoundAllocations& found) {
+    while (cursor._check < cursor._limit) {
+      if ((cursor._sizeAndFlags & (sizeof(Offset) | 6)) != 0) {
+        if (!skipCorruption) {
+          cursor._corruptionFound = true;
+          return false;
+        }
+        cursor._check =
+            HandleMainArenaCorruption(cursor._prevCheck, cursor._limit);
+        if (cursor._check != 0) {
+          cursor._chunkSize = 0;
+          cursor._prevCheck = cursor._check;
+          cursor._sizeAndFlags =
+              reader.ReadOffset(cursor._check + sizeof(Offset));
           continue;
         }
         break;
       }
-      _chunkSize = _sizeAndFlags & ~7;
-
-      if ((_chunkSize == 0) || (_chunkSize > (_limit - _check))) {
-        _check = HandleMainArenaCorruption(_prevCheck, _limit);
-        if (_check != 0) {
-          _chunkSize = 0;
-          _prevCheck = _check;
-          _sizeAndFlags = _reader.ReadOffset(_check + sizeof(Offset));
+      cursor._chunkSize = cursor._sizeAndFlags & ~7;
+
+      if ((cursor._chunkSize == 0) ||
+          (cursor._chunkSize > (cursor._limit - cursor._check))) {
+        if (!skipCorruption) {
+          cursor._corruptionFound = true;
+          return false;
+        }
+        cursor._check =
+            HandleMainArenaCorruption(cursor._prevCheck, cursor._limit);
+        if (cursor._check != 0) {
+          cursor._chunkSize = 0;
+          cursor._prevCheck = cursor._check;
+          cursor._sizeAndFlags =
+              reader.ReadOffset(cursor._check + sizeof(Offset));
           continue;
         }
         break;
       }
-      _allocationAddress = _check + 2 * sizeof(Offset);
-      _allocationSize = _chunkSize - sizeof(Offset);
-      _allocationIsUsed = false;
-      if (_check + _chunkSize == _limit) {
-        _allocationSize -= sizeof(Offset);
+      Offset allocationAddress = cursor._check + 2 * sizeof(Offset);
+      Offset allocationSize = cursor._chunkSize - sizeof(Offset);
+      bool allocationIsUsed = false;
+      if (cursor._check + cursor._chunkSize == cursor._limit) {
+        allocationSize -= sizeof(Offset);
       } else {
-        _sizeAndFlags =
-            _reader.ReadOffset(_check + sizeof(Offset) + _chunkSize);
-        _allocationIsUsed = ((_sizeAndFlags & 1) != 0);
+        cursor._sizeAndFlags = reader.ReadOffset(
+            cursor._check + sizeof(Offset) + cursor._chunkSize);
+        allocationIsUsed = ((cursor._sizeAndFlags & 1) != 0);
       }
-      _prevCheck = _check;
-      _check += _chunkSize;
+      found.emplace_back(allocationAddress, allocationSize, allocationIsUsed);
+      cursor._prevCheck = cursor._check;
+      cursor._check += cursor._chunkSize;
       return true;
     }
     return false;
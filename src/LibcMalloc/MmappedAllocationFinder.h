@@ -1,4 +1,4 @@
-// Copyright (c) 2017-2020 Broadcom. All Rights Reserved.
+// Copyright (c) 2017-2020,2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
@@ -16,41 +16,17 @@ class MmappedAllocationFinder : public Allocations::Directory<Offset>::Finder {
         _virtualMemoryPartition(virtualMemoryPartition),
         _addressMap(virtualMemoryPartition.GetAddressMap()) {
     ScanForMmappedChunks();
-    _itNext = _mmappedChunks.begin();
   }
 
   /*
-   * Return true if there are no more allocations available.
+   * Append all the mmapped allocations, in increasing order of address, to
+   * the given buffer.
    */
-  virtual bool Finished() { return _itNext == _mmappedChunks.end(); }
-  /*
-   * Return the address of the next allocation (in increasing order of
-   * address) to be reported by this finder, without advancing to the next
-   * allocation.  The return value is undefined if there are no more
-   * allocations available.  Note that at the time this function is called
-   * any allocations already reported by this allocation finder have already
-   * been assigned allocation indices in the Directory.
-   */
-  virtual Offset NextAddress() { return _itNext->first + 2 * sizeof(Offset); }
-  /*
-   * Return the size of the next allocation (in increasing order of
-   * address) to be reported by this finder, without advancing to the next
-   * allocation.  The return value is undefined if there are no more
-   * allocations available.
-   */
-  virtual Offset NextSize() { return _itNext->second - 2 * sizeof(Offset); }
-  /*
-   * Return true if the next allocation (in increasing order of address) to
-   * address) to be reported by this finder is considered used, without
-   * advancing to the next allocation.
-   */
-  virtual bool NextIsUsed() { return true; }
-  /*
-   * Advance to the next allocation.
-   */
-  virtual void Advance() {
-    if (_itNext != _mmappedChunks.end()) {
-      ++_itNext;
+  virtual void FindAllocations(
+      typename Allocations::Directory<Offset>::FoundAllocations& found) {
+    for (const auto& addressAndSize : _mmappedChunks) {
+      found.emplace_back(addressAndSize.first + 2 * sizeof(Offset),
+                         addressAndSize.second - 2 * sizeof(Offset), true);
     }
   }
   /*
@@ -68,7 +44,6 @@ class MmappedAllocationFinder : public Allocations::Directory<Offset>::Finder {
   VirtualMemoryPartition<Offset>& _virtualMemoryPartition;
   const VirtualAddressMap<Offset>& _addressMap;
   std::map<Offset, Offset> _mmappedChunks;  // start -> size
-  typename std::map<Offset, Offset>::const_iterator _itNext;
 
   void ScanForMmappedChunksInRange(Offset base, Offset limit) {
     typename VirtualAddressMap<Offset>::Reader reader(_addressMap);
@@ -20,9 +20,9 @@ class ELFCore32FileAnalyzerFactory : public FileAnalyzerFactory {
    */
 
   virtual FileAnalyzer* MakeFileAnalyzer(const FileImage& fileImage,
-                                         bool truncationCheckOnly) {
+                                         const AnalysisOptions& options) {
     try {
-      return new ELFCoreFileAnalyzer<Elf32>(fileImage, truncationCheckOnly);
+      return new ELFCoreFileAnalyzer<Elf32>(fileImage, options);
     } catch (std::bad_alloc&) {
       std::cerr << "There is not enough memory on this server to process"
                    " this ELF file.\n";
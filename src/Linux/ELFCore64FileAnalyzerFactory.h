@@ -20,9 +20,9 @@ class ELFCore64FileAnalyzerFactory : public FileAnalyzerFactory {
    */
 
   virtual FileAnalyzer* MakeFileAnalyzer(const FileImage& fileImage,
-                                         bool truncationCheckOnly) {
+                                         const AnalysisOptions& options) {
     try {
-      return new ELFCoreFileAnalyzer<Elf64>(fileImage, truncationCheckOnly);
+      return new ELFCoreFileAnalyzer<Elf64>(fileImage, options);
     } catch (std::bad_alloc&) {
       std::cerr << "There is not enough memory on this server to process"
                    " this ELF file.\n";
@@ -1,9 +1,10 @@
-// Copyright (c) 2017-2019 Broadcom. All Rights Reserved.
+// Copyright (c) 2017-2019,2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
 #pragma once
 #include "../FileAnalyzer.h"
+#include "../Parallel.h"
 #include "../VirtualAddressMapCommandHandler.h"
 #include "ELFImage.h"
 #include "LinuxProcessImage.h"
@@ -15,16 +16,19 @@ template <class ElfImage>
 class ELFCoreFileAnalyzer : public FileAnalyzer {
  public:
   typedef typename ElfImage::Offset Offset;
-  ELFCoreFileAnalyzer(const FileImage& fileImage, bool truncationCheckOnly)
-      : _elfImage(fileImage),
+  ELFCoreFileAnalyzer(const FileImage& fileImage,
+                      const AnalysisOptions& options)
+      : _elfImage(fileImage, options.omittedPagesAreZero),
         _virtualAddressMap(_elfImage.GetVirtualAddressMap()),
         _virtualAddressMapCommandHandler(_virtualAddressMap) {
     if (_elfImage.GetELFType() == ET_CORE) {
       _processImage.reset(
-          new LinuxProcessImage<ElfImage>(_elfImage, truncationCheckOnly));
-      if (!truncationCheckOnly) {
+          new LinuxProcessImage<ElfImage>(_elfImage, options));
+      if (!options.truncationCheckOnly) {
         _processImageCommandHandler.reset(
-            new ProcessImageCommandHandler<ElfImage>(*(_processImage.get())));
+            new ProcessImageCommandHandler<ElfImage>(
+                *(_processImage.get()), NumWorkerThreads(options.numThreads),
+                options.lowMemory));
       }
     } else {
       std::cerr << "This image is an ELF file but not an ELF core.\n";
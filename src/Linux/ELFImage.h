@@ -1,4 +1,4 @@
-// Copyright (c) 2017,2021,2023 Broadcom. All Rights Reserved.
+// Copyright (c) 2017,2021,2023-2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
@@ -49,7 +49,7 @@ const char *const ELF64PRStatusRegInfo::REGISTER_NAMES[] = {
     "rip", "",    "",    "rsp", "",    "*fs-base*"};
 
 template <class Ehdr, class Phdr, class Shdr, class Nhdr, class Off, class Word,
-          class Dyn, unsigned char elfClass, class PRStatusRegInfo>
+          class Dyn, class Sym, unsigned char elfClass, class PRStatusRegInfo>
 class ELFImage {
  public:
   typedef Ehdr ElfHeader;
@@ -59,11 +59,18 @@ class ELFImage {
   typedef Off Offset;
   typedef Word ElfWord;
   typedef Dyn ElfDynamic;
+  typedef Sym ElfSymbol;
   static constexpr unsigned char EXPECTED_ELF_CLASS = elfClass;
   typedef RangeMapper<Offset, Offset> AddrToOffsetMap;
 
   static const Offset MAX_OFFSET = ~0;
-  ELFImage(const FileImage &fileImage)
+  /*
+   * If omittedPagesAreZero is set, the part of any writable region that is
+   * beyond the part stored in the file is known to contain only zeros, as
+   * for cores written by tools that omit trailing zero pages.  Otherwise
+   * that part is considered to be not mapped in the file.
+   */
+  ELFImage(const FileImage &fileImage, bool omittedPagesAreZero = false)
       : _fileImage(fileImage),
         _fileSize(fileImage.GetFileSize()),
         _image(fileImage.GetImage()),
@@ -143,7 +150,18 @@ class ELFImage {
            * the region in the file and the region in the address space but
            * gives a smaller size for the file image.
            */
-          if (_fileSize >= limit) {
+          bool hasKnownZeroTail =
+              size > sizeInFile && omittedPagesAreZero &&
+              (flags & PF_W) != 0 && _fileSize >= limit &&
+              _virtualAddressMap.AddRangeWithKnownZeroTail(
+                  base, size, sizeInFile, adjust, true, (flags & PF_R) != 0,
+                  true, (flags & PF_X) != 0);
+          if (hasKnownZeroTail) {
+            /*
+             * The region, including the zeros omitted from the end of its
+             * image in the file, is a single range.
+             */
+          } else if (_fileSize >= limit) {
             /*
              * The entire range that is supposed to be present in
              * the file is there.
@@ -168,7 +186,7 @@ class ELFImage {
             AddRangeToVirtualAddressMap(base + present, missing, adjust, false,
                                         flags);
           }
-          if (size > sizeInFile) {
+          if (size > sizeInFile && !hasKnownZeroTail) {
             AddRangeToVirtualAddressMap(base + sizeInFile, size - sizeInFile,
                                         adjust, false, flags);
           }
@@ -187,16 +205,21 @@ class ELFImage {
       }
     }
 
+    /*
+     * All the ranges are known, so the map can be made faster to search.
+     */
+    _virtualAddressMap.Freeze();
+
     // TODO: include section headers in calculation of
     // _expectedMinimumFileSize.
     _isTruncated = (_fileSize < _minimumExpectedFileSize);
 
     if (_elfHeader->e_type == ET_CORE) {
-      VisitNotes(
-          std::bind(&ELFImage<Ehdr, Phdr, Shdr, Nhdr, Off, Word, Dyn, elfClass,
-                              PRStatusRegInfo>::FindThreadsFromPRStatus,
-                    this, std::placeholders::_1, std::placeholders::_2,
-                    std::placeholders::_3));
+      VisitNotes(std::bind(
+          &ELFImage<Ehdr, Phdr, Shdr, Nhdr, Off, Word, Dyn, Sym, elfClass,
+                    PRStatusRegInfo>::FindThreadsFromPRStatus,
+          this, std::placeholders::_1, std::placeholders::_2,
+          std::placeholders::_3));
     }
   }
 
@@ -240,7 +263,8 @@ class ELFImage {
 
   typedef std::function<bool(std::string &,  // Normalized note name
                              const char *,   // Description
-                             ElfWord)        // Note type
+                             ElfWord,        // Note type
+                             ElfWord)        // Description size
                         >
       NoteVisitor;
 
@@ -340,7 +364,7 @@ class ELFImage {
           return false;
         }
 
-        if (visitor(name, pDescription, noteHeader->n_type)) {
+        if (visitor(name, pDescription, noteHeader->n_type, descLen)) {
           return true;
         }
         noteImage = pDescription +
@@ -350,6 +374,88 @@ class ELFImage {
     return false;
   }
 
+  /*
+   * Return the GNU build ID of the image as a string of hex digits, or an
+   * empty string if the image has no build ID note.
+   */
+  std::string GetBuildId() const {
+    std::string buildId;
+    VisitNotes([&buildId](std::string &noteName, const char *description,
+                          ElfWord noteType, ElfWord descriptionSize) {
+      if (noteName != "GNU" || noteType != NT_GNU_BUILD_ID) {
+        return false;
+      }
+      static const char hexDigits[] = "0123456789abcdef";
+      for (ElfWord i = 0; i < descriptionSize; i++) {
+        unsigned char c = (unsigned char)(description[i]);
+        buildId.push_back(hexDigits[c >> 4]);
+        buildId.push_back(hexDigits[c & 0xf]);
+      }
+      return true;
+    });
+    return buildId;
+  }
+
+  typedef std::function<bool(const char *,        // Symbol name
+                             const ElfSymbol &)>  // Symbol
+      SymbolVisitor;
+
+  /*
+   * Visit the named symbols in any symbol tables of the given type, either
+   * SHT_SYMTAB or SHT_DYNSYM, skipping any part of a table, or any name,
+   * that is not present in the image.
+   */
+  bool VisitSymbols(ElfWord tableType, SymbolVisitor visitor) const {
+    Offset sectionHeadersOffset = _elfHeader->e_shoff;
+    size_t entrySize = _elfHeader->e_shentsize;
+    size_t numSections = _elfHeader->e_shnum;
+    if (sectionHeadersOffset == 0 || entrySize < sizeof(SectionHeader) ||
+        sectionHeadersOffset > _fileSize ||
+        numSections > (_fileSize - sectionHeadersOffset) / entrySize) {
+      return false;
+    }
+    const char *headers = _image + sectionHeadersOffset;
+    for (size_t i = 0; i < numSections; i++) {
+      const SectionHeader *table =
+          (const SectionHeader *)(headers + i * entrySize);
+      if (table->sh_type != tableType || table->sh_link >= numSections ||
+          table->sh_entsize < sizeof(ElfSymbol) ||
+          table->sh_offset > _fileSize) {
+        continue;
+      }
+      const SectionHeader *strings =
+          (const SectionHeader *)(headers + table->sh_link * entrySize);
+      if (strings->sh_type != SHT_STRTAB || strings->sh_offset > _fileSize ||
+          strings->sh_size > _fileSize - strings->sh_offset) {
+        continue;
+      }
+      const char *stringsImage = _image + strings->sh_offset;
+      Offset stringsSize = strings->sh_size;
+      Offset tableSize = table->sh_size;
+      if (tableSize > _fileSize - table->sh_offset) {
+        tableSize = _fileSize - table->sh_offset;
+      }
+      const char *symbols = _image + table->sh_offset;
+      size_t numSymbols = tableSize / table->sh_entsize;
+      // The first entry of any symbol table is reserved.
+      for (size_t j = 1; j < numSymbols; j++) {
+        const ElfSymbol &symbol =
+            *((const ElfSymbol *)(symbols + j * table->sh_entsize));
+        if (symbol.st_name == 0 || symbol.st_name >= stringsSize) {
+          continue;
+        }
+        const char *name = stringsImage + symbol.st_name;
+        if (memchr(name, 0, stringsSize - symbol.st_name) == nullptr) {
+          continue;
+        }
+        if (visitor(name, symbol)) {
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
   const FileImage &GetFileImage() { return _fileImage; }
   Offset GetFileSize() const { return _fileSize; }
   Offset GetMinimumExpectedFileSize() const { return _minimumExpectedFileSize; }
@@ -427,11 +533,13 @@ class ELFImage {
 };
 
 typedef ELFImage<Elf32_Ehdr, Elf32_Phdr, Elf32_Shdr, Elf32_Nhdr, Elf32_Off,
-                 Elf32_Word, Elf32_Dyn, ELFCLASS32, ELF32PRStatusRegInfo>
+                 Elf32_Word, Elf32_Dyn, Elf32_Sym, ELFCLASS32,
+                 ELF32PRStatusRegInfo>
     Elf32;
 
 typedef ELFImage<Elf64_Ehdr, Elf64_Phdr, Elf64_Shdr, Elf64_Nhdr, Elf64_Off,
-                 Elf64_Word, Elf64_Dyn, ELFCLASS64, ELF64PRStatusRegInfo>
+                 Elf64_Word, Elf64_Dyn, Elf64_Sym, ELFCLASS64,
+                 ELF64PRStatusRegInfo>
     Elf64;
 
 }  // namespace Linux
@@ -1,4 +1,4 @@
-// Copyright (c) 2023 Broadcom. All Rights Reserved.
+// Copyright (c) 2023-2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
@@ -13,7 +13,9 @@ template <class ElfImage>
 class ELFModuleImage : public ModuleImage<typename ElfImage::Offset> {
  public:
   ELFModuleImage(const std::string& filePath)
-      : _fileImage(filePath.c_str(), false), _elfImage(_fileImage) {
+      : _fileImage(filePath.c_str(), false),
+        _elfImage(_fileImage),
+        _buildId(_elfImage.GetBuildId()) {
     uint16_t elfType = _elfImage.GetELFType();
     if (elfType != ET_EXEC && elfType != ET_DYN) {
       std::cerr << "Warning: there was an attempt to reference " << filePath
@@ -28,10 +30,13 @@ class ELFModuleImage : public ModuleImage<typename ElfImage::Offset> {
   }
   const FileImage& GetFileImage() const { return _fileImage; }
   const std::string& GetPath() const { return _fileImage.GetFileName(); }
+  const std::string& GetBuildId() const { return _buildId; }
+  const ElfImage& GetElfImage() const { return _elfImage; }
 
  private:
   FileImage _fileImage;
   ElfImage _elfImage;
+  const std::string _buildId;
 };
 }  // namespace Linux
 }  // namespace chap
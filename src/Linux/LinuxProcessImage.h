@@ -7,12 +7,16 @@
 #include <map>
 #include <regex>
 #include "../Allocations/TaggerRunner.h"
-#include "../CPlusPlus/Unmangler.h"
+#include "../CPlusPlus/UnmangledNameCache.h"
 #include "../LibcMalloc/FinderGroup.h"
 #include "../ProcessImage.h"
+#include "../ModuleSignatureNameIndex.h"
+#include "../ResourceUsage.h"
 #include "ELFImage.h"
+#include "ELFModuleImage.h"
 #include "ELFModuleImageFactory.h"
 #include "ModuleFinder.h"
+#include "ModuleSymbolTable.h"
 
 namespace chap {
 namespace Linux {
@@ -25,11 +29,13 @@ class LinuxProcessImage : public ProcessImage<typename ElfImage::Offset> {
   typedef typename AddressMap::Reader Reader;
   typedef typename VirtualAddressMap<Offset>::RangeAttributes RangeAttributes;
   typedef typename Allocations::SignatureDirectory<Offset> SignatureDirectory;
-  LinuxProcessImage(ElfImage& elfImage, bool truncationCheckOnly)
+  LinuxProcessImage(ElfImage& elfImage, const AnalysisOptions& options)
       : ProcessImage<Offset>(elfImage.GetVirtualAddressMap(),
                              elfImage.GetThreadMap(),
                              new ELFModuleImageFactory<ElfImage>()),
         _elfImage(elfImage),
+        _options(options),
+        _reportAnalysisProgress(true),
         _firstReadableStackGuardFound(false),
         _symdefsRead(false) {
     if (_elfImage.GetELFType() != ET_CORE) {
@@ -41,7 +47,7 @@ class LinuxProcessImage : public ProcessImage<typename ElfImage::Offset> {
       abort();
     }
 
-    if (truncationCheckOnly) {
+    if (options.truncationCheckOnly) {
       return;
     }
 
@@ -52,12 +58,15 @@ class LinuxProcessImage : public ProcessImage<typename ElfImage::Offset> {
     /*
      * This finds the large structures associated with libc malloc then
      * registers any relevant allocation finders with the allocation
-     * directory.
+     * directory.  Unless we are favoring less memory, the libc malloc heaps
+     * are walked ahead in parallel, which briefly holds a copy of the
+     * boundaries of every chunk.
      */
 
     _libcMallocFinderGroup.reset(new LibcMalloc::FinderGroup<Offset>(
         Base::_virtualMemoryPartition, Base::_moduleDirectory,
-        Base::_allocationDirectory, Base::_threadMap, Base::_unfilledImages));
+        Base::_allocationDirectory, Base::_threadMap, Base::_unfilledImages,
+        options.lowMemory ? 1 : NumWorkerThreads(options.numThreads)));
 
     Base::_pythonFinderGroup.Resolve();
     Base::_goLangFinderGroup.Resolve();
@@ -113,7 +122,7 @@ class LinuxProcessImage : public ProcessImage<typename ElfImage::Offset> {
      * Now that any allocation finders have been registered with the
      * allocaion directory, find out where all the allocations are.
      */
-    Base::_allocationDirectory.ResolveAllocationBoundaries();
+    Base::_allocationDirectory.ResolveAllocationBoundaries(!options.lowMemory);
 
     /*
      * Finding statically declared type_info structures depends on
@@ -137,23 +146,14 @@ class LinuxProcessImage : public ProcessImage<typename ElfImage::Offset> {
      */
     FindStaticAnchorRanges();
 
-    Base::_allocationGraph = new Allocations::Graph<Offset>(
-        Base::_virtualAddressMap, Base::_allocationDirectory, Base::_threadMap,
-        Base::_stackRegistry, _staticAnchorLimits, nullptr, nullptr);
-
     /*
-     * In Linux processes the current approach is to wait until the
-     * allocations have been found, then treat pointers at the start of
-     * the allocations to read only memory as signatures.  This means
-     * that the signatures can't be identified until the allocations have
-     * been found.
+     * The signatures are found later, when first needed, but whether a
+     * writable signature candidate is in a claimed range must be judged
+     * as of this point, before any ranges are claimed just to keep them
+     * from being treated as anchors.
      */
-
-    FindSignaturesInAllocations();
-
-    FindSignatureNamesFromBinaries();
-
-    WriteSymreqsFileIfNeeded();
+    _rangesClaimedBeforeSignatures =
+        Base::_virtualMemoryPartition.GetClaimedRanges();
 
     /*
      * We do this after finding the allocations, because there is
@@ -172,7 +172,10 @@ class LinuxProcessImage : public ProcessImage<typename ElfImage::Offset> {
      */
     Base::_virtualMemoryPartition.ClaimUnclaimedRangesAsUnknown();
 
-    Base::TagAllocations();
+    /*
+     * The signatures, allocation graph and allocation tags are calculated
+     * in ResolveAllocationAnalysis(), the first time they are needed.
+     */
   }
 
   LibcMalloc::FinderGroup<Offset>& GetLibcMallocFinderGroup() const {
@@ -180,7 +183,7 @@ class LinuxProcessImage : public ProcessImage<typename ElfImage::Offset> {
   }
 
   void RefreshSignaturesAndAnchors() {
-    if (!_symdefsRead) {
+    if (!_symdefsRead && Base::AllocationAnalysisIsResolved()) {
       ReadSymdefsFile();
     }
   }
@@ -188,6 +191,138 @@ class LinuxProcessImage : public ProcessImage<typename ElfImage::Offset> {
  private:
   std::unique_ptr<LibcMalloc::FinderGroup<Offset> > _libcMallocFinderGroup;
 
+  void ReportAnalysisProgress(const char* step) const {
+    if (_reportAnalysisProgress) {
+      std::cerr << step;
+    }
+  }
+
+  void ResolveAllocationAnalysis() override {
+    if (_options.truncationCheckOnly) {
+      return;
+    }
+
+    /*
+     * If allowed, the graph, signatures and tags are taken from the analysis
+     * cache, in which case the cache is known to have been created from the
+     * same core and the same allocations.
+     */
+    std::unique_ptr<AnalysisCache<Offset> > analysisCache;
+    bool restoredFromCache = false;
+    if (_options.useAnalysisCache) {
+      ReportAnalysisProgress("Reading analysis cache...\n");
+      analysisCache.reset(MakeAnalysisCache());
+      restoredFromCache = RestoreFromAnalysisCache(*analysisCache);
+    }
+
+    if (!restoredFromCache) {
+      ReportAnalysisProgress("Finding references between allocations...\n");
+      Base::_allocationGraph = new Allocations::Graph<Offset>(
+          Base::_virtualAddressMap, Base::_allocationDirectory,
+          Base::_threadMap, Base::_stackRegistry, _staticAnchorLimits, nullptr,
+          nullptr, NumWorkerThreads(_options.numThreads),
+          _options.lowMemory);
+
+      /*
+       * In Linux processes the current approach is to wait until the
+       * allocations have been found, then treat pointers at the start of
+       * the allocations to read only memory as signatures.  This means
+       * that the signatures can't be identified until the allocations have
+       * been found.
+       */
+
+      ReportAnalysisProgress("Finding signatures...\n");
+      FindSignaturesInAllocations();
+
+      FindSignatureNamesFromBinaries();
+    }
+
+    /*
+     * The anchors are not kept in the analysis cache, so they are named
+     * whether or not the rest of the analysis was restored from the cache.
+     */
+    ReportAnalysisProgress("Finding names in module symbol tables...\n");
+    FindNamesFromSymbolTables();
+
+    WriteSymreqsFileIfNeeded();
+
+    if (!restoredFromCache) {
+      ReportAnalysisProgress("Tagging allocations...\n");
+      Base::TagAllocations(NumWorkerThreads(_options.numThreads),
+                           _options.verbose);
+      if (analysisCache) {
+        WriteAnalysisCache(*analysisCache);
+      }
+    }
+
+    /*
+     * Any names already gathered by gdb for the signatures and anchors
+     * apply to the command that caused the analysis to be done.
+     */
+    if (!_symdefsRead) {
+      ReadSymdefsFile();
+    }
+
+    if (_options.verbose) {
+      Base::_unmangledNameCache.ReportUsage();
+      std::cerr << "Peak resident set size: 0x" << std::hex
+                << PeakResidentSetSize() << std::dec << " bytes\n";
+    }
+  }
+
+  /*
+   * Create an analysis cache that is considered valid only for a core
+   * with the same size, modification time, ELF header and program headers.
+   */
+  AnalysisCache<Offset>* MakeAnalysisCache() {
+    const FileImage& fileImage = _elfImage.GetFileImage();
+    uint64_t headersSize = _elfImage._elfHeader->e_phoff +
+                           (uint64_t)(_elfImage._elfHeader->e_phnum) *
+                               _elfImage._elfHeader->e_phentsize;
+    if (headersSize > fileImage.GetFileSize()) {
+      headersSize = fileImage.GetFileSize();
+    }
+    return new AnalysisCache<Offset>(fileImage, fileImage.GetImage(),
+                                     headersSize);
+  }
+
+  bool RestoreFromAnalysisCache(AnalysisCache<Offset>& analysisCache) {
+    AnalysisCacheReader* reader = analysisCache.Open();
+    if (reader == nullptr) {
+      return false;
+    }
+    if (Base::_allocationDirectory.MatchesCachedAllocations(*reader)) {
+      Base::_allocationGraph = new Allocations::Graph<Offset>(
+          Base::_virtualAddressMap, Base::_allocationDirectory,
+          Base::_threadMap, Base::_stackRegistry, nullptr, nullptr,
+          _options.lowMemory, *reader);
+      if (reader->Ok()) {
+        SignatureDirectory signatureDirectory;
+        if (signatureDirectory.Read(*reader) &&
+            Base::RestoreAllocationTags(*reader)) {
+          Base::_signatureDirectory = signatureDirectory;
+          analysisCache.Close();
+          return true;
+        }
+      }
+      delete Base::_allocationGraph;
+      Base::_allocationGraph = nullptr;
+    }
+    std::cerr << "Ignoring unusable analysis cache \""
+              << analysisCache.GetPath() << "\".\n";
+    analysisCache.Close();
+    return false;
+  }
+
+  void WriteAnalysisCache(AnalysisCache<Offset>& analysisCache) {
+    analysisCache.Write([this](AnalysisCacheWriter& writer) {
+      Base::_allocationDirectory.Write(writer);
+      Base::_allocationGraph->Write(writer);
+      Base::_signatureDirectory.Write(writer);
+      Base::WriteAllocationTags(writer);
+    });
+  }
+
   void FindModules() {
     ModuleFinder<ElfImage> moduleFinder(Base::_virtualMemoryPartition,
                                         Base::_fileMappedRangeDirectory,
@@ -347,9 +482,13 @@ class LinuxProcessImage : public ProcessImage<typename ElfImage::Offset> {
 
  private:
   ElfImage& _elfImage;
+  const AnalysisOptions _options;
+  bool _reportAnalysisProgress;
   bool _firstReadableStackGuardFound;
   bool _symdefsRead;
   std::map<Offset, Offset> _staticAnchorLimits;
+  typename VirtualMemoryPartition<Offset>::ClaimedRanges
+      _rangesClaimedBeforeSignatures;
 
   bool ParseOffset(const std::string& s, Offset& value) const {
     if (!s.empty()) {
@@ -365,22 +504,21 @@ class LinuxProcessImage : public ProcessImage<typename ElfImage::Offset> {
   }
   std::string CopyAndUnmangle(
       const VirtualAddressMap<Offset>& virtualAddressMap,
-      Offset mangledNameAddr) const {
+      Offset mangledNameAddr) {
     std::string unmangledName;
     Reader reader(virtualAddressMap);
     char buffer[1000];
     size_t numCopied =
         reader.ReadCString(mangledNameAddr, buffer, sizeof(buffer));
     if (numCopied != 0 && numCopied != sizeof(buffer)) {
-      CPlusPlus::Unmangler<Offset> unmangler(buffer, false);
-      unmangledName = unmangler.Unmangled();
+      unmangledName = Base::_unmangledNameCache.Unmangled(buffer, numCopied);
     }
     return unmangledName;
   }
 
   std::string GetUnmangledTypeinfoName(
       const VirtualAddressMap<Offset>& virtualAddressMap,
-      Offset signature) const {
+      Offset signature) {
     std::string emptySignatureName;
     Offset typeInfoPointerAddress = signature - sizeof(Offset);
 
@@ -529,7 +667,8 @@ class LinuxProcessImage : public ProcessImage<typename ElfImage::Offset> {
          * with a module or if not it will be in an area of memory that is not
          * yet analyzed by chap.
          */
-        if (Base::_virtualMemoryPartition.IsClaimed(signature)) {
+        if (_rangesClaimedBeforeSignatures.find(signature) !=
+            _rangesClaimedBeforeSignatures.end()) {
           Offset relativeSignature;
           Offset rangeBase = 0;
           Offset rangeSize = 0;
@@ -614,10 +753,52 @@ class LinuxProcessImage : public ProcessImage<typename ElfImage::Offset> {
     }
   }
 
+  /*
+   * This holds what is needed to find signature names from a given module,
+   * which is opened at most once per search for such names.
+   */
+  struct ModuleForSignatureNames {
+    ModuleForSignatureNames() : _moduleImage(nullptr) {}
+    // This is null if the module could not be opened.
+    const ModuleImage<Offset>* _moduleImage;
+    // This is set only if the module directory had no image of the module.
+    std::unique_ptr<ModuleImage<Offset> > _openedModuleImage;
+    std::unique_ptr<ModuleSignatureNameIndex<Offset> > _nameIndex;
+  };
+  typedef std::map<std::string, ModuleForSignatureNames>
+      RuntimePathToModuleForSignatureNames;
+
+  ModuleForSignatureNames& GetModuleForSignatureNames(
+      const std::string& runtimePath,
+      RuntimePathToModuleForSignatureNames& modules) {
+    auto emplaceResult = modules.emplace(std::piecewise_construct,
+                                         std::forward_as_tuple(runtimePath),
+                                         std::forward_as_tuple());
+    ModuleForSignatureNames& module = emplaceResult.first->second;
+    if (emplaceResult.second) {
+      /*
+       * Prefer the image already found for the module directory, which
+       * honors CHAP_MODULE_ROOTS and has been checked against the process
+       * image, but fall back to the module at its runtime path.
+       */
+      module._moduleImage = Base::_moduleDirectory.GetModuleImage(runtimePath);
+      if (module._moduleImage == nullptr) {
+        try {
+          module._openedModuleImage.reset(
+              new ELFModuleImage<ElfImage>(runtimePath));
+          module._moduleImage = module._openedModuleImage.get();
+        } catch (...) {
+          return module;
+        }
+      }
+      module._nameIndex.reset(new ModuleSignatureNameIndex<Offset>(
+          *module._moduleImage, _options.useAnalysisCache));
+    }
+    return module;
+  }
+
   void FindSignatureNamesFromBinaries() {
-    std::string modulePath;
-    std::unique_ptr<FileImage> fileImage;
-    std::unique_ptr<ElfImage> elfImage;
+    RuntimePathToModuleForSignatureNames modules;
     Reader reader(Base::_virtualAddressMap);
     typename SignatureDirectory::SignatureNameAndStatusConstIterator itEnd =
         Base::_signatureDirectory.EndSignatures();
@@ -633,30 +814,33 @@ class LinuxProcessImage : public ProcessImage<typename ElfImage::Offset> {
       Offset relativeSignature;
       Offset rangeBase = 0;
       Offset rangeSize = 0;
-      std::string newModulePath;
-      if (!Base::_moduleDirectory.Find(signature, newModulePath, rangeBase,
+      std::string modulePath;
+      if (!Base::_moduleDirectory.Find(signature, modulePath, rangeBase,
                                        rangeSize, relativeSignature)) {
         continue;
       }
-      if (newModulePath != modulePath) {
-        modulePath = newModulePath;
-        try {
-          fileImage.reset(new FileImage(modulePath.c_str(), false));
-          elfImage.reset(new ElfImage(*fileImage));
-        } catch (...) {
-          elfImage.reset(0);
-          continue;
-        }
-      }
-      if (elfImage == 0) {
+      ModuleForSignatureNames& module =
+          GetModuleForSignatureNames(modulePath, modules);
+      if (module._moduleImage == nullptr) {
         continue;
       }
-      const VirtualAddressMap<Offset>& virtualAddressMap =
-          elfImage->GetVirtualAddressMap();
       std::string typeinfoName;
-      typeinfoName =
-          GetUnmangledTypeinfoName(virtualAddressMap, relativeSignature);
+      if (module._nameIndex->Find(relativeSignature, typeinfoName)) {
+        Base::_signatureDirectory.MapSignatureNameAndStatus(
+            signature, typeinfoName,
+            SignatureDirectory::VTABLE_WITH_NAME_FROM_BINARY);
+        continue;
+      }
+      typeinfoName = GetUnmangledTypeinfoName(
+          module._moduleImage->GetVirtualAddressMap(), relativeSignature);
       if (typeinfoName.empty()) {
+        /*
+         * The typeinfo is not known from the module alone, as is normal
+         * for a shared library, where the pointer to the typeinfo is
+         * subject to relocation.  Still, the name of the typeinfo to which
+         * that pointer is relocated depends only on the module, so the
+         * name found using the process image is suitable for the index.
+         */
         Offset typeinfoAddr = reader.ReadOffset(signature - sizeof(Offset), 0);
         if (typeinfoAddr == 0) {
           continue;
@@ -667,31 +851,133 @@ class LinuxProcessImage : public ProcessImage<typename ElfImage::Offset> {
           continue;
         }
         Offset relativeNameAddr;
-        if (!Base::_moduleDirectory.Find(mangledNameAddr, newModulePath,
+        std::string nameModulePath;
+        if (!Base::_moduleDirectory.Find(mangledNameAddr, nameModulePath,
                                          rangeBase, rangeSize,
                                          relativeNameAddr)) {
           continue;
         }
-        if (newModulePath == modulePath) {
-          typeinfoName = CopyAndUnmangle(virtualAddressMap, relativeNameAddr);
-        } else {
-          try {
-            std::unique_ptr<FileImage> fileImageForName(
-                new FileImage(newModulePath.c_str(), false));
-            std::unique_ptr<ElfImage> elfImageForName(
-                new ElfImage(*fileImageForName));
-            typeinfoName = CopyAndUnmangle(
-                elfImageForName->GetVirtualAddressMap(), relativeNameAddr);
-          } catch (...) {
-          }
+        ModuleForSignatureNames& nameModule =
+            GetModuleForSignatureNames(nameModulePath, modules);
+        if (nameModule._moduleImage == nullptr) {
+          continue;
         }
+        typeinfoName = CopyAndUnmangle(
+            nameModule._moduleImage->GetVirtualAddressMap(), relativeNameAddr);
       }
       if (!typeinfoName.empty()) {
+        module._nameIndex->Add(relativeSignature, typeinfoName);
         Base::_signatureDirectory.MapSignatureNameAndStatus(
             signature, typeinfoName,
             SignatureDirectory::VTABLE_WITH_NAME_FROM_BINARY);
       }
     }
+    for (auto& runtimePathAndModule : modules) {
+      ModuleForSignatureNames& module = runtimePathAndModule.second;
+      if (module._nameIndex) {
+        module._nameIndex->WriteIfChanged();
+      }
+    }
+  }
+
+  typedef std::map<std::string, std::unique_ptr<ModuleSymbolTable<ElfImage> > >
+      RuntimePathToSymbolTable;
+
+  /*
+   * Find the symbol that contains the given address in any module that has
+   * been checked against the process image, building the symbol table for
+   * each such module the first time it is needed.
+   */
+  bool FindSymbol(Offset address, RuntimePathToSymbolTable& symbolTables,
+                  std::string& name, Offset& offsetInSymbol) {
+    std::string modulePath;
+    Offset rangeBase;
+    Offset rangeSize;
+    Offset relativeAddress;
+    if (!Base::_moduleDirectory.Find(address, modulePath, rangeBase,
+                                     rangeSize, relativeAddress)) {
+      return false;
+    }
+    auto emplaceResult = symbolTables.emplace(
+        modulePath, std::unique_ptr<ModuleSymbolTable<ElfImage> >());
+    std::unique_ptr<ModuleSymbolTable<ElfImage> >& symbolTable =
+        emplaceResult.first->second;
+    if (emplaceResult.second) {
+      const ELFModuleImage<ElfImage>* moduleImage =
+          dynamic_cast<const ELFModuleImage<ElfImage>*>(
+              Base::_moduleDirectory.GetModuleImage(modulePath));
+      if (moduleImage != nullptr) {
+        symbolTable.reset(new ModuleSymbolTable<ElfImage>(
+            moduleImage->GetElfImage(), moduleImage->GetBuildId()));
+      }
+    }
+    return symbolTable &&
+           symbolTable->Find(relativeAddress, name, offsetInSymbol);
+  }
+
+  /*
+   * Name any signatures that are still pending and any static anchors
+   * using the symbol tables of the modules, so that in most cases gdb need
+   * not be run to create a .symdefs file.  Names that do come from a
+   * .symdefs file take precedence.
+   */
+  void FindNamesFromSymbolTables() {
+    RuntimePathToSymbolTable symbolTables;
+    std::string name;
+    Offset offsetInSymbol;
+    typename SignatureDirectory::SignatureNameAndStatusConstIterator itEnd =
+        Base::_signatureDirectory.EndSignatures();
+    for (typename SignatureDirectory::SignatureNameAndStatusConstIterator it =
+             Base::_signatureDirectory.BeginSignatures();
+         it != itEnd; ++it) {
+      typename SignatureDirectory::Status status = it->second.second;
+      if (status != SignatureDirectory::UNWRITABLE_PENDING_SYMDEFS &&
+          status != SignatureDirectory::WRITABLE_MODULE_REFERENCE) {
+        continue;
+      }
+      if (!FindSymbol(it->first, symbolTables, name, offsetInSymbol)) {
+        continue;
+      }
+      /*
+       * As for names from gdb, the prefix of the name of a vtable and the
+       * offset in the symbol are not part of the name of a signature.
+       */
+      static const std::string VTABLE_FOR("vtable for ");
+      bool isVTable = (name.compare(0, VTABLE_FOR.size(), VTABLE_FOR) == 0);
+      if (isVTable) {
+        Base::_signatureDirectory.MapSignatureNameAndStatus(
+            it->first, name.substr(VTABLE_FOR.size()),
+            SignatureDirectory::VTABLE_WITH_NAME_FROM_SYMBOL_TABLE);
+      } else {
+        Base::_signatureDirectory.MapSignatureNameAndStatus(
+            it->first, name,
+            SignatureDirectory::UNWRITABLE_WITH_NAME_FROM_SYMBOL_TABLE);
+      }
+    }
+
+    const Allocations::Graph<Offset>& graph = *(Base::_allocationGraph);
+    const Allocations::Directory<Offset>& directory =
+        Base::_allocationDirectory;
+    typename Allocations::Directory<Offset>::AllocationIndex numAllocations =
+        directory.NumAllocations();
+    for (typename Allocations::Directory<Offset>::AllocationIndex i = 0;
+         i < numAllocations; ++i) {
+      if (!graph.IsStaticAnchorPoint(i) ||
+          !directory.AllocationAt(i)->IsUsed()) {
+        continue;
+      }
+      for (Offset anchor : graph.GetStaticAnchors(i)) {
+        if (!FindSymbol(anchor, symbolTables, name, offsetInSymbol)) {
+          continue;
+        }
+        if (offsetInSymbol != 0) {
+          std::ostringstream withOffset;
+          withOffset << name << " + " << std::dec << offsetInSymbol;
+          name = withOffset.str();
+        }
+        Base::_anchorDirectory.MapAnchorToName(anchor, name);
+      }
+    }
   }
 
   void AddSignatureRequestsToSymReqs(std::ofstream& gdbScriptFile) {
@@ -724,22 +1010,26 @@ class LinuxProcessImage : public ProcessImage<typename ElfImage::Offset> {
       if (!allocation->IsUsed() || !graph.IsStaticAnchorPoint(i)) {
         continue;
       }
-      const std::vector<Offset>* anchors = graph.GetStaticAnchors(i);
-      typename std::vector<Offset>::const_iterator itAnchorsEnd =
-          anchors->end();
-      for (typename std::vector<Offset>::const_iterator itAnchors =
-               anchors->begin();
-           itAnchors != itAnchorsEnd; ++itAnchors) {
-        gdbScriptFile << "printf \"ANCHOR " << std::hex << *itAnchors << "\\n\""
+      for (Offset anchor : graph.GetStaticAnchors(i)) {
+        if (!Base::_anchorDirectory.Name(anchor).empty()) {
+          // The anchor was named from a module symbol table.
+          continue;
+        }
+        gdbScriptFile << "printf \"ANCHOR " << std::hex << anchor << "\\n\""
                       << '\n'
-                      << "info symbol 0x" << std::hex << *itAnchors << '\n';
+                      << "info symbol 0x" << std::hex << anchor << '\n';
       }
     }
   }
-  void WriteSymreqsFileIfNeeded() {
+  std::string SymreqsPath() const {
     std::string symReqsPath(
         Base::_virtualAddressMap.GetFileImage().GetFileName());
     symReqsPath.append(".symreqs");
+    return symReqsPath;
+  }
+
+  void WriteSymreqsFileIfNeeded() {
+    std::string symReqsPath(SymreqsPath());
     std::ifstream symReqs;
     symReqs.open(symReqsPath.c_str());
     if (!symReqs.fail()) {
@@ -0,0 +1,189 @@
+// Copyright (c) 2024 Broadcom. All Rights Reserved.
+// The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
+// SPDX-License-Identifier: GPL-2.0
+
+#pragma once
+#include <cxxabi.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+#include "../FileImage.h"
+#include "ELFImage.h"
+
+namespace chap {
+namespace Linux {
+/*
+ * A ModuleSymbolTable allows finding the symbol that contains a given
+ * address in a module, relative to the module, using the .symtab and
+ * .dynsym sections of the module and of a separate debug file for the
+ * module, if one can be found by the build ID of the module.
+ *
+ * Separate debug files are looked up in the directories given by the
+ * colon separated list in CHAP_DEBUG_DIRECTORIES, or in /usr/lib/debug
+ * if that is not set, as .build-id/xx/yyyy.debug, where xx is the first
+ * byte of the build ID in hex and yyyy is the rest.
+ */
+template <class ElfImage>
+class ModuleSymbolTable {
+ public:
+  typedef typename ElfImage::Offset Offset;
+  typedef typename ElfImage::ElfSymbol ElfSymbol;
+
+  /*
+   * The given module image must remain valid as long as the symbol table
+   * is used, because the names of the symbols are not copied.
+   */
+  ModuleSymbolTable(const ElfImage& moduleImage, const std::string& buildId) {
+    AddSymbols(moduleImage);
+    if (!buildId.empty()) {
+      OpenDebugImage(buildId);
+      if (_debugElfImage) {
+        AddSymbols(*_debugElfImage);
+      }
+    }
+
+    /*
+     * Where several symbols start at the same address, keep only the one
+     * that is most likely to be what gdb would report.
+     */
+    std::stable_sort(_symbols.begin(), _symbols.end(),
+                     [](const Symbol& left, const Symbol& right) {
+                       if (left._address != right._address) {
+                         return left._address < right._address;
+                       }
+                       return left._rank < right._rank;
+                     });
+    _symbols.erase(std::unique(_symbols.begin(), _symbols.end(),
+                               [](const Symbol& left, const Symbol& right) {
+                                 return left._address == right._address;
+                               }),
+                   _symbols.end());
+  }
+
+  size_t NumSymbols() const { return _symbols.size(); }
+  bool HasDebugImage() const { return _debugElfImage != nullptr; }
+
+  /*
+   * Return true and set the unmangled name of the symbol that contains the
+   * given address, relative to the module, and the offset of the address
+   * within that symbol, if there is such a symbol.
+   */
+  bool Find(Offset relativeAddress, std::string& name,
+            Offset& offsetInSymbol) const {
+    typename std::vector<Symbol>::const_iterator it = std::upper_bound(
+        _symbols.begin(), _symbols.end(), relativeAddress,
+        [](Offset address, const Symbol& symbol) {
+          return address < symbol._address;
+        });
+    if (it == _symbols.begin()) {
+      return false;
+    }
+    const Symbol& symbol = *(--it);
+    offsetInSymbol = relativeAddress - symbol._address;
+    if (offsetInSymbol != 0 && offsetInSymbol >= symbol._size) {
+      return false;
+    }
+    name = Unmangled(symbol._name);
+    return true;
+  }
+
+ private:
+  struct Symbol {
+    Offset _address;
+    Offset _size;
+    const char* _name;
+    // Lower is preferred where symbols share an address.
+    int _rank;
+  };
+  std::vector<Symbol> _symbols;
+  std::unique_ptr<FileImage> _debugFileImage;
+  std::unique_ptr<ElfImage> _debugElfImage;
+
+  void AddSymbols(const ElfImage& elfImage) {
+    /*
+     * Sized global symbols are preferred over sized local ones, and symbols
+     * from .symtab, which is a superset of .dynsym if both are present, are
+     * preferred over symbols from .dynsym.
+     */
+    int tableRank = 0;
+    for (auto tableType : {SHT_SYMTAB, SHT_DYNSYM}) {
+      elfImage.VisitSymbols(tableType, [this, tableRank](
+                                           const char* name,
+                                           const ElfSymbol& symbol) {
+        unsigned char type = symbol.st_info & 0xf;
+        unsigned char binding = symbol.st_info >> 4;
+        if ((type != STT_OBJECT && type != STT_FUNC) ||
+            symbol.st_shndx == SHN_UNDEF || symbol.st_value == 0 ||
+            name[0] == 0) {
+          return false;
+        }
+        int rank = tableRank + ((symbol.st_size == 0) ? 4 : 0) +
+                   ((binding == STB_LOCAL) ? 2 : 0);
+        _symbols.push_back({(Offset)(symbol.st_value),
+                            (Offset)(symbol.st_size), name, rank});
+        return false;
+      });
+      tableRank++;
+    }
+  }
+
+  void OpenDebugImage(const std::string& buildId) {
+    if (buildId.size() < 3) {
+      return;
+    }
+    std::string debugDirectories("/usr/lib/debug");
+    const char* fromEnvironment = getenv("CHAP_DEBUG_DIRECTORIES");
+    if (fromEnvironment != nullptr) {
+      debugDirectories.assign(fromEnvironment);
+    }
+    std::string::size_type pos = 0;
+    while (pos <= debugDirectories.size()) {
+      std::string::size_type colonPos = debugDirectories.find(':', pos);
+      if (colonPos == std::string::npos) {
+        colonPos = debugDirectories.size();
+      }
+      std::string debugPath(debugDirectories.substr(pos, colonPos - pos));
+      pos = colonPos + 1;
+      if (debugPath.empty()) {
+        continue;
+      }
+      debugPath.append("/.build-id/")
+          .append(buildId, 0, 2)
+          .append("/")
+          .append(buildId, 2, std::string::npos)
+          .append(".debug");
+      try {
+        _debugFileImage.reset(new FileImage(debugPath.c_str(), false));
+        _debugElfImage.reset(new ElfImage(*_debugFileImage));
+      } catch (...) {
+        _debugElfImage.reset();
+        _debugFileImage.reset();
+        continue;
+      }
+      if (_debugElfImage->GetBuildId() == buildId) {
+        return;
+      }
+      std::cerr << "Warning: ignoring debug file " << debugPath
+                << " because its build ID does not match.\n";
+      _debugElfImage.reset();
+      _debugFileImage.reset();
+    }
+  }
+
+  static std::string Unmangled(const char* name) {
+    if (name[0] == '_' && name[1] == 'Z') {
+      int status;
+      char* unmangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+      if (unmangled != nullptr) {
+        std::string unmangledName(unmangled);
+        free(unmangled);
+        return unmangledName;
+      }
+    }
+    return std::string(name);
+  }
+};
+}  // namespace Linux
+}  // namespace chap
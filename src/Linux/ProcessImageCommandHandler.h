@@ -16,8 +16,9 @@ class ProcessImageCommandHandler
  public:
   typedef typename ElfImage::Offset Offset;
   typedef typename chap::ProcessImageCommandHandler<Offset> Base;
-  ProcessImageCommandHandler(const LinuxProcessImage<ElfImage>& processImage)
-      : Base(processImage),
+  ProcessImageCommandHandler(const LinuxProcessImage<ElfImage>& processImage,
+                             size_t numThreads, bool lowMemory)
+      : Base(processImage, numThreads, lowMemory),
         _libcMallocFinderGroup(processImage.GetLibcMallocFinderGroup()),
         _pythonFinderGroup(processImage.GetPythonFinderGroup()),
         _describeArenasSubcommand(
@@ -1,4 +1,4 @@
-// Copyright (c) 2023 Broadcom. All Rights Reserved.
+// Copyright (c) 2023-2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
@@ -106,6 +106,9 @@ class DescribeModules : public Commands::Subcommand {
           if ((flags & RangeAttributes::IS_TRUNCATED) != 0) {
             output << "\n   and is missing due to truncation of "
                       "the process image";
+          } else if ((flags & RangeAttributes::IS_KNOWN_ZERO) != 0) {
+            output << "\n   and is mapped into the process image, except "
+                      "for zeros\n   omitted from its end";
           } else {
             output << "\n   and is mapped into the process image";
           }
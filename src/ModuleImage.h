@@ -1,4 +1,4 @@
-// Copyright (c) 2023 Broadcom. All Rights Reserved.
+// Copyright (c) 2023-2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
@@ -13,5 +13,10 @@ class ModuleImage {
   const virtual VirtualAddressMap<Offset>& GetVirtualAddressMap() const = 0;
   const virtual FileImage& GetFileImage() const = 0;
   const virtual std::string& GetPath() const = 0;
+  /*
+   * Return an identifier of the particular build of the module, such as the
+   * GNU build ID of an ELF module, or an empty string if none is known.
+   */
+  const virtual std::string& GetBuildId() const = 0;
 };
 }  // namespace chap
@@ -0,0 +1,201 @@
+// Copyright (c) 2024 Broadcom. All Rights Reserved.
+// The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
+// SPDX-License-Identifier: GPL-2.0
+
+#pragma once
+extern "C" {
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+};
+#include <string>
+#include <unordered_map>
+#include "AnalysisCache.h"
+#include "ModuleImage.h"
+
+namespace chap {
+/*
+ * A ModuleSignatureNameIndex maps the addresses of signatures, relative to
+ * the module that contains them, to the names found for those signatures
+ * from the module.  The index can be kept in a file in the chap cache
+ * directory, which is $XDG_CACHE_HOME/chap or else $HOME/.cache/chap, so that
+ * the names need not be found again for other process images that use the
+ * same build of that module.  The file is never written next to the module
+ * itself, which is often a system library.
+ */
+template <typename Offset>
+class ModuleSignatureNameIndex {
+ public:
+  static constexpr const char* SUFFIX = ".chapnames";
+  /*
+   * The format must be changed any time the layout of the index or the
+   * way the names are derived changes.
+   */
+  static constexpr uint64_t FORMAT = 1;
+
+  ModuleSignatureNameIndex(const ModuleImage<Offset>& moduleImage,
+                           bool isPersistent)
+      : _isPersistent(isPersistent), _isChanged(false) {
+    if (!_isPersistent) {
+      return;
+    }
+    /*
+     * The build ID, if there is one, is what identifies the build of the
+     * module.  Otherwise the start of the module, which contains the ELF
+     * header and normally the program headers, is used along with the size
+     * and modification time of the module.
+     */
+    const std::string& buildId = moduleImage.GetBuildId();
+    const FileImage& fileImage = moduleImage.GetFileImage();
+    std::string path;
+    if (!GetIndexPath(fileImage.GetFileName(), buildId, path)) {
+      _isPersistent = false;
+      return;
+    }
+    if (!buildId.empty()) {
+      _cache.reset(new AnalysisCache<Offset>(fileImage, buildId.data(),
+                                             buildId.size(), path));
+    } else {
+      uint64_t headersSize = fileImage.GetFileSize();
+      if (headersSize > MAX_HEADERS_SIZE) {
+        headersSize = MAX_HEADERS_SIZE;
+      }
+      _cache.reset(new AnalysisCache<Offset>(fileImage, fileImage.GetImage(),
+                                             headersSize, path));
+    }
+    Read();
+  }
+
+  /*
+   * Return true and set the name if a name is known for the given signature.
+   */
+  bool Find(Offset relativeSignature, std::string& name) const {
+    typename RelativeSignatureToName::const_iterator it =
+        _names.find(relativeSignature);
+    if (it == _names.end()) {
+      return false;
+    }
+    name = it->second;
+    return true;
+  }
+
+  void Add(Offset relativeSignature, const std::string& name) {
+    if (_names.emplace(relativeSignature, name).second) {
+      _isChanged = true;
+    }
+  }
+
+  /*
+   * Save the index if names were added since it was read, creating the chap
+   * cache directory if needed.
+   */
+  void WriteIfChanged() {
+    if (!_isPersistent || !_isChanged) {
+      return;
+    }
+    const std::string& path = _cache->GetPath();
+    if (!MakeDirectories(path.substr(0, path.rfind('/')))) {
+      return;
+    }
+    _cache->Write([this](AnalysisCacheWriter& writer) {
+      writer.WriteValue<uint64_t>(FORMAT);
+      writer.WriteValue<uint64_t>(_names.size());
+      for (const auto& relativeSignatureAndName : _names) {
+        writer.WriteValue<Offset>(relativeSignatureAndName.first);
+        writer.WriteString(relativeSignatureAndName.second);
+      }
+    });
+    _isChanged = false;
+  }
+
+ private:
+  typedef std::unordered_map<Offset, std::string> RelativeSignatureToName;
+  static constexpr uint64_t MAX_HEADERS_SIZE = 0x1000;
+  bool _isPersistent;
+  bool _isChanged;
+  std::unique_ptr<AnalysisCache<Offset> > _cache;
+  RelativeSignatureToName _names;
+
+  /*
+   * The name of the index has the name of the module, so that the cache
+   * directory is easy to browse, then a hash of the full path of the module,
+   * so that modules with the same name in different directories don't share
+   * an index, then the build ID, if any.
+   */
+  static bool GetIndexPath(const std::string& modulePath,
+                           const std::string& buildId, std::string& path) {
+    const char* cacheHome = getenv("XDG_CACHE_HOME");
+    if (cacheHome != nullptr && cacheHome[0] == '/') {
+      path.assign(cacheHome);
+    } else {
+      const char* home = getenv("HOME");
+      if (home == nullptr || home[0] != '/') {
+        return false;
+      }
+      path.assign(home);
+      path.append("/.cache");
+    }
+    path.append("/chap/");
+    std::string::size_type lastSlash = modulePath.rfind('/');
+    path.append((lastSlash == std::string::npos)
+                    ? modulePath
+                    : modulePath.substr(lastSlash + 1));
+    uint64_t pathHash = 0xcbf29ce484222325ULL;
+    for (char c : modulePath) {
+      pathHash = (pathHash ^ (unsigned char)c) * 0x100000001b3ULL;
+    }
+    static const char hexDigits[] = "0123456789abcdef";
+    path.push_back('-');
+    for (int shift = 60; shift >= 0; shift -= 4) {
+      path.push_back(hexDigits[(pathHash >> shift) & 0xf]);
+    }
+    if (!buildId.empty()) {
+      path.push_back('-');
+      path.append(buildId);
+    }
+    path.append(SUFFIX);
+    return true;
+  }
+
+  static bool MakeDirectories(const std::string& directory) {
+    struct stat statBuf;
+    if (stat(directory.c_str(), &statBuf) == 0) {
+      return S_ISDIR(statBuf.st_mode) && access(directory.c_str(), W_OK) == 0;
+    }
+    std::string::size_type lastSlash = directory.rfind('/');
+    if (lastSlash != std::string::npos && lastSlash != 0 &&
+        !MakeDirectories(directory.substr(0, lastSlash))) {
+      return false;
+    }
+    return mkdir(directory.c_str(), 0755) == 0 || errno == EEXIST;
+  }
+
+  void Read() {
+    AnalysisCacheReader* reader = _cache->Open();
+    if (reader == nullptr) {
+      return;
+    }
+    uint64_t format = 0;
+    uint64_t numNames;
+    if (reader->ReadValue(format) && format == FORMAT &&
+        reader->ReadValue(numNames)) {
+      for (uint64_t i = 0; i < numNames; i++) {
+        Offset relativeSignature;
+        std::string name;
+        if (!reader->ReadValue(relativeSignature) ||
+            !reader->ReadString(name)) {
+          break;
+        }
+        _names.emplace(relativeSignature, name);
+      }
+    }
+    if (!reader->Ok() || format != FORMAT) {
+      std::cerr << "Ignoring unusable signature name index \""
+                << _cache->GetPath() << "\".\n";
+      _names.clear();
+    }
+    _cache->Close();
+  }
+};
+}  // namespace chap
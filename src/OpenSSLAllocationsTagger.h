@@ -32,7 +32,8 @@ class OpenSSLAllocationsTagger : public Allocations::Tagger<Offset> {
                            EdgePredicate& edgeIsFavored,
                            const ModuleDirectory<Offset>& moduleDirectory,
                            const VirtualAddressMap<Offset>& addressMap)
-      : _graph(graph),
+      : Allocations::Tagger<Offset>("OpenSSL"),
+        _graph(graph),
         _tagHolder(tagHolder),
         _edgeIsFavored(edgeIsFavored),
         _directory(graph.GetAllocationDirectory()),
@@ -0,0 +1,91 @@
+// Copyright (c) 2024 Broadcom. All Rights Reserved.
+// The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
+// SPDX-License-Identifier: GPL-2.0
+
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace chap {
+/*
+ * Return the number of worker threads to use, given a requested number where
+ * 0 means to use one per available processor.
+ */
+inline size_t NumWorkerThreads(size_t requested) {
+  if (requested != 0) {
+    return requested;
+  }
+  size_t numProcessors = std::thread::hardware_concurrency();
+  return (numProcessors == 0) ? 1 : numProcessors;
+}
+
+/*
+ * Return a reference to the number of threads that a call to RunInParallel
+ * from the current thread may use, which is 0 unless the current thread is
+ * itself running tasks for some other call to RunInParallel.
+ */
+inline size_t& NestedThreadLimit() {
+  static thread_local size_t limit = 0;
+  return limit;
+}
+
+/*
+ * Return the number of threads that a call to RunInParallel from the current
+ * thread would actually use, given the requested number.  A call made from a
+ * task of another call to RunInParallel gets only its share of the threads
+ * of that call, so that, for example, commands run concurrently in batch
+ * mode do not each start as many threads as were allowed for the batch.
+ */
+inline size_t ThreadsAllowed(size_t numThreads) {
+  size_t limit = NestedThreadLimit();
+  return (limit != 0 && numThreads > limit) ? limit : numThreads;
+}
+
+/*
+ * Run the given task for each task index in [0, numTasks), using at most
+ * numThreads threads, including the calling thread.  Each task is also told
+ * the index of the worker running it, which is less than the number of
+ * workers actually used, so that the caller can keep state, such as buffers,
+ * per worker rather than per task.  Tasks are claimed in increasing order
+ * but may finish in any order, so a task must not depend on the results of
+ * any other task.  This returns only after all the tasks have finished.
+ */
+inline void RunInParallel(size_t numThreads, size_t numTasks,
+                          std::function<void(size_t, size_t)> task) {
+  size_t numAllowed = ThreadsAllowed(numThreads);
+  numThreads = numAllowed;
+  if (numThreads > numTasks) {
+    numThreads = numTasks;
+  }
+  if (numThreads <= 1) {
+    for (size_t taskIndex = 0; taskIndex < numTasks; taskIndex++) {
+      task(0, taskIndex);
+    }
+    return;
+  }
+  size_t limitPerWorker = std::max<size_t>(1, numAllowed / numThreads);
+  std::atomic<size_t> nextTask(0);
+  auto worker = [&](size_t workerIndex) {
+    size_t& limit = NestedThreadLimit();
+    size_t savedLimit = limit;
+    limit = limitPerWorker;
+    for (size_t taskIndex = nextTask++; taskIndex < numTasks;
+         taskIndex = nextTask++) {
+      task(workerIndex, taskIndex);
+    }
+    limit = savedLimit;
+  };
+  std::vector<std::thread> threads;
+  threads.reserve(numThreads - 1);
+  for (size_t workerIndex = 1; workerIndex < numThreads; workerIndex++) {
+    threads.emplace_back(worker, workerIndex);
+  }
+  worker(0);
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+}  // namespace chap
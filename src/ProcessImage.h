@@ -3,6 +3,9 @@
 // SPDX-License-Identifier: GPL-2.0
 
 #pragma once
+#include <atomic>
+#include <mutex>
+#include "AnalysisCache.h"
 #include "Allocations/AnchorDirectory.h"
 #include "Allocations/Directory.h"
 #include "Allocations/EdgePredicate.h"
@@ -15,6 +18,7 @@
 #include "CPlusPlus/LongStringAllocationsTagger.h"
 #include "CPlusPlus/MapOrSetAllocationsTagger.h"
 #include "CPlusPlus/TypeInfoDirectory.h"
+#include "CPlusPlus/UnmangledNameCache.h"
 #include "CPlusPlus/UnorderedMapOrSetAllocationsTagger.h"
 #include "CPlusPlus/VectorAllocationsTagger.h"
 #include "FileMappedRangeDirectory.h"
@@ -55,6 +59,8 @@ class ProcessImage {
         _moduleDirectory(_virtualMemoryPartition, moduleImageFactory),
         _unfilledImages(virtualAddressMap),
         _allocationTagHolder(nullptr),
+        _edgeIsTainted(nullptr),
+        _edgeIsFavored(nullptr),
         _allocationGraph(nullptr),
         _pythonFinderGroup(_virtualMemoryPartition, _moduleDirectory,
                            _allocationDirectory, _unfilledImages),
@@ -68,7 +74,8 @@ class ProcessImage {
         _follyFibersInfrastructureFinder(
             _moduleDirectory, _virtualMemoryPartition, _stackRegistry),
         _typeInfoDirectory(_moduleDirectory, _virtualAddressMap,
-                           _allocationDirectory) {}
+                           _allocationDirectory, _unmangledNameCache),
+        _allocationAnalysisIsResolved(false) {}
 
   virtual ~ProcessImage() {
     if (_allocationGraph != nullptr) {
@@ -99,19 +106,29 @@ class ProcessImage {
     return _moduleDirectory;
   }
 
+  /*
+   * The signatures, anchor names, allocation graph and allocation tags are
+   * expensive to calculate for a large process image and are not needed by
+   * many commands, so they are calculated the first time any of them is
+   * requested, rather than when the process image is created.
+   */
   const Allocations::SignatureDirectory<Offset> &GetSignatureDirectory() const {
+    ResolveAllocationAnalysisIfNeeded();
     return _signatureDirectory;
   }
 
   Allocations::SignatureDirectory<Offset> &GetSignatureDirectory() {
+    ResolveAllocationAnalysisIfNeeded();
     return _signatureDirectory;
   }
 
   const Allocations::AnchorDirectory<Offset> &GetAnchorDirectory() const {
+    ResolveAllocationAnalysisIfNeeded();
     return _anchorDirectory;
   }
 
   Allocations::AnchorDirectory<Offset> &GetAnchorDirectory() {
+    ResolveAllocationAnalysisIfNeeded();
     return _anchorDirectory;
   }
 
@@ -120,25 +137,38 @@ class ProcessImage {
   }
 
   const Allocations::TagHolder<Offset> *GetAllocationTagHolder() const {
+    ResolveAllocationAnalysisIfNeeded();
     return _allocationTagHolder;
   }
 
   Allocations::TagHolder<Offset> *GetAllocationTagHolder() {
+    ResolveAllocationAnalysisIfNeeded();
     return _allocationTagHolder;
   }
 
   const Allocations::Graph<Offset> *GetAllocationGraph() const {
+    ResolveAllocationAnalysisIfNeeded();
     return _allocationGraph;
   }
 
   const Allocations::EdgePredicate<Offset> *GetEdgeIsTainted() const {
+    ResolveAllocationAnalysisIfNeeded();
     return _edgeIsTainted;
   }
 
   const Allocations::EdgePredicate<Offset> *GetEdgeIsFavored() const {
+    ResolveAllocationAnalysisIfNeeded();
     return _edgeIsFavored;
   }
 
+  /*
+   * Return true if the signatures, allocation graph and allocation tags
+   * have already been calculated.
+   */
+  bool AllocationAnalysisIsResolved() const {
+    return _allocationAnalysisIsResolved;
+  }
+
   const PThread::InfrastructureFinder<Offset> &GetPThreadInfrastructureFinder()
       const {
     return _pThreadInfrastructureFinder;
@@ -185,13 +215,27 @@ class ProcessImage {
   TCMalloc::FinderGroup<Offset> _TCMallocFinderGroup;
   PThread::InfrastructureFinder<Offset> _pThreadInfrastructureFinder;
   FollyFibers::InfrastructureFinder<Offset> _follyFibersInfrastructureFinder;
+  /*
+   * This is shared by everything that unmangles type names for the process
+   * image, so that each distinct name is unmangled only once.
+   */
+  CPlusPlus::UnmangledNameCache<Offset> _unmangledNameCache;
   CPlusPlus::TypeInfoDirectory<Offset> _typeInfoDirectory;
 
   /*
-   * Pre-tag all allocations.  This should be done just once, at the end
-   * of the constructor for the derived class.
+   * Calculate the signatures, allocation graph and allocation tags.  This is
+   * called at most once, by whichever thread first requests any of them, and
+   * so must not itself call any of the public getters for them.
    */
-  void TagAllocations() {
+  virtual void ResolveAllocationAnalysis() {}
+
+  /*
+   * Pre-tag all allocations.  This should be done just once, at the end of
+   * ResolveAllocationAnalysis() for the derived class.  The work is split
+   * across at most the given number of threads and, if reportTimes is set,
+   * the time used by each tagger is reported.
+   */
+  void TagAllocations(size_t numThreads, bool reportTimes) {
     _edgeIsTainted =
         new Allocations::EdgePredicate<Offset>(*_allocationGraph, false);
 
@@ -204,7 +248,7 @@ class ProcessImage {
 
     Allocations::TaggerRunner<Offset> runner(
         *_allocationGraph, *_allocationTagHolder, *_edgeIsTainted,
-        _signatureDirectory);
+        _signatureDirectory, numThreads, reportTimes);
 
     runner.RegisterTagger(
         new CPlusPlus::UnorderedMapOrSetAllocationsTagger<Offset>(
@@ -252,5 +296,53 @@ class ProcessImage {
 
     runner.ResolveAllAllocationTags();
   }
+
+  /*
+   * Restore the allocation tags, along with the tainted and favored edges,
+   * from an analysis cache as an alternative to calling TagAllocations().
+   */
+  bool RestoreAllocationTags(AnalysisCacheReader &reader) {
+    _edgeIsTainted =
+        new Allocations::EdgePredicate<Offset>(*_allocationGraph, false);
+
+    _edgeIsFavored =
+        new Allocations::EdgePredicate<Offset>(*_allocationGraph, false);
+
+    _allocationTagHolder = new Allocations::TagHolder<Offset>(
+        _allocationDirectory.NumAllocations(), *_edgeIsFavored,
+        *_edgeIsTainted);
+
+    if (_edgeIsTainted->Read(reader) && _edgeIsFavored->Read(reader) &&
+        _allocationTagHolder->Read(reader)) {
+      return true;
+    }
+    delete _allocationTagHolder;
+    _allocationTagHolder = nullptr;
+    delete _edgeIsFavored;
+    _edgeIsFavored = nullptr;
+    delete _edgeIsTainted;
+    _edgeIsTainted = nullptr;
+    return false;
+  }
+
+  void WriteAllocationTags(AnalysisCacheWriter &writer) const {
+    _edgeIsTainted->Write(writer);
+    _edgeIsFavored->Write(writer);
+    _allocationTagHolder->Write(writer);
+  }
+
+ private:
+  mutable std::once_flag _allocationAnalysisOnce;
+  mutable std::atomic<bool> _allocationAnalysisIsResolved;
+
+  void ResolveAllocationAnalysisIfNeeded() const {
+    if (_allocationAnalysisIsResolved) {
+      return;
+    }
+    std::call_once(_allocationAnalysisOnce, [this]() {
+      const_cast<ProcessImage<Offset> *>(this)->ResolveAllocationAnalysis();
+      _allocationAnalysisIsResolved = true;
+    });
+  }
 };
 }  // namespace chap
@@ -6,6 +6,7 @@
 #include "Allocations/Describer.h"
 #include "Allocations/PatternDescriberRegistry.h"
 #include "Allocations/Subcommands/DefaultSubcommands.h"
+#include "Allocations/Subcommands/SummarizeMemory.h"
 #include "Allocations/Subcommands/SummarizeSignatures.h"
 #include "AnnotatorRegistry.h"
 #include "CPlusPlus/COWStringBodyDescriber.h"
@@ -48,6 +49,7 @@
 #include "Python/PyDictKeysObjectDescriber.h"
 #include "Python/PyDictValuesArrayDescriber.h"
 #include "Python/SimplePythonObjectDescriber.h"
+#include "ReferenceScanner.h"
 #include "SSLDescriber.h"
 #include "SSL_CTXDescriber.h"
 #include "StackCommands/CountStacks.h"
@@ -72,7 +74,15 @@ template <typename Offset>
 class ProcessImageCommandHandler {
  public:
   typedef ProcessImageCommandHandler<Offset> ThisClass;
-  ProcessImageCommandHandler(const ProcessImage<Offset>& processImage)
+  /*
+   * The given number of threads is used by commands that scan the whole
+   * process image, such as "enumerate pointers".  Unless lowMemory is set,
+   * such commands keep an index of references once they are asked more
+   * than once, and "summarize" also uses those threads, at the cost of
+   * remembering which allocations it visits.
+   */
+  ProcessImageCommandHandler(const ProcessImage<Offset>& processImage,
+                             size_t numThreads, bool lowMemory)
       : _virtualMemoryPartition(processImage.GetVirtualMemoryPartition()),
         _stackDescriber(processImage),
         _patternDescriberRegistry(processImage),
@@ -192,18 +202,23 @@ class ProcessImageCommandHandler {
             "writable ranges",
             _virtualMemoryPartition.GetClaimedWritableRanges(),
             _compoundDescriber, _virtualMemoryPartition.UNKNOWN),
-        _describePointersSubcommand(processImage, _compoundDescriber),
-        _enumeratePointersSubcommand(processImage),
-        _describeRelRefsSubcommand(processImage.GetVirtualAddressMap(),
-                                   _compoundDescriber),
-        _enumerateRelRefsSubcommand(processImage.GetVirtualAddressMap()),
-        _describeRangeRefsSubcommand(processImage, _compoundDescriber),
-        _enumerateRangeRefsSubcommand(processImage),
+        _referenceScanner(processImage.GetVirtualAddressMap(), numThreads,
+                          !lowMemory),
+        _describePointersSubcommand(processImage, _compoundDescriber,
+                                    _referenceScanner),
+        _enumeratePointersSubcommand(processImage, _referenceScanner),
+        _describeRelRefsSubcommand(_referenceScanner, _compoundDescriber),
+        _enumerateRelRefsSubcommand(_referenceScanner),
+        _describeRangeRefsSubcommand(processImage, _compoundDescriber,
+                                     _referenceScanner),
+        _enumerateRangeRefsSubcommand(processImage, _referenceScanner),
         _summarizeSignaturesSubcommand(processImage),
+        _summarizeMemorySubcommand(processImage, _referenceScanner),
         _summarizeStringUsersSubcommand(processImage),
         _defaultAllocationsSubcommands(processImage, _allocationDescriber,
                                        _patternDescriberRegistry,
-                                       _annotatorRegistry),
+                                       _annotatorRegistry,
+                                       lowMemory ? 1 : numThreads),
         _dequeMapDescriber(processImage),
         _dequeBlockDescriber(processImage),
         _unorderedMapOrSetBucketsDescriber(processImage),
@@ -294,6 +309,7 @@ class ProcessImageCommandHandler {
     RegisterSubcommand(r, _describeRangeRefsSubcommand);
     RegisterSubcommand(r, _enumerateRangeRefsSubcommand);
     RegisterSubcommand(r, _summarizeSignaturesSubcommand);
+    RegisterSubcommand(r, _summarizeMemorySubcommand);
     RegisterSubcommand(r, _summarizeStringUsersSubcommand);
     _defaultAllocationsSubcommands.RegisterSubcommands(r);
     _annotatorRegistry.RegisterAnnotator(_SSOStringAnnotator);
@@ -344,6 +360,7 @@ class ProcessImageCommandHandler {
       _summarizeWritableSubcommand;
   VirtualAddressMapCommands::ListRanges<Offset> _listWritableSubcommand;
   VirtualAddressMapCommands::DescribeRanges<Offset> _describeWritableSubcommand;
+  ReferenceScanner<Offset> _referenceScanner;
   VirtualAddressMapCommands::DescribePointers<Offset>
       _describePointersSubcommand;
   VirtualAddressMapCommands::EnumeratePointers<Offset>
@@ -358,6 +375,7 @@ class ProcessImageCommandHandler {
 
   Allocations::Subcommands::SummarizeSignatures<Offset>
       _summarizeSignaturesSubcommand;
+  Allocations::Subcommands::SummarizeMemory<Offset> _summarizeMemorySubcommand;
 
   CPlusPlus::Subcommands::SummarizeStringUsers<Offset>
       _summarizeStringUsersSubcommand;
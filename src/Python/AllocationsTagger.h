@@ -34,7 +34,8 @@ class AllocationsTagger : public Allocations::Tagger<Offset> {
                     EdgePredicate& edgeIsFavored,
                     const InfrastructureFinder<Offset>& infrastructureFinder,
                     const VirtualAddressMap<Offset>& virtualAddressMap)
-      : _graph(graph),
+      : Allocations::Tagger<Offset>("Python"),
+        _graph(graph),
         _directory(graph.GetAllocationDirectory()),
         _numAllocations(_directory.NumAllocations()),
         _tagHolder(tagHolder),
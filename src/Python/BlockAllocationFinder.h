@@ -47,55 +47,15 @@ class BlockAllocationFinder : public Allocations::Directory<Offset>::Finder {
   virtual ~BlockAllocationFinder() {}
 
   /*
-   * Return true if there are no more allocations available.
+   * Append all the allocations found by this finder, in increasing order of
+   * address, to the given buffer.
    */
-  virtual bool Finished() { return _itActiveIndices == _activeIndices.end(); }
-
-  /*
-   * Return the address of the next allocation (in increasing order of
-   * address) to be reported by this finder, without advancing to the next
-   * allocation.  The return value is undefined if there are no more
-   * allocations available.  Note that at the time this function is called
-   * any allocations already reported by this allocation finder have already
-   * been assigned allocation indices in the Directory.
-   */
-  virtual Offset NextAddress() { return _allocationAddress; }
-  /*
-   * Return the size of the next allocation (in increasing order of
-   * address) to be reported by this finder, without advancing to the next
-   * allocation.  The return value is undefined if there are no more
-   * allocations available.
-   */
-  virtual Offset NextSize() { return _allocationSize; }
-  /*
-   * Return true if the next allocation (in increasing order of address) to
-   * address) to be reported by this finder is considered used, without
-   * advancing to the next allocation.
-   */
-  virtual bool NextIsUsed() { return _allocationIsUsed; }
-  /*
-   * Advance to the next allocation.
-   */
-  virtual void Advance() {
-    if (_itActiveIndices != _activeIndices.end()) {
-      if (!AdvanceToNextAllocationOfArena()) {
-        /*
-         * There are no more allocations in the current arena.
-         */
-        if (++_itActiveIndices != _activeIndices.end()) {
-          /*
-           * We still have at least one arena to visit.
-           */
-          _arena = _reader.ReadOffset(_arenaStructArray +
-                                      _arenaStructSize * (*_itActiveIndices));
-          /*
-           * Find the first block in the first pool or treat the entire first
-           * pool as a free allocation if there are no blocks, free or
-           * otherwise, in the first pool.
-           */
-          AdvanceToFirstAllocationOfArena();
-        }
-      }
+  virtual void FindAllocations(
+      typename Allocations::Directory<Offset>::FoundAllocations& found) {
+    while (_itActiveIndices != _activeIndices.end()) {
+      found.emplace_back(_allocationAddress, _allocationSize,
+                         _allocationIsUsed);
+      Advance();
     }
   }
   /*
@@ -234,6 +194,32 @@ class BlockAllocationFinder : public Allocations::Directory<Offset>::Finder {
     }
     return false;
   }
+
+  /*
+   * Advance to the next allocation.
+   */
+  void Advance() {
+    if (_itActiveIndices != _activeIndices.end()) {
+      if (!AdvanceToNextAllocationOfArena()) {
+        /*
+         * There are no more allocations in the current arena.
+         */
+        if (++_itActiveIndices != _activeIndices.end()) {
+          /*
+           * We still have at least one arena to visit.
+           */
+          _arena = _reader.ReadOffset(_arenaStructArray +
+                                      _arenaStructSize * (*_itActiveIndices));
+          /*
+           * Find the first block in the first pool or treat the entire first
+           * pool as a free allocation if there are no blocks, free or
+           * otherwise, in the first pool.
+           */
+          AdvanceToFirstAllocationOfArena();
+        }
+      }
+    }
+  }
 };
 
 }  // namespace Python
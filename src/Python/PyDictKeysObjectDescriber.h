@@ -1,4 +1,4 @@
-// Copyright (c) 2018-2020 Broadcom. All Rights Reserved.
+// Copyright (c) 2018-2020,2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
@@ -19,8 +19,7 @@ class PyDictKeysObjectDescriber : public Allocations::PatternDescriber<Offset> {
   typedef typename Allocations::Directory<Offset>::Allocation Allocation;
   PyDictKeysObjectDescriber(const ProcessImage<Offset>& processImage)
       : Allocations::PatternDescriber<Offset>(processImage, "PyDictKeysObject"),
-        _graph(*(processImage.GetAllocationGraph())),
-        _directory(_graph.GetAllocationDirectory()),
+        _directory(processImage.GetAllocationDirectory()),
         _infrastructureFinder(processImage.GetPythonInfrastructureFinder()),
         _strType(_infrastructureFinder.StrType()),
         _cstringInStr(_infrastructureFinder.CstringInStr()),
@@ -68,7 +67,7 @@ class PyDictKeysObjectDescriber : public Allocations::PatternDescriber<Offset> {
 
       const AllocationIndex* pFirstIncoming;
       const AllocationIndex* pPastIncoming;
-      _graph.GetIncoming(index, &pFirstIncoming, &pPastIncoming);
+      Base::GetGraph().GetIncoming(index, &pFirstIncoming, &pPastIncoming);
       Offset minDictSizeWithGCH =
           _garbageCollectionHeaderSize + _keysInDict + sizeof(Offset);
       for (const AllocationIndex* pNextIncoming = pFirstIncoming;
@@ -150,7 +149,6 @@ class PyDictKeysObjectDescriber : public Allocations::PatternDescriber<Offset> {
   }
 
  private:
-  const Allocations::Graph<Offset>& _graph;
   const Allocations::Directory<Offset>& _directory;
   const InfrastructureFinder<Offset>& _infrastructureFinder;
   const Offset _strType;
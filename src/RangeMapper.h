@@ -3,8 +3,10 @@
 // SPDX-License-Identifier: GPL-2.0
 
 #pragma once
+#include <cstdlib>
 #include <functional>
 #include <map>
+#include <vector>
 namespace chap {
 template <class Off, class T>
 class RangeMapper {
@@ -18,7 +20,7 @@ class RangeMapper {
   typedef typename Map::const_reverse_iterator MapConstReverseIterator;
 
   RangeMapper(bool coallesceMatchingValues = true)
-      : _coallesceMatchingValues(coallesceMatchingValues) {}
+      : _coallesceMatchingValues(coallesceMatchingValues), _isFrozen(false) {}
   struct Range {
     Range() : _limit(0), _size(0), _base(0) {}
     void Set(Offset limit, Offset size, ValueType value) {
@@ -108,6 +110,12 @@ class RangeMapper {
 
   std::pair<const_iterator, bool> MapRange(Offset rangeBase, Offset rangeSize,
                                            ValueType value) {
+    if (_isFrozen) {
+      /*
+       * Once the mapper is frozen it can no longer be changed.
+       */
+      abort();
+    }
     if (rangeSize == 0) {
       return std::make_pair(end(), true);
     }
@@ -165,6 +173,9 @@ class RangeMapper {
   }
 
   void UnmapRange(Offset rangeBase, Offset rangeSize) {
+    if (_isFrozen) {
+      abort();
+    }
     if (rangeSize == 0) {
       return;
     }
@@ -215,7 +226,43 @@ class RangeMapper {
     }
   }
 
+  /*
+   * Make the mapper immutable and switch lookups by address from the tree to
+   * a flat array of ranges, searched using a copy of the range limits laid
+   * out in Eytzinger (breadth-first) order, which allows a branch-free
+   * search that uses the cache well.  This is worthwhile for a mapper that
+   * is searched very frequently after it is complete.
+   */
+  void Freeze() {
+    if (_isFrozen) {
+      return;
+    }
+    _isFrozen = true;
+    size_t numRanges = _map.size();
+    _frozenRanges.reserve(numRanges);
+    _frozenIterators.reserve(numRanges);
+    for (MapConstIterator it = _map.begin(); it != _map.end(); ++it) {
+      _frozenRanges.emplace_back();
+      _frozenRanges.back().Set(it->first, it->second.first, it->second.second);
+      _frozenIterators.push_back(it);
+    }
+    _eytzingerLimits.resize(numRanges + 1);
+    _eytzingerRanks.resize(numRanges + 1);
+    size_t rank = 0;
+    FillEytzinger(1, rank);
+  }
+
+  bool IsFrozen() const { return _isFrozen; }
+
   const_iterator find(Offset member) const {
+    if (_isFrozen) {
+      size_t rank = FrozenUpperBound(member);
+      if (rank == _frozenRanges.size() ||
+          member < _frozenRanges[rank]._base) {
+        return end();
+      }
+      return const_iterator(_frozenIterators[rank]);
+    }
     MapConstIterator it = _map.upper_bound(member);
     if (it != _map.end()) {
       if (member < it->first - it->second.first) {
@@ -231,13 +278,25 @@ class RangeMapper {
    * member, or an iterator to the end if no such range exists.
    */
   const_iterator upper_bound(Offset member) const {
+    if (_isFrozen) {
+      size_t rank = FrozenUpperBound(member);
+      if (rank == _frozenRanges.size()) {
+        return end();
+      }
+      return const_iterator(_frozenIterators[rank]);
+    }
     return const_iterator(_map.upper_bound(member));
   }
 
   /*
    * Clear the map.
    */
-  void clear() { _map.clear(); }
+  void clear() {
+    if (_isFrozen) {
+      abort();
+    }
+    _map.clear();
+  }
 
   /*
    * If a range containing the given member exists, return true and
@@ -247,6 +306,19 @@ class RangeMapper {
 
   bool FindRange(Offset member, Offset& rangeBase, Offset& rangeSize,
                  ValueType& value) const {
+    if (_isFrozen) {
+      size_t rank = FrozenUpperBound(member);
+      if (rank != _frozenRanges.size()) {
+        const Range& range = _frozenRanges[rank];
+        if (range._base <= member) {
+          rangeBase = range._base;
+          rangeSize = range._size;
+          value = range._value;
+          return true;
+        }
+      }
+      return false;
+    }
     MapConstIterator it = _map.upper_bound(member);
     if (it != _map.end()) {
       Offset foundRangeSize = it->second.first;
@@ -286,6 +358,46 @@ class RangeMapper {
  private:
   Map _map;
   bool _coallesceMatchingValues;
+  bool _isFrozen;
+  /*
+   * The following are used only once the mapper is frozen.  The ranges and
+   * the corresponding tree iterators are in order of address.  The limits
+   * are kept separately in Eytzinger order, starting at index 1, along with
+   * the position of each in address order.
+   */
+  std::vector<Range> _frozenRanges;
+  std::vector<MapConstIterator> _frozenIterators;
+  std::vector<Offset> _eytzingerLimits;
+  std::vector<size_t> _eytzingerRanks;
+
+  void FillEytzinger(size_t node, size_t& rank) {
+    if (node < _eytzingerLimits.size()) {
+      FillEytzinger(2 * node, rank);
+      _eytzingerLimits[node] = _frozenRanges[rank]._limit;
+      _eytzingerRanks[node] = rank;
+      rank++;
+      FillEytzinger(2 * node + 1, rank);
+    }
+  }
+
+  /*
+   * Return the position in address order of the first range with limit
+   * after the given member, or the number of ranges if there is none.
+   */
+  size_t FrozenUpperBound(Offset member) const {
+    size_t numNodes = _eytzingerLimits.size();
+    const Offset* limits = _eytzingerLimits.data();
+    size_t node = 1;
+    while (node < numNodes) {
+      node = 2 * node + (limits[node] <= member);
+    }
+    /*
+     * Strip the trailing right turns, and the left turn before them, to get
+     * the last node at which the search went left, which is the answer.
+     */
+    node >>= __builtin_ctzll(~((unsigned long long)node)) + 1;
+    return (node == 0) ? _frozenRanges.size() : _eytzingerRanks[node];
+  }
 };
 
 }  // namespace chap
@@ -0,0 +1,834 @@
+// Copyright (c) 2024 Broadcom. All Rights Reserved.
+// The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
+// SPDX-License-Identifier: GPL-2.0
+
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <utility>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include "Parallel.h"
+#include "ResourceUsage.h"
+#include "VirtualAddressMap.h"
+
+namespace chap {
+/*
+ * A ReferenceScanner finds the places in the mapped part of the address map
+ * that refer to any of a batch of targets, either as a pointer-aligned
+ * pointer or as a signed 32-bit offset relative to the address just after
+ * the offset.  The mapped ranges are split into chunks that are scanned in
+ * parallel, and the results for the chunks are combined in address order,
+ * so the results are the same regardless of the number of threads.
+ *
+ * The targets are grouped into at most MAX_SPANS spans, split at the
+ * largest gaps between targets.  Blocks of the image are checked against
+ * the spans using AVX2 or SSE2 where available and only values within some
+ * span are checked against the targets themselves.
+ *
+ * If asked to, the scanner also keeps an index of all the pointer-aligned
+ * references to addresses in ranges of the address map, sorted by target,
+ * so that repeated queries for such targets need not scan the whole image.
+ * The index is built, in one parallel scan, only when a second query that
+ * could use it is made, because a single query is faster without it, and
+ * only if an estimate made from a sample of the image shows that the index
+ * would fit in a fraction of the memory of the host.  Each reference takes
+ * 8 bytes in the index, packing the offset of the target in its piece of
+ * the known ranges with the number of the source word in the scanned image.
+ */
+template <class Offset>
+class ReferenceScanner {
+ public:
+  typedef VirtualAddressMap<Offset> AddressMap;
+
+  ReferenceScanner(const AddressMap& addressMap, size_t numThreads,
+                   bool useIndex)
+      : _addressMap(addressMap),
+        _numThreads(numThreads == 0 ? 1 : numThreads),
+        _useIndex(useIndex),
+        _inSpanMask(&ReferenceScanner::InSpanMaskScalar),
+        _hasRelativeInSpan(&ReferenceScanner::HasRelativeInSpanScalar),
+        _numIndexableQueries(0),
+        _indexIsBuilt(false),
+        _indexIsRefused(false),
+        _estimatedIndexSize(0) {
+    /*
+     * The pieces of the ranges in the address map are the buckets used
+     * to sort the index.  Touching ranges are combined first, so that a
+     * query about a span that crosses from one range to the next can still
+     * use the index.
+     */
+    typename AddressMap::const_iterator itEnd = _addressMap.end();
+    for (typename AddressMap::const_iterator it = _addressMap.begin();
+         it != itEnd; ++it) {
+      if (!_knownRanges.empty() && _knownRanges.back().second == it.Base()) {
+        _knownRanges.back().second = it.Limit();
+      } else {
+        _knownRanges.emplace_back(it.Base(), it.Limit());
+      }
+    }
+    for (const auto& knownRange : _knownRanges) {
+      Offset pieceBase = knownRange.first;
+      while (knownRange.second - pieceBase > INDEX_PIECE_SIZE) {
+        _indexPieces.emplace_back(pieceBase, INDEX_PIECE_SIZE);
+        pieceBase += INDEX_PIECE_SIZE;
+      }
+      _indexPieces.emplace_back(pieceBase, knownRange.second - pieceBase);
+    }
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("avx2")) {
+      _inSpanMask = &ReferenceScanner::InSpanMaskAVX2;
+      _hasRelativeInSpan = &ReferenceScanner::HasRelativeInSpanAVX2;
+    } else if (__builtin_cpu_supports("sse2")) {
+      _inSpanMask = &ReferenceScanner::InSpanMaskSSE2;
+      _hasRelativeInSpan = &ReferenceScanner::HasRelativeInSpanSSE2;
+    }
+#endif
+  }
+
+  /*
+   * Return, in increasing order, the pointer-aligned addresses that contain
+   * any of the given targets.
+   */
+  std::vector<Offset> FindPointers(std::vector<Offset> targets) const {
+    std::sort(targets.begin(), targets.end());
+    targets.erase(std::unique(targets.begin(), targets.end()), targets.end());
+    std::vector<Span> spans = MakeSpans(targets);
+    if (!targets.empty() &&
+        IndexIsReady(std::all_of(targets.begin(), targets.end(),
+                                 [this](Offset target) {
+                                   return IsKnown(target, target);
+                                 }))) {
+      std::vector<Offset> found;
+      for (Offset target : targets) {
+        FindIndexedPointers(target, target, found);
+      }
+      std::sort(found.begin(), found.end());
+      return found;
+    }
+    bool spansAreExact = (spans.size() == targets.size());
+    return ScanChunks(
+        true, [&](const Chunk& chunk, std::vector<Offset>& found) {
+          FindPointersInChunk(chunk, spans, spansAreExact ? nullptr : &targets,
+                              found);
+        });
+  }
+
+  /*
+   * Return, in increasing order, the pointer-aligned addresses that contain
+   * a value in [start, limit).
+   */
+  std::vector<Offset> FindPointersInRange(Offset start, Offset limit) const {
+    if (start >= limit) {
+      return std::vector<Offset>();
+    }
+    if (IndexIsReady(IsKnown(start, limit - 1))) {
+      std::vector<Offset> found;
+      FindIndexedPointers(start, limit - 1, found);
+      std::sort(found.begin(), found.end());
+      return found;
+    }
+    std::vector<Span> spans(1, Span(start, limit - 1 - start));
+    return ScanChunks(
+        true, [&](const Chunk& chunk, std::vector<Offset>& found) {
+          FindPointersInChunk(chunk, spans, nullptr, found);
+        });
+  }
+
+  /*
+   * Return, in increasing order, the addresses that contain a signed 32-bit
+   * integer that, when added to the address just after the integer, yields
+   * any of the given targets.  Such integers need not be aligned.
+   */
+  std::vector<Offset> FindRelativeReferences(
+      std::vector<Offset> targets) const {
+    std::sort(targets.begin(), targets.end());
+    targets.erase(std::unique(targets.begin(), targets.end()), targets.end());
+    std::vector<Span> spans = MakeSpans(targets);
+    return ScanChunks(
+        false, [&](const Chunk& chunk, std::vector<Offset>& found) {
+          FindRelativeReferencesInChunk(chunk, spans, targets, found);
+        });
+  }
+
+  /*
+   * These describe the index for "summarize memory".  An index that was
+   * refused, because its estimated size was too large, is never built.
+   */
+  bool UsesIndex() const { return _useIndex; }
+  bool IndexIsBuilt() const { return _indexIsBuilt.load(); }
+  bool IndexIsRefused() const { return _indexIsRefused.load(); }
+  uint64_t EstimatedIndexSize() const { return _estimatedIndexSize; }
+  size_t IndexMemoryFootprint() const {
+    return _index.capacity() * sizeof(uint64_t) +
+           _indexPieceStarts.capacity() * sizeof(size_t) +
+           _indexChunkBases.capacity() * sizeof(Offset);
+  }
+
+ private:
+  /*
+   * The chunks are small enough that the results for a chunk are usually
+   * found while the chunk is still in cache and large enough that the cost
+   * of claiming a chunk doesn't matter.
+   */
+  static constexpr Offset CHUNK_SIZE = 0x100000;
+  static constexpr size_t BLOCK_SIZE = 64;
+  /*
+   * Relative references are checked against bounds that are loosened by the
+   * size of the block, which matters little for blocks of this size.
+   */
+  static constexpr size_t RELATIVE_BLOCK_SIZE = 256;
+  static constexpr size_t MAX_SPANS = 4;
+  /*
+   * The pieces of the index are small enough that they can be sorted in
+   * parallel even if most references are to a single range, and that the
+   * offset of a target in its piece fits in the top bits of an entry.
+   */
+  static constexpr unsigned int INDEX_SOURCE_BITS = 40;
+  static constexpr Offset INDEX_PIECE_SIZE =
+      ((Offset)1) << (64 - INDEX_SOURCE_BITS);
+  static constexpr uint64_t INDEX_SOURCE_MASK =
+      (((uint64_t)1) << INDEX_SOURCE_BITS) - 1;
+  static constexpr Offset WORDS_PER_CHUNK = CHUNK_SIZE / sizeof(Offset);
+  static constexpr size_t QUERIES_BEFORE_INDEX = 2;
+  /*
+   * The size of the index is estimated from one of every INDEX_SAMPLE_STRIDE
+   * chunks, and the index is built only if the estimate is at most
+   * 1/INDEX_MEMORY_FRACTION of the memory of the host.
+   */
+  static constexpr size_t INDEX_SAMPLE_STRIDE = 16;
+  static constexpr uint64_t INDEX_MEMORY_FRACTION = 8;
+  static constexpr Offset RELATIVE_SIZE = sizeof(int32_t);
+
+  /*
+   * A span covers the values in [_base, _base + _extent], inclusive, so that
+   * a span can reach the largest possible value.
+   */
+  struct Span {
+    Span(Offset base, Offset extent) : _base(base), _extent(extent) {}
+    Offset _base;
+    Offset _extent;
+  };
+
+  /*
+   * A chunk is part of a mapped range.  A relative reference may start
+   * anywhere in the chunk but may extend past the chunk as long as it is
+   * within the range.
+   */
+  struct Chunk {
+    Offset _base;
+    Offset _size;
+    Offset _rangeLimit;
+    const char* _image;
+  };
+
+  typedef uint64_t (ReferenceScanner::*InSpanMaskFunction)(const Offset*,
+                                                           size_t, Offset,
+                                                           Offset) const;
+  typedef bool (ReferenceScanner::*HasRelativeInSpanFunction)(const char*,
+                                                              size_t, int32_t,
+                                                              int32_t) const;
+
+  const AddressMap& _addressMap;
+  const size_t _numThreads;
+  const bool _useIndex;
+  InSpanMaskFunction _inSpanMask;
+  HasRelativeInSpanFunction _hasRelativeInSpan;
+  /*
+   * Each known range is a [base, limit) pair and each index piece is a
+   * [base, base + size) pair, both in increasing order.
+   */
+  std::vector<std::pair<Offset, Offset> > _knownRanges;
+  std::vector<std::pair<Offset, Offset> > _indexPieces;
+  mutable std::atomic<size_t> _numIndexableQueries;
+  mutable std::atomic<bool> _indexIsBuilt;
+  mutable std::atomic<bool> _indexIsRefused;
+  mutable uint64_t _estimatedIndexSize;
+  mutable std::mutex _indexMutex;
+  /*
+   * The index has an entry for each pointer-aligned source that contains an
+   * address in some known range.  The entries for targets in each piece
+   * start at the corresponding element of _indexPieceStarts and are in
+   * increasing order.  The top bits of an entry are the offset of the
+   * target in the piece and the rest are the number of the source word,
+   * counting WORDS_PER_CHUNK words for each chunk, whose bases are in
+   * _indexChunkBases.
+   */
+  mutable std::vector<uint64_t> _index;
+  mutable std::vector<size_t> _indexPieceStarts;
+  mutable std::vector<Offset> _indexChunkBases;
+
+  /*
+   * Return true if [first, last], inclusive, is within a known range.
+   */
+  bool IsKnown(Offset first, Offset last) const {
+    auto it = std::upper_bound(
+        _knownRanges.begin(), _knownRanges.end(), first,
+        [](Offset value, const std::pair<Offset, Offset>& knownRange) {
+          return value < knownRange.second;
+        });
+    return it != _knownRanges.end() && it->first <= first &&
+           last < it->second;
+  }
+
+  /*
+   * Return true if the index can be used for a query, which requires that
+   * the targets be known, building the index if this is the query that
+   * makes it worth building.
+   */
+  bool IndexIsReady(bool targetsAreKnown) const {
+    if (!_useIndex || !targetsAreKnown || _indexIsRefused.load()) {
+      return false;
+    }
+    if (_indexIsBuilt.load()) {
+      return true;
+    }
+    if (++_numIndexableQueries < QUERIES_BEFORE_INDEX) {
+      return false;
+    }
+    std::lock_guard<std::mutex> lock(_indexMutex);
+    if (!_indexIsBuilt.load() && !_indexIsRefused.load()) {
+      if (BuildIndex()) {
+        _indexIsBuilt.store(true);
+      } else {
+        _indexIsRefused.store(true);
+      }
+    }
+    return _indexIsBuilt.load();
+  }
+
+  /*
+   * Append to found the sources of the references in the index to values in
+   * [first, last], inclusive, which must be within a known range.
+   */
+  void FindIndexedPointers(Offset first, Offset last,
+                           std::vector<Offset>& found) const {
+    auto it = std::upper_bound(
+        _indexPieces.begin(), _indexPieces.end(), first,
+        [](Offset value, const std::pair<Offset, Offset>& piece) {
+          return value < piece.first;
+        });
+    for (size_t piece = (it - _indexPieces.begin()) - 1;
+         piece < _indexPieces.size() && _indexPieces[piece].first <= last;
+         piece++) {
+      Offset pieceBase = _indexPieces[piece].first;
+      Offset lastInPiece = _indexPieces[piece].second - 1;
+      if (last - pieceBase < lastInPiece) {
+        lastInPiece = last - pieceBase;
+      }
+      uint64_t low = (first > pieceBase)
+                         ? ((uint64_t)(first - pieceBase)) << INDEX_SOURCE_BITS
+                         : 0;
+      uint64_t high = ((uint64_t)lastInPiece << INDEX_SOURCE_BITS) |
+                      INDEX_SOURCE_MASK;
+      auto itEnd = _index.begin() + _indexPieceStarts[piece + 1];
+      for (auto itEntry = std::lower_bound(
+               _index.begin() + _indexPieceStarts[piece], itEnd, low);
+           itEntry != itEnd && *itEntry <= high; ++itEntry) {
+        uint64_t sourceWord = *itEntry & INDEX_SOURCE_MASK;
+        found.push_back(_indexChunkBases[sourceWord / WORDS_PER_CHUNK] +
+                        (sourceWord % WORDS_PER_CHUNK) * sizeof(Offset));
+      }
+    }
+  }
+
+  /*
+   * Estimate the size of the index, counting the candidate references in
+   * a sample of the chunks.
+   */
+  uint64_t EstimateIndexSize(const std::vector<Chunk>& chunks,
+                             const std::vector<Span>& spans) const {
+    size_t numSamples =
+        (chunks.size() + INDEX_SAMPLE_STRIDE - 1) / INDEX_SAMPLE_STRIDE;
+    std::vector<uint64_t> numFoundInSamples(numSamples, 0);
+    RunInParallel(_numThreads, numSamples, [&](size_t, size_t i) {
+      std::vector<Offset> candidates;
+      FindPointersInChunk(chunks[i * INDEX_SAMPLE_STRIDE], spans, nullptr,
+                          candidates);
+      numFoundInSamples[i] = candidates.size();
+    });
+    uint64_t numFound = 0;
+    uint64_t sampledSize = 0;
+    uint64_t totalSize = 0;
+    for (size_t i = 0; i < chunks.size(); i++) {
+      totalSize += chunks[i]._size;
+      if ((i % INDEX_SAMPLE_STRIDE) == 0) {
+        sampledSize += chunks[i]._size;
+        numFound += numFoundInSamples[i / INDEX_SAMPLE_STRIDE];
+      }
+    }
+    if (sampledSize == 0) {
+      return 0;
+    }
+    return (uint64_t)((double)numFound * totalSize / sampledSize) *
+           sizeof(uint64_t);
+  }
+
+  /*
+   * Find the references to known addresses, chunk by chunk in parallel,
+   * noting the index piece that contains each target, then place the
+   * references by piece and sort the pieces in parallel.  Because the
+   * pieces are in increasing order, the result is fully sorted.  Return
+   * false, having built nothing, if the index would be too large.
+   */
+  bool BuildIndex() const {
+    if (_indexPieces.empty()) {
+      return false;
+    }
+    std::vector<Chunk> chunks = MakeChunks(true);
+    std::vector<Span> spans(
+        1, Span(_knownRanges.front().first,
+                _knownRanges.back().second - 1 - _knownRanges.front().first));
+    _estimatedIndexSize = EstimateIndexSize(chunks, spans);
+    uint64_t memorySize = PhysicalMemorySize();
+    if ((memorySize != 0 &&
+         _estimatedIndexSize > memorySize / INDEX_MEMORY_FRACTION) ||
+        chunks.size() > (INDEX_SOURCE_MASK + 1) / WORDS_PER_CHUNK) {
+      return false;
+    }
+    std::vector<std::vector<uint64_t> > foundInChunks(chunks.size());
+    std::vector<std::vector<uint32_t> > piecesInChunks(chunks.size());
+    RunInParallel(_numThreads, chunks.size(), [&](size_t, size_t i) {
+      const Chunk& chunk = chunks[i];
+      std::vector<uint64_t>& found = foundInChunks[i];
+      std::vector<uint32_t>& pieces = piecesInChunks[i];
+      std::vector<Offset> candidates;
+      FindPointersInChunk(chunk, spans, nullptr, candidates);
+      for (Offset source : candidates) {
+        Offset target =
+            *((const Offset*)(chunk._image + (source - chunk._base)));
+        auto it = std::upper_bound(
+            _indexPieces.begin(), _indexPieces.end(), target,
+            [](Offset value, const std::pair<Offset, Offset>& piece) {
+              return value < piece.first;
+            });
+        if (it == _indexPieces.begin()) {
+          continue;
+        }
+        --it;
+        if (target - it->first < it->second) {
+          found.push_back(
+              (((uint64_t)(target - it->first)) << INDEX_SOURCE_BITS) |
+              (i * WORDS_PER_CHUNK +
+               (source - chunk._base) / sizeof(Offset)));
+          pieces.push_back((uint32_t)(it - _indexPieces.begin()));
+        }
+      }
+    });
+
+    _indexChunkBases.reserve(chunks.size());
+    for (const Chunk& chunk : chunks) {
+      _indexChunkBases.push_back(chunk._base);
+    }
+    _indexPieceStarts.assign(_indexPieces.size() + 1, 0);
+    for (const std::vector<uint32_t>& pieces : piecesInChunks) {
+      for (uint32_t piece : pieces) {
+        _indexPieceStarts[piece + 1]++;
+      }
+    }
+    for (size_t piece = 0; piece < _indexPieces.size(); piece++) {
+      _indexPieceStarts[piece + 1] += _indexPieceStarts[piece];
+    }
+    _index.resize(_indexPieceStarts.back());
+    std::vector<size_t> nextInPiece(_indexPieceStarts.begin(),
+                                    _indexPieceStarts.end() - 1);
+    for (size_t i = 0; i < chunks.size(); i++) {
+      std::vector<uint64_t>& found = foundInChunks[i];
+      std::vector<uint32_t>& pieces = piecesInChunks[i];
+      for (size_t j = 0; j < found.size(); j++) {
+        _index[nextInPiece[pieces[j]]++] = found[j];
+      }
+      std::vector<uint64_t>().swap(found);
+      std::vector<uint32_t>().swap(pieces);
+    }
+    RunInParallel(_numThreads, _indexPieces.size(), [&](size_t, size_t piece) {
+      std::sort(_index.begin() + _indexPieceStarts[piece],
+                _index.begin() + _indexPieceStarts[piece + 1]);
+    });
+    return true;
+  }
+
+  /*
+   * Group the given sorted targets into at most MAX_SPANS spans, splitting
+   * at the largest gaps between consecutive targets.
+   */
+  static std::vector<Span> MakeSpans(const std::vector<Offset>& targets) {
+    std::vector<Span> spans;
+    size_t numTargets = targets.size();
+    if (numTargets == 0) {
+      return spans;
+    }
+    std::vector<size_t> splits;
+    for (size_t i = 1; i < numTargets; i++) {
+      splits.push_back(i);
+    }
+    if (splits.size() >= MAX_SPANS) {
+      std::partial_sort(splits.begin(), splits.begin() + MAX_SPANS - 1,
+                        splits.end(), [&](size_t a, size_t b) {
+                          return targets[a] - targets[a - 1] >
+                                 targets[b] - targets[b - 1];
+                        });
+      splits.resize(MAX_SPANS - 1);
+      std::sort(splits.begin(), splits.end());
+    }
+    size_t first = 0;
+    for (size_t split : splits) {
+      spans.emplace_back(targets[first], targets[split - 1] - targets[first]);
+      first = split;
+    }
+    spans.emplace_back(targets[first],
+                       targets[numTargets - 1] - targets[first]);
+    return spans;
+  }
+
+  /*
+   * Split the mapped ranges into chunks, in increasing order of address.
+   * If pointerAligned is set, only whole pointer-aligned words in each range
+   * matter.
+   */
+  std::vector<Chunk> MakeChunks(bool pointerAligned) const {
+    std::vector<Chunk> chunks;
+    typename AddressMap::const_iterator itEnd = _addressMap.end();
+    for (typename AddressMap::const_iterator it = _addressMap.begin();
+         it != itEnd; ++it) {
+      const char* rangeImage = it.GetImage();
+      if (rangeImage == (const char*)0) {
+        continue;
+      }
+      Offset base = it.Base();
+      Offset size = it.Size();
+      if (pointerAligned) {
+        size -= size % sizeof(Offset);
+      } else if (size < RELATIVE_SIZE) {
+        continue;
+      }
+      for (Offset chunkOffset = 0; chunkOffset < size;
+           chunkOffset += CHUNK_SIZE) {
+        Chunk chunk;
+        chunk._base = base + chunkOffset;
+        chunk._size = std::min(CHUNK_SIZE, size - chunkOffset);
+        chunk._rangeLimit = base + size;
+        chunk._image = rangeImage + chunkOffset;
+        chunks.push_back(chunk);
+      }
+    }
+    return chunks;
+  }
+
+  /*
+   * Call the given scanner for each chunk, using up to _numThreads threads,
+   * and return the combined results.
+   */
+  template <typename ChunkScanner>
+  std::vector<Offset> ScanChunks(bool pointerAligned,
+                                 ChunkScanner chunkScanner) const {
+    std::vector<Chunk> chunks = MakeChunks(pointerAligned);
+    std::vector<std::vector<Offset> > foundInChunks(chunks.size());
+    RunInParallel(_numThreads, chunks.size(), [&](size_t, size_t i) {
+      chunkScanner(chunks[i], foundInChunks[i]);
+    });
+
+    size_t numFound = 0;
+    for (const std::vector<Offset>& foundInChunk : foundInChunks) {
+      numFound += foundInChunk.size();
+    }
+    std::vector<Offset> found;
+    found.reserve(numFound);
+    for (const std::vector<Offset>& foundInChunk : foundInChunks) {
+      found.insert(found.end(), foundInChunk.begin(), foundInChunk.end());
+    }
+    return found;
+  }
+
+  /*
+   * Append to found the address of each word in the chunk that is in one
+   * of the spans and, unless targets is null, is also one of the targets.
+   */
+  void FindPointersInChunk(const Chunk& chunk, const std::vector<Span>& spans,
+                           const std::vector<Offset>* targets,
+                           std::vector<Offset>& found) const {
+    const Offset* first = (const Offset*)(chunk._image);
+    const Offset* limit = first + chunk._size / sizeof(Offset);
+    while (first < limit) {
+      size_t numInBlock = limit - first;
+      if (numInBlock > BLOCK_SIZE) {
+        numInBlock = BLOCK_SIZE;
+      }
+      uint64_t mask = 0;
+      for (const Span& span : spans) {
+        mask |= (this->*_inSpanMask)(first, numInBlock, span._base,
+                                     span._extent);
+      }
+      while (mask != 0) {
+        const Offset* check = first + __builtin_ctzll(mask);
+        mask &= mask - 1;
+        if (targets == nullptr ||
+            std::binary_search(targets->begin(), targets->end(), *check)) {
+          found.push_back(chunk._base +
+                          ((const char*)check - chunk._image));
+        }
+      }
+      first += numInBlock;
+    }
+  }
+
+  /*
+   * Return target - origin, limited to [-2^33, 2^33], which is enough for
+   * comparisons against a 32-bit value plus an offset within a chunk.
+   */
+  static int64_t RelativeBound(uint64_t target, uint64_t origin) {
+    const uint64_t maxBound = ((uint64_t)1) << 33;
+    if (target >= origin) {
+      return (int64_t)(std::min(target - origin, maxBound));
+    }
+    return -(int64_t)(std::min(origin - target, maxBound));
+  }
+
+  /*
+   * Append to found the address of each relative reference that starts in
+   * the chunk and refers to one of the targets.
+   */
+  void FindRelativeReferencesInChunk(const Chunk& chunk,
+                                     const std::vector<Span>& spans,
+                                     const std::vector<Offset>& targets,
+                                     std::vector<Offset>& found) const {
+    Offset maxPositions = chunk._rangeLimit - chunk._base - RELATIVE_SIZE + 1;
+    size_t numPositions = std::min(chunk._size, maxPositions);
+    uint64_t origin = (uint64_t)(chunk._base) + RELATIVE_SIZE;
+    /*
+     * A reference at position i in the chunk, containing v, refers to
+     * origin + i + v, so it can refer to a target in a span only if v + i
+     * is within the span relative to the origin.
+     */
+    std::vector<std::pair<int64_t, int64_t> > relativeSpans;
+    for (const Span& span : spans) {
+      relativeSpans.emplace_back(
+          RelativeBound(span._base, origin),
+          RelativeBound((uint64_t)(span._base) + span._extent, origin));
+    }
+    const int64_t minValue = std::numeric_limits<int32_t>::min();
+    const int64_t maxValue = std::numeric_limits<int32_t>::max();
+    for (size_t first = 0; first < numPositions;
+         first += RELATIVE_BLOCK_SIZE) {
+      size_t numInBlock = std::min(numPositions - first, RELATIVE_BLOCK_SIZE);
+      bool mayHaveReference = false;
+      for (const auto& relativeSpan : relativeSpans) {
+        int64_t low = relativeSpan.first - (int64_t)(first + numInBlock - 1);
+        int64_t high = relativeSpan.second - (int64_t)first;
+        if (high < minValue || low > maxValue) {
+          continue;
+        }
+        if ((this->*_hasRelativeInSpan)(chunk._image + first, numInBlock,
+                                        (int32_t)std::max(low, minValue),
+                                        (int32_t)std::min(high, maxValue))) {
+          mayHaveReference = true;
+          break;
+        }
+      }
+      if (!mayHaveReference) {
+        continue;
+      }
+      for (size_t i = first; i < first + numInBlock; i++) {
+        int32_t value;
+        memcpy(&value, chunk._image + i, sizeof(value));
+        uint64_t target = origin + i + (uint64_t)(int64_t)value;
+        if (sizeof(Offset) < sizeof(uint64_t) &&
+            target > (uint64_t)(std::numeric_limits<Offset>::max())) {
+          continue;
+        }
+        if (std::binary_search(targets.begin(), targets.end(),
+                               (Offset)target)) {
+          found.push_back(chunk._base + i);
+        }
+      }
+    }
+  }
+
+  /*
+   * Return a mask with bit i set if and only if values[i] - base is at most
+   * extent, for i < numValues <= BLOCK_SIZE.
+   */
+  uint64_t InSpanMaskScalar(const Offset* values, size_t numValues,
+                            Offset base, Offset extent) const {
+    uint64_t mask = 0;
+    for (size_t i = 0; i < numValues; i++) {
+      if ((Offset)(values[i] - base) <= extent) {
+        mask |= ((uint64_t)1) << i;
+      }
+    }
+    return mask;
+  }
+
+  /*
+   * Return true if some signed 32-bit value starting at bytes[i], for
+   * i < numPositions, is in [low, high].  All numPositions + 3 bytes must be
+   * readable.
+   */
+  bool HasRelativeInSpanScalar(const char* bytes, size_t numPositions,
+                               int32_t low, int32_t high) const {
+    for (size_t i = 0; i < numPositions; i++) {
+      int32_t value;
+      memcpy(&value, bytes + i, sizeof(value));
+      if (value >= low && value <= high) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+#if defined(__x86_64__) || defined(__i386__)
+  /*
+   * The vector forms use signed comparisons, so the sign bit is flipped
+   * on both sides to get the unsigned comparison of (value - base) against
+   * extent.
+   */
+  __attribute__((target("avx2"))) uint64_t InSpanMaskAVX2(
+      const Offset* values, size_t numValues, Offset base,
+      Offset extent) const {
+    uint64_t mask = 0;
+    size_t i = 0;
+    if (sizeof(Offset) == 8) {
+      const __m256i signBit = _mm256_set1_epi64x((long long)(1ULL << 63));
+      const __m256i baseVector = _mm256_set1_epi64x((long long)base);
+      const __m256i extentVector =
+          _mm256_xor_si256(_mm256_set1_epi64x((long long)extent), signBit);
+      for (; i + 4 <= numValues; i += 4) {
+        __m256i relative = _mm256_xor_si256(
+            _mm256_sub_epi64(
+                _mm256_loadu_si256((const __m256i*)(values + i)), baseVector),
+            signBit);
+        __m256i outside = _mm256_cmpgt_epi64(relative, extentVector);
+        mask |= ((uint64_t)(~_mm256_movemask_pd(_mm256_castsi256_pd(outside)) &
+                            0xf))
+                << i;
+      }
+    } else {
+      const __m256i signBit = _mm256_set1_epi32((int)(1U << 31));
+      const __m256i baseVector = _mm256_set1_epi32((int)base);
+      const __m256i extentVector =
+          _mm256_xor_si256(_mm256_set1_epi32((int)extent), signBit);
+      for (; i + 8 <= numValues; i += 8) {
+        __m256i relative = _mm256_xor_si256(
+            _mm256_sub_epi32(
+                _mm256_loadu_si256((const __m256i*)(values + i)), baseVector),
+            signBit);
+        __m256i outside = _mm256_cmpgt_epi32(relative, extentVector);
+        mask |= ((uint64_t)(~_mm256_movemask_ps(_mm256_castsi256_ps(outside)) &
+                            0xff))
+                << i;
+      }
+    }
+    if (i < numValues) {
+      mask |= InSpanMaskScalar(values + i, numValues - i, base, extent) << i;
+    }
+    return mask;
+  }
+
+  /*
+   * Each group of four unaligned loads covers 32 consecutive positions,
+   * because the load starting k bytes into the group holds the values at
+   * positions k, k + 4, k + 8 and so on.
+   */
+  __attribute__((target("avx2"))) bool HasRelativeInSpanAVX2(
+      const char* bytes, size_t numPositions, int32_t low,
+      int32_t high) const {
+    const __m256i lowVector = _mm256_set1_epi32(low);
+    const __m256i highVector = _mm256_set1_epi32(high);
+    size_t i = 0;
+    for (; i + 32 <= numPositions; i += 32) {
+      __m256i outside = _mm256_set1_epi32(-1);
+      for (size_t k = 0; k < 4; k++) {
+        __m256i values =
+            _mm256_loadu_si256((const __m256i*)(bytes + i + k));
+        outside = _mm256_and_si256(
+            outside, _mm256_or_si256(_mm256_cmpgt_epi32(lowVector, values),
+                                     _mm256_cmpgt_epi32(values, highVector)));
+      }
+      if (_mm256_movemask_ps(_mm256_castsi256_ps(outside)) != 0xff) {
+        return true;
+      }
+    }
+    return HasRelativeInSpanScalar(bytes + i, numPositions - i, low, high);
+  }
+
+  /*
+   * SSE2 lacks a 64-bit comparison, so for 64-bit values the comparison is
+   * built from 32-bit comparisons of the high and low halves.
+   */
+  __attribute__((target("sse2"))) uint64_t InSpanMaskSSE2(
+      const Offset* values, size_t numValues, Offset base,
+      Offset extent) const {
+    uint64_t mask = 0;
+    size_t i = 0;
+    if (sizeof(Offset) == 8) {
+      const __m128i signBit = _mm_set1_epi64x((long long)(1ULL << 63));
+      const __m128i lowSignBit = _mm_set1_epi64x(0x80000000LL);
+      const __m128i baseVector = _mm_set1_epi64x((long long)base);
+      const __m128i extentVector =
+          _mm_xor_si128(_mm_set1_epi64x((long long)extent), signBit);
+      const __m128i extentLow = _mm_xor_si128(extentVector, lowSignBit);
+      for (; i + 2 <= numValues; i += 2) {
+        __m128i relative = _mm_xor_si128(
+            _mm_sub_epi64(_mm_loadu_si128((const __m128i*)(values + i)),
+                          baseVector),
+            signBit);
+        __m128i highGreater = _mm_cmpgt_epi32(relative, extentVector);
+        __m128i highEqual = _mm_cmpeq_epi32(relative, extentVector);
+        __m128i lowGreater = _mm_cmpgt_epi32(
+            _mm_xor_si128(relative, lowSignBit), extentLow);
+        lowGreater = _mm_shuffle_epi32(lowGreater, _MM_SHUFFLE(2, 2, 0, 0));
+        __m128i outside =
+            _mm_or_si128(highGreater, _mm_and_si128(highEqual, lowGreater));
+        mask |= ((uint64_t)(~_mm_movemask_pd(_mm_castsi128_pd(outside)) & 0x3))
+                << i;
+      }
+    } else {
+      const __m128i signBit = _mm_set1_epi32((int)(1U << 31));
+      const __m128i baseVector = _mm_set1_epi32((int)base);
+      const __m128i extentVector =
+          _mm_xor_si128(_mm_set1_epi32((int)extent), signBit);
+      for (; i + 4 <= numValues; i += 4) {
+        __m128i relative = _mm_xor_si128(
+            _mm_sub_epi32(_mm_loadu_si128((const __m128i*)(values + i)),
+                          baseVector),
+            signBit);
+        __m128i outside = _mm_cmpgt_epi32(relative, extentVector);
+        mask |= ((uint64_t)(~_mm_movemask_ps(_mm_castsi128_ps(outside)) & 0xf))
+                << i;
+      }
+    }
+    if (i < numValues) {
+      mask |= InSpanMaskScalar(values + i, numValues - i, base, extent) << i;
+    }
+    return mask;
+  }
+
+  __attribute__((target("sse2"))) bool HasRelativeInSpanSSE2(
+      const char* bytes, size_t numPositions, int32_t low,
+      int32_t high) const {
+    const __m128i lowVector = _mm_set1_epi32(low);
+    const __m128i highVector = _mm_set1_epi32(high);
+    size_t i = 0;
+    for (; i + 16 <= numPositions; i += 16) {
+      __m128i outside = _mm_set1_epi32(-1);
+      for (size_t k = 0; k < 4; k++) {
+        __m128i values = _mm_loadu_si128((const __m128i*)(bytes + i + k));
+        outside = _mm_and_si128(
+            outside, _mm_or_si128(_mm_cmpgt_epi32(lowVector, values),
+                                  _mm_cmpgt_epi32(values, highVector)));
+      }
+      if (_mm_movemask_ps(_mm_castsi128_ps(outside)) != 0xf) {
+        return true;
+      }
+    }
+    return HasRelativeInSpanScalar(bytes + i, numPositions - i, low, high);
+  }
+#endif
+};
+}  // namespace chap
@@ -0,0 +1,38 @@
+// Copyright (c) 2024 Broadcom. All Rights Reserved.
+// The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
+// SPDX-License-Identifier: GPL-2.0
+
+#pragma once
+extern "C" {
+#include <sys/resource.h>
+#include <unistd.h>
+};
+#include <cstdint>
+
+namespace chap {
+/*
+ * Return the largest number of bytes that chap has had resident at any one
+ * time so far, or 0 if this is not known.
+ */
+inline uint64_t PeakResidentSetSize() {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0 || usage.ru_maxrss < 0) {
+    return 0;
+  }
+  // On Linux, ru_maxrss is in kilobytes.
+  return ((uint64_t)(usage.ru_maxrss)) * 1024;
+}
+
+/*
+ * Return the number of bytes of physical memory of the host, or 0 if this
+ * is not known.
+ */
+inline uint64_t PhysicalMemorySize() {
+  long numPages = sysconf(_SC_PHYS_PAGES);
+  long pageSize = sysconf(_SC_PAGESIZE);
+  if (numPages <= 0 || pageSize <= 0) {
+    return 0;
+  }
+  return ((uint64_t)numPages) * ((uint64_t)pageSize);
+}
+}  // namespace chap
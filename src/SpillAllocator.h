@@ -0,0 +1,96 @@
+// Copyright (c) 2024 Broadcom. All Rights Reserved.
+// The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
+// SPDX-License-Identifier: GPL-2.0
+
+#pragma once
+extern "C" {
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+};
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+
+namespace chap {
+/*
+ * This allocator is for vectors that may be too large to keep comfortably
+ * in anonymous memory on a host with limited memory.  If it is asked to
+ * spill, each block is mapped from its own temporary file, which is
+ * unlinked as soon as it is created, so that the kernel can write the pages
+ * back to that file and drop them rather than needing RAM or swap to hold
+ * them.  If no temporary file can be created, anonymous memory is mapped
+ * instead.
+ */
+template <typename T>
+class SpillAllocator {
+ public:
+  typedef T value_type;
+
+  SpillAllocator(bool spill = false) : _spill(spill) {}
+  template <typename U>
+  SpillAllocator(const SpillAllocator<U>& other) : _spill(other.Spills()) {}
+
+  bool Spills() const { return _spill; }
+
+  T* allocate(size_t n) {
+    if (!_spill || n == 0) {
+      return std::allocator<T>().allocate(n);
+    }
+    size_t numBytes = n * sizeof(T);
+    void* block = MAP_FAILED;
+    int fd = MakeTemporaryFile(numBytes);
+    if (fd >= 0) {
+      block = mmap(nullptr, numBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                   0);
+      close(fd);
+    }
+    if (block == MAP_FAILED) {
+      block = mmap(nullptr, numBytes, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (block == MAP_FAILED) {
+        throw std::bad_alloc();
+      }
+    }
+    return (T*)(block);
+  }
+
+  void deallocate(T* p, size_t n) {
+    if (!_spill || n == 0) {
+      std::allocator<T>().deallocate(p, n);
+      return;
+    }
+    (void)munmap(p, n * sizeof(T));
+  }
+
+  template <typename U>
+  bool operator==(const SpillAllocator<U>& other) const {
+    return _spill == other.Spills();
+  }
+  template <typename U>
+  bool operator!=(const SpillAllocator<U>& other) const {
+    return _spill != other.Spills();
+  }
+
+ private:
+  bool _spill;
+
+  static int MakeTemporaryFile(size_t numBytes) {
+    const char* directory = getenv("TMPDIR");
+    std::string path((directory == nullptr || *directory == '\0') ? "/tmp"
+                                                                  : directory);
+    path.append("/chapSpillXXXXXX");
+    int fd = mkstemp(&(path[0]));
+    if (fd < 0) {
+      return -1;
+    }
+    (void)unlink(path.c_str());
+    if (ftruncate(fd, (off_t)(numBytes)) != 0) {
+      close(fd);
+      return -1;
+    }
+    return fd;
+  }
+};
+}  // namespace chap
@@ -61,58 +61,22 @@ class PageMapAllocationFinder : public Allocations::Directory<Offset>::Finder {
   virtual ~PageMapAllocationFinder() {}
 
   /*
-   * Return true if there are no more allocations available.
+   * Append all the allocations found by this finder, in increasing order of
+   * address, to the given buffer.
    */
-  virtual bool Finished() { return _pageMapIterator->Finished(); }
-
-  /*
-   * Return the address of the next allocation (in increasing order of
-   * address) to be reported by this finder, without advancing to the next
-   * allocation.  The return value is undefined if there are no more
-   * allocations available.  Note that at the time this function is called
-   * any allocations already reported by this allocation finder have already
-   * been assigned allocation indices in the Directory.
-   */
-  virtual Offset NextAddress() { return _allocationAddress; }
-  /*
-   * Return the size of the next allocation (in increasing order of
-   * address) to be reported by this finder, without advancing to the next
-   * allocation.  The return value is undefined if there are no more
-   * allocations available.
-   */
-  virtual Offset NextSize() { return _allocationSize; }
-  /*
-   * Return true if the next allocation (in increasing order of address) to
-   * address) to be reported by this finder is considered used, without
-   * advancing to the next allocation.
-   */
-  virtual bool NextIsUsed() { return _allocationIsUsed; }
-  /*
-   * Advance to the next allocation.
-   */
-  virtual void Advance() {
-    if (_pageMapIterator->Finished()) {
-      return;
-    }
-
-    if (++_indexInSpan < _numAllocationsInSpan) {
-      _allocationAddress += _allocationSize;
-      return;
-    }
-
-    _pageMapIterator->Advance();
-    if (_pageMapIterator->Finished()) {
-      CorrectAllocationFreeStatus();
-      return;
+  virtual void FindAllocations(
+      typename Allocations::Directory<Offset>::FoundAllocations& found) {
+    while (!(_pageMapIterator->Finished())) {
+      found.emplace_back(_allocationAddress, _allocationSize,
+                         _allocationIsUsed);
+      Advance();
     }
-
-    _allocationAddress = _pageMapIterator->FirstAddressForSpan();
-    _allocationSize = _pageMapIterator->AllocationSize();
-    _allocationIsUsed = _pageMapIterator->SpanIsUsed();
-    _indexInSpan = 0;
-    _numAllocationsInSpan = _pageMapIterator->NumAllocationsInSpan();
   }
-
+  /*
+   * Correct the free status of allocations that are on free lists or in
+   * caches, now that all the allocations have been assigned indices.
+   */
+  virtual void AllocationsResolved() { CorrectAllocationFreeStatus(); }
   /*
    * Return the smallest request size that might reasonably have resulted
    * in an allocation of the given size.
@@ -420,6 +384,31 @@ class PageMapAllocationFinder : public Allocations::Directory<Offset>::Finder {
       }
     }
   }
+
+  /*
+   * Advance to the next allocation.
+   */
+  void Advance() {
+    if (_pageMapIterator->Finished()) {
+      return;
+    }
+
+    if (++_indexInSpan < _numAllocationsInSpan) {
+      _allocationAddress += _allocationSize;
+      return;
+    }
+
+    _pageMapIterator->Advance();
+    if (_pageMapIterator->Finished()) {
+      return;
+    }
+
+    _allocationAddress = _pageMapIterator->FirstAddressForSpan();
+    _allocationSize = _pageMapIterator->AllocationSize();
+    _allocationIsUsed = _pageMapIterator->SpanIsUsed();
+    _indexInSpan = 0;
+    _numAllocationsInSpan = _pageMapIterator->NumAllocationsInSpan();
+  }
 };
 
 }  // namespace TCMalloc
@@ -1,4 +1,4 @@
-// Copyright (c) 2017-2019,2021-2023 Broadcom. All Rights Reserved.
+// Copyright (c) 2017-2019,2021-2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
@@ -11,14 +11,28 @@ class VirtualAddressMap {
  public:
   typedef OffsetType Offset;
   struct RangeAttributes {
-    RangeAttributes() : _adjustToFileOffset(0), _flags(0) {}
+    RangeAttributes()
+        : _adjustToFileOffset(0), _flags(0), _image(0), _knownZeroBase(0) {}
     RangeAttributes(Offset adjustToFileOffset)
-        : _adjustToFileOffset(adjustToFileOffset), _flags(0) {}
+        : _adjustToFileOffset(adjustToFileOffset),
+          _flags(0),
+          _image(0),
+          _knownZeroBase(0) {}
     RangeAttributes(Offset adjustToFileOffset, int flags)
-        : _adjustToFileOffset(adjustToFileOffset), _flags(flags) {}
+        : _adjustToFileOffset(adjustToFileOffset),
+          _flags(flags),
+          _image(0),
+          _knownZeroBase(0) {}
+    RangeAttributes(Offset adjustToFileOffset, int flags, const char *image,
+                    Offset knownZeroBase)
+        : _adjustToFileOffset(adjustToFileOffset),
+          _flags(flags),
+          _image(image),
+          _knownZeroBase(knownZeroBase) {}
     bool operator==(const RangeAttributes &other) {
       return _adjustToFileOffset == other._adjustToFileOffset &&
-             _flags == other._flags;
+             _flags == other._flags && _image == other._image &&
+             _knownZeroBase == other._knownZeroBase;
     }
     Offset _adjustToFileOffset;
     static const int IS_READABLE = 0x01;
@@ -27,10 +41,43 @@ class VirtualAddressMap {
     static const int HAS_KNOWN_PERMISSIONS = 0x08;
     static const int IS_MAPPED = 0x10;  // mapped, but possibly truncated
     static const int IS_TRUNCATED = 0x20;
+    /*
+     * The range, starting at _knownZeroBase, is known to contain only
+     * zeros, which were omitted from the file.
+     */
+    static const int IS_KNOWN_ZERO = 0x40;
     static const int PERMISSIONS_MASK = 0x0f;
     int _flags;
+    /*
+     * If not null, this is the image of the range, which is used in place
+     * of the image in the file because the file has only part of the range.
+     */
+    const char *_image;
+    Offset _knownZeroBase;
   };
   typedef RangeMapper<Offset, RangeAttributes> RangeFileOffsetMapper;
+
+  /*
+   * Return the image of the range with the given base and attributes, or
+   * null if that range has no image in the file.
+   */
+  static const char *ImageOf(const char *fileImage, Offset base,
+                             const RangeAttributes &attributes) {
+    if ((attributes._flags &
+         (RangeAttributes::IS_MAPPED | RangeAttributes::IS_TRUNCATED)) !=
+        RangeAttributes::IS_MAPPED) {
+      return 0;
+    } else if (attributes._image != 0) {
+      return attributes._image;
+    } else {
+      return fileImage +
+             // The parenthesis matters here because in general this is
+             // counting on overflow of unsigned arithmetic to leave
+             // a potentially smaller file offset than base value.  This
+             // matters for 32 bit cores.
+             (base + attributes._adjustToFileOffset);
+    }
+  }
   template <class OneWayIterator>
   class RangeIterator {
    public:
@@ -51,24 +98,23 @@ class VirtualAddressMap {
 
     const char *GetImage() {
       const typename RangeFileOffsetMapper::Range &range = *_oneWayIterator;
-      if ((range._value._flags &
-           (RangeAttributes::IS_MAPPED | RangeAttributes::IS_TRUNCATED)) !=
-          RangeAttributes::IS_MAPPED) {
-        return 0;
-      } else {
-        return _fileImage +
-               // The parenthesis matters here because in general this is
-               // counting on overflow of unsigned arithmetic to leave
-               // a potentially smaller file offset than base value.  This
-               // matters for 32 bit cores.
-               (range._base + range._value._adjustToFileOffset);
-      }
+      return ImageOf(_fileImage, range._base, range._value);
     }
 
     Offset Base() { return _oneWayIterator->_base; }
     Offset Size() { return _oneWayIterator->_size; }
     Offset Limit() { return _oneWayIterator->_limit; }
     int Flags() { return _oneWayIterator->_value._flags; }
+    /*
+     * Return the address from which the range is known to contain only
+     * zeros, or the limit of the range if there is no such address.
+     */
+    Offset KnownZeroBase() {
+      const typename RangeFileOffsetMapper::Range &range = *_oneWayIterator;
+      return ((range._value._flags & RangeAttributes::IS_KNOWN_ZERO) != 0)
+                 ? range._value._knownZeroBase
+                 : range._limit;
+    }
 
    private:
     OneWayIterator _oneWayIterator;
@@ -89,11 +135,10 @@ class VirtualAddressMap {
    public:
     Reader(const VirtualAddressMap &map)
         : _map(map),
-          _iterator(map.end()),
-          _endIterator(map.end()),
           _image((const char *)0),
           _base(0),
-          _limit(0) {}
+          _limit(0),
+          _nextCachedRangeToReplace(0) {}
     /*
      * This form, which throws an exception if the address is not mapped,
      * should be used only if the address is actually expected to be mapped,
@@ -104,23 +149,9 @@ class VirtualAddressMap {
       if (readLimit < address) {  // wrap
         throw NotMapped(address);
       }
-      if (_base > address || _limit < readLimit) {
-        _image = nullptr;
-        _base = 0;
-        _limit = 0;
-        _iterator = _map.find(address);
-        if (_iterator != _endIterator) {
-          _image = _iterator.GetImage();
-          if (_image != nullptr) {
-            _base = _iterator.Base();
-            _limit = _iterator.Limit();
-          } else {
-            throw NotMapped(address);
-          }
-        }
-        if (readLimit > _limit) {
-          throw NotMapped(address);
-        }
+      if ((_base > address || _limit < readLimit) &&
+          !SelectRange(address, readLimit)) {
+        throw NotMapped(address);
       }
       return *((Offset *)(_image + (address - _base)));
     }
@@ -134,23 +165,9 @@ class VirtualAddressMap {
       if (readLimit < address) {  // wrap
         return defaultValue;
       }
-      if (_base > address || _limit < readLimit) {
-        _image = nullptr;
-        _base = 0;
-        _limit = 0;
-        _iterator = _map.find(address);
-        if (_iterator != _endIterator) {
-          _image = _iterator.GetImage();
-          if (_image != nullptr) {
-            _base = _iterator.Base();
-            _limit = _iterator.Limit();
-          } else {
-            return defaultValue;
-          }
-        }
-        if (readLimit > _limit) {
-          return defaultValue;
-        }
+      if ((_base > address || _limit < readLimit) &&
+          !SelectRange(address, readLimit)) {
+        return defaultValue;
       }
       return *((Offset *)(_image + (address - _base)));
     }
@@ -164,23 +181,9 @@ class VirtualAddressMap {
       if (readLimit < address) {  // wrap
         throw NotMapped(address);
       }
-      if (_base > address || _limit < readLimit) {
-        _image = nullptr;
-        _base = 0;
-        _limit = 0;
-        _iterator = _map.find(address);
-        if (_iterator != _endIterator) {
-          _image = _iterator.GetImage();
-          if (_image != nullptr) {
-            _base = _iterator.Base();
-            _limit = _iterator.Limit();
-          } else {
-            throw NotMapped(address);
-          }
-        }
-        if (readLimit > _limit) {
-          throw NotMapped(address);
-        }
+      if ((_base > address || _limit < readLimit) &&
+          !SelectRange(address, readLimit)) {
+        throw NotMapped(address);
       }
       return *((uint16_t *)(_image + (address - _base)));
     }
@@ -193,23 +196,9 @@ class VirtualAddressMap {
       if (readLimit < address) {  // wrap
         return defaultValue;
       }
-      if (_base > address || _limit < readLimit) {
-        _image = nullptr;
-        _base = 0;
-        _limit = 0;
-        _iterator = _map.find(address);
-        if (_iterator != _endIterator) {
-          _image = _iterator.GetImage();
-          if (_image != nullptr) {
-            _base = _iterator.Base();
-            _limit = _iterator.Limit();
-          } else {
-            return defaultValue;
-          }
-        }
-        if (readLimit > _limit) {
-          return defaultValue;
-        }
+      if ((_base > address || _limit < readLimit) &&
+          !SelectRange(address, readLimit)) {
+        return defaultValue;
       }
       return *((uint16_t *)(_image + (address - _base)));
     }
@@ -223,23 +212,9 @@ class VirtualAddressMap {
       if (readLimit < address) {  // wrap
         throw NotMapped(address);
       }
-      if (_base > address || _limit < readLimit) {
-        _image = nullptr;
-        _base = 0;
-        _limit = 0;
-        _iterator = _map.find(address);
-        if (_iterator != _endIterator) {
-          _image = _iterator.GetImage();
-          if (_image != nullptr) {
-            _base = _iterator.Base();
-            _limit = _iterator.Limit();
-          } else {
-            throw NotMapped(address);
-          }
-        }
-        if (readLimit > _limit) {
-          throw NotMapped(address);
-        }
+      if ((_base > address || _limit < readLimit) &&
+          !SelectRange(address, readLimit)) {
+        throw NotMapped(address);
       }
       return *((uint32_t *)(_image + (address - _base)));
     }
@@ -252,23 +227,9 @@ class VirtualAddressMap {
       if (readLimit < address) {  // wrap
         return defaultValue;
       }
-      if (_base > address || _limit < readLimit) {
-        _image = nullptr;
-        _base = 0;
-        _limit = 0;
-        _iterator = _map.find(address);
-        if (_iterator != _endIterator) {
-          _image = _iterator.GetImage();
-          if (_image != nullptr) {
-            _base = _iterator.Base();
-            _limit = _iterator.Limit();
-          } else {
-            return defaultValue;
-          }
-        }
-        if (readLimit > _limit) {
-          return defaultValue;
-        }
+      if ((_base > address || _limit < readLimit) &&
+          !SelectRange(address, readLimit)) {
+        return defaultValue;
       }
       return *((uint32_t *)(_image + (address - _base)));
     }
@@ -281,23 +242,9 @@ class VirtualAddressMap {
       if (readLimit < address) {  // wrap
         return defaultValue;
       }
-      if (_base > address || _limit < readLimit) {
-        _image = nullptr;
-        _base = 0;
-        _limit = 0;
-        _iterator = _map.find(address);
-        if (_iterator != _endIterator) {
-          _image = _iterator.GetImage();
-          if (_image != nullptr) {
-            _base = _iterator.Base();
-            _limit = _iterator.Limit();
-          } else {
-            return defaultValue;
-          }
-        }
-        if (readLimit > _limit) {
-          return defaultValue;
-        }
+      if ((_base > address || _limit < readLimit) &&
+          !SelectRange(address, readLimit)) {
+        return defaultValue;
       }
       return *((int32_t *)(_image + (address - _base)));
     }
@@ -311,23 +258,9 @@ class VirtualAddressMap {
       if (readLimit < address) {  // wrap
         throw NotMapped(address);
       }
-      if (_base > address || _limit < readLimit) {
-        _image = nullptr;
-        _base = 0;
-        _limit = 0;
-        _iterator = _map.find(address);
-        if (_iterator != _endIterator) {
-          _image = _iterator.GetImage();
-          if (_image != nullptr) {
-            _base = _iterator.Base();
-            _limit = _iterator.Limit();
-          } else {
-            throw NotMapped(address);
-          }
-        }
-        if (readLimit > _limit) {
-          throw NotMapped(address);
-        }
+      if ((_base > address || _limit < readLimit) &&
+          !SelectRange(address, readLimit)) {
+        throw NotMapped(address);
       }
       return *((uint64_t *)(_image + (address - _base)));
     }
@@ -340,23 +273,9 @@ class VirtualAddressMap {
       if (readLimit < address) {  // wrap
         return defaultValue;
       }
-      if (_base > address || _limit < readLimit) {
-        _image = nullptr;
-        _base = 0;
-        _limit = 0;
-        _iterator = _map.find(address);
-        if (_iterator != _endIterator) {
-          _image = _iterator.GetImage();
-          if (_image != nullptr) {
-            _base = _iterator.Base();
-            _limit = _iterator.Limit();
-          } else {
-            return defaultValue;
-          }
-        }
-        if (readLimit > _limit) {
-          return defaultValue;
-        }
+      if ((_base > address || _limit < readLimit) &&
+          !SelectRange(address, readLimit)) {
+        return defaultValue;
       }
       return *((uint64_t *)(_image + (address - _base)));
     }
@@ -370,23 +289,9 @@ class VirtualAddressMap {
       if (readLimit < address) {  // wrap
         throw NotMapped(address);
       }
-      if (_base > address || _limit < readLimit) {
-        _image = nullptr;
-        _base = 0;
-        _limit = 0;
-        _iterator = _map.find(address);
-        if (_iterator != _endIterator) {
-          _image = _iterator.GetImage();
-          if (_image != nullptr) {
-            _base = _iterator.Base();
-            _limit = _iterator.Limit();
-          } else {
-            throw NotMapped(address);
-          }
-        }
-        if (readLimit > _limit) {
-          throw NotMapped(address);
-        }
+      if ((_base > address || _limit < readLimit) &&
+          !SelectRange(address, readLimit)) {
+        throw NotMapped(address);
       }
       return *((uint8_t *)(_image + (address - _base)));
     }
@@ -399,23 +304,9 @@ class VirtualAddressMap {
       if (readLimit < address) {  // wrap
         return defaultValue;
       }
-      if (_base > address || _limit < readLimit) {
-        _image = nullptr;
-        _base = 0;
-        _limit = 0;
-        _iterator = _map.find(address);
-        if (_iterator != _endIterator) {
-          _image = _iterator.GetImage();
-          if (_image != nullptr) {
-            _base = _iterator.Base();
-            _limit = _iterator.Limit();
-          } else {
-            return defaultValue;
-          }
-        }
-        if (readLimit > _limit) {
-          return defaultValue;
-        }
+      if ((_base > address || _limit < readLimit) &&
+          !SelectRange(address, readLimit)) {
+        return defaultValue;
       }
       return *((uint8_t *)(_image + (address - _base)));
     }
@@ -427,20 +318,9 @@ class VirtualAddressMap {
      * trailing '\0'.
      */
     size_t ReadCString(Offset address, char *buffer, size_t bufferSize) {
-      if (_base > address || _limit <= address) {
-        _image = nullptr;
-        _base = 0;
-        _limit = 0;
-        _iterator = _map.find(address);
-        if (_iterator == _endIterator) {
-          return 0;
-        }
-        _image = _iterator.GetImage();
-        if (_image == nullptr) {
-          return 0;
-        }
-        _base = _iterator.Base();
-        _limit = _iterator.Limit();
+      if ((_base > address || _limit <= address) &&
+          !SelectRange(address, address + 1)) {
+        return 0;
       }
       size_t maxStringLenPlus1 = bufferSize;
       if ((address + bufferSize > _limit) || (address + bufferSize < address)) {
@@ -455,36 +335,88 @@ class VirtualAddressMap {
       return stringLength;
     }
 
+    /*
+     * Start bringing the image at the given address into the cache, so that
+     * a later read there is less likely to wait for memory.  This does
+     * nothing unless the address is in one of the ranges the reader
+     * remembers, so that a prefetch never costs a search of the map.
+     */
+    void Prefetch(Offset address) const {
+      for (const CachedRange &cachedRange : _cachedRanges) {
+        if (cachedRange._base <= address && address < cachedRange._limit) {
+          __builtin_prefetch(cachedRange._image +
+                             (address - cachedRange._base));
+          return;
+        }
+      }
+    }
+
     template <typename T>
     void Read(Offset address, T *valueRead) {
-      if (_base > address || _limit < address + sizeof(T)) {
-        _image = nullptr;
-        _base = 0;
-        _limit = 0;
-        _iterator = _map.find(address);
-        if (_iterator != _endIterator) {
-          _image = _iterator.GetImage();
-          if (_image != nullptr) {
-            _base = _iterator.Base();
-            _limit = _iterator.Limit();
-          } else {
-            throw NotMapped(address);
-          }
-        }
-        if (address + sizeof(T) > _limit) {
-          throw NotMapped(address);
-        }
+      if ((_base > address || _limit < address + sizeof(T)) &&
+          !SelectRange(address, address + sizeof(T))) {
+        throw NotMapped(address);
       }
       *valueRead = *((T *)(_image + (address - _base)));
     }
 
    private:
+    /*
+     * A reader remembers the last few imaged ranges it has used, because
+     * following references tends to alternate among a few ranges, such as
+     * those for a heap, a stack and a module.
+     */
+    static constexpr size_t NUM_CACHED_RANGES = 4;
+    struct CachedRange {
+      CachedRange() : _image((const char *)0), _base(0), _limit(0) {}
+      const char *_image;
+      Offset _base;
+      Offset _limit;
+    };
     const VirtualAddressMap &_map;
-    typename VirtualAddressMap::const_iterator _iterator;
-    typename VirtualAddressMap::const_iterator _endIterator;
     const char *_image;
     Offset _base;
     Offset _limit;
+    CachedRange _cachedRanges[NUM_CACHED_RANGES];
+    size_t _nextCachedRangeToReplace;
+
+    /*
+     * Make the imaged range containing the given address, if any, the
+     * current one, then return true if the entire read is within that range.
+     */
+    bool SelectRange(Offset address, Offset readLimit) {
+      for (const CachedRange &cachedRange : _cachedRanges) {
+        if (cachedRange._base <= address && address < cachedRange._limit) {
+          _image = cachedRange._image;
+          _base = cachedRange._base;
+          _limit = cachedRange._limit;
+          return readLimit <= _limit;
+        }
+      }
+      _image = nullptr;
+      _base = 0;
+      _limit = 0;
+      Offset base;
+      Offset size;
+      RangeAttributes attributes;
+      if (!_map._ranges.FindRange(address, base, size, attributes)) {
+        return false;
+      }
+      const char *image = _map.ImageOf(base, attributes);
+      if (image == nullptr) {
+        return false;
+      }
+      _image = image;
+      _base = base;
+      _limit = base + size;
+      CachedRange &cachedRange = _cachedRanges[_nextCachedRangeToReplace];
+      cachedRange._image = _image;
+      cachedRange._base = _base;
+      cachedRange._limit = _limit;
+      _nextCachedRangeToReplace =
+          (_nextCachedRangeToReplace + 1) % NUM_CACHED_RANGES;
+      return readLimit <= _limit;
+    }
   };
   VirtualAddressMap(const FileImage &fileImage)
       : _fileImage(fileImage), _fileSize((Offset)(fileImage.GetFileSize())) {}
@@ -507,6 +439,16 @@ class VirtualAddressMap {
     return const_iterator(_ranges.upper_bound(addr), _fileImage.GetImage());
   }
 
+  const char *ImageOf(Offset base, const RangeAttributes &attributes) const {
+    return ImageOf(_fileImage.GetImage(), base, attributes);
+  }
+
+  /*
+   * Make the map immutable, which allows faster lookups by address.  This
+   * should be done once all the ranges have been added.
+   */
+  void Freeze() { _ranges.Freeze(); }
+
   Offset FindMappedMemoryImage(Offset addr, const char **image) const {
     const_iterator it = find(addr);
     if (it != end()) {
@@ -532,22 +474,11 @@ class VirtualAddressMap {
                 bool isMapped, bool hasKnownPermissions, bool readable,
                 bool writable, bool executable) {
     // TODO: add error handling
-    int flags = 0;
+    int flags =
+        PermissionFlags(hasKnownPermissions, readable, writable, executable);
     if (isMapped) {
       flags |= RangeAttributes::IS_MAPPED;
     }
-    if (hasKnownPermissions) {
-      flags |= RangeAttributes::HAS_KNOWN_PERMISSIONS;
-      if (readable) {
-        flags |= RangeAttributes::IS_READABLE;
-      }
-      if (writable) {
-        flags |= RangeAttributes::IS_WRITABLE;
-      }
-      if (executable) {
-        flags |= RangeAttributes::IS_EXECUTABLE;
-      }
-    }
 
     Offset limit = rangeAddr + rangeSize + adjustToFileOffset;
     bool overlap = false;
@@ -585,11 +516,91 @@ class VirtualAddressMap {
     }
   }
 
+  /*
+   * Add a range of which only the first sizeInFile bytes are present in the
+   * file, where the rest of the range is known to contain only zeros, as
+   * happens in cores written by tools that omit zero pages.  The range is
+   * kept whole, with an image that reads the zeros without using space in
+   * the file or memory.  Return false, having added nothing, if the part of
+   * the range that should be in the file is not all present, if no such
+   * image can be made, or, after reporting the overlap, if the range
+   * overlaps one already in the map.  A range that immediately precedes the
+   * new one, in both the address space and the file, with the same
+   * permissions, becomes part of the new range, just as AddRange would have
+   * coalesced the two.
+   */
+  bool AddRangeWithKnownZeroTail(Offset rangeAddr, Offset rangeSize,
+                                 Offset sizeInFile, Offset adjustToFileOffset,
+                                 bool hasKnownPermissions, bool readable,
+                                 bool writable, bool executable) {
+    Offset fileOffset = rangeAddr + adjustToFileOffset;
+    if (sizeInFile > rangeSize || fileOffset > _fileSize ||
+        sizeInFile > _fileSize - fileOffset) {
+      return false;
+    }
+    typename RangeFileOffsetMapper::const_iterator itAfter =
+        _ranges.upper_bound(rangeAddr);
+    if (itAfter != _ranges.end() && itAfter->_base < rangeAddr + rangeSize) {
+      std::cerr << "Warning: the range [0x" << std::hex << rangeAddr << ", 0x"
+                << (rangeAddr + rangeSize)
+                << ") overlaps the range already mapped at [0x"
+                << itAfter->_base << ", 0x" << itAfter->_limit << ").\n";
+      return false;
+    }
+    int permissionFlags =
+        PermissionFlags(hasKnownPermissions, readable, writable, executable);
+    Offset precedingSize = 0;
+    if (rangeAddr != 0) {
+      typename RangeFileOffsetMapper::const_iterator it =
+          _ranges.find(rangeAddr - 1);
+      if (it != _ranges.end() &&
+          it->_value._flags ==
+              (permissionFlags | RangeAttributes::IS_MAPPED) &&
+          it->_value._adjustToFileOffset == adjustToFileOffset) {
+        precedingSize = it->_size;
+      }
+    }
+    const char *image = _fileImage.ImageWithZeroTail(
+        fileOffset - precedingSize, precedingSize + sizeInFile,
+        precedingSize + rangeSize);
+    if (image == 0) {
+      return false;
+    }
+    if (precedingSize != 0) {
+      _ranges.UnmapRange(rangeAddr - precedingSize, precedingSize);
+    }
+    int flags = permissionFlags | RangeAttributes::IS_MAPPED |
+                RangeAttributes::IS_KNOWN_ZERO;
+    /*
+     * This cannot fail, because any overlap was ruled out above.
+     */
+    _ranges.MapRange(rangeAddr - precedingSize, precedingSize + rangeSize,
+                     RangeAttributes(adjustToFileOffset, flags, image,
+                                     rangeAddr + sizeInFile));
+    return true;
+  }
+
   // TODO: resolve error handling for references
-  // TODO: handle 0-page omission where dump format allows it and it
-  //       makes sense
 
  private:
+  static int PermissionFlags(bool hasKnownPermissions, bool readable,
+                             bool writable, bool executable) {
+    int flags = 0;
+    if (hasKnownPermissions) {
+      flags |= RangeAttributes::HAS_KNOWN_PERMISSIONS;
+      if (readable) {
+        flags |= RangeAttributes::IS_READABLE;
+      }
+      if (writable) {
+        flags |= RangeAttributes::IS_WRITABLE;
+      }
+      if (executable) {
+        flags |= RangeAttributes::IS_EXECUTABLE;
+      }
+    }
+    return flags;
+  }
+
   const FileImage &_fileImage;
   Offset _fileSize;
   RangeFileOffsetMapper _ranges;
@@ -1,10 +1,11 @@
-// Copyright (c) 2023 Broadcom. All Rights Reserved.
+// Copyright (c) 2023-2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
 #pragma once
 #include "../Commands/Runner.h"
 #include "../Commands/Subcommand.h"
+#include "../ReferenceScanner.h"
 #include "../VirtualAddressMap.h"
 #include "AddressFilter.h"
 namespace chap {
@@ -14,11 +15,13 @@ class DescribeRangeRefs : public Commands::Subcommand {
  public:
   typedef VirtualAddressMap<Offset> AddressMap;
   DescribeRangeRefs(const ProcessImage<Offset>& processImage,
-                    const CompoundDescriber<Offset>& describer)
+                    const CompoundDescriber<Offset>& describer,
+                    const ReferenceScanner<Offset>& scanner)
       : Commands::Subcommand("describe", "rangerefs"),
         _processImage(processImage),
         _addressMap(processImage.GetVirtualAddressMap()),
-        _describer(describer) {}
+        _describer(describer),
+        _scanner(scanner) {}
 
   void ShowHelpMessage(Commands::Context& context) {
     context.GetOutput() << "Use \"describe rangerefs <start> <limit>\" to "
@@ -50,31 +53,17 @@ class DescribeRangeRefs : public Commands::Subcommand {
     }
     Commands::Output& output = context.GetOutput();
     bool filterIsActive = addressFilter.IsActive();
-    typename AddressMap::const_iterator itEnd = _addressMap.end();
-    for (typename AddressMap::const_iterator it = _addressMap.begin();
-         it != itEnd; ++it) {
-      const char* rangeImage = it.GetImage();
-      if (rangeImage != (const char*)0) {
-        const Offset* nextCandidate = (const Offset*)(rangeImage);
-        Offset numCandidates = it.Size() / sizeof(Offset);
-
-        for (const Offset* limit = nextCandidate + numCandidates;
-             nextCandidate < limit; nextCandidate++) {
-          Offset maybeInRange = *nextCandidate;
-          if (maybeInRange >= rangeStart && maybeInRange < rangeLimit) {
-            Offset refAddr =
-                it.Base() + ((const char*)nextCandidate - rangeImage);
-            if (refAddr < rangeStart || refAddr >= rangeLimit) {
-              if (filterIsActive && addressFilter.Exclude(refAddr)) {
-                continue;
-              }
-              output << std::hex << refAddr << "\n";
-              _describer.Describe(context, refAddr, false, true);
-              output << "\n";
-            }
-          }
-        }
+    for (Offset refAddr :
+         _scanner.FindPointersInRange(rangeStart, rangeLimit)) {
+      if (refAddr >= rangeStart && refAddr < rangeLimit) {
+        continue;
+      }
+      if (filterIsActive && addressFilter.Exclude(refAddr)) {
+        continue;
       }
+      output << std::hex << refAddr << "\n";
+      _describer.Describe(context, refAddr, false, true);
+      output << "\n";
     }
   }
 
@@ -82,6 +71,7 @@ class DescribeRangeRefs : public Commands::Subcommand {
   const ProcessImage<Offset>& _processImage;
   const AddressMap& _addressMap;
   const CompoundDescriber<Offset>& _describer;
+  const ReferenceScanner<Offset>& _scanner;
 };
 }  // namespace VirtualAddressMapCommands
 }  // namespace chap
@@ -1,10 +1,11 @@
-// Copyright (c) 2019-2023 Broadcom. All Rights Reserved.
+// Copyright (c) 2019-2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
 #pragma once
 #include "../Commands/Runner.h"
 #include "../Commands/Subcommand.h"
+#include "../ReferenceScanner.h"
 #include "../VirtualAddressMap.h"
 #include "AddressFilter.h"
 namespace chap {
@@ -13,23 +14,30 @@ template <class Offset>
 class EnumeratePointers : public Commands::Subcommand {
  public:
   typedef VirtualAddressMap<Offset> AddressMap;
-  EnumeratePointers(const ProcessImage<Offset>& processImage)
+  EnumeratePointers(const ProcessImage<Offset>& processImage,
+                    const ReferenceScanner<Offset>& scanner)
       : Commands::Subcommand("enumerate", "pointers"),
         _processImage(processImage),
-        _addressMap(processImage.GetVirtualAddressMap()) {}
+        _addressMap(processImage.GetVirtualAddressMap()),
+        _scanner(scanner) {}
 
   void ShowHelpMessage(Commands::Context& context) {
-    context.GetOutput() << "Use \"enumerate pointers <address>\" to enumerate "
-                           "all pointer-aligned addresses\nthat point "
-                           "to the given address.\n";
+    context.GetOutput() << "Use \"enumerate pointers <address>...\" to "
+                           "enumerate all pointer-aligned\naddresses that "
+                           "point to any of the given addresses.\n";
   }
 
   void Run(Commands::Context& context) {
-    Offset valueToMatch;
-    bool hasErrors = false;
-    if (context.GetNumPositionals() != 3 ||
-        !context.ParsePositional(2, valueToMatch)) {
-      hasErrors = true;
+    size_t numPositionals = context.GetNumPositionals();
+    std::vector<Offset> valuesToMatch;
+    bool hasErrors = (numPositionals < 3);
+    for (size_t i = 2; i < numPositionals; i++) {
+      Offset valueToMatch;
+      if (context.ParsePositional(i, valueToMatch)) {
+        valuesToMatch.push_back(valueToMatch);
+      } else {
+        hasErrors = true;
+      }
     }
 
     AddressFilter<Offset> addressFilter(_processImage, context);
@@ -37,40 +45,26 @@ class EnumeratePointers : public Commands::Subcommand {
       hasErrors = true;
     }
     if (hasErrors) {
-      context.GetError() << "Use \"enumerate pointers <address>\" to enumerate "
-                            "all pointer-aligned addresses\nthat point "
-                            "to the given address.\n";
+      context.GetError() << "Use \"enumerate pointers <address>...\" to "
+                            "enumerate all pointer-aligned\naddresses that "
+                            "point to any of the given addresses.\n";
       return;
     }
     Commands::Output& output = context.GetOutput();
     output << std::hex;
     bool filterIsActive = addressFilter.IsActive();
-    typename AddressMap::const_iterator itEnd = _addressMap.end();
-    for (typename AddressMap::const_iterator it = _addressMap.begin();
-         it != itEnd; ++it) {
-      Offset numCandidates = it.Size() / sizeof(Offset);
-      const char* rangeImage = it.GetImage();
-      if (rangeImage != (const char*)0) {
-        const Offset* nextCandidate = (const Offset*)(rangeImage);
-
-        for (const Offset* limit = nextCandidate + numCandidates;
-             nextCandidate < limit; nextCandidate++) {
-          if (*nextCandidate == valueToMatch) {
-            Offset pointerAddress =
-                ((it.Base()) + ((const char*)nextCandidate - rangeImage));
-            if (filterIsActive && addressFilter.Exclude(pointerAddress)) {
-              continue;
-            }
-            output << pointerAddress << "\n";
-          }
-        }
+    for (Offset pointerAddress : _scanner.FindPointers(valuesToMatch)) {
+      if (filterIsActive && addressFilter.Exclude(pointerAddress)) {
+        continue;
       }
+      output << pointerAddress << "\n";
     }
   }
 
  private:
   const ProcessImage<Offset>& _processImage;
   const AddressMap& _addressMap;
+  const ReferenceScanner<Offset>& _scanner;
 };
 }  // namespace VirtualAddressMapCommands
 }  // namespace chap
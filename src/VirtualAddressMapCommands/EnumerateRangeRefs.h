@@ -1,10 +1,11 @@
-// Copyright (c) 2020-2023 Broadcom. All Rights Reserved.
+// Copyright (c) 2020-2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
 #pragma once
 #include "../Commands/Runner.h"
 #include "../Commands/Subcommand.h"
+#include "../ReferenceScanner.h"
 #include "../VirtualAddressMap.h"
 #include "AddressFilter.h"
 namespace chap {
@@ -13,10 +14,12 @@ template <class Offset>
 class EnumerateRangeRefs : public Commands::Subcommand {
  public:
   typedef VirtualAddressMap<Offset> AddressMap;
-  EnumerateRangeRefs(const ProcessImage<Offset>& processImage)
+  EnumerateRangeRefs(const ProcessImage<Offset>& processImage,
+                     const ReferenceScanner<Offset>& scanner)
       : Commands::Subcommand("enumerate", "rangerefs"),
         _processImage(processImage),
-        _addressMap(processImage.GetVirtualAddressMap()) {}
+        _addressMap(processImage.GetVirtualAddressMap()),
+        _scanner(scanner) {}
 
   void ShowHelpMessage(Commands::Context& context) {
     context.GetOutput() << "Use \"enumerate rangerefs <start> <limit>\" to "
@@ -49,35 +52,22 @@ class EnumerateRangeRefs : public Commands::Subcommand {
     Commands::Output& output = context.GetOutput();
     bool filterIsActive = addressFilter.IsActive();
     output << std::hex;
-    typename AddressMap::const_iterator itEnd = _addressMap.end();
-    for (typename AddressMap::const_iterator it = _addressMap.begin();
-         it != itEnd; ++it) {
-      const char* rangeImage = it.GetImage();
-      if (rangeImage != (const char*)0) {
-        const Offset* nextCandidate = (const Offset*)(rangeImage);
-        Offset numCandidates = it.Size() / sizeof(Offset);
-
-        for (const Offset* limit = nextCandidate + numCandidates;
-             nextCandidate < limit; nextCandidate++) {
-          Offset maybeInRange = *nextCandidate;
-          if (maybeInRange >= rangeStart && maybeInRange < rangeLimit) {
-            Offset refAddr =
-                it.Base() + ((const char*)nextCandidate - rangeImage);
-            if (refAddr < rangeStart || refAddr >= rangeLimit) {
-              if (filterIsActive && addressFilter.Exclude(refAddr)) {
-                continue;
-              }
-              output << std::hex << refAddr << "\n";
-            }
-          }
-        }
+    for (Offset refAddr :
+         _scanner.FindPointersInRange(rangeStart, rangeLimit)) {
+      if (refAddr >= rangeStart && refAddr < rangeLimit) {
+        continue;
+      }
+      if (filterIsActive && addressFilter.Exclude(refAddr)) {
+        continue;
       }
+      output << std::hex << refAddr << "\n";
     }
   }
 
  private:
   const ProcessImage<Offset>& _processImage;
   const AddressMap& _addressMap;
+  const ReferenceScanner<Offset>& _scanner;
 };
 }  // namespace VirtualAddressMapCommands
 }  // namespace chap
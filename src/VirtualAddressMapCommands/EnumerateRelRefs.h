@@ -1,10 +1,11 @@
-// Copyright (c) 2019 Broadcom. All Rights Reserved.
+// Copyright (c) 2019,2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
 #pragma once
 #include "../Commands/Runner.h"
 #include "../Commands/Subcommand.h"
+#include "../ReferenceScanner.h"
 #include "../VirtualAddressMap.h"
 namespace chap {
 namespace VirtualAddressMapCommands {
@@ -12,50 +13,47 @@ template <class Offset>
 class EnumerateRelRefs : public Commands::Subcommand {
  public:
   typedef VirtualAddressMap<Offset> AddressMap;
-  EnumerateRelRefs(const AddressMap& addressMap)
-      : Commands::Subcommand("enumerate", "relrefs"), _addressMap(addressMap) {}
+  EnumerateRelRefs(const ReferenceScanner<Offset>& scanner)
+      : Commands::Subcommand("enumerate", "relrefs"), _scanner(scanner) {}
 
   void ShowHelpMessage(Commands::Context& context) {
-    context.GetOutput() << "Use \"enumerate relrefs <address>\" to enumerate "
-                           "all  addresses that contain a\nsigned 32-bit "
-                           "integer that, when added to the address just after "
-                           "the integer,\nyields the requested address.\n";
+    context.GetOutput() << "Use \"enumerate relrefs <address>...\" to "
+                           "enumerate all addresses that contain\na signed "
+                           "32-bit integer that, when added to the address "
+                           "just after the\ninteger, yields any of the "
+                           "requested addresses.\n";
   }
 
   void Run(Commands::Context& context) {
-    Offset valueToMatch;
-    if (context.GetNumTokens() != 3 || !context.ParseTokenAt(2, valueToMatch)) {
+    size_t numTokens = context.GetNumTokens();
+    std::vector<Offset> valuesToMatch;
+    bool hasErrors = (numTokens < 3);
+    for (size_t i = 2; i < numTokens; i++) {
+      Offset valueToMatch;
+      if (context.ParseTokenAt(i, valueToMatch)) {
+        valuesToMatch.push_back(valueToMatch);
+      } else {
+        hasErrors = true;
+      }
+    }
+    if (hasErrors) {
       context.GetError()
-          << "Use \"enumerate relrefs <address>\" to enumerate "
-             "all  addresses that contain a\nsigned 32-bit "
-             "integer that, when added to the address just after "
-             "the integer,\nyields the requested address.\n";
+          << "Use \"enumerate relrefs <address>...\" to "
+             "enumerate all addresses that contain\na signed "
+             "32-bit integer that, when added to the address "
+             "just after the\ninteger, yields any of the "
+             "requested addresses.\n";
       return;
     }
     Commands::Output& output = context.GetOutput();
     output << std::hex;
-    typename AddressMap::const_iterator itEnd = _addressMap.end();
-    for (typename AddressMap::const_iterator it = _addressMap.begin();
-         it != itEnd; ++it) {
-      const char* rangeImage = it.GetImage();
-      if (rangeImage != (const char*)0) {
-        const unsigned char* nextCandidate = (const unsigned char*)(rangeImage);
-
-        Offset addr = it.Base();
-        for (const unsigned char* limit =
-                 nextCandidate + it.Size() - sizeof(int) + 1;
-             nextCandidate < limit; nextCandidate++) {
-          if (addr + sizeof(int) + *(int*)(nextCandidate) == valueToMatch) {
-            output << std::hex << addr << "\n";
-          }
-          addr++;
-        }
-      }
+    for (Offset addr : _scanner.FindRelativeReferences(valuesToMatch)) {
+      output << addr << "\n";
     }
   }
 
  private:
-  const AddressMap& _addressMap;
+  const ReferenceScanner<Offset>& _scanner;
 };
 }  // namespace VirtualAddressMapCommands
 }  // namespace chap
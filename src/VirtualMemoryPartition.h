@@ -1,4 +1,4 @@
-// Copyright (c) 2017-2019, 2023 Broadcom. All Rights Reserved.
+// Copyright (c) 2017-2019, 2023-2024 Broadcom. All Rights Reserved.
 // The term "Broadcom" refers to Broadcom Inc. and/or its subsidiaries.
 // SPDX-License-Identifier: GPL-2.0
 
@@ -133,6 +133,8 @@ class VirtualMemoryPartition {
     return _staticAnchorCandidates;
   }
 
+  const ClaimedRanges &GetClaimedRanges() const { return _claimedRanges; }
+
   const ClaimedRanges &GetClaimedWritableRanges() const {
     return _claimedWritableRanges;
   }
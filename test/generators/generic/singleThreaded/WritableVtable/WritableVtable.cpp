@@ -0,0 +1,43 @@
+#include <string.h>
+#include <sys/mman.h>
+#include <typeinfo>
+
+/*
+ * Some linkers have been known to leave vtables in writable memory.  This
+ * simulates that case, in memory that does not belong to any module, by
+ * copying the vtable for Shape, including the offset to the top and the
+ * pointer to the type_info that precede the address used as the vtable
+ * pointer, to an anonymous writable mapping and pointing the vtable pointers
+ * of some allocated Shape instances there.  The type_info and its mangled
+ * name are copied as well, with the name in read-only memory, so that the
+ * name can be found from the core alone.
+ */
+struct Shape {
+  Shape(int sides) : _sides(sides) {}
+  virtual ~Shape() {}
+  virtual int Sides() const { return _sides; }
+  int _sides;
+};
+
+int main(int, char **, char **) {
+  char *mapped = (char *)mmap(0, 0x2000, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  void **writableVtable = (void **)(mapped) + 2;
+  void **typeInfoCopy = (void **)(mapped + 0x100);
+  char *nameCopy = mapped + 0x1000;
+  Shape *shapes[3];
+  for (int i = 0; i < 3; i++) {
+    shapes[i] = new Shape(i + 3);
+  }
+  void **vtable = *(void ***)(shapes[0]);
+  memcpy(writableVtable - 2, vtable - 2, 5 * sizeof(void *));
+  memcpy(typeInfoCopy, (void *)(&typeid(Shape)), 2 * sizeof(void *));
+  strcpy(nameCopy, typeid(Shape).name());
+  typeInfoCopy[1] = nameCopy;
+  writableVtable[-1] = typeInfoCopy;
+  mprotect(nameCopy, 0x1000, PROT_READ);
+  for (int i = 0; i < 2; i++) {
+    *(void ***)(shapes[i]) = writableVtable;
+  }
+  *((int *)(0)) = 92;
+}